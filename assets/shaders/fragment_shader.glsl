@@ -1,10 +1,16 @@
 #version 450 core
 
+uniform float alpha;
+uniform float chunk_size;
+
 in vec3 pos;
 in float norm;
-out vec3 color;
+flat in float block;
+out vec4 color;
 
 void main() {
-  color = vec3(pos.x / 33, pos.y / 33, pos.z / 33);
-  color *= (norm + 5) / 10;
+  color.rgb = pos / (chunk_size + 1);
+  color.rgb *= (norm + 5) / 10;
+  color.rgb *= 0.75 + 0.25 * fract(block * 0.618);
+  color.a = alpha;
 }
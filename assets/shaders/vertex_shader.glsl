@@ -3,18 +3,23 @@
 uniform mat4 projection_matrix;
 uniform mat4 view_matrix;
 uniform vec3 chunk_position;
+uniform float chunk_size;
 
 in float vertex_position;
 in float vertex_normal;
 out vec3 pos;
 out float norm;
+flat out float block;
 
 void main() {
-  pos[0] = round(mod(vertex_position, 33));
-  pos[1] = floor(mod(vertex_position / 33, 33));
-  pos[2] = floor(vertex_position / (33 * 33));
+  float stride = chunk_size + 1;
 
-  norm = vertex_normal;
+  pos[0] = round(mod(vertex_position, stride));
+  pos[1] = floor(mod(vertex_position / stride, stride));
+  pos[2] = floor(vertex_position / (stride * stride));
 
-  gl_Position = projection_matrix * view_matrix * vec4(pos + chunk_position * 32, 1.0);
+  norm = round(mod(vertex_normal, 6));
+  block = floor(vertex_normal / 6);
+
+  gl_Position = projection_matrix * view_matrix * vec4(pos + chunk_position * chunk_size, 1.0);
 }
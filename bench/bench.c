@@ -0,0 +1,71 @@
+#include "bench.h"
+
+#include "metrics.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct Benchmark {
+  const char *name;
+  void (*run)(void);
+} Benchmark;
+
+static const Benchmark benchmarks[] = {
+    {"block_update", bench_block_update},
+    {"collision", bench_collision},
+    {"dag", bench_dag},
+    {"fluid", bench_fluid},
+    {"heightmap", bench_heightmap},
+    {"light", bench_light},
+    {"mesh", bench_mesh},
+    {"path", bench_path},
+    {"raycast", bench_raycast},
+    {"region", bench_region},
+    {"replay", bench_replay},
+    {"residency", bench_residency},
+    {"sections", bench_sections},
+    {"simulation", bench_simulation},
+    {"stream", bench_stream},
+};
+
+double bench_now(void) {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+
+  return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+int bench_compare_double(const void *a, const void *b) {
+  double value_a = *(const double *)a;
+  double value_b = *(const double *)b;
+
+  return (value_a > value_b) - (value_a < value_b);
+}
+
+int main(int argc, char **argv) {
+  unsigned int benchmark_count = sizeof(benchmarks) / sizeof(Benchmark);
+  const char *metrics_target = getenv("VOXEL_METRICS");
+
+  if (metrics_target != NULL) {
+    metrics_open(metrics_target, 1);
+  }
+
+  for (unsigned int i = 0; i < benchmark_count; i++) {
+    bool selected = argc == 1;
+
+    for (int j = 1; j < argc; j++) {
+      selected |= strcmp(argv[j], benchmarks[i].name) == 0;
+    }
+
+    if (selected) {
+      benchmarks[i].run();
+      metrics_tick();
+    }
+  }
+
+  metrics_close();
+
+  return 0;
+}
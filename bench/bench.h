@@ -0,0 +1,35 @@
+#pragma once
+
+double bench_now(void);
+
+int bench_compare_double(const void *a, const void *b);
+
+void bench_block_update(void);
+
+void bench_collision(void);
+
+void bench_dag(void);
+
+void bench_fluid(void);
+
+void bench_heightmap(void);
+
+void bench_light(void);
+
+void bench_mesh(void);
+
+void bench_path(void);
+
+void bench_raycast(void);
+
+void bench_region(void);
+
+void bench_replay(void);
+
+void bench_residency(void);
+
+void bench_sections(void);
+
+void bench_simulation(void);
+
+void bench_stream(void);
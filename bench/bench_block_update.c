@@ -0,0 +1,191 @@
+#include "bench.h"
+
+#include "block_update.h"
+#include "world.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define bench_block_update_count 2000000
+#define bench_block_update_horizon 6000
+#define bench_block_update_long_horizon (1 << 20)
+
+typedef struct BenchHeapEntry {
+  uint64_t due;
+  uint32_t id;
+} BenchHeapEntry;
+
+typedef struct BenchHeap {
+  BenchHeapEntry *entries;
+  unsigned int size;
+} BenchHeap;
+
+static void bench_block_update_noop(BlockUpdateContext *context,
+                                    const Vec3i block, uint32_t data) {}
+
+static uint32_t bench_block_update_delay(void) {
+  if (rand() % 10 == 0) {
+    return 1 + rand() % bench_block_update_long_horizon;
+  }
+
+  return 1 + rand() % bench_block_update_horizon;
+}
+
+static void bench_heap_push(BenchHeap *heap, BenchHeapEntry entry) {
+  unsigned int index = heap->size++;
+
+  while (index > 0 && heap->entries[(index - 1) / 2].due > entry.due) {
+    heap->entries[index] = heap->entries[(index - 1) / 2];
+    index = (index - 1) / 2;
+  }
+
+  heap->entries[index] = entry;
+}
+
+static BenchHeapEntry bench_heap_pop(BenchHeap *heap) {
+  BenchHeapEntry top = heap->entries[0];
+  BenchHeapEntry last = heap->entries[--heap->size];
+  unsigned int index = 0;
+
+  while (true) {
+    unsigned int child = index * 2 + 1;
+
+    if (child >= heap->size) {
+      break;
+    }
+
+    if (child + 1 < heap->size &&
+        heap->entries[child + 1].due < heap->entries[child].due) {
+      child++;
+    }
+
+    if (heap->entries[child].due >= last.due) {
+      break;
+    }
+
+    heap->entries[index] = heap->entries[child];
+    index = child;
+  }
+
+  if (heap->size != 0) {
+    heap->entries[index] = last;
+  }
+
+  return top;
+}
+
+static void bench_block_update_heap(const uint32_t *delays,
+                                    const bool *cancelled) {
+  BenchHeap heap = {malloc(sizeof(BenchHeapEntry) * bench_block_update_count),
+                    0};
+
+  double start = bench_now();
+
+  for (unsigned int i = 0; i < bench_block_update_count; i++) {
+    bench_heap_push(&heap, (BenchHeapEntry){delays[i], i});
+  }
+
+  double schedule_elapsed = bench_now() - start;
+  unsigned int executed = 0;
+  start = bench_now();
+
+  for (uint64_t tick = 1; tick <= bench_block_update_horizon; tick++) {
+    while (heap.size != 0 && heap.entries[0].due <= tick) {
+      executed += !cancelled[bench_heap_pop(&heap).id];
+    }
+  }
+
+  double tick_elapsed = bench_now() - start;
+
+  printf("block_update: heap   schedule %.1f ns/op, %u ticks %.3f ms/tick, "
+         "%u executed\n",
+         schedule_elapsed * 1e9 / bench_block_update_count,
+         bench_block_update_horizon,
+         tick_elapsed * 1e3 / bench_block_update_horizon, executed);
+
+  free(heap.entries);
+}
+
+void bench_block_update(void) {
+  World *world = calloc(1, sizeof(World));
+  world_init_headless(world);
+  world_fill(world, (Vec3i){render_distance / 2, render_distance / 2,
+                            render_distance / 2});
+
+  BlockUpdateScheduler *scheduler = &world->updates;
+  BlockUpdateKind kind = block_update_register(bench_block_update_noop);
+  int extent = render_distance * chunk_size;
+
+  Vec3i *blocks = malloc(sizeof(Vec3i) * bench_block_update_count);
+  uint32_t *delays = malloc(sizeof(uint32_t) * bench_block_update_count);
+  bool *cancelled = calloc(bench_block_update_count, sizeof(bool));
+  BlockUpdateHandle *handles =
+      malloc(sizeof(BlockUpdateHandle) * bench_block_update_count);
+  srand(1);
+
+  for (unsigned int i = 0; i < bench_block_update_count; i++) {
+    blocks[i][0] = rand() % extent;
+    blocks[i][1] = rand() % extent;
+    blocks[i][2] = rand() % extent;
+    delays[i] = bench_block_update_delay();
+  }
+
+  double start = bench_now();
+
+  for (unsigned int i = 0; i < bench_block_update_count; i++) {
+    handles[i] =
+        block_update_schedule(scheduler, blocks[i], delays[i], kind, i);
+  }
+
+  double schedule_elapsed = bench_now() - start;
+  unsigned int cancel_count = 0;
+  start = bench_now();
+
+  for (unsigned int i = 0; i < bench_block_update_count; i += 4) {
+    cancelled[i] = block_update_cancel(scheduler, handles[i]);
+    cancel_count++;
+  }
+
+  double cancel_elapsed = bench_now() - start;
+  uint64_t pending = scheduler->stats.pending;
+  double *tick_times = malloc(sizeof(double) * bench_block_update_horizon);
+
+  for (unsigned int i = 0; i < bench_block_update_horizon; i++) {
+    double tick_start = bench_now();
+    block_update_tick(scheduler);
+    tick_times[i] = bench_now() - tick_start;
+  }
+
+  double tick_total = 0;
+
+  for (unsigned int i = 0; i < bench_block_update_horizon; i++) {
+    tick_total += tick_times[i];
+  }
+
+  qsort(tick_times, bench_block_update_horizon, sizeof(double),
+        bench_compare_double);
+
+  printf("block_update: wheel  schedule %.1f ns/op, cancel %.1f ns/op, "
+         "%llu pending\n",
+         schedule_elapsed * 1e9 / bench_block_update_count,
+         cancel_elapsed * 1e9 / cancel_count, (unsigned long long)pending);
+  printf("block_update: wheel  %u ticks %.3f ms/tick, p99 %.3f ms, "
+         "%llu executed, %.1f ns/update\n",
+         bench_block_update_horizon,
+         tick_total * 1e3 / bench_block_update_horizon,
+         tick_times[bench_block_update_horizon * 99 / 100] * 1e3,
+         (unsigned long long)scheduler->stats.executed,
+         tick_total * 1e9 / scheduler->stats.executed);
+
+  bench_block_update_heap(delays, cancelled);
+
+  free(tick_times);
+  free(handles);
+  free(cancelled);
+  free(delays);
+  free(blocks);
+
+  light_engine_wait(&world->light_engine);
+  world_free(world);
+  free(world);
+}
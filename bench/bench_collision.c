@@ -0,0 +1,183 @@
+#include "bench.h"
+
+#include "block_type.h"
+#include "chunk.h"
+#include "collision.h"
+#include "thread_pool.h"
+#include "world.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define bench_collision_entities 16384
+#define bench_collision_ticks 16
+#define bench_collision_scatter 16384
+
+static void bench_collision_reference(World *world,
+                                      const CollisionQuery *query,
+                                      CollisionResult *result) {
+  Aabb box = query->box;
+  unsigned int axis_order[3] = {1, 0, 2};
+
+  for (unsigned int i = 0; i < 3; i++) {
+    unsigned int axis = axis_order[i];
+    double motion = query->motion[axis];
+
+    Vec3i low;
+    Vec3i high;
+
+    for (unsigned int other = 0; other < 3; other++) {
+      double shift = other == axis ? motion : 0;
+      low[other] = floor(fmin(box.min[other], box.min[other] + shift));
+      high[other] = ceil(fmax(box.max[other], box.max[other] + shift)) - 1;
+    }
+
+    for (int x = low[0]; x <= high[0]; x++) {
+      for (int y = low[1]; y <= high[1]; y++) {
+        for (int z = low[2]; z <= high[2]; z++) {
+          Vec3i block = {x, y, z};
+
+          if (!block_type_is_solid(world_get_block_type(world, block))) {
+            continue;
+          }
+
+          bool overlaps = true;
+
+          for (unsigned int other = 0; other < 3; other++) {
+            overlaps &= other == axis || (box.max[other] > block[other] &&
+                                          box.min[other] < block[other] + 1);
+          }
+
+          if (!overlaps) {
+            continue;
+          }
+
+          if (motion > 0 && box.max[axis] - 1e-7 <= block[axis]) {
+            motion = fmax(fmin(motion, block[axis] - box.max[axis]), 0);
+          } else if (motion < 0 && box.min[axis] + 1e-7 >= block[axis] + 1) {
+            motion = fmin(fmax(motion, block[axis] + 1 - box.min[axis]), 0);
+          }
+        }
+      }
+    }
+
+    box.min[axis] += motion;
+    box.max[axis] += motion;
+    result->motion[axis] = motion;
+    result->collided[axis] = motion != query->motion[axis];
+  }
+}
+
+static double bench_collision_random(void) {
+  return (double)rand() / RAND_MAX * 2 - 1;
+}
+
+static void bench_collision_step(CollisionQuery *queries,
+                                 const CollisionResult *results) {
+  for (unsigned int i = 0; i < bench_collision_entities; i++) {
+    CollisionQuery *query = &queries[i];
+
+    for (unsigned int axis = 0; axis < 3; axis++) {
+      query->box.min[axis] += results[i].motion[axis];
+      query->box.max[axis] += results[i].motion[axis];
+    }
+
+    query->motion[0] = bench_collision_random() * 0.4;
+    query->motion[1] = results[i].collided[1] ? 0.4 : -0.6;
+    query->motion[2] = bench_collision_random() * 0.4;
+  }
+}
+
+void bench_collision(void) {
+  World *world = calloc(1, sizeof(World));
+  world_init_headless(world);
+  world_fill(world, (Vec3i){render_distance / 2, render_distance / 2,
+                            render_distance / 2});
+
+  srand(1);
+
+  int extent = render_distance * chunk_size;
+
+  for (unsigned int i = 0; i < bench_collision_scatter; i++) {
+    Vec3i block = {rand() % extent, rand() % extent, rand() % extent};
+    world_set_block_type(world, block, i % 2 ? LEAVES : AIR);
+  }
+
+  CollisionQuery *queries =
+      malloc(sizeof(CollisionQuery) * bench_collision_entities);
+  CollisionResult *results =
+      malloc(sizeof(CollisionResult) * bench_collision_entities);
+
+  for (unsigned int i = 0; i < bench_collision_entities; i++) {
+    Vec3 position = {rand() % extent + 0.5, rand() % extent + 0.5,
+                     rand() % extent + 0.5};
+    Vec3 half_extent = {0.3, 0.9, 0.3};
+
+    for (unsigned int axis = 0; axis < 3; axis++) {
+      queries[i].box.min[axis] = position[axis] - half_extent[axis];
+      queries[i].box.max[axis] = position[axis] + half_extent[axis];
+      queries[i].motion[axis] = 0;
+    }
+  }
+
+  ThreadPool pool;
+  thread_pool_init(&pool, thread_pool_default_thread_count());
+
+  for (unsigned int batched = 0; batched < 2; batched++) {
+    double start = bench_now();
+
+    for (unsigned int tick = 0; tick < bench_collision_ticks; tick++) {
+      if (batched) {
+        collision_sweep_batch(world, &pool, queries, results,
+                              bench_collision_entities);
+      } else {
+        for (unsigned int i = 0; i < bench_collision_entities; i++) {
+          collision_sweep(world, &queries[i], &results[i]);
+        }
+      }
+
+      bench_collision_step(queries, results);
+    }
+
+    double elapsed = bench_now() - start;
+    unsigned int sweep_count = bench_collision_entities * bench_collision_ticks;
+
+    printf("collision: %s %u sweeps in %.2f ms, %.1f entities/ms, "
+           "%u threads\n",
+           batched ? "batch" : "single", sweep_count, elapsed * 1e3,
+           sweep_count / (elapsed * 1e3), batched ? pool.thread_count : 1);
+  }
+
+  thread_pool_free(&pool);
+
+  CollisionResult *references =
+      malloc(sizeof(CollisionResult) * bench_collision_entities);
+  collision_sweep_batch(world, NULL, queries, results,
+                        bench_collision_entities);
+
+  double start = bench_now();
+
+  for (unsigned int i = 0; i < bench_collision_entities; i++) {
+    bench_collision_reference(world, &queries[i], &references[i]);
+  }
+
+  double elapsed = bench_now() - start;
+  unsigned int mismatch_count = 0;
+
+  for (unsigned int i = 0; i < bench_collision_entities; i++) {
+    for (unsigned int axis = 0; axis < 3; axis++) {
+      mismatch_count += references[i].motion[axis] != results[i].motion[axis];
+    }
+  }
+
+  printf("collision: per-voxel reference %u sweeps in %.2f ms, "
+         "%u mismatches\n",
+         bench_collision_entities, elapsed * 1e3, mismatch_count);
+
+  light_engine_wait(&world->light_engine);
+  world_free(world);
+  free(queries);
+  free(results);
+  free(references);
+  free(world);
+}
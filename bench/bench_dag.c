@@ -0,0 +1,119 @@
+#include "bench.h"
+
+#include "block_type.h"
+#include "epoch.h"
+#include "region.h"
+#include "voxel_dag.h"
+#include "world.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define bench_dag_column 8
+#define bench_dag_lookups (1 << 22)
+
+static double bench_dag_lookup(World *world, const Vec3i *blocks,
+                               BlockType *out) {
+  double start = bench_now();
+
+  for (unsigned int i = 0; i < bench_dag_lookups; i++) {
+    out[i] = world_get_block_type(world, blocks[i]);
+  }
+
+  return bench_now() - start;
+}
+
+static void bench_dag_print(const char *label, const VoxelDagReport *report) {
+  printf("dag: %s %zu unique / %zu total nodes, %.2f / %.2f MiB, "
+         "%zu shared groups\n",
+         label, report->unique_nodes, report->total_nodes,
+         report->unique_bytes / 1048576.0, report->total_bytes / 1048576.0,
+         report->shared_groups);
+}
+
+void bench_dag(void) {
+  World *world = calloc(1, sizeof(World));
+  world_init_headless(world);
+  world_fill(world, (Vec3i){render_distance / 2, render_distance / 2,
+                            render_distance / 2});
+
+  int extent = render_distance * chunk_size;
+  srand(1);
+
+  for (int x = 0; x < extent; x += bench_dag_column) {
+    for (int z = 0; z < extent; z += bench_dag_column) {
+      int height = extent / 4 + rand() % (extent / 8);
+
+      region_fill_box(world, (Vec3i){x, 0, z},
+                      (Vec3i){x + bench_dag_column, height,
+                              z + bench_dag_column},
+                      GRASS);
+      region_fill_box(world, (Vec3i){x, height, z},
+                      (Vec3i){x + bench_dag_column, extent,
+                              z + bench_dag_column},
+                      AIR);
+    }
+  }
+
+  VoxelDagReport report;
+  voxel_dag_report(world, &report);
+  bench_dag_print("tree", &report);
+
+  Vec3i *blocks = malloc(sizeof(Vec3i) * bench_dag_lookups);
+  BlockType *tree_results = malloc(sizeof(BlockType) * bench_dag_lookups);
+  BlockType *dag_results = malloc(sizeof(BlockType) * bench_dag_lookups);
+
+  for (unsigned int i = 0; i < bench_dag_lookups; i++) {
+    blocks[i][0] = rand() % extent;
+    blocks[i][1] = rand() % extent;
+    blocks[i][2] = rand() % extent;
+  }
+
+  double tree_elapsed = bench_dag_lookup(world, blocks, tree_results);
+
+  double start = bench_now();
+
+  for (unsigned int x = 0; x < render_distance; x++) {
+    for (unsigned int y = 0; y < render_distance; y++) {
+      for (unsigned int z = 0; z < render_distance; z++) {
+        chunk_publish(world->chunks[x][y][z]);
+      }
+    }
+  }
+
+  double share_elapsed = bench_now() - start;
+  epoch_flush();
+
+  voxel_dag_report(world, &report);
+  bench_dag_print("dag", &report);
+
+  double dag_elapsed = bench_dag_lookup(world, blocks, dag_results);
+  unsigned int mismatch_count = 0;
+
+  for (unsigned int i = 0; i < bench_dag_lookups; i++) {
+    mismatch_count += tree_results[i] != dag_results[i];
+  }
+
+  printf("dag: share %.2f ms, lookup tree %.1f ns, dag %.1f ns, "
+         "%u mismatches\n",
+         share_elapsed * 1e3, tree_elapsed * 1e9 / bench_dag_lookups,
+         dag_elapsed * 1e9 / bench_dag_lookups, mismatch_count);
+
+  Vec3i edited = {chunk_size + 3, 3, chunk_size + 5};
+  Vec3i untouched = {3, 3, 5};
+  BlockType before = world_get_block_type(world, untouched);
+
+  world_set_block_type(world, edited, LAMP);
+
+  printf("dag: copy-on-write edit %s, neighbour %s\n",
+         world_get_block_type(world, edited) == LAMP ? "applied" : "lost",
+         world_get_block_type(world, untouched) == before ? "unchanged"
+                                                           : "changed");
+
+  free(blocks);
+  free(tree_results);
+  free(dag_results);
+
+  light_engine_wait(&world->light_engine);
+  world_free(world);
+  free(world);
+}
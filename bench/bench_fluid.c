@@ -0,0 +1,95 @@
+#include "bench.h"
+
+#include "block_type.h"
+#include "fluid.h"
+#include "region.h"
+#include "world.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define bench_fluid_floor 64
+#define bench_fluid_drop 8
+#define bench_fluid_spacing 12
+#define bench_fluid_max_ticks 400
+
+static unsigned int bench_fluid_scene(World *world) {
+  int extent = render_distance * chunk_size;
+  unsigned int sources = 0;
+  srand(1);
+
+  region_fill_box(world, (Vec3i){0, 0, 0},
+                  (Vec3i){extent, bench_fluid_floor, extent}, GRASS);
+  region_fill_box(world, (Vec3i){0, bench_fluid_floor, 0},
+                  (Vec3i){extent, extent, extent}, AIR);
+
+  for (int x = 0; x < extent; x += 4 * bench_fluid_spacing) {
+    for (int z = 0; z < extent; z += 4 * bench_fluid_spacing) {
+      int height = 1 + rand() % bench_fluid_drop;
+
+      region_fill_box(world, (Vec3i){x, bench_fluid_floor, z},
+                      (Vec3i){x + bench_fluid_spacing, bench_fluid_floor +
+                                                           height,
+                              z + bench_fluid_spacing},
+                      GRASS);
+    }
+  }
+
+  for (int x = bench_fluid_spacing / 2; x < extent; x += bench_fluid_spacing) {
+    for (int z = bench_fluid_spacing / 2; z < extent;
+         z += bench_fluid_spacing) {
+      BlockType fluid = rand() % 16 == 0 ? LAVA : WATER;
+
+      world_set_block_type(
+          world, (Vec3i){x, bench_fluid_floor + bench_fluid_drop, z}, fluid);
+      sources++;
+    }
+  }
+
+  return sources;
+}
+
+void bench_fluid(void) {
+  World *world = calloc(1, sizeof(World));
+  world_init_headless(world);
+  world_fill(world, (Vec3i){render_distance / 2, render_distance / 2,
+                            render_distance / 2});
+
+  unsigned int sources = bench_fluid_scene(world);
+  FluidEngine *fluid = &world->fluid;
+  unsigned int peak_chunks = 0;
+  unsigned int peak_cells = 0;
+  double start = bench_now();
+
+  while (!fluid_idle(fluid) && fluid->stats.ticks < bench_fluid_max_ticks) {
+    fluid_tick(fluid);
+
+    if (fluid->stats.active_cells > peak_cells) {
+      peak_cells = fluid->stats.active_cells;
+    }
+
+    if (fluid->stats.active_chunks > peak_chunks) {
+      peak_chunks = fluid->stats.active_chunks;
+    }
+  }
+
+  double elapsed = bench_now() - start;
+  double full_grid = (double)fluid->stats.ticks * render_distance *
+                     render_distance * render_distance * chunk_volume;
+
+  printf("fluid: %u sources settled in %u ticks%s, %.2f ms, %.2f ms/tick\n",
+         sources, fluid->stats.ticks, fluid_idle(fluid) ? "" : " (capped)",
+         elapsed * 1e3, elapsed * 1e3 / fluid->stats.ticks);
+  printf("fluid: %llu cells updated, %llu changed, %.2f M cells/s\n",
+         (unsigned long long)fluid->stats.cells_updated,
+         (unsigned long long)fluid->stats.cells_changed,
+         fluid->stats.cells_updated / elapsed / 1e6);
+  printf("fluid: peak active set %u cells in %u chunks, %.4f%% of a "
+         "full-grid sweep (%.0f cells)\n",
+         peak_cells, peak_chunks,
+         100.0 * fluid->stats.cells_updated / full_grid, full_grid);
+
+  light_engine_flush(&world->light_engine);
+  light_engine_wait(&world->light_engine);
+  world_free(world);
+  free(world);
+}
@@ -0,0 +1,229 @@
+#include "bench.h"
+
+#include "block_type.h"
+#include "heightmap.h"
+#include "region.h"
+#include "world.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define bench_heightmap_floor 96
+#define bench_heightmap_amplitude 40
+#define bench_heightmap_tile 8
+#define bench_heightmap_slab 200
+#define bench_heightmap_slab_spacing 64
+#define bench_heightmap_queries 4000000
+#define bench_heightmap_baseline_queries 4096
+#define bench_heightmap_summaries 1000000
+#define bench_heightmap_edits 100000
+#define bench_heightmap_samples 65536
+
+static void bench_heightmap_scene(World *world) {
+  int extent = render_distance * chunk_size;
+
+  region_fill_box(world, (Vec3i){0, 0, 0}, (Vec3i){extent, extent, extent},
+                  AIR);
+
+  for (int x = 0; x < extent; x += bench_heightmap_tile) {
+    for (int z = 0; z < extent; z += bench_heightmap_tile) {
+      int height = bench_heightmap_floor +
+                   lround(bench_heightmap_amplitude *
+                          (0.6 * sin(x * 0.013) * cos(z * 0.011) +
+                           0.4 * sin((x - z) * 0.007)));
+
+      region_fill_box(world, (Vec3i){x, 0, z},
+                      (Vec3i){x + bench_heightmap_tile, height,
+                              z + bench_heightmap_tile},
+                      GRASS);
+    }
+  }
+
+  for (int x = 0; x < extent; x += bench_heightmap_slab_spacing) {
+    for (int z = 0; z < extent; z += bench_heightmap_slab_spacing) {
+      region_fill_box(world, (Vec3i){x, bench_heightmap_slab, z},
+                      (Vec3i){x + bench_heightmap_slab_spacing / 4,
+                              bench_heightmap_slab + 2,
+                              z + bench_heightmap_slab_spacing / 4},
+                      GLASS);
+    }
+  }
+}
+
+static int bench_heightmap_walk(const World *world, int x, int z) {
+  for (int y = render_distance * chunk_size - 1; y >= 0; y--) {
+    if (block_type_is_solid(world_get_block_type(world, (Vec3i){x, y, z}))) {
+      return y;
+    }
+  }
+
+  return heightmap_none;
+}
+
+static unsigned int bench_heightmap_mismatches(World *world,
+                                               unsigned int samples) {
+  int extent = render_distance * chunk_size;
+  unsigned int mismatches = 0;
+
+  for (unsigned int i = 0; i < samples; i++) {
+    int x = rand() % extent;
+    int z = rand() % extent;
+
+    mismatches += heightmap_get_height(&world->heightmap, x, z) !=
+                  bench_heightmap_walk(world, x, z);
+  }
+
+  return mismatches;
+}
+
+static void bench_heightmap_query(World *world) {
+  int extent = render_distance * chunk_size;
+  Vec2i *columns = malloc(sizeof(Vec2i) * bench_heightmap_samples);
+  long long checksum = 0;
+
+  for (unsigned int i = 0; i < bench_heightmap_samples; i++) {
+    columns[i][0] = rand() % extent;
+    columns[i][1] = rand() % extent;
+  }
+
+  double start = bench_now();
+
+  for (unsigned int i = 0; i < bench_heightmap_queries; i++) {
+    const int *column = columns[i % bench_heightmap_samples];
+    checksum += heightmap_get_height(&world->heightmap, column[0], column[1]);
+  }
+
+  double elapsed = bench_now() - start;
+
+  start = bench_now();
+
+  for (unsigned int i = 0; i < bench_heightmap_baseline_queries; i++) {
+    const int *column = columns[i];
+    checksum += bench_heightmap_walk(world, column[0], column[1]);
+  }
+
+  double baseline = bench_now() - start;
+
+  printf("heightmap: %.1f ns/query indexed, %.1f us/query walking columns "
+         "(%.0fx), checksum %lld\n",
+         elapsed * 1e9 / bench_heightmap_queries,
+         baseline * 1e6 / bench_heightmap_baseline_queries,
+         baseline / bench_heightmap_baseline_queries /
+             (elapsed / bench_heightmap_queries),
+         checksum);
+
+  HeightmapSummary summary;
+  unsigned int found = 0;
+  int spread = 0;
+
+  start = bench_now();
+
+  for (unsigned int i = 0; i < bench_heightmap_summaries; i++) {
+    const int *column = columns[i % bench_heightmap_samples];
+    Vec2i position = {column[0] / chunk_size, column[1] / chunk_size};
+
+    if (heightmap_get_summary(&world->heightmap, position, &summary)) {
+      spread += summary.highest - summary.lowest;
+      found++;
+    }
+  }
+
+  elapsed = bench_now() - start;
+
+  printf("heightmap: %.1f ns/summary, %u of %u columns summarized, mean "
+         "spread %.1f blocks\n",
+         elapsed * 1e9 / bench_heightmap_summaries, found,
+         bench_heightmap_summaries, (double)spread / found);
+
+  free(columns);
+}
+
+static void bench_heightmap_edit(World *world) {
+  Heightmap *heightmap = &world->heightmap;
+  int extent = render_distance * chunk_size;
+  unsigned int descents = heightmap->stats.descents;
+  double elapsed = 0;
+
+  for (unsigned int i = 0; i < bench_heightmap_edits; i++) {
+    int x = rand() % extent;
+    int z = rand() % extent;
+    int height = heightmap_get_height(heightmap, x, z);
+    bool dig = rand() % 2 != 0 && height > 0;
+    Vec3i block = {x, dig ? height : height + 1, z};
+    BlockType block_type = dig ? AIR : GLASS;
+
+    Vec3i chunk_position;
+    Vec3i local;
+    world_block_to_chunk(block, chunk_position, local);
+
+    Chunk *chunk = world_get_loaded_chunk(world, chunk_position);
+
+    if (chunk == NULL) {
+      continue;
+    }
+
+    chunk_set_block_type(chunk, local, block_type);
+
+    double start = bench_now();
+    heightmap_set_block(heightmap, block, block_type);
+    elapsed += bench_now() - start;
+  }
+
+  printf("heightmap: %.1f ns/edit incremental update over %u edits, %u "
+         "descents, %u mismatched of %u sampled\n",
+         elapsed * 1e9 / bench_heightmap_edits, bench_heightmap_edits,
+         heightmap->stats.descents - descents,
+         bench_heightmap_mismatches(world, bench_heightmap_samples),
+         bench_heightmap_samples);
+}
+
+static void bench_heightmap_rebuild(World *world) {
+  Heightmap *heightmap = &world->heightmap;
+  unsigned int rebuilt = heightmap->stats.columns_rebuilt;
+
+  for (int x = 0; x < render_distance; x++) {
+    for (int z = 0; z < render_distance; z++) {
+      Chunk *chunk = world_get_chunk(world, (Vec3i){x, 0, z});
+      heightmap_invalidate_chunk(heightmap, chunk);
+    }
+  }
+
+  double start = bench_now();
+  heightmap_update(heightmap);
+  double elapsed = bench_now() - start;
+
+  rebuilt = heightmap->stats.columns_rebuilt - rebuilt;
+
+  printf("heightmap: rebuilt %u chunk columns in %.2f ms (%.1f us/column, "
+         "%.1f ns/block column)\n",
+         rebuilt, elapsed * 1e3, elapsed * 1e6 / rebuilt,
+         elapsed * 1e9 / rebuilt / (chunk_size * chunk_size));
+}
+
+void bench_heightmap(void) {
+  World *world = calloc(1, sizeof(World));
+  world_init_headless(world);
+  world_fill(world, (Vec3i){render_distance / 2, render_distance / 2,
+                            render_distance / 2});
+
+  bench_heightmap_scene(world);
+  light_engine_wait(&world->light_engine);
+  srand(1);
+
+  double start = bench_now();
+  unsigned int columns = heightmap_update(&world->heightmap);
+  double elapsed = bench_now() - start;
+
+  printf("heightmap: built %u chunk columns in %.2f ms (%.1f us/column), %u "
+         "mismatched of %u sampled\n",
+         columns, elapsed * 1e3, elapsed * 1e6 / columns,
+         bench_heightmap_mismatches(world, bench_heightmap_samples),
+         bench_heightmap_samples);
+
+  bench_heightmap_query(world);
+  bench_heightmap_edit(world);
+  bench_heightmap_rebuild(world);
+
+  world_free(world);
+  free(world);
+}
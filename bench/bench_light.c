@@ -0,0 +1,82 @@
+#include "bench.h"
+
+#include "block_type.h"
+#include "light.h"
+#include "world.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define bench_light_extent 8
+#define bench_light_edits 256
+
+void bench_light(void) {
+  World *world = calloc(1, sizeof(World));
+  world_init_headless(world);
+  world_fill(world, (Vec3i){render_distance / 2, render_distance / 2,
+                            render_distance / 2});
+
+  unsigned int chunk_count = 0;
+  Chunk **chunks = malloc(sizeof(Chunk *) * bench_light_extent *
+                          render_distance * bench_light_extent);
+
+  for (int x = 0; x < bench_light_extent; x++) {
+    for (int y = 0; y < render_distance; y++) {
+      for (int z = 0; z < bench_light_extent; z++) {
+        chunks[chunk_count++] = world_get_chunk(world, (Vec3i){x, y, z});
+      }
+    }
+  }
+
+  double start = bench_now();
+  light_engine_submit_chunks(&world->light_engine, chunks, chunk_count);
+  light_engine_wait(&world->light_engine);
+  double elapsed = bench_now() - start;
+
+  unsigned int uniform_count = 0;
+
+  for (unsigned int i = 0; i < chunk_count; i++) {
+    uniform_count += chunks[i]->light.levels == NULL;
+  }
+
+  printf("light: full chunk %u chunks in %.2f ms, %.3f ms/chunk, %u threads, "
+         "%u uniform\n",
+         chunk_count, elapsed * 1e3, elapsed * 1e3 / chunk_count,
+         world->light_engine.pool.thread_count, uniform_count);
+
+  double latencies[bench_light_edits];
+  srand(1);
+
+  for (unsigned int i = 0; i < bench_light_edits; i++) {
+    Vec3i block = {rand() % (bench_light_extent * chunk_size),
+                   rand() % (render_distance * chunk_size),
+                   rand() % (bench_light_extent * chunk_size)};
+
+    BlockType block_type = world_get_block_type(world, block);
+    BlockType next_block_type = block_type_is_solid(block_type) ? AIR
+                                : i % 2                         ? LAMP
+                                                                : GRASS;
+
+    start = bench_now();
+    world_set_block_type(world, block, next_block_type);
+    light_engine_flush(&world->light_engine);
+    light_engine_wait(&world->light_engine);
+    latencies[i] = bench_now() - start;
+  }
+
+  qsort(latencies, bench_light_edits, sizeof(double), bench_compare_double);
+
+  double total = 0;
+
+  for (unsigned int i = 0; i < bench_light_edits; i++) {
+    total += latencies[i];
+  }
+
+  printf("light: single edit relight mean %.1f us, p50 %.1f us, p99 %.1f us\n",
+         total / bench_light_edits * 1e6,
+         latencies[bench_light_edits / 2] * 1e6,
+         latencies[bench_light_edits * 99 / 100] * 1e6);
+
+  free(chunks);
+  world_free(world);
+  free(world);
+}
@@ -0,0 +1,106 @@
+#include "bench.h"
+
+#include "block_type.h"
+#include "chunk.h"
+#include "mesh_kernel.h"
+#include "world.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define bench_mesh_extent 8
+#define bench_mesh_scatter 64
+
+static void bench_mesh_run(World *world, const char *label) {
+  unsigned int chunk_count = 0;
+  unsigned int face_count = 0;
+  unsigned int allocation_count = chunk_mesh_scratch_allocations();
+
+  double start = bench_now();
+
+  for (int x = 0; x < bench_mesh_extent; x++) {
+    for (int y = 0; y < bench_mesh_extent; y++) {
+      for (int z = 0; z < bench_mesh_extent; z++) {
+        Chunk *chunk = world_get_chunk(world, (Vec3i){x, y, z});
+        Mesh mesh = chunk_build_mesh(chunk, world);
+
+        chunk_count++;
+        face_count += mesh.vertices.size / 6;
+
+        vector_free_float(&mesh.vertices);
+        vector_free_float(&mesh.normals);
+      }
+    }
+  }
+
+  double elapsed = bench_now() - start;
+
+  printf("mesh: %u^3 %s %u chunks in %.2f ms, %.3f ms/chunk, %.2f ns/block, "
+         "%u faces/chunk, %u scratch allocations\n",
+         chunk_size, label, chunk_count, elapsed * 1e3,
+         elapsed * 1e3 / chunk_count,
+         elapsed * 1e9 / ((double)chunk_count * chunk_volume),
+         face_count / chunk_count,
+         chunk_mesh_scratch_allocations() - allocation_count);
+}
+
+void bench_mesh(void) {
+  World *world = calloc(1, sizeof(World));
+  world_init_headless(world);
+  world_fill(world, (Vec3i){render_distance / 2, render_distance / 2,
+                            render_distance / 2});
+
+  Mesh warm_up = chunk_build_mesh(world_get_chunk(world, (Vec3i){0, 0, 0}),
+                                  world);
+  vector_free_float(&warm_up.vertices);
+  vector_free_float(&warm_up.normals);
+
+  bench_mesh_run(world, "1 material");
+
+  BlockType materials[] = {LAMP, GLASS, LEAVES};
+  srand(1);
+
+  for (unsigned int i = 0; i < sizeof(materials) / sizeof(BlockType); i++) {
+    for (int x = 0; x < bench_mesh_extent; x++) {
+      for (int y = 0; y < bench_mesh_extent; y++) {
+        for (int z = 0; z < bench_mesh_extent; z++) {
+          for (unsigned int j = 0; j < bench_mesh_scatter; j++) {
+            Vec3i block = {x * chunk_size + rand() % chunk_size,
+                           y * chunk_size + rand() % chunk_size,
+                           z * chunk_size + rand() % chunk_size};
+            world_set_block_type(world, block, materials[i]);
+          }
+        }
+      }
+    }
+
+    for (int x = 0; x < bench_mesh_extent; x++) {
+      for (int y = 0; y < bench_mesh_extent; y++) {
+        for (int z = 0; z < bench_mesh_extent; z++) {
+          chunk_publish(world_get_chunk(world, (Vec3i){x, y, z}));
+        }
+      }
+    }
+
+    char label[32];
+    snprintf(label, sizeof(label), "%u materials", i + 2);
+    bench_mesh_run(world, label);
+  }
+
+  MeshKernelIsa default_isa = mesh_kernel_active();
+
+  for (unsigned int i = 0; i < MESH_KERNEL_ISA_COUNT; i++) {
+    if (!mesh_kernel_select(i)) {
+      continue;
+    }
+
+    char label[32];
+    snprintf(label, sizeof(label), "%s kernel", mesh_kernel_name(i));
+    bench_mesh_run(world, label);
+  }
+
+  mesh_kernel_select(default_isa);
+
+  light_engine_wait(&world->light_engine);
+  world_free(world);
+  free(world);
+}
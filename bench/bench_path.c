@@ -0,0 +1,435 @@
+#include "bench.h"
+
+#include "block_type.h"
+#include "path.h"
+#include "region.h"
+#include "world.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define bench_path_floor 64
+#define bench_path_height 16
+#define bench_path_tile 8
+#define bench_path_wall_spacing 96
+#define bench_path_gap_spacing 80
+#define bench_path_gap 6
+#define bench_path_queries 512
+#define bench_path_local_extent 48
+#define bench_path_batch 4096
+#define bench_path_edits 64
+#define bench_path_baseline_queries 8
+
+typedef struct BenchPathOpen {
+  uint32_t estimate;
+  uint32_t index;
+} BenchPathOpen;
+
+typedef struct BenchPathFlat {
+  const World *world;
+  uint32_t *costs;
+  BenchPathOpen *open;
+  unsigned int open_size;
+  unsigned int open_capacity;
+  unsigned int expanded;
+} BenchPathFlat;
+
+static const int bench_path_directions[4][2] = {
+    {1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+
+static void bench_path_scene(World *world) {
+  int extent = render_distance * chunk_size;
+
+  region_fill_box(world, (Vec3i){0, 0, 0},
+                  (Vec3i){extent, bench_path_floor, extent}, GRASS);
+  region_fill_box(world, (Vec3i){0, bench_path_floor, 0},
+                  (Vec3i){extent, extent, extent}, AIR);
+
+  for (int x = 0; x < extent; x += bench_path_tile) {
+    for (int z = 0; z < extent; z += bench_path_tile) {
+      int height = 3 + lround(2.5 * sin(x * 0.021) * cos(z * 0.017) +
+                              sin((x + z) * 0.009));
+
+      region_fill_box(world, (Vec3i){x, bench_path_floor, z},
+                      (Vec3i){x + bench_path_tile, bench_path_floor + height,
+                              z + bench_path_tile},
+                      GRASS);
+    }
+  }
+
+  for (int wall = bench_path_wall_spacing / 2; wall < extent;
+       wall += bench_path_wall_spacing) {
+    for (int i = 0; i < extent; i += bench_path_gap_spacing) {
+      int end = i + bench_path_gap_spacing - bench_path_gap;
+
+      region_fill_box(world, (Vec3i){wall, bench_path_floor, i},
+                      (Vec3i){wall + 2, bench_path_floor + bench_path_height,
+                              end},
+                      GLASS);
+      region_fill_box(world, (Vec3i){i, bench_path_floor, wall},
+                      (Vec3i){end, bench_path_floor + bench_path_height,
+                              wall + 2},
+                      GLASS);
+    }
+  }
+}
+
+static bool bench_path_solid(const World *world, int x, int y, int z) {
+  return block_type_is_solid(world_get_block_type(world, (Vec3i){x, y, z}));
+}
+
+static bool bench_path_walkable(const World *world, int x, int y, int z) {
+  return bench_path_solid(world, x, y - 1, z) &&
+         !bench_path_solid(world, x, y, z) &&
+         !bench_path_solid(world, x, y + 1, z);
+}
+
+static void bench_path_block(const PathGraph *graph, Vec3i block) {
+  int extent = render_distance * chunk_size;
+
+  do {
+    block[0] = rand() % extent;
+    block[1] = bench_path_floor + bench_path_height / 2;
+    block[2] = rand() % extent;
+
+    while (block[1] > bench_path_floor && !path_is_walkable(graph, block)) {
+      block[1]--;
+    }
+  } while (!path_is_walkable(graph, block));
+}
+
+static void bench_path_pair(const PathGraph *graph, unsigned int index,
+                            Vec3i start, Vec3i goal) {
+  bench_path_block(graph, start);
+
+  if (index % 2 == 0) {
+    bench_path_block(graph, goal);
+    return;
+  }
+
+  do {
+    Vec3i offset = {rand() % (2 * bench_path_local_extent) -
+                        bench_path_local_extent,
+                    0,
+                    rand() % (2 * bench_path_local_extent) -
+                        bench_path_local_extent};
+
+    vec3i_add(goal, start, offset);
+    goal[1] = bench_path_floor + bench_path_height / 2;
+
+    while (goal[1] > bench_path_floor && !path_is_walkable(graph, goal)) {
+      goal[1]--;
+    }
+  } while (!path_is_walkable(graph, goal));
+}
+
+static unsigned int bench_path_invalid(const World *world,
+                                       const Vector_PathStep *path) {
+  unsigned int invalid = 0;
+
+  for (unsigned int i = 0; i < path->size; i++) {
+    const int *block = path->data[i].block;
+
+    if (!bench_path_walkable(world, block[0], block[1], block[2])) {
+      invalid++;
+      continue;
+    }
+
+    if (i == 0) {
+      continue;
+    }
+
+    const int *previous = path->data[i - 1].block;
+
+    invalid += abs(block[0] - previous[0]) + abs(block[2] - previous[2]) != 1 ||
+               abs(block[1] - previous[1]) > 1;
+  }
+
+  return invalid;
+}
+
+static unsigned int bench_path_index(int x, int y, int z) {
+  int extent = render_distance * chunk_size;
+
+  return ((y - bench_path_floor) * extent + z) * extent + x;
+}
+
+static void bench_path_flat_push(BenchPathFlat *flat, uint32_t estimate,
+                                 uint32_t index) {
+  if (flat->open_size == flat->open_capacity) {
+    flat->open_capacity = flat->open_capacity ? flat->open_capacity * 2 : 1024;
+    flat->open =
+        realloc(flat->open, sizeof(BenchPathOpen) * flat->open_capacity);
+  }
+
+  unsigned int i = flat->open_size++;
+
+  while (i > 0 && flat->open[(i - 1) / 2].estimate > estimate) {
+    flat->open[i] = flat->open[(i - 1) / 2];
+    i = (i - 1) / 2;
+  }
+
+  flat->open[i] = (BenchPathOpen){estimate, index};
+}
+
+static BenchPathOpen bench_path_flat_pop(BenchPathFlat *flat) {
+  BenchPathOpen top = flat->open[0];
+  BenchPathOpen last = flat->open[--flat->open_size];
+  unsigned int i = 0;
+
+  while (i * 2 + 1 < flat->open_size) {
+    unsigned int child = i * 2 + 1;
+
+    if (child + 1 < flat->open_size &&
+        flat->open[child + 1].estimate < flat->open[child].estimate) {
+      child++;
+    }
+
+    if (flat->open[child].estimate >= last.estimate) {
+      break;
+    }
+
+    flat->open[i] = flat->open[child];
+    i = child;
+  }
+
+  if (flat->open_size != 0) {
+    flat->open[i] = last;
+  }
+
+  return top;
+}
+
+static uint32_t bench_path_flat_estimate(int x, int y, int z,
+                                         const Vec3i goal) {
+  uint32_t horizontal = abs(x - goal[0]) + abs(z - goal[2]);
+  uint32_t vertical = abs(y - goal[1]);
+
+  return horizontal > vertical ? horizontal : vertical;
+}
+
+static uint32_t bench_path_flat_find(BenchPathFlat *flat, const Vec3i start,
+                                     const Vec3i goal) {
+  int extent = render_distance * chunk_size;
+  size_t volume = (size_t)extent * extent * bench_path_height;
+
+  memset(flat->costs, 0xff, sizeof(uint32_t) * volume);
+  flat->open_size = 0;
+  flat->expanded = 0;
+
+  flat->costs[bench_path_index(start[0], start[1], start[2])] = 0;
+  bench_path_flat_push(flat, bench_path_flat_estimate(start[0], start[1],
+                                                      start[2], goal),
+                       bench_path_index(start[0], start[1], start[2]));
+
+  while (flat->open_size != 0) {
+    BenchPathOpen top = bench_path_flat_pop(flat);
+    int x = top.index % extent;
+    int z = top.index / extent % extent;
+    int y = top.index / extent / extent + bench_path_floor;
+    uint32_t cost = flat->costs[top.index];
+
+    if (top.estimate != cost + bench_path_flat_estimate(x, y, z, goal)) {
+      continue;
+    }
+
+    if (x == goal[0] && y == goal[1] && z == goal[2]) {
+      return cost;
+    }
+
+    flat->expanded++;
+
+    for (unsigned int move = 0; move < 12; move++) {
+      int target_x = x + bench_path_directions[move / 3][0];
+      int target_y = y + (int)(move % 3) - 1;
+      int target_z = z + bench_path_directions[move / 3][1];
+
+      if (target_x < 0 || target_x >= extent || target_z < 0 ||
+          target_z >= extent || target_y < bench_path_floor ||
+          target_y >= bench_path_floor + bench_path_height) {
+        continue;
+      }
+
+      uint32_t index = bench_path_index(target_x, target_y, target_z);
+
+      if (flat->costs[index] <= cost + 1 ||
+          !bench_path_walkable(flat->world, target_x, target_y, target_z) ||
+          (target_y > y && bench_path_solid(flat->world, x, y + 2, z)) ||
+          (target_y < y &&
+           bench_path_solid(flat->world, target_x, target_y + 2, target_z))) {
+        continue;
+      }
+
+      flat->costs[index] = cost + 1;
+      bench_path_flat_push(
+          flat,
+          cost + 1 +
+              bench_path_flat_estimate(target_x, target_y, target_z, goal),
+          index);
+    }
+  }
+
+  return path_unreachable;
+}
+
+static void bench_path_serial(World *world) {
+  PathGraph *graph = &world->paths;
+  Vec3i *starts = malloc(sizeof(Vec3i) * bench_path_queries);
+  Vec3i *goals = malloc(sizeof(Vec3i) * bench_path_queries);
+  double *latencies = malloc(sizeof(double) * bench_path_queries);
+  Vector_PathStep path = {0};
+  unsigned int found = 0;
+  unsigned int invalid = 0;
+  unsigned int expanded = 0;
+  double length = 0;
+  double total = 0;
+
+  for (unsigned int i = 0; i < bench_path_queries; i++) {
+    bench_path_pair(graph, i, starts[i], goals[i]);
+  }
+
+  for (unsigned int i = 0; i < bench_path_queries; i++) {
+    double start = bench_now();
+    bool path_found = path_find(graph, starts[i], goals[i], &path);
+    latencies[i] = bench_now() - start;
+    total += latencies[i];
+
+    if (path_found) {
+      found++;
+      length += path.size - 1;
+      expanded += graph->search.expanded;
+      invalid += bench_path_invalid(world, &path);
+    }
+  }
+
+  qsort(latencies, bench_path_queries, sizeof(double), bench_compare_double);
+
+  printf("path: %u queries, %u found, mean length %.1f, %.1f portals "
+         "expanded, %u invalid steps\n",
+         bench_path_queries, found, found ? length / found : 0,
+         found ? (double)expanded / found : 0, invalid);
+  printf("path: query mean %.1f us, p50 %.1f us, p99 %.1f us\n",
+         total / bench_path_queries * 1e6,
+         latencies[bench_path_queries / 2] * 1e6,
+         latencies[bench_path_queries * 99 / 100] * 1e6);
+
+  int extent = render_distance * chunk_size;
+  BenchPathFlat flat = {
+      .world = world,
+      .costs = malloc(sizeof(uint32_t) * extent * extent * bench_path_height)};
+  double flat_time = 0;
+  double graph_time = 0;
+  double flat_length = 0;
+  double graph_length = 0;
+  unsigned int flat_expanded = 0;
+  unsigned int compared = 0;
+
+  for (unsigned int i = 0; i < bench_path_baseline_queries; i++) {
+    unsigned int query = i * 2;
+    double start = bench_now();
+    uint32_t cost = bench_path_flat_find(&flat, starts[query], goals[query]);
+    flat_time += bench_now() - start;
+
+    start = bench_now();
+    bool path_found = path_find(graph, starts[query], goals[query], &path);
+    graph_time += bench_now() - start;
+
+    if (cost != path_unreachable && path_found) {
+      compared++;
+      flat_length += cost;
+      graph_length += path.size - 1;
+      flat_expanded += flat.expanded;
+    }
+  }
+
+  printf("path: flat voxel A* %.2f ms/query, %.0f voxels expanded; portal "
+         "graph %.3f ms/query, %.1f%% longer over %u long queries\n",
+         flat_time / bench_path_baseline_queries * 1e3,
+         compared ? (double)flat_expanded / compared : 0,
+         graph_time / bench_path_baseline_queries * 1e3,
+         flat_length ? (graph_length / flat_length - 1) * 100 : 0, compared);
+
+  free(flat.costs);
+  free(flat.open);
+  vector_free_PathStep(&path);
+  free(latencies);
+  free(goals);
+  free(starts);
+}
+
+static void bench_path_parallel(World *world) {
+  PathGraph *graph = &world->paths;
+  PathQuery *queries = calloc(bench_path_batch, sizeof(PathQuery));
+  unsigned int found = 0;
+
+  for (unsigned int i = 0; i < bench_path_batch; i++) {
+    bench_path_pair(graph, i, queries[i].start, queries[i].goal);
+  }
+
+  double start = bench_now();
+  path_find_batch(graph, queries, bench_path_batch);
+  double elapsed = bench_now() - start;
+
+  for (unsigned int i = 0; i < bench_path_batch; i++) {
+    found += queries[i].found;
+    vector_free_PathStep(&queries[i].path);
+  }
+
+  printf("path: batch of %u queries on %u threads, %.0f queries/s, %u "
+         "found\n",
+         bench_path_batch, graph->pool.thread_count, bench_path_batch / elapsed,
+         found);
+
+  free(queries);
+}
+
+static void bench_path_rebuild(World *world) {
+  PathGraph *graph = &world->paths;
+  int extent = render_distance * chunk_size;
+  unsigned int rebuilt = 0;
+  double total = 0;
+
+  for (unsigned int i = 0; i < bench_path_edits; i++) {
+    Vec3i block = {rand() % extent, bench_path_floor + rand() % 8,
+                   rand() % extent};
+
+    world_set_block_type(world, block, i % 2 ? GLASS : AIR);
+
+    double start = bench_now();
+    rebuilt += path_graph_update(graph);
+    total += bench_now() - start;
+  }
+
+  printf("path: %u single block edits, %.2f chunks rebuilt/edit, %.1f "
+         "us/edit\n",
+         bench_path_edits, (double)rebuilt / bench_path_edits,
+         total / bench_path_edits * 1e6);
+}
+
+void bench_path(void) {
+  World *world = calloc(1, sizeof(World));
+  world_init_headless(world);
+  world_fill(world, (Vec3i){render_distance / 2, render_distance / 2,
+                            render_distance / 2});
+
+  bench_path_scene(world);
+  srand(1);
+
+  PathGraph *graph = &world->paths;
+  double start = bench_now();
+  unsigned int chunks = path_graph_update(graph);
+  double elapsed = bench_now() - start;
+
+  printf("path: built %u chunks in %.2f ms (%.1f us/chunk), %u cells, %u "
+         "portals\n",
+         chunks, elapsed * 1e3, elapsed * 1e6 / chunks, graph->stats.cells,
+         graph->stats.portals);
+
+  bench_path_serial(world);
+  bench_path_parallel(world);
+  bench_path_rebuild(world);
+
+  world_free(world);
+  free(world);
+}
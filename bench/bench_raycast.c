@@ -0,0 +1,171 @@
+#include "bench.h"
+
+#include "block_type.h"
+#include "chunk.h"
+#include "raycast.h"
+#include "thread_pool.h"
+#include "world.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define bench_raycast_rays 65536
+#define bench_raycast_scatter 4096
+#define bench_raycast_distance 256.0
+
+static bool bench_raycast_reference(const World *world, const Ray *ray,
+                                    RaycastHit *hit) {
+  *hit = (RaycastHit){.hit = false};
+
+  Vec3 direction;
+  vec3_normalize(direction, ray->direction);
+
+  Vec3i block;
+  Vec3i step;
+  Vec3 next;
+  Vec3 delta;
+
+  for (unsigned int axis = 0; axis < 3; axis++) {
+    block[axis] = floor(ray->origin[axis]);
+    step[axis] = direction[axis] > 0 ? 1 : -1;
+    delta[axis] = fabs(1 / direction[axis]);
+
+    double plane = direction[axis] > 0 ? block[axis] + 1 : block[axis];
+    next[axis] = direction[axis] != 0
+                     ? (plane - ray->origin[axis]) / direction[axis]
+                     : INFINITY;
+  }
+
+  double distance = 0;
+  unsigned int axis = 3;
+
+  while (distance <= ray->max_distance) {
+    BlockType block_type = world_get_block_type(world, block);
+
+    if (block_type_is_solid(block_type)) {
+      hit->hit = true;
+      hit->block_type = block_type;
+      vec3i_copy(hit->block, block);
+
+      if (axis < 3) {
+        hit->normal[axis] = -step[axis];
+      }
+
+      hit->distance = distance;
+      return true;
+    }
+
+    axis = next[0] < next[1] ? (next[0] < next[2] ? 0 : 2)
+                             : (next[1] < next[2] ? 1 : 2);
+    distance = next[axis];
+    next[axis] += delta[axis];
+    block[axis] += step[axis];
+  }
+
+  return false;
+}
+
+static double bench_raycast_random(void) {
+  return (double)rand() / RAND_MAX * 2 - 1;
+}
+
+void bench_raycast(void) {
+  World *world = calloc(1, sizeof(World));
+  world_init_headless(world);
+  world_fill(world, (Vec3i){render_distance / 2, render_distance / 2,
+                            render_distance / 2});
+
+  for (int x = 0; x < render_distance; x++) {
+    for (int y = render_distance / 2; y < render_distance; y++) {
+      for (int z = 0; z < render_distance; z++) {
+        Chunk *chunk = world_get_chunk(world, (Vec3i){x, y, z});
+        voxel_node_free(&chunk->root);
+        chunk->root = (VoxelNode){.has_octants = false, .block_type = AIR};
+      }
+    }
+  }
+
+  srand(1);
+
+  int extent = render_distance * chunk_size;
+
+  for (unsigned int i = 0; i < bench_raycast_scatter; i++) {
+    Vec3i block = {rand() % extent, extent / 2 + rand() % (extent / 2),
+                   rand() % extent};
+    world_set_block_type(world, block, LAMP);
+  }
+
+  Ray *rays = malloc(sizeof(Ray) * bench_raycast_rays);
+  RaycastHit *hits = malloc(sizeof(RaycastHit) * bench_raycast_rays);
+
+  for (unsigned int i = 0; i < bench_raycast_rays; i++) {
+    Ray *ray = &rays[i];
+
+    do {
+      ray->origin[0] = rand() % extent + 0.5;
+      ray->origin[1] = extent / 2 + rand() % (extent / 2) + 0.5;
+      ray->origin[2] = rand() % extent + 0.5;
+    } while (block_type_is_solid(world_get_block_type(
+        world, (Vec3i){ray->origin[0], ray->origin[1], ray->origin[2]})));
+
+    do {
+      ray->direction[0] = bench_raycast_random();
+      ray->direction[1] = bench_raycast_random();
+      ray->direction[2] = bench_raycast_random();
+    } while (vec3_length(ray->direction) < 1e-3);
+
+    ray->max_distance = bench_raycast_distance;
+  }
+
+  unsigned int hit_count = 0;
+  double start = bench_now();
+
+  for (unsigned int i = 0; i < bench_raycast_rays; i++) {
+    hit_count += raycast(world, &rays[i], &hits[i]);
+  }
+
+  double elapsed = bench_now() - start;
+
+  printf("raycast: octree %u rays in %.2f ms, %.2f Mrays/s, %u hits\n",
+         bench_raycast_rays, elapsed * 1e3,
+         bench_raycast_rays / elapsed / 1e6, hit_count);
+
+  ThreadPool pool;
+  thread_pool_init(&pool, thread_pool_default_thread_count());
+
+  start = bench_now();
+  raycast_batch(world, &pool, rays, hits, bench_raycast_rays);
+  elapsed = bench_now() - start;
+
+  printf("raycast: batch %u rays in %.2f ms, %.2f Mrays/s, %u threads\n",
+         bench_raycast_rays, elapsed * 1e3,
+         bench_raycast_rays / elapsed / 1e6, pool.thread_count);
+
+  thread_pool_free(&pool);
+
+  unsigned int mismatch_count = 0;
+  start = bench_now();
+
+  for (unsigned int i = 0; i < bench_raycast_rays; i++) {
+    RaycastHit reference;
+    bench_raycast_reference(world, &rays[i], &reference);
+
+    mismatch_count += reference.hit != hits[i].hit ||
+                      (reference.hit &&
+                       (!vec3i_compare(reference.block, hits[i].block) ||
+                        !vec3i_compare(reference.normal, hits[i].normal)));
+  }
+
+  elapsed = bench_now() - start;
+
+  printf("raycast: per-voxel %u rays in %.2f ms, %.2f Mrays/s, "
+         "%u mismatches\n",
+         bench_raycast_rays, elapsed * 1e3,
+         bench_raycast_rays / elapsed / 1e6, mismatch_count);
+
+  light_engine_wait(&world->light_engine);
+  world_free(world);
+  free(rays);
+  free(hits);
+  free(world);
+}
@@ -0,0 +1,101 @@
+#include "bench.h"
+
+#include "block_type.h"
+#include "region.h"
+#include "world.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define bench_region_offset 5
+#define bench_region_clip_size 64
+#define bench_region_paste_budget 4.0
+
+void bench_region(void) {
+  World *world = calloc(1, sizeof(World));
+  world_init_headless(world);
+  world_fill(world, (Vec3i){render_distance / 2, render_distance / 2,
+                            render_distance / 2});
+
+  for (int size = 4; size <= 256; size *= 2) {
+    Vec3i from = {bench_region_offset, bench_region_offset,
+                  bench_region_offset};
+    Vec3i to = {from[0] + size, from[1] + size, from[2] + size};
+
+    double start = bench_now();
+    region_fill_box(world, from, to, LAMP);
+    double elapsed = bench_now() - start;
+
+    double voxel_count = (double)size * size * size;
+
+    printf("region: box %3d^3 in %8.3f ms, %8.1f Mvoxels/s\n", size,
+           elapsed * 1e3, voxel_count / elapsed / 1e6);
+  }
+
+  for (double radius = 8; radius <= 128; radius *= 4) {
+    Vec3 center = {256.5, 256.5, 256.5};
+
+    double start = bench_now();
+    region_fill_sphere(world, center, radius, AIR);
+    double elapsed = bench_now() - start;
+
+    double voxel_count = 4.0 / 3 * 3.14159265 * radius * radius * radius;
+
+    printf("region: sphere r=%3.0f in %8.3f ms, %8.1f Mvoxels/s\n", radius,
+           elapsed * 1e3, voxel_count / elapsed / 1e6);
+  }
+
+  Vec3i from = {230, 230, 30};
+  Vec3i to = {from[0] + bench_region_clip_size,
+              from[1] + bench_region_clip_size,
+              from[2] + bench_region_clip_size};
+  Vec3i origin = {13, 300, 27};
+
+  RegionClip clip;
+  double start = bench_now();
+  region_copy(world, from, to, &clip);
+  double copy_elapsed = bench_now() - start;
+
+  size_t serialized_size;
+  uint8_t *serialized = region_clip_serialize(&clip, &serialized_size);
+
+  RegionClip pasted_clip;
+  bool valid =
+      region_clip_deserialize(&pasted_clip, serialized, serialized_size);
+
+  start = bench_now();
+  region_paste(world, &pasted_clip, origin);
+  double paste_elapsed = bench_now() - start;
+
+  unsigned int mismatch_count = 0;
+
+  for (int x = 0; x < bench_region_clip_size; x++) {
+    for (int y = 0; y < bench_region_clip_size; y++) {
+      for (int z = 0; z < bench_region_clip_size; z++) {
+        mismatch_count +=
+            world_get_block_type(world, (Vec3i){from[0] + x, from[1] + y,
+                                                from[2] + z}) !=
+            world_get_block_type(world, (Vec3i){origin[0] + x, origin[1] + y,
+                                                origin[2] + z});
+      }
+    }
+  }
+
+  double paste_ratio = paste_elapsed / copy_elapsed;
+
+  printf("region: clip %d^3 copy %.3f ms, paste %.3f ms, %u runs, "
+         "%zu bytes, %s, %u mismatches\n",
+         bench_region_clip_size, copy_elapsed * 1e3, paste_elapsed * 1e3,
+         clip.runs.size, serialized_size, valid ? "valid" : "invalid",
+         mismatch_count);
+  printf("region: paste/copy %.2fx, %s (budget %.1fx)\n", paste_ratio,
+         paste_ratio <= bench_region_paste_budget ? "ok" : "too slow",
+         bench_region_paste_budget);
+
+  free(serialized);
+  region_clip_free(&clip);
+  region_clip_free(&pasted_clip);
+
+  light_engine_wait(&world->light_engine);
+  world_free(world);
+  free(world);
+}
@@ -0,0 +1,120 @@
+#include "bench.h"
+
+#include "camera_path.h"
+#include "replay.h"
+#include "world.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define bench_replay_frames 240
+#define bench_replay_timestep (1.0 / 60)
+
+static void bench_replay_run(const char *name, const CameraPath *path,
+                             bool prefetch) {
+  World *world = calloc(1, sizeof(World));
+  world_init_headless(world);
+  world->prefetch.config.enabled = prefetch;
+
+  ReplayConfig config = {.timestep = bench_replay_timestep,
+                         .frame_count = bench_replay_frames,
+                         .synchronous = true,
+                         .warm_up = true};
+  ReplayFrame *frames = malloc(sizeof(ReplayFrame) * config.frame_count);
+
+  replay_run(world, path, &config, frames);
+
+  ReplaySummary summary;
+  replay_summarize(frames, config.frame_count, &summary);
+
+  printf("replay: %-8s %-11s load mean %.3f ms, p50 %.3f ms, p99 %.3f ms, "
+         "max %.3f ms, %u generated, %u meshed, latency mean %.2f ms, "
+         "max %.2f ms\n",
+         name, prefetch ? "prefetch" : "no prefetch",
+         summary.load_time_mean * 1e3, summary.load_time_p50 * 1e3,
+         summary.load_time_p99 * 1e3, summary.load_time_max * 1e3,
+         summary.chunks_generated, summary.chunks_meshed,
+         summary.mesh_latency_mean * 1e3, summary.mesh_latency_max * 1e3);
+  printf("replay: %-8s %-11s %u prefetch hits, %.1f%% hit rate, "
+         "%.1f unmeshed chunks/frame, max %u, %u cancelled, %u dropped\n",
+         name, prefetch ? "prefetch" : "no prefetch", summary.prefetch_hits,
+         summary.prefetch_hit_rate * 100, summary.unmeshed_mean,
+         summary.unmeshed_max, world->prefetch.stats.cancelled,
+         world->prefetch.stats.dropped);
+  printf("replay: %-8s %-11s %u meshes avoided, %u stale tasks dropped, "
+         "%u restored from residency, %u unloads deferred for light\n",
+         name, prefetch ? "prefetch" : "no prefetch", summary.meshes_avoided,
+         summary.stale_dropped, summary.residency_hits,
+         summary.unloads_deferred);
+
+  const char *csv_prefix = getenv("VOXEL_REPLAY_CSV");
+
+  if (csv_prefix != NULL) {
+    char filename[256];
+    snprintf(filename, sizeof(filename), "%s_%s%s.csv", csv_prefix, name,
+             prefetch ? "_prefetch" : "");
+
+    FILE *file = fopen(filename, "wt");
+
+    if (file != NULL) {
+      replay_write_csv(file, frames, config.frame_count);
+      fclose(file);
+    }
+  }
+
+  free(frames);
+
+  light_engine_wait(&world->light_engine);
+  world_free(world);
+  free(world);
+}
+
+static void bench_replay_first_frame(const CameraPath *path) {
+  World *world = calloc(1, sizeof(World));
+
+  double start = bench_now();
+  world_init_headless(world);
+
+  unsigned int chunks_meshed;
+  double first_frame = replay_first_frame(world, path, &chunks_meshed);
+
+  double elapsed = bench_now() - start;
+
+  printf("replay: first frame after %.2f ms (init %.2f ms), %u chunks meshed\n",
+         elapsed * 1e3, (elapsed - first_frame) * 1e3, chunks_meshed);
+
+  light_engine_wait(&world->light_engine);
+  world_free(world);
+  free(world);
+}
+
+void bench_replay(void) {
+  CameraPath line = {.kind = CAMERA_PATH_LINE,
+                     .origin = {0, 64, 0},
+                     .velocity = {64, 0, 16}};
+  bench_replay_first_frame(&line);
+  bench_replay_run("line", &line, false);
+  bench_replay_run("line", &line, true);
+
+  CameraPath circle = {.kind = CAMERA_PATH_CIRCLE,
+                       .origin = {0, 64, 0},
+                       .radius = 128,
+                       .period = 4};
+  bench_replay_run("circle", &circle, false);
+  bench_replay_run("circle", &circle, true);
+
+  CameraPath teleport = {.kind = CAMERA_PATH_TELEPORT,
+                         .origin = {0, 64, 0},
+                         .velocity = {512, 0, 0},
+                         .period = 1};
+  bench_replay_run("teleport", &teleport, true);
+
+  const char *recorded_filename = getenv("VOXEL_REPLAY_PATH");
+  CameraPath recorded;
+
+  if (recorded_filename != NULL &&
+      camera_path_load(&recorded, recorded_filename)) {
+    bench_replay_run("recorded", &recorded, false);
+    bench_replay_run("recorded", &recorded, true);
+    camera_path_free(&recorded);
+  }
+}
@@ -0,0 +1,201 @@
+#include "bench.h"
+
+#include "block_type.h"
+#include "region.h"
+#include "residency.h"
+#include "voxel_dag.h"
+#include "world.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define bench_residency_column 8
+#define bench_residency_chunks                                                 \
+  (render_distance * render_distance * render_distance)
+
+static bool bench_residency_equal(const VoxelNode *a, const VoxelNode *b) {
+  if (a->has_octants != b->has_octants) {
+    return false;
+  }
+
+  if (!a->has_octants) {
+    return a->block_type == b->block_type;
+  }
+
+  for (unsigned int i = 0; i < 8; i++) {
+    if (!bench_residency_equal(&a->octants[i], &b->octants[i])) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static void bench_residency_terrain(World *world) {
+  int extent = render_distance * chunk_size;
+  srand(1);
+
+  for (int x = 0; x < extent; x += bench_residency_column) {
+    for (int z = 0; z < extent; z += bench_residency_column) {
+      int height = extent / 4 + rand() % (extent / 8);
+
+      region_fill_box(world, (Vec3i){x, 0, z},
+                      (Vec3i){x + bench_residency_column, height,
+                              z + bench_residency_column},
+                      GRASS);
+      region_fill_box(world, (Vec3i){x, height, z},
+                      (Vec3i){x + bench_residency_column, extent,
+                              z + bench_residency_column},
+                      AIR);
+    }
+  }
+
+  region_fill_sphere(world, (Vec3){extent / 2.0, extent / 4.0, extent / 2.0},
+                     extent / 6.0, GLASS);
+}
+
+static void bench_residency_tier(World *world) {
+  ChunkResidency residency;
+  residency_init(&residency);
+  residency.config.keep_distance = render_distance;
+  residency.config.memory_budget = 256 * 1024;
+  residency_update(&residency, (Vec3i){render_distance / 2,
+                                       render_distance / 2,
+                                       render_distance / 2});
+
+  for (unsigned int x = 0; x < render_distance; x++) {
+    for (unsigned int y = 0; y < render_distance; y++) {
+      for (unsigned int z = 0; z < render_distance; z++) {
+        const Chunk *chunk = world->chunks[x][y][z];
+        residency_store(&residency, chunk->position, &chunk->root, NULL, 0);
+      }
+    }
+  }
+
+  unsigned int hits = 0;
+  double start = bench_now();
+
+  for (unsigned int x = 0; x < render_distance; x++) {
+    for (unsigned int y = 0; y < render_distance; y++) {
+      for (unsigned int z = 0; z < render_distance; z++) {
+        VoxelNode root;
+        uint8_t *updates;
+        size_t updates_size;
+
+        if (residency_take(&residency, world->chunks[x][y][z]->position,
+                           &root, &updates, &updates_size)) {
+          voxel_node_free(&root);
+          free(updates);
+          hits++;
+        }
+      }
+    }
+  }
+
+  double elapsed = bench_now() - start;
+
+  printf("residency: %zu KiB budget kept %u / %u chunks, %u evicted, "
+         "%u restored in %.2f ms\n",
+         residency.config.memory_budget / 1024, hits, bench_residency_chunks,
+         residency.stats.evicted, residency.stats.hits, elapsed * 1e3);
+
+  residency_free(&residency);
+}
+
+void bench_residency(void) {
+  World *world = calloc(1, sizeof(World));
+  world_init_headless(world);
+  world_fill(world, (Vec3i){render_distance / 2, render_distance / 2,
+                            render_distance / 2});
+
+  bench_residency_terrain(world);
+
+  uint8_t **data = malloc(sizeof(uint8_t *) * bench_residency_chunks);
+  size_t *sizes = malloc(sizeof(size_t) * bench_residency_chunks);
+  size_t compressed_bytes = 0;
+  size_t resident_bytes = 0;
+  size_t tree_bytes = 0;
+  unsigned int index = 0;
+
+  double start = bench_now();
+
+  for (unsigned int x = 0; x < render_distance; x++) {
+    for (unsigned int y = 0; y < render_distance; y++) {
+      for (unsigned int z = 0; z < render_distance; z++) {
+        data[index] = residency_compress(&world->chunks[x][y][z]->root,
+                                         &sizes[index]);
+        index++;
+      }
+    }
+  }
+
+  double compress_elapsed = bench_now() - start;
+
+  for (unsigned int x = 0; x < render_distance; x++) {
+    for (unsigned int y = 0; y < render_distance; y++) {
+      for (unsigned int z = 0; z < render_distance; z++) {
+        tree_bytes +=
+            voxel_node_count(&world->chunks[x][y][z]->root) * sizeof(VoxelNode);
+      }
+    }
+  }
+
+  for (unsigned int i = 0; i < bench_residency_chunks; i++) {
+    compressed_bytes += sizes[i];
+    resident_bytes += residency_entry_bytes(sizes[i]);
+  }
+
+  VoxelNode *roots = malloc(sizeof(VoxelNode) * bench_residency_chunks);
+
+  start = bench_now();
+
+  for (unsigned int i = 0; i < bench_residency_chunks; i++) {
+    residency_decompress(data[i], sizes[i], &roots[i]);
+  }
+
+  double decompress_elapsed = bench_now() - start;
+
+  unsigned int mismatches = 0;
+  index = 0;
+
+  for (unsigned int x = 0; x < render_distance; x++) {
+    for (unsigned int y = 0; y < render_distance; y++) {
+      for (unsigned int z = 0; z < render_distance; z++) {
+        mismatches += !bench_residency_equal(&world->chunks[x][y][z]->root,
+                                             &roots[index]);
+        voxel_node_free(&roots[index]);
+        free(data[index]);
+        index++;
+      }
+    }
+  }
+
+  double dense_bytes =
+      (double)bench_residency_chunks * chunk_volume * sizeof(BlockType);
+
+  printf("residency: compress %u chunks in %.2f ms, %.2f us/chunk, "
+         "%.0f MB/s dense\n",
+         bench_residency_chunks, compress_elapsed * 1e3,
+         compress_elapsed * 1e6 / bench_residency_chunks,
+         dense_bytes / compress_elapsed / 1e6);
+  printf("residency: decompress %.2f ms, %.2f us/chunk, %.0f MB/s dense, "
+         "%u mismatches\n",
+         decompress_elapsed * 1e3,
+         decompress_elapsed * 1e6 / bench_residency_chunks,
+         dense_bytes / decompress_elapsed / 1e6, mismatches);
+  printf("residency: %.1f bytes/chunk compressed, %.1f resident, "
+         "%.1f expanded tree, %zu dense\n",
+         (double)compressed_bytes / bench_residency_chunks,
+         (double)resident_bytes / bench_residency_chunks,
+         (double)tree_bytes / bench_residency_chunks,
+         chunk_volume * sizeof(BlockType));
+
+  bench_residency_tier(world);
+
+  free(roots);
+  free(sizes);
+  free(data);
+
+  light_engine_wait(&world->light_engine);
+  world_free(world);
+  free(world);
+}
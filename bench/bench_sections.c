@@ -0,0 +1,178 @@
+#include "bench.h"
+
+#include "block_type.h"
+#include "camera.h"
+#include "heightmap.h"
+#include "mesh_sections.h"
+#include "world.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define bench_sections_churn 1000000
+#define bench_sections_churn_size 4096
+#define bench_sections_edits 256
+#define bench_sections_settle_rounds 64
+#define bench_sections_extent 96
+
+static void bench_sections_churn_run(void) {
+  MeshSections sections;
+  mesh_sections_init(&sections, 0);
+
+  unsigned int compactions = 0;
+  unsigned int invalid = 0;
+  double fill = 0;
+
+  srand(1);
+
+  double start = bench_now();
+
+  for (unsigned int i = 0; i < bench_sections_churn; i++) {
+    unsigned int section = rand() % mesh_section_count;
+    unsigned int size = rand() % bench_sections_churn_size / 6 * 6;
+
+    if (!mesh_sections_place(&sections, section, size)) {
+      MeshRange previous[mesh_section_count];
+      mesh_sections_compact(&sections,
+                            mesh_sections_headroom(sections.used + size),
+                            previous);
+      mesh_sections_place(&sections, section, size);
+      compactions++;
+    }
+
+    fill += sections.capacity != 0 ? (double)sections.used / sections.capacity
+                                   : 1;
+  }
+
+  double elapsed = bench_now() - start;
+
+  for (unsigned int section = 0; section < mesh_section_count; section++) {
+    mesh_sections_release(&sections, section);
+    invalid += !mesh_sections_valid(&sections);
+  }
+
+  mesh_sections_init(&sections, 0);
+  srand(1);
+
+  for (unsigned int i = 0; i < bench_sections_churn / 100; i++) {
+    unsigned int section = rand() % mesh_section_count;
+    unsigned int size = rand() % bench_sections_churn_size / 6 * 6;
+
+    if (!mesh_sections_place(&sections, section, size)) {
+      MeshRange previous[mesh_section_count];
+      mesh_sections_compact(&sections,
+                            mesh_sections_headroom(sections.used + size),
+                            previous);
+      mesh_sections_place(&sections, section, size);
+    }
+
+    invalid += !mesh_sections_valid(&sections) ||
+               sections.ranges[section].size != size;
+  }
+
+  printf("sections: allocator %.1f ns/placement, %u compactions over %u "
+         "placements, %.1f%% mean fill, %u invalid layouts\n",
+         elapsed * 1e9 / bench_sections_churn, compactions,
+         bench_sections_churn, fill * 100 / bench_sections_churn, invalid);
+}
+
+static void bench_sections_settle(World *world, Camera *camera) {
+  for (unsigned int i = 0; i < bench_sections_settle_rounds; i++) {
+    light_engine_wait(&world->light_engine);
+    world_wait(world);
+    world_load(world, camera);
+
+    if (world->stats.unmeshed_chunks == 0 && world->stats.mesh_queue == 0 &&
+        world->stats.chunks_meshed == 0 && world->stats.chunks_generated == 0) {
+      return;
+    }
+  }
+}
+
+static void bench_sections_mark_dirty(const World *world, bool *dirty) {
+  for (unsigned int slot = 0;
+       slot < render_distance * render_distance * render_distance; slot++) {
+    const Chunk *chunk = &world->chunk_storage[slot];
+
+    dirty[slot] = atomic_load(&chunk->loaded) && chunk->dirty_sections != 0;
+  }
+}
+
+static size_t bench_sections_full_bytes(const World *world,
+                                        const bool *dirty) {
+  size_t bytes = 0;
+
+  for (unsigned int slot = 0;
+       slot < render_distance * render_distance * render_distance; slot++) {
+    if (dirty[slot]) {
+      bytes += world->views[slot].sections.used * 2 * sizeof(float);
+    }
+  }
+
+  return bytes;
+}
+
+static void bench_sections_edit_run(void) {
+  World *world = calloc(1, sizeof(World));
+  world_init_headless(world);
+  world->prefetch.config.enabled = false;
+
+  Camera camera = {.transform = {.position = {0, 64, 0}, .scale = {1, 1, 1}}};
+  bench_sections_settle(world, &camera);
+
+  bool *dirty = calloc(render_distance * render_distance * render_distance,
+                       sizeof(bool));
+  size_t sectioned_bytes = 0;
+  size_t full_bytes = 0;
+  unsigned int sections_uploaded = 0;
+  unsigned int buffers_grown = 0;
+  unsigned int edits = 0;
+
+  srand(2);
+
+  for (unsigned int i = 0; i < bench_sections_edits; i++) {
+    int x = rand() % (2 * bench_sections_extent) - bench_sections_extent;
+    int z = rand() % (2 * bench_sections_extent) - bench_sections_extent;
+    int height = heightmap_get_height(&world->heightmap, x, z);
+
+    if (height == heightmap_none) {
+      continue;
+    }
+
+    bool dig = i % 2 != 0;
+    world_set_block_type(world, (Vec3i){x, dig ? height : height + 1, z},
+                         dig ? AIR : GLASS);
+    edits++;
+
+    bench_sections_mark_dirty(world, dirty);
+
+    for (unsigned int round = 0; round < 2; round++) {
+      light_engine_wait(&world->light_engine);
+      world_wait(world);
+      world_load(world, &camera);
+
+      sectioned_bytes += world->stats.bytes_uploaded;
+      sections_uploaded += world->stats.sections_uploaded;
+      buffers_grown += world->stats.buffers_grown;
+    }
+
+    full_bytes += bench_sections_full_bytes(world, dirty);
+  }
+
+  printf("sections: %u edits, %.2f KB/edit uploaded by section, %.2f KB/edit "
+         "for whole chunks (%.1fx), %.2f sections/edit, %u buffers grown\n",
+         edits, sectioned_bytes / 1e3 / edits, full_bytes / 1e3 / edits,
+         (double)full_bytes / sectioned_bytes,
+         (double)sections_uploaded / edits, buffers_grown);
+
+  free(dirty);
+  light_engine_wait(&world->light_engine);
+  world_wait(world);
+  world_free(world);
+  free(world);
+}
+
+void bench_sections(void) {
+  bench_sections_churn_run();
+  bench_sections_edit_run();
+}
@@ -0,0 +1,177 @@
+#include "bench.h"
+
+#include "block_type.h"
+#include "camera_path.h"
+#include "simulation.h"
+#include "world.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define bench_simulation_ticks 240
+#define bench_simulation_edits 8
+#define bench_simulation_duration 4.0
+#define bench_simulation_frame_time (1.0 / 120)
+#define bench_simulation_frame_samples 4096
+
+static void bench_simulation_edit(Simulation *simulation,
+                                  const Transform *camera) {
+  int extent = render_distance / 4 * chunk_size;
+
+  for (unsigned int i = 0; i < bench_simulation_edits; i++) {
+    Vec3i block;
+
+    for (unsigned int axis = 0; axis < 3; axis++) {
+      block[axis] = camera->position[axis] + rand() % (2 * extent) - extent;
+    }
+
+    simulation_edit(simulation, block, rand() % 2 ? AIR : GLASS);
+  }
+}
+
+static unsigned int bench_simulation_mismatches(const World *world) {
+  unsigned int mismatches = 0;
+
+  for (unsigned int slot = 0;
+       slot < render_distance * render_distance * render_distance; slot++) {
+    const Chunk *chunk = &world->chunk_storage[slot];
+    const ChunkView *view = &world->views[slot];
+    bool meshed = atomic_load(&chunk->loaded) && chunk->request_time == 0;
+
+    if (meshed) {
+      mismatches += !view->loaded ||
+                    !vec3i_compare(view->position, chunk->position) ||
+                    !mesh_sections_valid(&view->sections);
+    } else if (!atomic_load(&chunk->loaded)) {
+      mismatches += view->loaded;
+    }
+  }
+
+  return mismatches;
+}
+
+static void bench_simulation_report(const char *name,
+                                    const Simulation *simulation) {
+  SimulationSummary summary;
+  simulation_summarize(simulation, &summary);
+
+  printf("simulation: %-8s %u ticks, tick mean %.2f ms, p50 %.2f ms, p95 "
+         "%.2f ms, p99 %.2f ms, max %.2f ms, %u overruns, %u dropped\n",
+         name, summary.ticks, summary.tick_time_mean * 1e3,
+         summary.tick_time_p50 * 1e3, summary.tick_time_p95 * 1e3,
+         summary.tick_time_p99 * 1e3, summary.tick_time_max * 1e3,
+         summary.overruns, summary.ticks_dropped);
+  printf("simulation: %-8s %u frames presented, %u merged, %u uploads "
+         "applied, %u buffers grown, %u mismatched views\n",
+         name, summary.frames_presented, summary.frames_merged,
+         summary.uploads_applied, summary.buffers_grown,
+         bench_simulation_mismatches(simulation->world));
+}
+
+static void bench_simulation_headless(const CameraPath *path) {
+  World *world = calloc(1, sizeof(World));
+  world_init_headless(world);
+
+  Simulation simulation;
+  simulation_init(&simulation, world, simulation_default_timestep);
+  srand(1);
+
+  Transform camera = {.scale = {1, 1, 1}};
+
+  for (unsigned int i = 0; i < bench_simulation_ticks; i++) {
+    camera_path_sample(path, i * simulation.timestep, &camera);
+    simulation_set_camera(&simulation, &camera);
+    bench_simulation_edit(&simulation, &camera);
+
+    simulation_tick(&simulation);
+    light_engine_wait(&world->light_engine);
+    world_wait(world);
+
+    if (i % 3 != 0) {
+      simulation_present(&simulation);
+    }
+  }
+
+  simulation_present(&simulation);
+  bench_simulation_report("headless", &simulation);
+
+  simulation_free(&simulation);
+  light_engine_wait(&world->light_engine);
+  world_wait(world);
+  world_free(world);
+  free(world);
+}
+
+static void bench_simulation_threaded(const CameraPath *path) {
+  World *world = calloc(1, sizeof(World));
+  world_init_headless(world);
+
+  Simulation simulation;
+  simulation_init(&simulation, world, simulation_default_timestep);
+  srand(2);
+
+  Transform camera = {.scale = {1, 1, 1}};
+  simulation_set_camera(&simulation, &camera);
+  simulation_start(&simulation);
+
+  double *present_times =
+      malloc(sizeof(double) * bench_simulation_frame_samples);
+  unsigned int frame_count = 0;
+  unsigned int stale_frames = 0;
+  unsigned int previous_tick = 0;
+  double start = bench_now();
+
+  while (bench_now() - start < bench_simulation_duration &&
+         frame_count < bench_simulation_frame_samples) {
+    double frame_start = bench_now();
+
+    camera_path_sample(path, frame_start - start, &camera);
+    simulation_set_camera(&simulation, &camera);
+
+    if (frame_count % 4 == 0) {
+      bench_simulation_edit(&simulation, &camera);
+    }
+
+    const SimulationFrame *frame = simulation_present(&simulation);
+    present_times[frame_count++] = bench_now() - frame_start;
+
+    stale_frames += frame->tick == previous_tick;
+    previous_tick = frame->tick;
+
+    double remaining =
+        bench_simulation_frame_time - (bench_now() - frame_start);
+
+    if (remaining > 0) {
+      thrd_sleep(&(struct timespec){.tv_nsec = remaining * 1e9}, NULL);
+    }
+  }
+
+  simulation_stop(&simulation);
+  simulation_present(&simulation);
+
+  qsort(present_times, frame_count, sizeof(double), bench_compare_double);
+
+  printf("simulation: %-8s %u render frames over %.2f s, present p50 %.1f "
+         "us, p99 %.1f us, max %.1f us, %u frames reused a snapshot\n",
+         "threaded", frame_count, bench_now() - start,
+         present_times[frame_count / 2] * 1e6,
+         present_times[frame_count * 99 / 100] * 1e6,
+         present_times[frame_count - 1] * 1e6, stale_frames);
+  bench_simulation_report("threaded", &simulation);
+
+  free(present_times);
+  simulation_free(&simulation);
+  light_engine_wait(&world->light_engine);
+  world_wait(world);
+  world_free(world);
+  free(world);
+}
+
+void bench_simulation(void) {
+  CameraPath line = {.kind = CAMERA_PATH_LINE,
+                     .origin = {0, 64, 0},
+                     .velocity = {64, 0, 16}};
+
+  bench_simulation_headless(&line);
+  bench_simulation_threaded(&line);
+}
@@ -0,0 +1,206 @@
+#include "bench.h"
+
+#include "block_type.h"
+#include "camera.h"
+#include "camera_path.h"
+#include "stream.h"
+#include "transport.h"
+#include "world.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define bench_stream_frames 240
+#define bench_stream_timestep (1.0 / 60)
+#define bench_stream_edits 16
+#define bench_stream_box 4
+#define bench_stream_drain_rounds 64
+#define bench_stream_samples 200000
+
+typedef struct BenchStreamPeers {
+  World *server_world;
+  World *client_world;
+  StreamServer server;
+  StreamClient client;
+} BenchStreamPeers;
+
+static void bench_stream_view(const Camera *camera, Vec3i view) {
+  for (unsigned int axis = 0; axis < 3; axis++) {
+    view[axis] = camera->transform.position[axis];
+    view[axis] /= chunk_size;
+  }
+}
+
+static void bench_stream_wait(World *world) {
+  light_engine_wait(&world->light_engine);
+  world_wait(world);
+}
+
+static void bench_stream_edit(BenchStreamPeers *peers, const Vec3i view) {
+  int extent = render_distance / 2 * chunk_size;
+
+  for (unsigned int i = 0; i < bench_stream_edits; i++) {
+    Vec3i block;
+    BlockType block_type = rand() % 2 ? AIR : GLASS;
+    int size = i % 8 == 0 ? bench_stream_box : 1;
+
+    for (unsigned int axis = 0; axis < 3; axis++) {
+      block[axis] =
+          view[axis] * chunk_size + rand() % (2 * extent - size) - extent;
+    }
+
+    for (int x = 0; x < size; x++) {
+      for (int y = 0; y < size; y++) {
+        for (int z = 0; z < size; z++) {
+          Vec3i edit = {block[0] + x, block[1] + y, block[2] + z};
+
+          world_set_block_type(peers->server_world, edit, block_type);
+          stream_server_edit(&peers->server, edit, block_type);
+        }
+      }
+    }
+  }
+}
+
+static void bench_stream_step(BenchStreamPeers *peers, Camera *camera,
+                              const Vec3i view) {
+  world_load(peers->server_world, camera);
+  bench_stream_wait(peers->server_world);
+
+  stream_client_update(&peers->client, view);
+  stream_server_update(&peers->server);
+  stream_client_update(&peers->client, view);
+
+  world_load(peers->client_world, camera);
+  bench_stream_wait(peers->client_world);
+}
+
+static unsigned int bench_stream_mismatches(const BenchStreamPeers *peers,
+                                            const Vec3i view) {
+  int extent = render_distance / 2 * chunk_size;
+  unsigned int mismatches = 0;
+
+  for (unsigned int i = 0; i < bench_stream_samples; i++) {
+    Vec3i block;
+
+    for (unsigned int axis = 0; axis < 3; axis++) {
+      block[axis] = view[axis] * chunk_size + rand() % (2 * extent) - extent;
+    }
+
+    mismatches += world_get_block_type(peers->server_world, block) !=
+                  world_get_block_type(peers->client_world, block);
+  }
+
+  return mismatches;
+}
+
+static void bench_stream_run(const char *name, const CameraPath *path,
+                             Transport server_transport,
+                             Transport client_transport) {
+  BenchStreamPeers peers;
+  peers.server_world = calloc(1, sizeof(World));
+  peers.client_world = calloc(1, sizeof(World));
+  world_init_headless(peers.server_world);
+  world_init_headless(peers.client_world);
+  peers.server_world->prefetch.config.enabled = false;
+
+  stream_server_init(&peers.server, peers.server_world, server_transport);
+  stream_client_init(&peers.client, peers.client_world, client_transport);
+  srand(1);
+
+  Camera camera = {.transform = {.scale = {1, 1, 1}}};
+  Vec3i view;
+  double start = bench_now();
+  double wall_time = 0;
+
+  for (unsigned int i = 0; i < bench_stream_frames; i++) {
+    camera_path_sample(path, i * bench_stream_timestep, &camera.transform);
+    bench_stream_view(&camera, view);
+
+    bench_stream_edit(&peers, view);
+
+    double frame_start = bench_now();
+    bench_stream_step(&peers, &camera, view);
+    wall_time += bench_now() - frame_start;
+  }
+
+  for (unsigned int i = 0; i < bench_stream_drain_rounds; i++) {
+    unsigned int chunks = peers.server.stats.chunks;
+    size_t bytes = peers.server.stats.bytes;
+
+    bench_stream_step(&peers, &camera, view);
+
+    if (peers.server.stats.chunks == chunks &&
+        peers.server.stats.bytes == bytes) {
+      break;
+    }
+  }
+
+  double elapsed = bench_now() - start;
+  const StreamStats *sent = &peers.server.stats;
+  const StreamStats *received = &peers.client.stats;
+
+  printf("stream: %-8s %u chunks, %.1f bytes/chunk, %u edits, "
+         "%.2f bytes/edit, %.2f MB total\n",
+         name, sent->chunks, (double)sent->chunk_bytes / sent->chunks,
+         sent->edits, sent->edits ? (double)sent->edit_bytes / sent->edits : 0,
+         sent->bytes / 1e6);
+  printf("stream: %-8s encode %.0f chunks/s (%.2f us/chunk), decode %.0f "
+         "chunks/s (%.2f us/chunk), %.2f us/edit applied\n",
+         name, sent->chunks / sent->chunk_time,
+         sent->chunk_time * 1e6 / sent->chunks,
+         received->chunks / received->chunk_time,
+         received->chunk_time * 1e6 / received->chunks,
+         received->edits ? received->edit_time * 1e6 / received->edits : 0);
+  printf("stream: %-8s %.0f chunks/s end to end over %.2f s, %u resent, "
+         "%u dropped, %u mismatched blocks of %u sampled\n",
+         name, received->chunks / wall_time, elapsed, sent->chunks_resent,
+         received->chunks_dropped, bench_stream_mismatches(&peers, view),
+         bench_stream_samples);
+
+  stream_client_free(&peers.client);
+  stream_server_free(&peers.server);
+
+  bench_stream_wait(peers.client_world);
+  bench_stream_wait(peers.server_world);
+  world_free(peers.client_world);
+  world_free(peers.server_world);
+  free(peers.client_world);
+  free(peers.server_world);
+}
+
+void bench_stream(void) {
+  CameraPath line = {.kind = CAMERA_PATH_LINE,
+                     .origin = {0, 64, 0},
+                     .velocity = {64, 0, 16}};
+
+  Transport server_transport;
+  Transport client_transport;
+  transport_loopback_pair(&server_transport, &client_transport);
+  bench_stream_run("loopback", &line, server_transport, client_transport);
+
+  TransportListener listener;
+
+  if (!transport_tcp_listen(&listener, 0)) {
+    printf("stream: tcp      skipped, cannot listen on loopback\n");
+    return;
+  }
+
+  bool connected =
+      transport_tcp_connect(&client_transport, "127.0.0.1", listener.port);
+
+  if (connected && !transport_tcp_accept(&listener, &server_transport)) {
+    transport_close(&client_transport);
+    connected = false;
+  }
+
+  transport_listener_close(&listener);
+
+  if (!connected) {
+    printf("stream: tcp      skipped, cannot connect on port %u\n",
+           listener.port);
+    return;
+  }
+
+  bench_stream_run("tcp", &line, server_transport, client_transport);
+}
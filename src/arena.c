@@ -0,0 +1,74 @@
+#include "arena.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define arena_alignment alignof(ArenaBlock)
+
+static ArenaBlock *arena_block_create(size_t size) {
+  ArenaBlock *block = aligned_alloc(
+      arena_alignment,
+      (sizeof(ArenaBlock) + size + arena_alignment - 1) / arena_alignment *
+          arena_alignment);
+  block->next = NULL;
+  block->size = size;
+  block->used = 0;
+
+  return block;
+}
+
+void arena_init(Arena *arena, size_t size) {
+  arena->block = arena_block_create(size);
+  arena->allocation_count = 1;
+}
+
+void *arena_alloc(Arena *arena, size_t size) {
+  size = (size + arena_alignment - 1) / arena_alignment * arena_alignment;
+
+  if (arena->block->used + size > arena->block->size) {
+    size_t block_size = arena->block->size > size ? arena->block->size : size;
+    ArenaBlock *block = arena_block_create(block_size);
+    block->next = arena->block;
+    arena->block = block;
+    arena->allocation_count++;
+  }
+
+  void *data = arena->block->data + arena->block->used;
+  arena->block->used += size;
+
+  return data;
+}
+
+void *arena_calloc(Arena *arena, size_t count, size_t size) {
+  void *data = arena_alloc(arena, count * size);
+  memset(data, 0, count * size);
+
+  return data;
+}
+
+void arena_reset(Arena *arena) {
+  if (arena->block->next == NULL) {
+    arena->block->used = 0;
+    return;
+  }
+
+  size_t size = 0;
+
+  while (arena->block != NULL) {
+    ArenaBlock *next = arena->block->next;
+    size += arena->block->size;
+    free(arena->block);
+    arena->block = next;
+  }
+
+  arena->block = arena_block_create(size);
+  arena->allocation_count++;
+}
+
+void arena_free(Arena *arena) {
+  while (arena->block != NULL) {
+    ArenaBlock *next = arena->block->next;
+    free(arena->block);
+    arena->block = next;
+  }
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdalign.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct ArenaBlock {
+  struct ArenaBlock *next;
+  size_t size;
+  size_t used;
+  alignas(64) uint8_t data[];
+} ArenaBlock;
+
+typedef struct Arena {
+  ArenaBlock *block;
+  unsigned int allocation_count;
+} Arena;
+
+void arena_init(Arena *arena, size_t size);
+
+void *arena_alloc(Arena *arena, size_t size);
+
+void *arena_calloc(Arena *arena, size_t count, size_t size);
+
+void arena_reset(Arena *arena);
+
+void arena_free(Arena *arena);
@@ -0,0 +1,92 @@
+#include "block_type.h"
+
+#include <stdio.h>
+#include <string.h>
+
+BlockRegistry block_registry;
+
+BlockType AIR;
+BlockType GRASS;
+BlockType LAMP;
+BlockType GLASS;
+BlockType LEAVES;
+BlockType WATER;
+BlockType LAVA;
+
+void block_registry_init(void) {
+  if (block_registry.size != 0) {
+    return;
+  }
+
+  AIR = block_registry_register(&(BlockTypeInfo){.name = "air"});
+  GRASS = block_registry_register(
+      &(BlockTypeInfo){.name = "grass",
+                       .is_solid = true,
+                       .is_opaque = true,
+                       .render_layer = BLOCK_RENDER_LAYER_OPAQUE});
+  LAMP = block_registry_register(
+      &(BlockTypeInfo){.name = "lamp",
+                       .is_solid = true,
+                       .is_opaque = true,
+                       .render_layer = BLOCK_RENDER_LAYER_OPAQUE,
+                       .texture_layer = 1,
+                       .light_emission = 15});
+  GLASS = block_registry_register(
+      &(BlockTypeInfo){.name = "glass",
+                       .is_solid = true,
+                       .render_layer = BLOCK_RENDER_LAYER_TRANSLUCENT,
+                       .texture_layer = 2});
+  LEAVES = block_registry_register(
+      &(BlockTypeInfo){.name = "leaves",
+                       .is_solid = true,
+                       .render_layer = BLOCK_RENDER_LAYER_CUTOUT,
+                       .texture_layer = 3});
+  WATER = block_registry_register(
+      &(BlockTypeInfo){.name = "water",
+                       .render_layer = BLOCK_RENDER_LAYER_TRANSLUCENT,
+                       .texture_layer = 4});
+  LAVA = block_registry_register(
+      &(BlockTypeInfo){.name = "lava",
+                       .is_opaque = true,
+                       .render_layer = BLOCK_RENDER_LAYER_OPAQUE,
+                       .texture_layer = 5,
+                       .light_emission = 15});
+}
+
+BlockType block_registry_register(const BlockTypeInfo *info) {
+  if (block_registry.size >= block_type_capacity) {
+    printf("Block registry is full, cannot register %s\n", info->name);
+    return 0;
+  }
+
+  BlockType block_type = block_registry.size++;
+
+  block_registry.names[block_type] = info->name;
+  block_registry.is_solid[block_type] = info->is_solid;
+  block_registry.is_opaque[block_type] = info->is_opaque;
+  block_registry.render_layer[block_type] = info->render_layer;
+  block_registry.texture_layer[block_type] = info->texture_layer;
+  block_registry.light_emission[block_type] = info->light_emission;
+
+  uint64_t bit = (uint64_t)1 << (block_type % 64);
+
+  if (info->is_solid) {
+    block_registry.solid_bits[block_type / 64] |= bit;
+  }
+
+  if (info->is_opaque) {
+    block_registry.opaque_bits[block_type / 64] |= bit;
+  }
+
+  return block_type;
+}
+
+BlockType block_registry_find(const char *name) {
+  for (unsigned int i = 0; i < block_registry.size; i++) {
+    if (strcmp(block_registry.names[i], name) == 0) {
+      return i;
+    }
+  }
+
+  return AIR;
+}
@@ -1,13 +1,64 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
 
-typedef struct BlockTypeStruct {
-  bool is_solid : 1;
-  unsigned int id : 15;
-} BlockTypeStruct;
+#define block_type_capacity 1024
 
-typedef const BlockTypeStruct *BlockType;
+typedef uint16_t BlockType;
 
-static const BlockTypeStruct AIR = {false, 0};
-static const BlockTypeStruct GRASS = {true, 1};
+typedef enum BlockRenderLayer {
+  BLOCK_RENDER_LAYER_NONE,
+  BLOCK_RENDER_LAYER_OPAQUE,
+  BLOCK_RENDER_LAYER_CUTOUT,
+  BLOCK_RENDER_LAYER_TRANSLUCENT,
+} BlockRenderLayer;
+
+typedef struct BlockTypeInfo {
+  const char *name;
+  bool is_solid;
+  bool is_opaque;
+  BlockRenderLayer render_layer;
+  uint16_t texture_layer;
+  uint8_t light_emission;
+} BlockTypeInfo;
+
+typedef struct BlockRegistry {
+  unsigned int size;
+  const char *names[block_type_capacity];
+  bool is_solid[block_type_capacity];
+  bool is_opaque[block_type_capacity];
+  uint8_t render_layer[block_type_capacity];
+  uint16_t texture_layer[block_type_capacity];
+  uint8_t light_emission[block_type_capacity];
+  uint64_t solid_bits[block_type_capacity / 64];
+  uint64_t opaque_bits[block_type_capacity / 64];
+} BlockRegistry;
+
+extern BlockRegistry block_registry;
+
+extern BlockType AIR;
+extern BlockType GRASS;
+extern BlockType LAMP;
+extern BlockType GLASS;
+extern BlockType LEAVES;
+extern BlockType WATER;
+extern BlockType LAVA;
+
+void block_registry_init(void);
+
+BlockType block_registry_register(const BlockTypeInfo *info);
+
+BlockType block_registry_find(const char *name);
+
+static inline bool block_type_is_solid(BlockType block_type) {
+  return block_registry.solid_bits[block_type / 64] >> (block_type % 64) & 1;
+}
+
+static inline bool block_type_is_opaque(BlockType block_type) {
+  return block_registry.opaque_bits[block_type / 64] >> (block_type % 64) & 1;
+}
+
+static inline uint8_t block_type_light_emission(BlockType block_type) {
+  return block_registry.light_emission[block_type];
+}
@@ -0,0 +1,519 @@
+#include "block_update.h"
+
+#include "tracy/TracyC.h"
+#include "world.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define block_update_none 0
+#define block_update_overflow_bucket                                           \
+  (block_update_wheel_levels * block_update_wheel_size)
+#define block_update_free_bucket UINT16_MAX
+#define block_update_record_size (10 + sizeof(ChunkIndex))
+#define block_update_window_volume                                             \
+  (render_distance * render_distance * render_distance)
+
+MakeVectorDefinition(BlockUpdateAction);
+
+BlockUpdateKind BLOCK_UPDATE_REPLACE;
+
+static BlockUpdateHandler block_update_handlers[block_update_kind_capacity];
+static unsigned int block_update_kind_count;
+
+static void block_update_replace(BlockUpdateContext *context,
+                                 const Vec3i block, uint32_t data) {
+  if (world_get_block_type(context->world, block) == (data & 0xffff)) {
+    block_update_context_set(context, block, data >> 16);
+  }
+}
+
+void block_update_registry_init(void) {
+  if (block_update_kind_count != 0) {
+    return;
+  }
+
+  BLOCK_UPDATE_REPLACE = block_update_register(block_update_replace);
+}
+
+BlockUpdateKind block_update_register(BlockUpdateHandler handler) {
+  if (block_update_kind_count >= block_update_kind_capacity) {
+    return 0;
+  }
+
+  block_update_handlers[block_update_kind_count] = handler;
+
+  return block_update_kind_count++;
+}
+
+uint32_t block_update_replace_data(BlockType from, BlockType to) {
+  return from | (uint32_t)to << 16;
+}
+
+void block_update_context_set(BlockUpdateContext *context, const Vec3i block,
+                              BlockType block_type) {
+  BlockUpdateAction action = {.block_type = block_type};
+  vec3i_copy(action.block, block);
+  vector_insert_BlockUpdateAction(&context->shard->actions, action);
+}
+
+void block_update_context_schedule(BlockUpdateContext *context,
+                                   const Vec3i block, uint32_t delay,
+                                   BlockUpdateKind kind, uint32_t data) {
+  BlockUpdateAction action = {
+      .schedule = true, .kind = kind, .delay = delay, .data = data};
+  vec3i_copy(action.block, block);
+  vector_insert_BlockUpdateAction(&context->shard->actions, action);
+}
+
+static uint16_t block_update_bucket(uint64_t now, uint64_t due) {
+  uint64_t delta = due - now;
+
+  for (unsigned int level = 0; level < block_update_wheel_levels; level++) {
+    unsigned int shift = block_update_wheel_bits * level;
+
+    if (delta >> shift < block_update_wheel_size) {
+      return level * block_update_wheel_size +
+             (due >> shift & (block_update_wheel_size - 1));
+    }
+  }
+
+  return block_update_overflow_bucket;
+}
+
+static void block_update_link(BlockUpdateShard *shard, uint32_t index) {
+  BlockUpdate *update = &shard->updates[index];
+  uint32_t *head = &shard->buckets[block_update_bucket(shard->now,
+                                                       update->due)];
+
+  update->bucket = head - shard->buckets;
+  update->previous = block_update_none;
+
+  if (update->bucket != block_update_overflow_bucket) {
+    shard->occupied[update->bucket / block_update_wheel_size] |=
+        (uint64_t)1 << update->bucket % block_update_wheel_size;
+  }
+
+  if (*head != block_update_none) {
+    shard->updates[*head].previous = index;
+  }
+
+  update->next = *head;
+  *head = index;
+}
+
+static void block_update_unlink(BlockUpdateShard *shard, uint32_t index) {
+  BlockUpdate *update = &shard->updates[index];
+
+  if (update->previous != block_update_none) {
+    shard->updates[update->previous].next = update->next;
+  } else {
+    shard->buckets[update->bucket] = update->next;
+
+    if (update->next == block_update_none &&
+        update->bucket != block_update_overflow_bucket) {
+      shard->occupied[update->bucket / block_update_wheel_size] &=
+          ~((uint64_t)1 << update->bucket % block_update_wheel_size);
+    }
+  }
+
+  if (update->next != block_update_none) {
+    shard->updates[update->next].previous = update->previous;
+  }
+}
+
+static uint32_t block_update_alloc(BlockUpdateShard *shard) {
+  if (shard->free_head == block_update_none) {
+    unsigned int capacity = shard->capacity != 0 ? shard->capacity * 2 : 64;
+    shard->updates = realloc(shard->updates, sizeof(BlockUpdate) * capacity);
+
+    for (unsigned int i = capacity - 1; i >= shard->capacity && i != 0; i--) {
+      shard->updates[i] = (BlockUpdate){.next = shard->free_head,
+                                        .bucket = block_update_free_bucket};
+      shard->free_head = i;
+    }
+
+    shard->capacity = capacity;
+  }
+
+  uint32_t index = shard->free_head;
+  shard->free_head = shard->updates[index].next;
+  shard->count++;
+
+  return index;
+}
+
+static void block_update_release_index(BlockUpdateShard *shard,
+                                       uint32_t index) {
+  BlockUpdate *update = &shard->updates[index];
+
+  update->generation++;
+  update->bucket = block_update_free_bucket;
+  update->next = shard->free_head;
+  shard->free_head = index;
+  shard->count--;
+}
+
+static uint32_t block_update_detach(BlockUpdateShard *shard,
+                                    unsigned int bucket) {
+  uint32_t index = shard->buckets[bucket];
+  shard->buckets[bucket] = block_update_none;
+
+  if (bucket != block_update_overflow_bucket) {
+    shard->occupied[bucket / block_update_wheel_size] &=
+        ~((uint64_t)1 << bucket % block_update_wheel_size);
+  }
+
+  return index;
+}
+
+static void block_update_cascade(BlockUpdateShard *shard, unsigned int bucket) {
+  uint32_t index = block_update_detach(shard, bucket);
+
+  while (index != block_update_none) {
+    uint32_t next = shard->updates[index].next;
+    block_update_link(shard, index);
+    index = next;
+  }
+}
+
+static bool block_update_wrapped(uint64_t now, unsigned int level) {
+  return (now & (((uint64_t)1 << block_update_wheel_bits * level) - 1)) == 0;
+}
+
+static bool block_update_due(const BlockUpdateShard *shard) {
+  uint64_t now = shard->now + 1;
+
+  if (shard->occupied[0] >> (now & (block_update_wheel_size - 1)) & 1) {
+    return true;
+  }
+
+  for (unsigned int level = 1; level < block_update_wheel_levels; level++) {
+    if (!block_update_wrapped(now, level)) {
+      return false;
+    }
+
+    unsigned int slot = now >> block_update_wheel_bits * level &
+                        (block_update_wheel_size - 1);
+
+    if (shard->occupied[level] >> slot & 1) {
+      return true;
+    }
+  }
+
+  return block_update_wrapped(now, block_update_wheel_levels) &&
+         shard->buckets[block_update_overflow_bucket] != block_update_none;
+}
+
+static uint32_t block_update_advance(BlockUpdateShard *shard) {
+  uint64_t now = ++shard->now;
+
+  if (block_update_wrapped(now, block_update_wheel_levels)) {
+    block_update_cascade(shard, block_update_overflow_bucket);
+  }
+
+  for (unsigned int level = block_update_wheel_levels - 1; level > 0;
+       level--) {
+    if (block_update_wrapped(now, level)) {
+      block_update_cascade(shard, level * block_update_wheel_size +
+                                      (now >> block_update_wheel_bits * level &
+                                       (block_update_wheel_size - 1)));
+    }
+  }
+
+  return block_update_detach(shard, now & (block_update_wheel_size - 1));
+}
+
+static unsigned int block_update_slot(const BlockUpdateScheduler *scheduler,
+                                      const Chunk *chunk) {
+  return chunk - scheduler->world->chunk_storage;
+}
+
+void block_update_init(BlockUpdateScheduler *scheduler, World *world,
+                       unsigned int thread_count) {
+  block_update_registry_init();
+
+  scheduler->world = world;
+  scheduler->shards =
+      calloc(block_update_window_volume, sizeof(BlockUpdateShard));
+  scheduler->active =
+      malloc(sizeof(unsigned int) * block_update_window_volume);
+  scheduler->tick = 0;
+  scheduler->accumulator = 0;
+  scheduler->stats = (BlockUpdateStats){0};
+
+  thread_pool_init(&scheduler->pool, thread_count);
+}
+
+static BlockUpdateHandle block_update_insert(BlockUpdateScheduler *scheduler,
+                                             unsigned int slot, ChunkIndex cell,
+                                             uint32_t delay,
+                                             BlockUpdateKind kind,
+                                             uint32_t data) {
+  BlockUpdateShard *shard = &scheduler->shards[slot];
+
+  if (shard->buckets == NULL) {
+    shard->buckets = calloc(block_update_bucket_count, sizeof(uint32_t));
+  }
+
+  if (shard->count == 0) {
+    shard->now = scheduler->tick + slot;
+  }
+
+  uint32_t index = block_update_alloc(shard);
+  BlockUpdate *update = &shard->updates[index];
+  update->due = shard->now + (delay != 0 ? delay : 1);
+  update->data = data;
+  update->cell = cell;
+  update->kind = kind;
+  block_update_link(shard, index);
+
+  scheduler->stats.scheduled++;
+  scheduler->stats.pending++;
+
+  return (BlockUpdateHandle){slot, index, update->generation};
+}
+
+BlockUpdateHandle block_update_schedule(BlockUpdateScheduler *scheduler,
+                                        const Vec3i block, uint32_t delay,
+                                        BlockUpdateKind kind, uint32_t data) {
+  Vec3i chunk_position;
+  Vec3i local;
+  world_block_to_chunk(block, chunk_position, local);
+
+  Chunk *chunk = world_get_loaded_chunk(scheduler->world, chunk_position);
+
+  if (chunk == NULL || kind >= block_update_kind_count) {
+    return (BlockUpdateHandle){0};
+  }
+
+  return block_update_insert(
+      scheduler, block_update_slot(scheduler, chunk),
+      local[0] + (local[1] + local[2] * chunk_size) * chunk_size, delay, kind,
+      data);
+}
+
+bool block_update_cancel(BlockUpdateScheduler *scheduler,
+                         BlockUpdateHandle handle) {
+  if (handle.shard >= block_update_window_volume) {
+    return false;
+  }
+
+  BlockUpdateShard *shard = &scheduler->shards[handle.shard];
+
+  if (handle.index == block_update_none || handle.index >= shard->capacity ||
+      shard->updates[handle.index].generation != handle.generation ||
+      shard->updates[handle.index].bucket == block_update_free_bucket) {
+    return false;
+  }
+
+  block_update_unlink(shard, handle.index);
+  block_update_release_index(shard, handle.index);
+
+  scheduler->stats.cancelled++;
+  scheduler->stats.pending--;
+
+  return true;
+}
+
+uint8_t *block_update_save(const BlockUpdateScheduler *scheduler,
+                           const Chunk *chunk, size_t *size) {
+  const BlockUpdateShard *shard =
+      &scheduler->shards[block_update_slot(scheduler, chunk)];
+
+  *size = 0;
+
+  if (shard->count == 0) {
+    return NULL;
+  }
+
+  *size = shard->count * block_update_record_size;
+  uint8_t *data = malloc(*size);
+  uint8_t *cursor = data;
+
+  for (unsigned int i = 1; i < shard->capacity; i++) {
+    const BlockUpdate *update = &shard->updates[i];
+
+    if (update->bucket == block_update_free_bucket) {
+      continue;
+    }
+
+    uint64_t remaining = update->due - shard->now;
+    uint32_t delay = remaining < UINT32_MAX ? remaining : UINT32_MAX;
+
+    memcpy(cursor, &update->kind, sizeof(BlockUpdateKind));
+    memcpy(cursor + 2, &update->data, sizeof(uint32_t));
+    memcpy(cursor + 6, &delay, sizeof(uint32_t));
+    memcpy(cursor + 10, &update->cell, sizeof(ChunkIndex));
+    cursor += block_update_record_size;
+  }
+
+  return data;
+}
+
+void block_update_load(BlockUpdateScheduler *scheduler, const Chunk *chunk,
+                       const uint8_t *data, size_t size) {
+  unsigned int slot = block_update_slot(scheduler, chunk);
+
+  for (size_t offset = 0; offset + block_update_record_size <= size;
+       offset += block_update_record_size) {
+    ChunkIndex cell;
+    BlockUpdateKind kind;
+    uint32_t update_data;
+    uint32_t delay;
+
+    memcpy(&kind, data + offset, sizeof(BlockUpdateKind));
+    memcpy(&update_data, data + offset + 2, sizeof(uint32_t));
+    memcpy(&delay, data + offset + 6, sizeof(uint32_t));
+    memcpy(&cell, data + offset + 10, sizeof(ChunkIndex));
+
+    if (cell < chunk_volume && kind < block_update_kind_count) {
+      block_update_insert(scheduler, slot, cell, delay, kind, update_data);
+    }
+  }
+}
+
+void block_update_release(BlockUpdateScheduler *scheduler,
+                          const Chunk *chunk) {
+  BlockUpdateShard *shard =
+      &scheduler->shards[block_update_slot(scheduler, chunk)];
+
+  if (shard->count == 0) {
+    return;
+  }
+
+  scheduler->stats.pending -= shard->count;
+
+  for (unsigned int i = 1; i < shard->capacity; i++) {
+    if (shard->updates[i].bucket != block_update_free_bucket) {
+      block_update_release_index(shard, i);
+    }
+  }
+
+  memset(shard->occupied, 0, sizeof(shard->occupied));
+  memset(shard->buckets, 0, sizeof(uint32_t) * block_update_bucket_count);
+}
+
+static void block_update_run_shard(BlockUpdateScheduler *scheduler,
+                                   unsigned int slot) {
+  BlockUpdateShard *shard = &scheduler->shards[slot];
+  const Chunk *chunk = &scheduler->world->chunk_storage[slot];
+  BlockUpdateContext context = {scheduler->world, shard, scheduler->tick};
+  uint32_t index = block_update_advance(shard);
+
+  while (index != block_update_none) {
+    BlockUpdate *update = &shard->updates[index];
+    uint32_t next = update->next;
+    Vec3i block = {update->cell % chunk_size,
+                   update->cell / chunk_size % chunk_size,
+                   update->cell / (chunk_size * chunk_size)};
+
+    for (unsigned int axis = 0; axis < 3; axis++) {
+      block[axis] += chunk->position[axis] * chunk_size;
+    }
+
+    block_update_handlers[update->kind](&context, block, update->data);
+    block_update_release_index(shard, index);
+    shard->executed++;
+
+    index = next;
+  }
+}
+
+static void block_update_run_range(void *data, unsigned int begin,
+                                   unsigned int end) {
+  BlockUpdateScheduler *scheduler = data;
+
+  for (unsigned int i = begin; i < end; i++) {
+    block_update_run_shard(scheduler, scheduler->active[i]);
+  }
+}
+
+static void block_update_apply(BlockUpdateScheduler *scheduler,
+                               BlockUpdateShard *shard) {
+  scheduler->stats.executed += shard->executed;
+  scheduler->stats.pending -= shard->executed;
+  shard->executed = 0;
+
+  for (unsigned int i = 0; i < shard->actions.size; i++) {
+    const BlockUpdateAction *action = &shard->actions.data[i];
+
+    if (action->schedule) {
+      block_update_schedule(scheduler, action->block, action->delay,
+                            action->kind, action->data);
+    } else {
+      world_set_block_type(scheduler->world, action->block,
+                           action->block_type);
+    }
+  }
+
+  vector_clear_BlockUpdateAction(&shard->actions);
+}
+
+void block_update_tick(BlockUpdateScheduler *scheduler) {
+  TracyCZone(block_update_tick, true);
+
+  unsigned int active_count = 0;
+
+  for (unsigned int i = 0; i < block_update_window_volume; i++) {
+    BlockUpdateShard *shard = &scheduler->shards[i];
+
+    if (shard->count == 0) {
+      continue;
+    }
+
+    if (block_update_due(shard)) {
+      scheduler->active[active_count++] = i;
+    } else {
+      shard->now++;
+    }
+  }
+
+  scheduler->tick++;
+
+  unsigned int batch_size = active_count / (scheduler->pool.thread_count * 4);
+
+  thread_pool_parallel_for(&scheduler->pool, active_count,
+                           batch_size > 64 ? batch_size : 64,
+                           block_update_run_range, scheduler);
+
+  for (unsigned int i = 0; i < active_count; i++) {
+    block_update_apply(scheduler, &scheduler->shards[scheduler->active[i]]);
+  }
+
+  scheduler->stats.ticks++;
+  scheduler->stats.active_chunks = active_count;
+
+  TracyCZoneEnd(block_update_tick);
+}
+
+unsigned int block_update_update(BlockUpdateScheduler *scheduler,
+                                 double delta) {
+  unsigned int ticks = 0;
+  scheduler->accumulator += delta;
+
+  while (scheduler->accumulator >= block_update_tick_interval &&
+         ticks < block_update_max_ticks) {
+    block_update_tick(scheduler);
+    scheduler->accumulator -= block_update_tick_interval;
+    ticks++;
+  }
+
+  if (scheduler->accumulator >= block_update_tick_interval) {
+    scheduler->accumulator = 0;
+  }
+
+  return ticks;
+}
+
+void block_update_free(BlockUpdateScheduler *scheduler) {
+  thread_pool_free(&scheduler->pool);
+
+  for (unsigned int i = 0; i < block_update_window_volume; i++) {
+    free(scheduler->shards[i].updates);
+    free(scheduler->shards[i].buckets);
+    vector_free_BlockUpdateAction(&scheduler->shards[i].actions);
+  }
+
+  free(scheduler->shards);
+  free(scheduler->active);
+}
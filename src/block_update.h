@@ -0,0 +1,131 @@
+#pragma once
+
+#include "block_type.h"
+#include "chunk.h"
+#include "thread_pool.h"
+#include "vec3.h"
+#include "vector.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define block_update_wheel_bits 6
+#define block_update_wheel_size (1 << block_update_wheel_bits)
+#define block_update_wheel_levels 4
+#define block_update_bucket_count                                              \
+  (block_update_wheel_levels * block_update_wheel_size + 1)
+#define block_update_kind_capacity 64
+#define block_update_tick_interval 0.05
+#define block_update_max_ticks 4
+
+typedef struct World World;
+
+typedef uint16_t BlockUpdateKind;
+
+typedef struct BlockUpdate {
+  uint64_t due;
+  uint32_t next;
+  uint32_t previous;
+  uint32_t generation;
+  uint32_t data;
+  ChunkIndex cell;
+  BlockUpdateKind kind;
+  uint16_t bucket;
+} BlockUpdate;
+
+typedef struct BlockUpdateHandle {
+  uint32_t shard;
+  uint32_t index;
+  uint32_t generation;
+} BlockUpdateHandle;
+
+typedef struct BlockUpdateAction {
+  Vec3i block;
+  bool schedule;
+  BlockType block_type;
+  BlockUpdateKind kind;
+  uint32_t delay;
+  uint32_t data;
+} BlockUpdateAction;
+
+MakeVectorDeclaration(BlockUpdateAction);
+
+typedef struct BlockUpdateShard {
+  BlockUpdate *updates;
+  unsigned int capacity;
+  unsigned int count;
+  unsigned int executed;
+  uint32_t free_head;
+  uint64_t now;
+  uint64_t occupied[block_update_wheel_levels];
+  uint32_t *buckets;
+  Vector_BlockUpdateAction actions;
+} BlockUpdateShard;
+
+typedef struct BlockUpdateContext {
+  const World *world;
+  BlockUpdateShard *shard;
+  uint64_t tick;
+} BlockUpdateContext;
+
+typedef void (*BlockUpdateHandler)(BlockUpdateContext *context,
+                                   const Vec3i block, uint32_t data);
+
+typedef struct BlockUpdateStats {
+  uint64_t scheduled;
+  uint64_t cancelled;
+  uint64_t executed;
+  uint64_t pending;
+  unsigned int ticks;
+  unsigned int active_chunks;
+} BlockUpdateStats;
+
+typedef struct BlockUpdateScheduler {
+  World *world;
+  BlockUpdateShard *shards;
+  unsigned int *active;
+  uint64_t tick;
+  ThreadPool pool;
+  double accumulator;
+  BlockUpdateStats stats;
+} BlockUpdateScheduler;
+
+extern BlockUpdateKind BLOCK_UPDATE_REPLACE;
+
+void block_update_registry_init(void);
+
+BlockUpdateKind block_update_register(BlockUpdateHandler handler);
+
+uint32_t block_update_replace_data(BlockType from, BlockType to);
+
+void block_update_context_set(BlockUpdateContext *context, const Vec3i block,
+                              BlockType block_type);
+
+void block_update_context_schedule(BlockUpdateContext *context,
+                                   const Vec3i block, uint32_t delay,
+                                   BlockUpdateKind kind, uint32_t data);
+
+void block_update_init(BlockUpdateScheduler *scheduler, World *world,
+                       unsigned int thread_count);
+
+BlockUpdateHandle block_update_schedule(BlockUpdateScheduler *scheduler,
+                                        const Vec3i block, uint32_t delay,
+                                        BlockUpdateKind kind, uint32_t data);
+
+bool block_update_cancel(BlockUpdateScheduler *scheduler,
+                         BlockUpdateHandle handle);
+
+uint8_t *block_update_save(const BlockUpdateScheduler *scheduler,
+                           const Chunk *chunk, size_t *size);
+
+void block_update_load(BlockUpdateScheduler *scheduler, const Chunk *chunk,
+                       const uint8_t *data, size_t size);
+
+void block_update_release(BlockUpdateScheduler *scheduler, const Chunk *chunk);
+
+void block_update_tick(BlockUpdateScheduler *scheduler);
+
+unsigned int block_update_update(BlockUpdateScheduler *scheduler,
+                                 double delta);
+
+void block_update_free(BlockUpdateScheduler *scheduler);
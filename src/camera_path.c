@@ -0,0 +1,134 @@
+#include "camera_path.h"
+
+#include "math_util.h"
+#include <math.h>
+#include <stdio.h>
+
+MakeVectorDefinition(CameraPathKey);
+
+static void camera_path_sample_recorded(const CameraPath *path, double time,
+                                        Transform *transform) {
+  const Vector_CameraPathKey *keys = &path->keys;
+
+  if (keys->size == 0) {
+    return;
+  }
+
+  unsigned int next = 0;
+
+  while (next < keys->size && keys->data[next].time <= time) {
+    next++;
+  }
+
+  if (next == 0 || next == keys->size) {
+    *transform = keys->data[next == 0 ? 0 : keys->size - 1].transform;
+    return;
+  }
+
+  const CameraPathKey *a = &keys->data[next - 1];
+  const CameraPathKey *b = &keys->data[next];
+  double factor = (time - a->time) / (b->time - a->time);
+
+  for (unsigned int axis = 0; axis < 3; axis++) {
+    transform->position[axis] =
+        a->transform.position[axis] +
+        (b->transform.position[axis] - a->transform.position[axis]) * factor;
+    transform->rotation[axis] =
+        a->transform.rotation[axis] +
+        (b->transform.rotation[axis] - a->transform.rotation[axis]) * factor;
+  }
+}
+
+void camera_path_sample(const CameraPath *path, double time,
+                        Transform *transform) {
+  *transform = (Transform){.scale = {1, 1, 1}};
+
+  switch (path->kind) {
+  case CAMERA_PATH_LINE:
+    for (unsigned int axis = 0; axis < 3; axis++) {
+      transform->position[axis] =
+          path->origin[axis] + path->velocity[axis] * time;
+    }
+
+    transform->rotation[1] =
+        atan2(path->velocity[0], path->velocity[2]) / DEG_TO_RAD;
+    break;
+  case CAMERA_PATH_CIRCLE: {
+    double angle = 2 * M_PI * time / path->period;
+
+    transform->position[0] = path->origin[0] + cos(angle) * path->radius;
+    transform->position[1] = path->origin[1];
+    transform->position[2] = path->origin[2] + sin(angle) * path->radius;
+    transform->rotation[1] = -angle / DEG_TO_RAD;
+    break;
+  }
+  case CAMERA_PATH_TELEPORT: {
+    double jumps = floor(time / path->period);
+
+    for (unsigned int axis = 0; axis < 3; axis++) {
+      transform->position[axis] =
+          path->origin[axis] + path->velocity[axis] * path->period * jumps;
+    }
+    break;
+  }
+  case CAMERA_PATH_RECORDED:
+    camera_path_sample_recorded(path, time, transform);
+    break;
+  }
+}
+
+void camera_path_record(CameraPath *path, double time,
+                        const Transform *transform) {
+  vector_insert_CameraPathKey(&path->keys,
+                              (CameraPathKey){time, *transform});
+}
+
+bool camera_path_load(CameraPath *path, const char *filename) {
+  FILE *file = fopen(filename, "rt");
+
+  if (file == NULL) {
+    return false;
+  }
+
+  *path = (CameraPath){.kind = CAMERA_PATH_RECORDED};
+  vector_init_CameraPathKey(&path->keys, 0);
+
+  CameraPathKey key = {.transform = {.scale = {1, 1, 1}}};
+
+  while (fscanf(file, "%lf %lf %lf %lf %lf %lf %lf", &key.time,
+                &key.transform.position[0], &key.transform.position[1],
+                &key.transform.position[2], &key.transform.rotation[0],
+                &key.transform.rotation[1],
+                &key.transform.rotation[2]) == 7) {
+    vector_insert_CameraPathKey(&path->keys, key);
+  }
+
+  fclose(file);
+
+  return path->keys.size != 0;
+}
+
+bool camera_path_save(const CameraPath *path, const char *filename) {
+  FILE *file = fopen(filename, "wt");
+
+  if (file == NULL) {
+    return false;
+  }
+
+  for (unsigned int i = 0; i < path->keys.size; i++) {
+    const CameraPathKey *key = &path->keys.data[i];
+
+    fprintf(file, "%.6f %.6f %.6f %.6f %.6f %.6f %.6f\n", key->time,
+            key->transform.position[0], key->transform.position[1],
+            key->transform.position[2], key->transform.rotation[0],
+            key->transform.rotation[1], key->transform.rotation[2]);
+  }
+
+  fclose(file);
+
+  return true;
+}
+
+void camera_path_free(CameraPath *path) {
+  vector_free_CameraPathKey(&path->keys);
+}
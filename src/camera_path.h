@@ -0,0 +1,40 @@
+#pragma once
+
+#include "transform.h"
+#include "vector.h"
+#include <stdbool.h>
+
+typedef enum CameraPathKind {
+  CAMERA_PATH_LINE,
+  CAMERA_PATH_CIRCLE,
+  CAMERA_PATH_TELEPORT,
+  CAMERA_PATH_RECORDED,
+} CameraPathKind;
+
+typedef struct CameraPathKey {
+  double time;
+  Transform transform;
+} CameraPathKey;
+
+MakeVectorDeclaration(CameraPathKey);
+
+typedef struct CameraPath {
+  CameraPathKind kind;
+  Vec3 origin;
+  Vec3 velocity;
+  double radius;
+  double period;
+  Vector_CameraPathKey keys;
+} CameraPath;
+
+void camera_path_sample(const CameraPath *path, double time,
+                        Transform *transform);
+
+void camera_path_record(CameraPath *path, double time,
+                        const Transform *transform);
+
+bool camera_path_load(CameraPath *path, const char *filename);
+
+bool camera_path_save(const CameraPath *path, const char *filename);
+
+void camera_path_free(CameraPath *path);
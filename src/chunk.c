@@ -1,68 +1,143 @@
 #include "chunk.h"
 
 #include "block_type.h"
+#include "epoch.h"
+#include "mesh_kernel.h"
+#include "metrics.h"
 #include "tracy/TracyC.h"
 #include "vec3.h"
 #include "vector.h"
+#include "voxel_dag.h"
 #include "world.h"
-#include <GL/glew.h>
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+typedef struct MeshScratch {
+  Arena arena;
+  unsigned int palette_capacity;
+} MeshScratch;
+
+MakeVectorDefinition(ChunkPointer);
+
+static tss_t mesh_scratch_key;
+static once_flag mesh_scratch_once = ONCE_FLAG_INIT;
+static atomic_uint mesh_scratch_allocations;
 
 static void voxel_node_init(VoxelNode *voxel_node, int depth) {
   voxel_node->has_octants = true;
+  voxel_node->octants = voxel_octants_alloc();
 
-  for (uint8_t i = 0; i < 8; i++) {
-    voxel_node->octants[i] = calloc(1, sizeof(VoxelNode));
-  }
+  voxel_node->octants[0].block_type = GRASS;
+  voxel_node->octants[1].block_type = AIR;
+  voxel_node->octants[2].block_type = AIR;
+  voxel_node->octants[3].block_type = GRASS;
+  voxel_node->octants[4].block_type = AIR;
+  voxel_node->octants[5].block_type = GRASS;
+  voxel_node->octants[6].block_type = GRASS;
+  voxel_node->octants[7].block_type = AIR;
+}
 
-  voxel_node->octants[0]->block_type = &GRASS;
-  voxel_node->octants[1]->block_type = &AIR;
-  voxel_node->octants[2]->block_type = &AIR;
-  voxel_node->octants[3]->block_type = &GRASS;
-  voxel_node->octants[4]->block_type = &AIR;
-  voxel_node->octants[5]->block_type = &GRASS;
-  voxel_node->octants[6]->block_type = &GRASS;
-  voxel_node->octants[7]->block_type = &AIR;
+void chunk_generate(VoxelNode *root, const Vec3i position) {
+  uint64_t start = metrics_now();
+
+  voxel_node_init(root, 0);
+
+  metrics_add(METRIC_CHUNKS_GENERATED, 1);
+  metrics_record(METRIC_CHUNK_GENERATE, metrics_now() - start);
 }
 
 void chunk_init(Chunk *chunk, const Vec3i position) {
   TracyCZone(chunk_init, true);
 
+  VoxelNode root;
+  chunk_generate(&root, position);
+  chunk_init_with_root(chunk, position, root);
+
+  TracyCZoneEnd(chunk_init);
+}
+
+void chunk_init_with_root(Chunk *chunk, const Vec3i position,
+                          VoxelNode root) {
   mtx_init(&chunk->mutex, mtx_plain);
 
   vec3i_copy(chunk->position, position);
 
-  voxel_node_init(&chunk->root, 0);
+  chunk->root = root;
+  chunk->light = (ChunkLight){0};
+  chunk->solid_rows = NULL;
+  chunk->solid_columns = NULL;
+  chunk->dirty_sections = 0;
 
-  glGenBuffers(1, &chunk->vertex_buffer);
-  glGenBuffers(1, &chunk->normal_buffer);
+  chunk_publish(chunk);
+  atomic_store(&chunk->loaded, true);
+}
 
-  chunk->mesh_size = 0;
+static void chunk_snapshot_free(void *data) {
+  ChunkSnapshot *snapshot = data;
 
-  TracyCZoneEnd(chunk_init);
+  voxel_node_free(&snapshot->root);
+  free(snapshot);
+}
+
+void chunk_publish(Chunk *chunk) {
+  voxel_node_share(&chunk->root);
+
+  ChunkSnapshot *previous = atomic_load(&chunk->snapshot);
+
+  if (previous != NULL &&
+      previous->root.has_octants == chunk->root.has_octants &&
+      previous->root.block_type == chunk->root.block_type &&
+      previous->root.octants == chunk->root.octants &&
+      vec3i_compare(previous->position, chunk->position)) {
+    return;
+  }
+
+  ChunkSnapshot *snapshot = malloc(sizeof(ChunkSnapshot));
+  snapshot->root = chunk->root;
+  vec3i_copy(snapshot->position, chunk->position);
+
+  if (snapshot->root.has_octants) {
+    voxel_octants_retain(snapshot->root.octants);
+  }
+
+  previous = atomic_exchange(&chunk->snapshot, snapshot);
+
+  if (previous != NULL) {
+    epoch_retire(previous, chunk_snapshot_free);
+  }
+}
+
+const ChunkSnapshot *chunk_get_snapshot(const Chunk *chunk) {
+  return atomic_load(&chunk->snapshot);
 }
 
 BlockType chunk_get_block_type(const Chunk *chunk, const Vec3i block) {
-  const VoxelNode *octant = &chunk->root;
+  return voxel_node_get_block_type(&chunk->root, block);
+}
 
-  int depth_factor = 16;
+BlockType voxel_node_get_block_type(const VoxelNode *root, const Vec3i block) {
+  const VoxelNode *octant = root;
+
+  int depth_factor = chunk_size / 2;
 
   uint8_t local_x = block[0];
   uint8_t local_y = block[1];
   uint8_t local_z = block[2];
 
   while (octant->has_octants) {
-    int octant_x = local_x / depth_factor < 1;
-    int octant_y = local_y / depth_factor < 1;
-    int octant_z = local_z / depth_factor < 1;
+    int octant_x = local_x / depth_factor >= 1;
+    int octant_y = local_y / depth_factor >= 1;
+    int octant_z = local_z / depth_factor >= 1;
 
     local_x %= depth_factor;
     local_y %= depth_factor;
     local_z %= depth_factor;
 
-    octant = octant->octants[octant_x + octant_y * 2 + octant_z * 4];
+    octant = &octant->octants[octant_x + octant_y * 2 + octant_z * 4];
 
     depth_factor /= 2;
   }
@@ -70,202 +145,865 @@ BlockType chunk_get_block_type(const Chunk *chunk, const Vec3i block) {
   return octant->block_type;
 }
 
-static void make_vertex(Vector_float *vertices, Vector_float *normals,
-                        Vec3i coordinates, unsigned int normal) {
-  vector_insert_float(vertices, coordinates[0] + coordinates[1] * 33 +
-                                    coordinates[2] * 33 * 33);
-  vector_insert_float(normals, normal);
+const VoxelNode *chunk_get_leaf(const Chunk *chunk, const Vec3i block,
+                                Vec3i offset, unsigned int *size) {
+  const VoxelNode *node = &chunk->root;
+  unsigned int node_size = chunk_size;
+  Vec3i node_offset = {0, 0, 0};
+
+  while (node->has_octants) {
+    node_size /= 2;
+    unsigned int index = 0;
+
+    for (unsigned int axis = 0; axis < 3; axis++) {
+      if (block[axis] >= node_offset[axis] + (int)node_size) {
+        node_offset[axis] += node_size;
+        index |= 1 << axis;
+      }
+    }
+
+    node = &node->octants[index];
+  }
+
+  vec3i_copy(offset, node_offset);
+  *size = node_size;
+
+  return node;
+}
+
+static void voxel_node_split(VoxelNode *voxel_node) {
+  voxel_node->has_octants = true;
+  voxel_node->octants = voxel_octants_alloc();
+
+  for (uint8_t i = 0; i < 8; i++) {
+    voxel_node->octants[i].block_type = voxel_node->block_type;
+  }
+}
+
+static bool voxel_node_collapse(VoxelNode *voxel_node) {
+  for (uint8_t i = 0; i < 8; i++) {
+    const VoxelNode *octant = &voxel_node->octants[i];
+
+    if (octant->has_octants ||
+        octant->block_type != voxel_node->octants[0].block_type) {
+      return false;
+    }
+  }
+
+  voxel_node->block_type = voxel_node->octants[0].block_type;
+
+  voxel_octants_release(voxel_node->octants);
+  voxel_node->octants = NULL;
+  voxel_node->has_octants = false;
+
+  return true;
+}
+
+void chunk_set_block_type(Chunk *chunk, const Vec3i block,
+                          BlockType block_type) {
+  VoxelNode *path[6];
+  unsigned int depth = 0;
+
+  VoxelNode *octant = &chunk->root;
+  unsigned int depth_factor = chunk_size / 2;
+
+  while (depth_factor >= 1) {
+    if (!octant->has_octants) {
+      if (octant->block_type == block_type) {
+        return;
+      }
+
+      voxel_node_split(octant);
+    } else {
+      voxel_node_make_unique(octant);
+    }
+
+    path[depth++] = octant;
+
+    int octant_x = (block[0] & depth_factor) != 0;
+    int octant_y = (block[1] & depth_factor) != 0;
+    int octant_z = (block[2] & depth_factor) != 0;
+
+    octant = &octant->octants[octant_x + octant_y * 2 + octant_z * 4];
+
+    depth_factor /= 2;
+  }
+
+  octant->block_type = block_type;
+
+  if (chunk->solid_rows != NULL) {
+    ChunkRow *row = &chunk->solid_rows[block[1] * chunk_size + block[2]];
+    ChunkRow bit = (ChunkRow)1 << block[0];
+    *row = block_type_is_solid(block_type) ? *row | bit : *row & ~bit;
+  }
+
+  if (chunk->solid_columns != NULL) {
+    ChunkRow *column = &chunk->solid_columns[block[0] + block[2] * chunk_size];
+    ChunkRow bit = (ChunkRow)1 << block[1];
+    *column = block_type_is_solid(block_type) ? *column | bit : *column & ~bit;
+  }
+
+  while (depth > 0 && voxel_node_collapse(path[depth - 1])) {
+    depth--;
+  }
+}
+
+uint8_t chunk_edit_sections(const Vec3i block) {
+  unsigned int section = block[1] / chunk_section_height;
+  unsigned int height = block[1] % chunk_section_height;
+  uint8_t sections = 1 << section;
+
+  if (height == 0 && section > 0) {
+    sections |= 1 << (section - 1);
+  }
+
+  if (height == chunk_section_height - 1 && section < mesh_section_count - 1) {
+    sections |= 1 << (section + 1);
+  }
+
+  return sections;
+}
+
+uint8_t chunk_neighbour_sections(const Vec3i block, unsigned int axis) {
+  if (axis != 1) {
+    return 1 << block[1] / chunk_section_height;
+  }
+
+  return block[1] == 0 ? 1 << (mesh_section_count - 1) : 1;
+}
+
+static bool voxel_node_fill(VoxelNode *node, const Vec3i offset,
+                            unsigned int size, VoxelRegionTest test,
+                            const void *data, BlockType block_type) {
+  if (!node->has_octants && node->block_type == block_type) {
+    return false;
+  }
+
+  VoxelCoverage coverage = test(offset, size, data);
+
+  if (coverage == VOXEL_COVERAGE_NONE) {
+    return false;
+  }
+
+  if (coverage == VOXEL_COVERAGE_FULL || size == 1) {
+    voxel_node_free(node);
+    *node = (VoxelNode){.has_octants = false, .block_type = block_type};
+    return true;
+  }
+
+  if (!node->has_octants) {
+    voxel_node_split(node);
+  } else {
+    voxel_node_make_unique(node);
+  }
+
+  bool changed = false;
+  unsigned int half = size / 2;
+
+  for (unsigned int i = 0; i < 8; i++) {
+    Vec3i octant_offset = {offset[0] + (i & 1) * half,
+                           offset[1] + (i >> 1 & 1) * half,
+                           offset[2] + (i >> 2 & 1) * half};
+    changed |= voxel_node_fill(&node->octants[i], octant_offset, half, test,
+                               data, block_type);
+  }
+
+  voxel_node_collapse(node);
+
+  return changed;
+}
+
+static bool voxel_node_paint(VoxelNode *node, const Vec3i offset,
+                             unsigned int size, VoxelRegionSample sample,
+                             const void *data) {
+  BlockType block_type;
+  VoxelCoverage coverage = sample(offset, size, data, &block_type);
+
+  if (coverage == VOXEL_COVERAGE_NONE) {
+    return false;
+  }
+
+  if (coverage == VOXEL_COVERAGE_FULL) {
+    if (!node->has_octants && node->block_type == block_type) {
+      return false;
+    }
+
+    voxel_node_free(node);
+    *node = (VoxelNode){.has_octants = false, .block_type = block_type};
+    return true;
+  }
+
+  if (!node->has_octants) {
+    voxel_node_split(node);
+  } else {
+    voxel_node_make_unique(node);
+  }
+
+  bool changed = false;
+  unsigned int half = size / 2;
+
+  for (unsigned int i = 0; i < 8; i++) {
+    Vec3i octant_offset = {offset[0] + (i & 1) * half,
+                           offset[1] + (i >> 1 & 1) * half,
+                           offset[2] + (i >> 2 & 1) * half};
+    changed |=
+        voxel_node_paint(&node->octants[i], octant_offset, half, sample, data);
+  }
+
+  voxel_node_collapse(node);
+
+  return changed;
+}
+
+static void chunk_region_changed(Chunk *chunk) {
+  free(chunk->solid_rows);
+  free(chunk->solid_columns);
+  chunk->solid_rows = NULL;
+  chunk->solid_columns = NULL;
+}
+
+bool chunk_fill_region(Chunk *chunk, VoxelRegionTest test, const void *data,
+                       BlockType block_type) {
+  Vec3i origin = {chunk->position[0] * chunk_size,
+                  chunk->position[1] * chunk_size,
+                  chunk->position[2] * chunk_size};
+
+  bool changed =
+      voxel_node_fill(&chunk->root, origin, chunk_size, test, data, block_type);
+
+  if (changed) {
+    chunk_region_changed(chunk);
+  }
+
+  return changed;
+}
+
+bool chunk_paint_region(Chunk *chunk, VoxelRegionSample sample,
+                        const void *data) {
+  Vec3i origin = {chunk->position[0] * chunk_size,
+                  chunk->position[1] * chunk_size,
+                  chunk->position[2] * chunk_size};
+
+  bool changed =
+      voxel_node_paint(&chunk->root, origin, chunk_size, sample, data);
+
+  if (changed) {
+    chunk_region_changed(chunk);
+  }
+
+  return changed;
+}
+
+static void for_each_leaf_step(const VoxelNode *node, unsigned int depth_factor,
+                               const Vec3i offset, VoxelLeafCallback callback,
+                               void *data) {
+  if (!node->has_octants) {
+    callback(node, offset, depth_factor, data);
+    return;
+  }
+
+  for (unsigned char x = 0; x < 2; x++) {
+    for (unsigned char y = 0; y < 2; y++) {
+      for (unsigned char z = 0; z < 2; z++) {
+        for_each_leaf_step(&node->octants[x + y * 2 + z * 4], depth_factor / 2,
+                           (Vec3i){offset[0] + x * depth_factor / 2,
+                                   offset[1] + y * depth_factor / 2,
+                                   offset[2] + z * depth_factor / 2},
+                           callback, data);
+      }
+    }
+  }
+}
+
+void chunk_for_each_leaf(const Chunk *chunk, VoxelLeafCallback callback,
+                         void *data) {
+  voxel_node_for_each_leaf(&chunk->root, callback, data);
+}
+
+void voxel_node_for_each_leaf(const VoxelNode *root, VoxelLeafCallback callback,
+                              void *data) {
+  for_each_leaf_step(root, chunk_size, (Vec3i){0, 0, 0}, callback, data);
+}
+
+static void fill_solid_rows_leaf(const VoxelNode *leaf, const Vec3i offset,
+                                 unsigned int size, void *data) {
+  if (!block_type_is_solid(leaf->block_type)) {
+    return;
+  }
+
+  ChunkRow *solid_rows = data;
+  ChunkRow span =
+      size == chunk_size ? chunk_row_full : ((ChunkRow)1 << size) - 1;
+
+  for (unsigned int y = offset[1]; y < offset[1] + size; y++) {
+    for (unsigned int z = offset[2]; z < offset[2] + size; z++) {
+      solid_rows[y * chunk_size + z] |= span << offset[0];
+    }
+  }
+}
+
+const ChunkRow *chunk_get_solid_rows(Chunk *chunk) {
+  if (chunk->solid_rows == NULL) {
+    chunk->solid_rows = calloc(chunk_size * chunk_size, sizeof(ChunkRow));
+    chunk_for_each_leaf(chunk, fill_solid_rows_leaf, chunk->solid_rows);
+  }
+
+  return chunk->solid_rows;
+}
+
+static void fill_solid_columns_leaf(const VoxelNode *leaf, const Vec3i offset,
+                                    unsigned int size, void *data) {
+  if (!block_type_is_solid(leaf->block_type)) {
+    return;
+  }
+
+  ChunkRow *solid_columns = data;
+  ChunkRow span =
+      size == chunk_size ? chunk_row_full : ((ChunkRow)1 << size) - 1;
+
+  for (unsigned int z = offset[2]; z < offset[2] + size; z++) {
+    for (unsigned int x = offset[0]; x < offset[0] + size; x++) {
+      solid_columns[x + z * chunk_size] |= span << offset[1];
+    }
+  }
 }
 
-static void make_face(Vector_float *vertices, Vector_float *normals,
-                      Vec3i coordinates, int axis, int negative) {
+const ChunkRow *chunk_get_solid_columns(Chunk *chunk) {
+  if (chunk->solid_columns == NULL) {
+    chunk->solid_columns = calloc(chunk_size * chunk_size, sizeof(ChunkRow));
+    chunk_for_each_leaf(chunk, fill_solid_columns_leaf, chunk->solid_columns);
+  }
+
+  return chunk->solid_columns;
+}
+
+typedef struct MaskBuilder {
+  ChunkMasks *masks;
+  uint64_t seen[block_type_capacity / 64];
+  uint16_t palette_index[block_type_capacity];
+} MaskBuilder;
+
+static void mesh_scratch_free(void *data) {
+  MeshScratch *scratch = data;
+
+  arena_free(&scratch->arena);
+  free(scratch);
+}
+
+static void mesh_scratch_create_key(void) {
+  tss_create(&mesh_scratch_key, mesh_scratch_free);
+}
+
+static unsigned int mesh_scratch_palette_capacity(void) {
+  unsigned int palette_capacity = 0;
+
+  for (unsigned int i = 0; i < block_registry.size; i++) {
+    palette_capacity +=
+        block_registry.render_layer[i] != BLOCK_RENDER_LAYER_NONE;
+  }
+
+  return palette_capacity;
+}
+
+static size_t mesh_scratch_size(unsigned int palette_capacity) {
+  return sizeof(MaskBuilder) + sizeof(ChunkMasks) +
+         palette_capacity * (sizeof(BlockType) + 3 * sizeof(BlockMask) +
+                             2 * sizeof(MaskRow)) +
+         8 * alignof(ArenaBlock);
+}
+
+static MeshScratch *mesh_scratch_get(void) {
+  call_once(&mesh_scratch_once, mesh_scratch_create_key);
+
+  MeshScratch *scratch = tss_get(mesh_scratch_key);
+  unsigned int palette_capacity = mesh_scratch_palette_capacity();
+
+  if (scratch != NULL && scratch->palette_capacity >= palette_capacity) {
+    return scratch;
+  }
+
+  if (scratch == NULL) {
+    scratch = malloc(sizeof(MeshScratch));
+    tss_set(mesh_scratch_key, scratch);
+  } else {
+    arena_free(&scratch->arena);
+    atomic_fetch_add(&mesh_scratch_allocations, 1);
+  }
+
+  arena_init(&scratch->arena, mesh_scratch_size(palette_capacity));
+  scratch->palette_capacity = palette_capacity;
+
+  return scratch;
+}
+
+unsigned int chunk_mesh_scratch_allocations(void) {
+  return atomic_load(&mesh_scratch_allocations);
+}
+
+#define vertex_stride (chunk_size + 1)
+
+static inline __attribute__((always_inline)) float
+make_vertex(unsigned int base, unsigned int x, unsigned int y,
+            unsigned int z) {
+  return base + x + y * vertex_stride + z * vertex_stride * vertex_stride;
+}
+
+static inline __attribute__((always_inline)) void
+make_face(float *restrict vertices, float *restrict normals,
+          const unsigned int *coordinates, unsigned int axis, bool negative,
+          float normal) {
   bool axis_x = axis == 0;
   bool axis_y = axis == 1;
   bool axis_z = axis == 2;
 
-  Vec3i v1 = {coordinates[0], coordinates[1], coordinates[2]};
-  Vec3i v2 = {coordinates[0] + !axis_x, coordinates[1] + !axis_y,
-              coordinates[2] + !axis_z};
-  Vec3i v3 = {coordinates[0] + axis_z, coordinates[1] + axis_x,
-              coordinates[2] + axis_y};
-  Vec3i v4 = {coordinates[0] + axis_y, coordinates[1] + axis_z,
-              coordinates[2] + axis_x};
-
-  float normal = !negative * 3 + axis;
-
-  if (negative == 0) {
-    make_vertex(vertices, normals, v3, normal);
-    make_vertex(vertices, normals, v2, normal);
-    make_vertex(vertices, normals, v1, normal);
-    make_vertex(vertices, normals, v2, normal);
-    make_vertex(vertices, normals, v4, normal);
-    make_vertex(vertices, normals, v1, normal);
+  unsigned int v1 = make_vertex(0, coordinates[0], coordinates[1],
+                                coordinates[2]);
+  float v2 = make_vertex(v1, !axis_x, !axis_y, !axis_z);
+  float v3 = make_vertex(v1, axis_z, axis_x, axis_y);
+  float v4 = make_vertex(v1, axis_y, axis_z, axis_x);
+
+  if (!negative) {
+    vertices[0] = v3;
+    vertices[1] = v2;
+    vertices[2] = v1;
+    vertices[3] = v2;
+    vertices[4] = v4;
+    vertices[5] = v1;
   } else {
-    make_vertex(vertices, normals, v1, normal);
-    make_vertex(vertices, normals, v2, normal);
-    make_vertex(vertices, normals, v3, normal);
-    make_vertex(vertices, normals, v1, normal);
-    make_vertex(vertices, normals, v4, normal);
-    make_vertex(vertices, normals, v2, normal);
-  }
-}
-
-static void build_block_mask_step(uint64_t *block_mask, const VoxelNode *node,
-                                  unsigned int depth_factor, const Vec3i offset,
-                                  unsigned int axis) {
-  if (node->has_octants) {
-    for (unsigned char x = 0; x < 2; x++) {
-      for (unsigned char y = 0; y < 2; y++) {
-        for (unsigned char z = 0; z < 2; z++) {
-          build_block_mask_step(block_mask, node->octants[x + y * 2 + z * 4],
-                                depth_factor / 2,
-                                (Vec3i){offset[0] + x * depth_factor / 2,
-                                        offset[1] + y * depth_factor / 2,
-                                        offset[2] + z * depth_factor / 2},
-                                axis);
+    vertices[0] = v1;
+    vertices[1] = v2;
+    vertices[2] = v3;
+    vertices[3] = v1;
+    vertices[4] = v4;
+    vertices[5] = v2;
+  }
+
+  for (unsigned int i = 0; i < 6; i++) {
+    normals[i] = normal;
+  }
+}
+
+static const unsigned int mask_row_axes[3][2] = {{1, 2}, {0, 2}, {0, 1}};
+
+static void collect_palette_leaf(const VoxelNode *leaf, const Vec3i offset,
+                                 unsigned int size, void *data) {
+  MaskBuilder *builder = data;
+  builder->seen[leaf->block_type / 64] |= (uint64_t)1 << leaf->block_type % 64;
+}
+
+static void fill_masks_leaf(const VoxelNode *leaf, const Vec3i offset,
+                            unsigned int size, void *data) {
+  MaskBuilder *builder = data;
+  uint16_t palette_index = builder->palette_index[leaf->block_type];
+
+  if (palette_index == UINT16_MAX) {
+    return;
+  }
+
+  bool opaque = block_type_is_opaque(leaf->block_type);
+  MaskRow bits = ((MaskRow)1 << size) - 1;
+
+  for (unsigned int axis = 0; axis < 3; axis++) {
+    unsigned int axis_a = mask_row_axes[axis][0];
+    unsigned int axis_b = mask_row_axes[axis][1];
+    MaskRow row_bits = bits << (offset[axis] + 1);
+
+    MaskRow *material = builder->masks->materials[palette_index][axis];
+    MaskRow *opaque_mask = builder->masks->opaque[axis];
+
+    for (unsigned int b = offset[axis_b]; b < offset[axis_b] + size; b++) {
+      for (unsigned int a = offset[axis_a]; a < offset[axis_a] + size; a++) {
+        material[a + b * chunk_size] |= row_bits;
+
+        if (opaque) {
+          opaque_mask[a + b * chunk_size] |= row_bits;
         }
       }
     }
+  }
+}
 
+static void fill_masks_border(MaskBuilder *builder,
+                              const ChunkSnapshot *snapshot, World *world,
+                              unsigned int axis, bool next) {
+  Vec3i neighbour_position;
+  vec3i_copy(neighbour_position, snapshot->position);
+  neighbour_position[axis] += next ? 1 : -1;
+
+  const ChunkSnapshot *neighbour =
+      world_get_snapshot(world, neighbour_position);
+
+  if (neighbour == NULL) {
     return;
   }
 
-  if (node->block_type->is_solid == false) {
-    return;
+  ChunkMasks *masks = builder->masks;
+  unsigned int axis_a = mask_row_axes[axis][0];
+  unsigned int axis_b = mask_row_axes[axis][1];
+  MaskRow bit = (MaskRow)1 << (next ? chunk_size + 1 : 0);
+
+  for (unsigned int b = 0; b < chunk_size; b++) {
+    for (unsigned int a = 0; a < chunk_size; a++) {
+      Vec3i block;
+      block[axis] = next ? 0 : chunk_size - 1;
+      block[axis_a] = a;
+      block[axis_b] = b;
+
+      BlockType block_type =
+          voxel_node_get_block_type(&neighbour->root, block);
+
+      if (block_type_is_opaque(block_type)) {
+        masks->opaque[axis][a + b * chunk_size] |= bit;
+        continue;
+      }
+
+      uint16_t palette_index = builder->palette_index[block_type];
+
+      if (palette_index != UINT16_MAX) {
+        masks->materials[palette_index][axis][a + b * chunk_size] |= bit;
+      }
+    }
+  }
+}
+
+ChunkMasks *chunk_build_masks(const ChunkSnapshot *snapshot, World *world,
+                              Arena *arena) {
+  TracyCZone(chunk_build_masks, true);
+  uint64_t start = metrics_now();
+
+  MaskBuilder *builder = arena_calloc(arena, 1, sizeof(MaskBuilder));
+  ChunkMasks *masks = arena_calloc(arena, 1, sizeof(ChunkMasks));
+  builder->masks = masks;
+
+  voxel_node_for_each_leaf(&snapshot->root, collect_palette_leaf, builder);
+
+  memset(builder->palette_index, 0xff, sizeof(builder->palette_index));
+
+  for (unsigned int i = 0; i < block_type_capacity; i++) {
+    if ((builder->seen[i / 64] >> i % 64 & 1) &&
+        block_registry.render_layer[i] != BLOCK_RENDER_LAYER_NONE) {
+      masks->palette_size++;
+    }
+  }
+
+  masks->palette = arena_alloc(arena, sizeof(BlockType) * masks->palette_size);
+  masks->materials =
+      arena_calloc(arena, masks->palette_size, sizeof(BlockMask));
+
+  unsigned int palette_size = 0;
+
+  for (unsigned int i = 0; i < block_type_capacity; i++) {
+    if ((builder->seen[i / 64] >> i % 64 & 1) &&
+        block_registry.render_layer[i] != BLOCK_RENDER_LAYER_NONE) {
+      builder->palette_index[i] = palette_size;
+      masks->palette[palette_size++] = i;
+    }
   }
 
-  uint64_t mask = 1;
-  for (unsigned int i = 0; i < depth_factor - 1; i++) {
-    mask = mask << 1;
-    mask++;
+  if (masks->palette_size != 0) {
+    voxel_node_for_each_leaf(&snapshot->root, fill_masks_leaf, builder);
+
+    for (unsigned int axis = 0; axis < 3; axis++) {
+      fill_masks_border(builder, snapshot, world, axis, false);
+      fill_masks_border(builder, snapshot, world, axis, true);
+    }
   }
 
-  for (int a = 0; a < depth_factor; a++) {
-    for (int b = 0; b < depth_factor; b++) {
-      switch (axis) {
-      case 0:
-        block_mask[offset[1] + a + (offset[2] + b) * 32] |= mask << offset[0];
-      case 1:
-        block_mask[offset[0] + a + (offset[2] + b) * 32] |= mask << offset[1];
-      case 2:
-        block_mask[offset[0] + a + (offset[1] + b) * 32] |= mask << offset[2];
+  metrics_record(METRIC_CHUNK_MASK, metrics_now() - start);
+
+  TracyCZoneEnd(chunk_build_masks);
+  return masks;
+}
+
+bool chunk_snapshot_border_occluded(const ChunkSnapshot *snapshot,
+                                    const ChunkSnapshot *neighbour,
+                                    unsigned int axis, bool next) {
+  if (!snapshot->root.has_octants &&
+      block_registry.render_layer[snapshot->root.block_type] ==
+          BLOCK_RENDER_LAYER_NONE) {
+    return false;
+  }
+
+  unsigned int axis_a = mask_row_axes[axis][0];
+  unsigned int axis_b = mask_row_axes[axis][1];
+
+  for (unsigned int b = 0; b < chunk_size; b++) {
+    for (unsigned int a = 0; a < chunk_size; a++) {
+      Vec3i block;
+      block[axis] = next ? chunk_size - 1 : 0;
+      block[axis_a] = a;
+      block[axis_b] = b;
+
+      BlockType block_type = voxel_node_get_block_type(&snapshot->root, block);
+      BlockRenderLayer layer = block_registry.render_layer[block_type];
+
+      if (layer == BLOCK_RENDER_LAYER_NONE) {
+        continue;
+      }
+
+      block[axis] = next ? 0 : chunk_size - 1;
+      BlockType neighbour_type =
+          voxel_node_get_block_type(&neighbour->root, block);
+
+      if (block_type_is_opaque(neighbour_type) ||
+          (layer == BLOCK_RENDER_LAYER_TRANSLUCENT &&
+           neighbour_type == block_type)) {
+        return true;
       }
     }
   }
+
+  return false;
 }
 
-uint64_t *chunk_build_block_mask(Chunk *chunk, World *world,
-                                 unsigned int axis) {
-  TracyCZone(chunk_build_block_mask, true);
+static bool palette_is_translucent(const ChunkMasks *masks,
+                                   unsigned int palette_index) {
+  return block_registry.render_layer[masks->palette[palette_index]] ==
+         BLOCK_RENDER_LAYER_TRANSLUCENT;
+}
 
-  uint64_t *block_mask = calloc(1024, sizeof(uint64_t));
-  build_block_mask_step(block_mask, &chunk->root, 32, (Vec3i){0, 0, 0}, axis);
+typedef void (*FacesFromMasks)(Mesh *mesh, const ChunkMasks *masks,
+                               unsigned int palette_index,
+                               unsigned int section);
 
-  bool axis_x = axis == 0;
-  bool axis_y = axis == 1;
-  bool axis_z = axis == 2;
+static inline __attribute__((always_inline)) void
+faces_from_masks(Mesh *mesh, const ChunkMasks *masks,
+                 unsigned int palette_index, unsigned int section,
+                 unsigned int axis, bool negative) {
+  TracyCZone(faces_from_masks, true);
+
+  const MaskRow *faces = masks->faces[negative][palette_index][axis];
+  float normal = !negative * 3 + axis + masks->palette[palette_index] * 6;
+  unsigned int axis_a = mask_row_axes[axis][0];
+  unsigned int axis_b = mask_row_axes[axis][1];
+  unsigned int section_begin = section * chunk_section_height;
+  unsigned int section_end = section_begin + chunk_section_height;
+  unsigned int a_begin = axis == 0 ? section_begin : 0;
+  unsigned int a_end = axis == 0 ? section_end : chunk_size;
+  unsigned int b_begin = axis == 2 ? section_begin : 0;
+  unsigned int b_end = axis == 2 ? section_end : chunk_size;
+  MaskRow section_rows =
+      axis == 1 ? (((MaskRow)1 << chunk_section_height) - 1)
+                      << (section_begin + 1)
+                : ~(MaskRow)0;
+
+  if (axis == 1 &&
+      (masks->face_layers[negative][palette_index] & section_rows) == 0) {
+    TracyCZoneEnd(faces_from_masks);
+    return;
+  }
+
+  float *vertices = mesh->vertices.data + mesh->vertices.size;
+  float *normals = mesh->normals.data + mesh->normals.size;
+  unsigned int coordinates[3];
+
+  for (unsigned int b = b_begin; b < b_end; b++) {
+    coordinates[axis_b] = b;
+
+    for (unsigned int a = a_begin; a < a_end; a++) {
+      MaskRow face_mask = faces[a + b * chunk_size] & section_rows;
+      coordinates[axis_a] = a;
+
+      while (face_mask != 0) {
+        coordinates[axis] = chunk_mask_row_lowest(face_mask) - negative;
+        face_mask &= face_mask - 1;
+
+        make_face(vertices, normals, coordinates, axis, negative, normal);
+        vertices += 6;
+        normals += 6;
+      }
+    }
+  }
+
+  mesh->vertices.size = vertices - mesh->vertices.data;
+  mesh->normals.size = normals - mesh->normals.data;
+
+  TracyCZoneEnd(faces_from_masks);
+}
+
+#define MakeFacesFromMasks(axis, negative)                                     \
+  static void faces_from_masks_##axis##_##negative(                            \
+      Mesh *mesh, const ChunkMasks *masks, unsigned int palette_index,         \
+      unsigned int section) {                                                  \
+    faces_from_masks(mesh, masks, palette_index, section, axis, negative);     \
+  }
+
+MakeFacesFromMasks(0, 0);
+MakeFacesFromMasks(0, 1);
+MakeFacesFromMasks(1, 0);
+MakeFacesFromMasks(1, 1);
+MakeFacesFromMasks(2, 0);
+MakeFacesFromMasks(2, 1);
+
+static const FacesFromMasks faces_from_masks_kernels[3][2] = {
+    {faces_from_masks_0_0, faces_from_masks_0_1},
+    {faces_from_masks_1_0, faces_from_masks_1_1},
+    {faces_from_masks_2_0, faces_from_masks_2_1},
+};
+
+static unsigned int faces_count(ChunkMasks *masks, Arena *arena) {
+  unsigned int face_count = 0;
+
+  for (unsigned int negative = 0; negative < 2; negative++) {
+    masks->faces[negative] =
+        arena_alloc(arena, sizeof(BlockMask) * masks->palette_size);
+    masks->face_layers[negative] =
+        arena_calloc(arena, masks->palette_size, sizeof(MaskRow));
+  }
+
+  for (unsigned int i = 0; i < masks->palette_size; i++) {
+    bool translucent = palette_is_translucent(masks, i);
+
+    for (unsigned int axis = 0; axis < 3; axis++) {
+      for (unsigned int negative = 0; negative < 2; negative++) {
+        face_count += mesh_kernel_face_rows(
+            masks->materials[i][axis], masks->opaque[axis], translucent,
+            negative, masks->faces[negative][i][axis]);
+      }
+    }
+
+    for (unsigned int negative = 0; negative < 2; negative++) {
+      const MaskRow *faces = masks->faces[negative][i][1];
+      MaskRow layers = 0;
+
+      for (unsigned int row = 0; row < chunk_size * chunk_size; row++) {
+        layers |= faces[row];
+      }
 
-  Chunk *previous_chunk = world_get_chunk(
-      world, (Vec3i){chunk->position[0] - axis_x, chunk->position[1] - axis_y,
-                     chunk->position[2] - axis_z});
-  Chunk *next_chunk = world_get_chunk(
-      world, (Vec3i){chunk->position[0] + axis_x, chunk->position[1] + axis_y,
-                     chunk->position[2] + axis_z});
-
-  for (unsigned int a = 0; a < 32; a++) {
-    for (unsigned int b = 0; b < 32; b++) {
-      Vec3i previous_block_position = {axis_x ? 31 : a,
-                                       axis_y   ? 31
-                                       : axis_x ? a
-                                                : b,
-                                       axis_z ? 31 : b};
-      uint64_t previous_block =
-          chunk_get_block_type(previous_chunk, previous_block_position)
-              ->is_solid;
-
-      block_mask[a + b * 32] |= previous_block << 32;
-
-      Vec3i next_block_position = {axis_x ? 0 : a,
-                                   axis_y   ? 0
-                                   : axis_x ? a
-                                            : b,
-                                   axis_z ? 0 : b};
-      uint64_t next_block =
-          chunk_get_block_type(next_chunk, next_block_position)->is_solid;
-
-      block_mask[a + b * 32] <<= 1;
-
-      block_mask[a + b * 32] |= next_block;
+      masks->face_layers[negative][i] = layers;
     }
   }
 
-  TracyCZoneEnd(chunk_build_block_mask);
-  return block_mask;
+  return face_count;
 }
 
-static void faces_from_block_mask(Vector_float *vertices, Vector_float *normals,
-                                  uint64_t *block_mask, unsigned int axis,
-                                  bool negative) {
-  TracyCZone(faces_from_block_mask, true);
-  for (unsigned int a = 0; a < 32; a++) {
-    for (unsigned int b = 0; b < 32; b++) {
-      uint64_t face_mask = block_mask[a + b * 32];
-      face_mask &= ~(negative ? face_mask << 1 : face_mask >> 1);
+static unsigned int faces_count_sections(const ChunkMasks *masks,
+                                         uint8_t sections) {
+  MaskRow section_rows = 0;
+
+  for (unsigned int section = 0; section < mesh_section_count; section++) {
+    if (sections >> section & 1) {
+      section_rows |= (((MaskRow)1 << chunk_section_height) - 1)
+                      << (section * chunk_section_height + 1);
+    }
+  }
+
+  unsigned int face_count = 0;
 
-      for (unsigned int c = 0; c < 32; c++) {
-        face_mask >>= 1;
-        if (face_mask & 1) {
-          Vec3i coordinates = {axis == 0 ? c : a,
-                               axis == 1   ? c
-                               : axis == 0 ? a
-                                           : b,
-                               axis == 2 ? c : b};
+  for (unsigned int i = 0; i < masks->palette_size; i++) {
+    for (unsigned int negative = 0; negative < 2; negative++) {
+      const BlockMask *faces = &masks->faces[negative][i];
 
-          if (!negative) {
-            vec3i_add(coordinates, coordinates,
-                      (Vec3i){axis == 0, axis == 1, axis == 2});
-          }
+      for (unsigned int row = 0; row < chunk_size * chunk_size; row++) {
+        unsigned int a = row % chunk_size;
+        unsigned int b = row / chunk_size;
 
-          make_face(vertices, normals, coordinates, axis, negative);
+        face_count += chunk_mask_row_count((*faces)[1][row] & section_rows);
+
+        if (sections >> (a / chunk_section_height) & 1) {
+          face_count += chunk_mask_row_count((*faces)[0][row]);
+        }
+
+        if (sections >> (b / chunk_section_height) & 1) {
+          face_count += chunk_mask_row_count((*faces)[2][row]);
         }
       }
     }
   }
-  TracyCZoneEnd(faces_from_block_mask);
+
+  return face_count;
+}
+
+static void faces_from_layer(Mesh *mesh, const ChunkMasks *masks,
+                             bool translucent, unsigned int section) {
+  for (unsigned int i = 0; i < masks->palette_size; i++) {
+    if (palette_is_translucent(masks, i) != translucent) {
+      continue;
+    }
+
+    for (unsigned int axis = 0; axis < 3; axis++) {
+      faces_from_masks_kernels[axis][0](mesh, masks, i, section);
+      faces_from_masks_kernels[axis][1](mesh, masks, i, section);
+    }
+  }
 }
 
 Mesh chunk_build_mesh(Chunk *chunk, World *world) {
+  epoch_enter();
+
+  Mesh mesh = chunk_snapshot_build_mesh(chunk_get_snapshot(chunk), world);
+
+  epoch_exit();
+
+  return mesh;
+}
+
+Mesh chunk_snapshot_build_mesh(const ChunkSnapshot *snapshot, World *world) {
+  return chunk_snapshot_build_sections(snapshot, world, mesh_sections_all);
+}
+
+Mesh chunk_snapshot_build_sections(const ChunkSnapshot *snapshot, World *world,
+                                   uint8_t sections) {
   TracyCZone(chunk_build_mesh, true);
+  uint64_t start = metrics_now();
+
+  Mesh mesh = {.sections = sections};
 
-  if (!chunk->root.has_octants && chunk->root.block_type == &AIR) {
+  epoch_enter();
+
+  if (snapshot == NULL ||
+      (!snapshot->root.has_octants &&
+       block_registry.render_layer[snapshot->root.block_type] ==
+           BLOCK_RENDER_LAYER_NONE)) {
+    epoch_exit();
     TracyCZoneEnd(chunk_build_mesh);
-    return (Mesh){};
+    return mesh;
+  }
+
+  MeshScratch *scratch = mesh_scratch_get();
+  unsigned int allocation_count = scratch->arena.allocation_count;
+
+  arena_reset(&scratch->arena);
+
+  ChunkMasks *masks = chunk_build_masks(snapshot, world, &scratch->arena);
+  unsigned int face_count = faces_count(masks, &scratch->arena);
+
+  if (face_count != 0 && sections != mesh_sections_all) {
+    face_count = faces_count_sections(masks, sections);
   }
 
-  Vector_float vertices = {0};
-  Vector_float normals = {0};
+  if (face_count != 0) {
+    vector_init_float(&mesh.vertices, face_count * 6);
+    vector_init_float(&mesh.normals, face_count * 6);
+
+    for (unsigned int section = 0; section < mesh_section_count; section++) {
+      mesh.section_offsets[section] = mesh.vertices.size;
 
-  vector_init_float(&vertices, 64);
-  vector_init_float(&normals, 64);
+      if (!(sections >> section & 1)) {
+        continue;
+      }
+
+      faces_from_layer(&mesh, masks, false, section);
+      mesh.section_opaque[section] =
+          mesh.vertices.size - mesh.section_offsets[section];
+      faces_from_layer(&mesh, masks, true, section);
+    }
+  }
+
+  mesh.section_offsets[mesh_section_count] = mesh.vertices.size;
 
-  uint64_t *block_mask_x = chunk_build_block_mask(chunk, world, 0);
-  uint64_t *block_mask_y = chunk_build_block_mask(chunk, world, 1);
-  uint64_t *block_mask_z = chunk_build_block_mask(chunk, world, 2);
+  epoch_exit();
 
-  faces_from_block_mask(&vertices, &normals, block_mask_x, 0, 0);
-  faces_from_block_mask(&vertices, &normals, block_mask_x, 0, 1);
-  faces_from_block_mask(&vertices, &normals, block_mask_x, 1, 0);
-  faces_from_block_mask(&vertices, &normals, block_mask_x, 1, 1);
-  faces_from_block_mask(&vertices, &normals, block_mask_x, 2, 0);
-  faces_from_block_mask(&vertices, &normals, block_mask_x, 2, 1);
+  atomic_fetch_add(&mesh_scratch_allocations,
+                   scratch->arena.allocation_count - allocation_count);
 
-  free(block_mask_x);
-  free(block_mask_y);
-  free(block_mask_z);
+  metrics_add(METRIC_CHUNKS_MESHED, 1);
+  metrics_add(METRIC_FACES_EMITTED, mesh.vertices.size / 6);
+  metrics_record(METRIC_CHUNK_MESH, metrics_now() - start);
 
   TracyCZoneEnd(chunk_build_mesh);
 
-  return (Mesh){vertices, normals};
+  return mesh;
 }
 
 void voxel_node_free(VoxelNode *voxel_node) {
@@ -274,14 +1012,22 @@ void voxel_node_free(VoxelNode *voxel_node) {
   }
 
   if (voxel_node->has_octants) {
-    for (unsigned int i = 0; i < 8; i++) {
-      voxel_node_free(voxel_node->octants[i]);
-      free(voxel_node->octants[i]);
-    }
+    voxel_octants_release(voxel_node->octants);
   }
 }
 
 void chunk_free(Chunk *chunk) {
+  ChunkSnapshot *snapshot = atomic_exchange(&chunk->snapshot, NULL);
+
+  if (snapshot != NULL) {
+    epoch_retire(snapshot, chunk_snapshot_free);
+  }
+
   voxel_node_free(&chunk->root);
+  free(chunk->light.levels);
+  free(chunk->solid_rows);
+  free(chunk->solid_columns);
   mtx_destroy(&chunk->mutex);
+
+  chunk->loaded = false;
 }
@@ -1,43 +1,191 @@
 #pragma once
 
+#include "arena.h"
 #include "block_type.h"
+#include "mesh_sections.h"
 #include "vec3.h"
 #include "vector.h"
+#include <stdatomic.h>
 #include <stdint.h>
 #include <threads.h>
 
+#ifndef chunk_size
+#define chunk_size 32
+#endif
+
+#define chunk_volume (chunk_size * chunk_size * chunk_size)
+#define chunk_section_height (chunk_size / mesh_section_count)
+
+#if chunk_size == 16
+typedef uint16_t ChunkRow;
+typedef uint16_t ChunkIndex;
+typedef uint64_t MaskRow;
+#elif chunk_size == 32
+typedef uint32_t ChunkRow;
+typedef uint16_t ChunkIndex;
+typedef uint64_t MaskRow;
+#elif chunk_size == 64
+typedef uint64_t ChunkRow;
+typedef uint32_t ChunkIndex;
+typedef unsigned __int128 MaskRow;
+#else
+#error "chunk_size must be 16, 32 or 64"
+#endif
+
+#define chunk_row_full ((ChunkRow)~(ChunkRow)0)
+
 typedef struct World World;
 
 typedef struct Mesh {
   Vector_float vertices;
   Vector_float normals;
+  uint8_t sections;
+  unsigned int section_offsets[mesh_section_count + 1];
+  unsigned int section_opaque[mesh_section_count];
 } Mesh;
 
+typedef MaskRow BlockMask[3][chunk_size * chunk_size];
+
+typedef struct ChunkMasks {
+  BlockMask opaque;
+  unsigned int palette_size;
+  BlockType *palette;
+  BlockMask *materials;
+  BlockMask *faces[2];
+  MaskRow *face_layers[2];
+} ChunkMasks;
+
 typedef struct VoxelNode {
   bool has_octants;
   BlockType block_type;
-  struct VoxelNode *octants[8];
+  struct VoxelNode *octants;
 } VoxelNode;
 
+typedef struct ChunkLight {
+  uint8_t *levels;
+  uint8_t uniform_level;
+  bool ready;
+  uint8_t heightmap[chunk_size * chunk_size];
+} ChunkLight;
+
+typedef struct ChunkSnapshot {
+  VoxelNode root;
+  Vec3i position;
+} ChunkSnapshot;
+
 typedef struct Chunk {
   VoxelNode root;
-  unsigned int vertex_buffer;
-  unsigned int normal_buffer;
-  unsigned int mesh_size;
+  ChunkSnapshot *_Atomic snapshot;
+  ChunkLight light;
+  ChunkRow *solid_rows;
+  ChunkRow *solid_columns;
   Vec3i position;
+  atomic_bool loaded;
+  atomic_uint generation;
+  atomic_uint light_jobs;
+  uint8_t mesh_neighbours;
+  uint8_t dirty_sections;
+  double request_time;
   mtx_t mutex;
 } Chunk;
 
+typedef Chunk *ChunkPointer;
+
+MakeVectorDeclaration(ChunkPointer);
+
+typedef enum VoxelCoverage {
+  VOXEL_COVERAGE_NONE,
+  VOXEL_COVERAGE_PARTIAL,
+  VOXEL_COVERAGE_FULL,
+} VoxelCoverage;
+
+typedef VoxelCoverage (*VoxelRegionTest)(const Vec3i min, unsigned int size,
+                                         const void *data);
+
+typedef VoxelCoverage (*VoxelRegionSample)(const Vec3i min, unsigned int size,
+                                           const void *data,
+                                           BlockType *block_type);
+
+typedef void (*VoxelLeafCallback)(const VoxelNode *leaf, const Vec3i offset,
+                                  unsigned int size, void *data);
+
+static inline unsigned int chunk_mask_row_count(MaskRow row) {
+#if chunk_size == 64
+  return __builtin_popcountll((uint64_t)row) +
+         __builtin_popcountll((uint64_t)(row >> 64));
+#else
+  return __builtin_popcountll(row);
+#endif
+}
+
+static inline unsigned int chunk_mask_row_lowest(MaskRow row) {
+#if chunk_size == 64
+  return (uint64_t)row != 0 ? __builtin_ctzll((uint64_t)row)
+                            : 64 + __builtin_ctzll((uint64_t)(row >> 64));
+#else
+  return __builtin_ctzll(row);
+#endif
+}
+
+void chunk_generate(VoxelNode *root, const Vec3i position);
+
 void chunk_init(Chunk *chunk, const Vec3i position);
 
+void chunk_init_with_root(Chunk *chunk, const Vec3i position,
+                          VoxelNode root);
+
 BlockType chunk_get_block_type(const Chunk *chunk, const Vec3i block);
 
-uint64_t *chunk_build_block_mask(Chunk *chunk, World *world, unsigned int axis);
+BlockType voxel_node_get_block_type(const VoxelNode *root, const Vec3i block);
+
+const VoxelNode *chunk_get_leaf(const Chunk *chunk, const Vec3i block,
+                                Vec3i offset, unsigned int *size);
+
+void chunk_set_block_type(Chunk *chunk, const Vec3i block,
+                          BlockType block_type);
+
+uint8_t chunk_edit_sections(const Vec3i block);
+
+uint8_t chunk_neighbour_sections(const Vec3i block, unsigned int axis);
+
+bool chunk_fill_region(Chunk *chunk, VoxelRegionTest test, const void *data,
+                       BlockType block_type);
+
+bool chunk_paint_region(Chunk *chunk, VoxelRegionSample sample,
+                        const void *data);
+
+void chunk_for_each_leaf(const Chunk *chunk, VoxelLeafCallback callback,
+                         void *data);
+
+void voxel_node_for_each_leaf(const VoxelNode *root, VoxelLeafCallback callback,
+                              void *data);
+
+void chunk_publish(Chunk *chunk);
+
+const ChunkSnapshot *chunk_get_snapshot(const Chunk *chunk);
+
+ChunkMasks *chunk_build_masks(const ChunkSnapshot *snapshot, World *world,
+                              Arena *arena);
+
+bool chunk_snapshot_border_occluded(const ChunkSnapshot *snapshot,
+                                    const ChunkSnapshot *neighbour,
+                                    unsigned int axis, bool next);
 
 bool chunk_block_is_solid(const Chunk *chunk, const Vec3i position);
 
+const ChunkRow *chunk_get_solid_rows(Chunk *chunk);
+
+const ChunkRow *chunk_get_solid_columns(Chunk *chunk);
+
 Mesh chunk_build_mesh(Chunk *chunk, World *world);
 
+Mesh chunk_snapshot_build_mesh(const ChunkSnapshot *snapshot, World *world);
+
+Mesh chunk_snapshot_build_sections(const ChunkSnapshot *snapshot, World *world,
+                                   uint8_t sections);
+
+unsigned int chunk_mesh_scratch_allocations(void);
+
 void voxel_node_free(VoxelNode *voxel_node);
 
 void chunk_free(Chunk *chunk);
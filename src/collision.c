@@ -0,0 +1,191 @@
+#include "collision.h"
+
+#include "chunk.h"
+#include "math_util.h"
+#include "tracy/TracyC.h"
+#include "vector.h"
+#include "world.h"
+#include <math.h>
+#include <threads.h>
+
+#define collision_batch_size 64
+#define collision_epsilon 1e-7
+
+typedef struct CollisionBlock {
+  int position[3];
+} CollisionBlock;
+
+MakeVectorDeclaration(CollisionBlock);
+MakeVectorDefinition(CollisionBlock);
+
+typedef struct CollisionBatch {
+  World *world;
+  const CollisionQuery *queries;
+  CollisionResult *results;
+} CollisionBatch;
+
+static const unsigned int collision_axis_order[3] = {1, 0, 2};
+
+static tss_t collision_scratch_key;
+static once_flag collision_scratch_once = ONCE_FLAG_INIT;
+
+static void collision_scratch_free(void *data) {
+  vector_free_CollisionBlock(data);
+  free(data);
+}
+
+static void collision_scratch_create(void) {
+  tss_create(&collision_scratch_key, collision_scratch_free);
+}
+
+static Vector_CollisionBlock *collision_scratch_get(void) {
+  call_once(&collision_scratch_once, collision_scratch_create);
+
+  Vector_CollisionBlock *blocks = tss_get(collision_scratch_key);
+
+  if (blocks == NULL) {
+    blocks = malloc(sizeof(Vector_CollisionBlock));
+    vector_init_CollisionBlock(blocks, 64);
+    tss_set(collision_scratch_key, blocks);
+  }
+
+  return blocks;
+}
+
+static void collision_gather_chunk(Chunk *chunk, const Vec3i low,
+                                   const Vec3i high,
+                                   Vector_CollisionBlock *blocks) {
+  Vec3i chunk_origin;
+
+  for (unsigned int axis = 0; axis < 3; axis++) {
+    chunk_origin[axis] = chunk->position[axis] * chunk_size;
+  }
+
+  int x_begin = max(low[0] - chunk_origin[0], 0);
+  int x_end = min(high[0] - chunk_origin[0], chunk_size - 1);
+  ChunkRow span =
+      (ChunkRow)(chunk_row_full >> (chunk_size - 1 - x_end + x_begin))
+      << x_begin;
+
+  mtx_lock(&chunk->mutex);
+  const ChunkRow *solid_rows = chunk_get_solid_rows(chunk);
+
+  for (int y = max(low[1] - chunk_origin[1], 0);
+       y <= min(high[1] - chunk_origin[1], chunk_size - 1); y++) {
+    for (int z = max(low[2] - chunk_origin[2], 0);
+         z <= min(high[2] - chunk_origin[2], chunk_size - 1); z++) {
+      ChunkRow row = solid_rows[y * chunk_size + z] & span;
+
+      while (row != 0) {
+        int x = __builtin_ctzll(row);
+        row &= row - 1;
+
+        vector_insert_CollisionBlock(
+            blocks,
+            (CollisionBlock){{chunk_origin[0] + x, chunk_origin[1] + y,
+                              chunk_origin[2] + z}});
+      }
+    }
+  }
+
+  mtx_unlock(&chunk->mutex);
+}
+
+static void collision_gather(World *world, const Aabb *box,
+                             const Vec3 motion,
+                             Vector_CollisionBlock *blocks) {
+  Vec3i low;
+  Vec3i high;
+  Vec3i low_chunk;
+  Vec3i high_chunk;
+  Vec3i local;
+
+  for (unsigned int axis = 0; axis < 3; axis++) {
+    low[axis] = floor(fmin(box->min[axis], box->min[axis] + motion[axis]));
+    high[axis] =
+        ceil(fmax(box->max[axis], box->max[axis] + motion[axis])) - 1;
+  }
+
+  world_block_to_chunk(low, low_chunk, local);
+  world_block_to_chunk(high, high_chunk, local);
+
+  for (int x = low_chunk[0]; x <= high_chunk[0]; x++) {
+    for (int y = low_chunk[1]; y <= high_chunk[1]; y++) {
+      for (int z = low_chunk[2]; z <= high_chunk[2]; z++) {
+        Chunk *chunk = world_get_loaded_chunk(world, (Vec3i){x, y, z});
+
+        if (chunk != NULL) {
+          collision_gather_chunk(chunk, low, high, blocks);
+        }
+      }
+    }
+  }
+}
+
+static double collision_clip_axis(const Aabb *box, const CollisionBlock *block,
+                                  unsigned int axis, double motion) {
+  for (unsigned int other = 0; other < 3; other++) {
+    if (other != axis && (box->max[other] <= block->position[other] ||
+                          box->min[other] >= block->position[other] + 1)) {
+      return motion;
+    }
+  }
+
+  if (motion > 0 &&
+      box->max[axis] - collision_epsilon <= block->position[axis]) {
+    return fmax(fmin(motion, block->position[axis] - box->max[axis]), 0);
+  }
+
+  if (motion < 0 &&
+      box->min[axis] + collision_epsilon >= block->position[axis] + 1) {
+    return fmin(fmax(motion, block->position[axis] + 1 - box->min[axis]), 0);
+  }
+
+  return motion;
+}
+
+void collision_sweep(World *world, const CollisionQuery *query,
+                     CollisionResult *result) {
+  Vector_CollisionBlock *blocks = collision_scratch_get();
+  vector_clear_CollisionBlock(blocks);
+  collision_gather(world, &query->box, query->motion, blocks);
+
+  Aabb box = query->box;
+
+  for (unsigned int i = 0; i < 3; i++) {
+    unsigned int axis = collision_axis_order[i];
+    double motion = query->motion[axis];
+
+    for (unsigned int j = 0; j < blocks->size && motion != 0; j++) {
+      motion = collision_clip_axis(&box, &blocks->data[j], axis, motion);
+    }
+
+    box.min[axis] += motion;
+    box.max[axis] += motion;
+
+    result->motion[axis] = motion;
+    result->collided[axis] = motion != query->motion[axis];
+  }
+}
+
+static void collision_batch_range(void *data, unsigned int begin,
+                                  unsigned int end) {
+  TracyCZone(collision_batch_range, true);
+
+  CollisionBatch *batch = data;
+
+  for (unsigned int i = begin; i < end; i++) {
+    collision_sweep(batch->world, &batch->queries[i], &batch->results[i]);
+  }
+
+  TracyCZoneEnd(collision_batch_range);
+}
+
+void collision_sweep_batch(World *world, ThreadPool *pool,
+                           const CollisionQuery *queries,
+                           CollisionResult *results, unsigned int count) {
+  CollisionBatch batch = {world, queries, results};
+
+  thread_pool_parallel_for(pool, count, collision_batch_size,
+                           collision_batch_range, &batch);
+}
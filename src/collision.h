@@ -0,0 +1,29 @@
+#pragma once
+
+#include "thread_pool.h"
+#include "vec3.h"
+#include <stdbool.h>
+
+typedef struct World World;
+
+typedef struct Aabb {
+  Vec3 min;
+  Vec3 max;
+} Aabb;
+
+typedef struct CollisionQuery {
+  Aabb box;
+  Vec3 motion;
+} CollisionQuery;
+
+typedef struct CollisionResult {
+  Vec3 motion;
+  bool collided[3];
+} CollisionResult;
+
+void collision_sweep(World *world, const CollisionQuery *query,
+                     CollisionResult *result);
+
+void collision_sweep_batch(World *world, ThreadPool *pool,
+                           const CollisionQuery *queries,
+                           CollisionResult *results, unsigned int count);
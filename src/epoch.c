@@ -0,0 +1,159 @@
+#include "epoch.h"
+
+#include "vector.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <threads.h>
+
+#define epoch_thread_capacity 256
+
+typedef struct EpochRetired {
+  void *data;
+  EpochDestructor destructor;
+  unsigned int epoch;
+} EpochRetired;
+
+MakeVectorDeclaration(EpochRetired);
+MakeVectorDefinition(EpochRetired);
+
+typedef struct EpochState {
+  atomic_uint epoch;
+  atomic_uint thread_states[epoch_thread_capacity];
+  atomic_bool thread_claimed[epoch_thread_capacity];
+  unsigned int thread_depths[epoch_thread_capacity];
+  mtx_t mutex;
+  Vector_EpochRetired retired;
+} EpochState;
+
+static EpochState epoch_state;
+static tss_t epoch_slot_key;
+static once_flag epoch_once = ONCE_FLAG_INIT;
+
+static void epoch_slot_release(void *data) {
+  unsigned int slot = (uintptr_t)data - 1;
+
+  atomic_store(&epoch_state.thread_states[slot], 0);
+  atomic_store(&epoch_state.thread_claimed[slot], false);
+}
+
+static void epoch_init(void) {
+  mtx_init(&epoch_state.mutex, mtx_plain);
+  vector_init_EpochRetired(&epoch_state.retired, 0);
+  tss_create(&epoch_slot_key, epoch_slot_release);
+}
+
+static unsigned int epoch_slot(void) {
+  call_once(&epoch_once, epoch_init);
+
+  uintptr_t slot = (uintptr_t)tss_get(epoch_slot_key);
+
+  if (slot != 0) {
+    return slot - 1;
+  }
+
+  for (unsigned int i = 0; i < epoch_thread_capacity; i++) {
+    bool claimed = false;
+
+    if (atomic_compare_exchange_strong(&epoch_state.thread_claimed[i],
+                                       &claimed, true)) {
+      epoch_state.thread_depths[i] = 0;
+      tss_set(epoch_slot_key, (void *)(uintptr_t)(i + 1));
+      return i;
+    }
+  }
+
+  printf("Epoch thread capacity of %u exceeded\n", epoch_thread_capacity);
+  abort();
+}
+
+void epoch_enter(void) {
+  unsigned int slot = epoch_slot();
+
+  if (epoch_state.thread_depths[slot]++ == 0) {
+    unsigned int epoch = atomic_load(&epoch_state.epoch);
+    atomic_store(&epoch_state.thread_states[slot], epoch << 1 | 1);
+  }
+}
+
+void epoch_exit(void) {
+  unsigned int slot = epoch_slot();
+
+  if (--epoch_state.thread_depths[slot] == 0) {
+    atomic_store(&epoch_state.thread_states[slot], 0);
+  }
+}
+
+void epoch_retire(void *data, EpochDestructor destructor) {
+  call_once(&epoch_once, epoch_init);
+
+  mtx_lock(&epoch_state.mutex);
+  vector_insert_EpochRetired(
+      &epoch_state.retired,
+      (EpochRetired){data, destructor, atomic_load(&epoch_state.epoch)});
+  mtx_unlock(&epoch_state.mutex);
+}
+
+void epoch_collect(void) {
+  call_once(&epoch_once, epoch_init);
+
+  mtx_lock(&epoch_state.mutex);
+
+  unsigned int epoch = atomic_load(&epoch_state.epoch);
+  bool quiescent = true;
+
+  for (unsigned int i = 0; i < epoch_thread_capacity && quiescent; i++) {
+    unsigned int state = atomic_load(&epoch_state.thread_states[i]);
+    quiescent = !(state & 1) || state >> 1 == epoch;
+  }
+
+  if (quiescent) {
+    atomic_store(&epoch_state.epoch, ++epoch);
+  }
+
+  Vector_EpochRetired expired;
+  vector_init_EpochRetired(&expired, 0);
+
+  Vector_EpochRetired *retired = &epoch_state.retired;
+  unsigned int kept = 0;
+
+  for (unsigned int i = 0; i < retired->size; i++) {
+    if (epoch - retired->data[i].epoch >= 2) {
+      vector_insert_EpochRetired(&expired, retired->data[i]);
+    } else {
+      retired->data[kept++] = retired->data[i];
+    }
+  }
+
+  retired->size = kept;
+
+  mtx_unlock(&epoch_state.mutex);
+
+  for (unsigned int i = 0; i < expired.size; i++) {
+    expired.data[i].destructor(expired.data[i].data);
+  }
+
+  vector_free_EpochRetired(&expired);
+}
+
+void epoch_flush(void) {
+  while (epoch_pending() != 0) {
+    epoch_collect();
+
+    if (epoch_pending() != 0) {
+      thrd_yield();
+    }
+  }
+}
+
+unsigned int epoch_pending(void) {
+  call_once(&epoch_once, epoch_init);
+
+  mtx_lock(&epoch_state.mutex);
+  unsigned int pending = epoch_state.retired.size;
+  mtx_unlock(&epoch_state.mutex);
+
+  return pending;
+}
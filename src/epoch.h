@@ -0,0 +1,15 @@
+#pragma once
+
+typedef void (*EpochDestructor)(void *data);
+
+void epoch_enter(void);
+
+void epoch_exit(void);
+
+void epoch_retire(void *data, EpochDestructor destructor);
+
+void epoch_collect(void);
+
+void epoch_flush(void);
+
+unsigned int epoch_pending(void);
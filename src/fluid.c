@@ -0,0 +1,683 @@
+#include "fluid.h"
+
+#include "block_type.h"
+#include "light.h"
+#include "math_util.h"
+#include "metrics.h"
+#include "tracy/TracyC.h"
+#include "world.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define fluid_level_mask 0x0f
+#define fluid_kind_mask 0x30
+#define fluid_kind_shift 4
+#define fluid_solid 0x40
+#define fluid_source 0x80
+#define fluid_kind_count 2
+#define fluid_phase_count 8
+#define fluid_window_volume                                                    \
+  (render_distance * render_distance * render_distance)
+
+MakeVectorDefinition(FluidCell);
+
+typedef struct FluidKind {
+  const BlockType *block_type;
+  uint8_t decay;
+} FluidKind;
+
+typedef struct FluidSync {
+  FluidEngine *engine;
+  Chunk *chunk;
+  FluidChunk *fluid_chunk;
+} FluidSync;
+
+static const FluidKind fluid_kinds[fluid_kind_count] = {{&WATER, 1},
+                                                        {&LAVA, 2}};
+
+static const int fluid_directions[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+
+static unsigned int fluid_index(int x, int y, int z) {
+  return x + (y + z * chunk_size) * chunk_size;
+}
+
+static unsigned int fluid_slot(const FluidEngine *engine, const Chunk *chunk) {
+  return chunk - engine->world->chunk_storage;
+}
+
+static uint8_t fluid_cell_from_block(BlockType block_type) {
+  for (unsigned int kind = 0; kind < fluid_kind_count; kind++) {
+    if (block_type == *fluid_kinds[kind].block_type) {
+      return fluid_source | kind << fluid_kind_shift | fluid_level_max;
+    }
+  }
+
+  return 0;
+}
+
+static BlockType fluid_block_type(uint8_t cell) {
+  if ((cell & fluid_level_mask) == 0) {
+    return AIR;
+  }
+
+  return *fluid_kinds[(cell & fluid_kind_mask) >> fluid_kind_shift].block_type;
+}
+
+bool fluid_block_type_is_fluid(BlockType block_type) {
+  return fluid_cell_from_block(block_type) != 0;
+}
+
+static Chunk *fluid_resolve(const FluidEngine *engine, const Chunk *chunk,
+                            Vec3i local) {
+  Vec3i position;
+  bool inside = true;
+
+  for (unsigned int axis = 0; axis < 3; axis++) {
+    position[axis] = chunk->position[axis];
+
+    if (local[axis] < 0 || local[axis] >= chunk_size) {
+      inside = false;
+      position[axis] += local[axis] < 0 ? -1 : 1;
+      local[axis] = mod(local[axis], chunk_size);
+    }
+  }
+
+  if (inside) {
+    return (Chunk *)chunk;
+  }
+
+  return world_get_loaded_chunk(engine->world, position);
+}
+
+static uint8_t fluid_cell(const FluidEngine *engine, const Chunk *chunk,
+                          const Vec3i local) {
+  const uint8_t *levels = engine->chunks[fluid_slot(engine, chunk)].levels;
+
+  if (levels != NULL) {
+    return levels[fluid_index(local[0], local[1], local[2])];
+  }
+
+  return fluid_cell_from_block(chunk_get_block_type(chunk, local));
+}
+
+static uint8_t fluid_read(const FluidEngine *engine, const Chunk *chunk, int x,
+                          int y, int z) {
+  Vec3i local = {x, y, z};
+  chunk = fluid_resolve(engine, chunk, local);
+
+  if (chunk == NULL ||
+      chunk->solid_rows[local[1] * chunk_size + local[2]] >> local[0] & 1) {
+    return fluid_solid;
+  }
+
+  return fluid_cell(engine, chunk, local);
+}
+
+static uint8_t fluid_flow(const FluidEngine *engine, const Chunk *chunk, int x,
+                          int y, int z) {
+  uint8_t cell = fluid_read(engine, chunk, x, y, z);
+
+  if (cell & fluid_solid) {
+    return 0;
+  }
+
+  if (cell & fluid_source) {
+    return cell;
+  }
+
+  uint8_t above = fluid_read(engine, chunk, x, y + 1, z);
+
+  if (above & fluid_level_mask) {
+    return (above & fluid_kind_mask) | fluid_level_max;
+  }
+
+  uint8_t flow = 0;
+
+  for (unsigned int i = 0; i < 4; i++) {
+    int neighbour_x = x + fluid_directions[i][0];
+    int neighbour_z = z + fluid_directions[i][1];
+    uint8_t neighbour = fluid_read(engine, chunk, neighbour_x, y, neighbour_z);
+    unsigned int level = neighbour & fluid_level_mask;
+    unsigned int decay =
+        fluid_kinds[(neighbour & fluid_kind_mask) >> fluid_kind_shift].decay;
+
+    if (level <= decay || level - decay <= (flow & fluid_level_mask)) {
+      continue;
+    }
+
+    uint8_t below = fluid_read(engine, chunk, neighbour_x, y - 1, neighbour_z);
+
+    if (below & (fluid_solid | fluid_source)) {
+      flow = (neighbour & fluid_kind_mask) | (level - decay);
+    }
+  }
+
+  return flow;
+}
+
+static void fluid_push(FluidChunk *fluid_chunk, FluidCell cell) {
+  uint64_t bit = (uint64_t)1 << cell % 64;
+
+  if (fluid_chunk->queued[cell / 64] & bit) {
+    return;
+  }
+
+  fluid_chunk->queued[cell / 64] |= bit;
+  vector_insert_FluidCell(&fluid_chunk->next, cell);
+}
+
+static void fluid_list(FluidEngine *engine, unsigned int slot) {
+  FluidChunk *fluid_chunk = &engine->chunks[slot];
+
+  if (fluid_chunk->queued == NULL) {
+    fluid_chunk->queued = calloc(chunk_volume / 64, sizeof(uint64_t));
+  }
+
+  if (!fluid_chunk->listed) {
+    fluid_chunk->listed = true;
+    engine->listed[engine->listed_count++] = slot;
+  }
+}
+
+static void fluid_queue(FluidEngine *engine, const Chunk *chunk, int x, int y,
+                        int z) {
+  Vec3i local = {x, y, z};
+  chunk = fluid_resolve(engine, chunk, local);
+
+  if (chunk == NULL) {
+    return;
+  }
+
+  unsigned int slot = fluid_slot(engine, chunk);
+  fluid_list(engine, slot);
+  fluid_push(&engine->chunks[slot],
+             fluid_index(local[0], local[1], local[2]));
+}
+
+static void fluid_queue_around(FluidEngine *engine, const Chunk *chunk, int x,
+                               int y, int z) {
+  for (int dx = -1; dx <= 1; dx++) {
+    for (int dy = -1; dy <= 1; dy++) {
+      for (int dz = -1; dz <= 1; dz++) {
+        fluid_queue(engine, chunk, x + dx, y + dy, z + dz);
+      }
+    }
+  }
+}
+
+static void fluid_queue_faces(FluidEngine *engine, const Chunk *chunk, int x,
+                              int y, int z) {
+  fluid_queue(engine, chunk, x, y, z);
+
+  for (unsigned int side = 0; side < 6; side++) {
+    Vec3i local = {x, y, z};
+    local[side / 2] += side % 2 ? 1 : -1;
+    fluid_queue(engine, chunk, local[0], local[1], local[2]);
+  }
+}
+
+static void fluid_wake(FluidEngine *engine, FluidChunk *fluid_chunk,
+                       const Chunk *chunk, int x, int y, int z) {
+  for (unsigned int side = 0; side < 6; side++) {
+    unsigned int axis = side / 2;
+    Vec3i local = {x, y, z};
+    local[axis] += side % 2 ? 1 : -1;
+
+    if (local[axis] >= 0 && local[axis] < chunk_size) {
+      fluid_push(fluid_chunk, fluid_index(local[0], local[1], local[2]));
+      continue;
+    }
+
+    Chunk *neighbour = fluid_resolve(engine, chunk, local);
+
+    if (neighbour == NULL) {
+      continue;
+    }
+
+    vector_insert_FluidCell(
+        &engine->chunks[fluid_slot(engine, neighbour)].inbox[side],
+        fluid_index(local[0], local[1], local[2]));
+    fluid_chunk->outbox |= 1 << side;
+  }
+}
+
+static void fluid_load_leaf(const VoxelNode *leaf, const Vec3i offset,
+                            unsigned int size, void *data) {
+  uint8_t *levels = data;
+  uint8_t cell = fluid_cell_from_block(leaf->block_type);
+
+  if (cell == 0) {
+    return;
+  }
+
+  for (unsigned int z = offset[2]; z < offset[2] + size; z++) {
+    for (unsigned int y = offset[1]; y < offset[1] + size; y++) {
+      memset(&levels[fluid_index(offset[0], y, z)], cell, size);
+    }
+  }
+}
+
+static void fluid_load_levels(FluidChunk *fluid_chunk, const Chunk *chunk) {
+  fluid_chunk->levels = calloc(chunk_volume, sizeof(uint8_t));
+  chunk_for_each_leaf(chunk, fluid_load_leaf, fluid_chunk->levels);
+}
+
+uint8_t fluid_get_level(const FluidEngine *engine, const Vec3i block) {
+  Vec3i chunk_position;
+  Vec3i local;
+  world_block_to_chunk(block, chunk_position, local);
+
+  Chunk *chunk = world_get_loaded_chunk(engine->world, chunk_position);
+
+  if (chunk == NULL) {
+    return 0;
+  }
+
+  return fluid_cell(engine, chunk, local) & fluid_level_mask;
+}
+
+void fluid_engine_init(FluidEngine *engine, World *world,
+                       unsigned int thread_count) {
+  engine->world = world;
+  engine->chunks = calloc(fluid_window_volume, sizeof(FluidChunk));
+  engine->listed = malloc(sizeof(unsigned int) * fluid_window_volume);
+  engine->listed_count = 0;
+  engine->order = malloc(sizeof(unsigned int) * fluid_window_volume);
+  engine->phase_begin = 0;
+  vector_init_FluidCell(&engine->lit, 0);
+  engine->accumulator = 0;
+  engine->stats = (FluidStats){0};
+
+  thread_pool_init(&engine->pool, thread_count);
+}
+
+void fluid_activate(FluidEngine *engine, const Vec3i block) {
+  Vec3i chunk_position;
+  Vec3i local;
+  world_block_to_chunk(block, chunk_position, local);
+
+  Chunk *chunk = world_get_loaded_chunk(engine->world, chunk_position);
+
+  if (chunk == NULL) {
+    return;
+  }
+
+  FluidChunk *fluid_chunk = &engine->chunks[fluid_slot(engine, chunk)];
+
+  if (fluid_chunk->levels != NULL) {
+    fluid_chunk->levels[fluid_index(local[0], local[1], local[2])] =
+        fluid_cell_from_block(chunk_get_block_type(chunk, local));
+  }
+
+  fluid_queue_around(engine, chunk, local[0], local[1], local[2]);
+}
+
+static bool fluid_cell_matches(uint8_t cell, uint8_t expected) {
+  if (expected == 0) {
+    return cell == 0;
+  }
+
+  return (cell & fluid_level_mask) != 0 &&
+         (cell & fluid_kind_mask) == (expected & fluid_kind_mask);
+}
+
+static void fluid_sync_leaf(const VoxelNode *leaf, const Vec3i offset,
+                            unsigned int size, void *data) {
+  FluidSync *sync = data;
+  uint8_t *levels = sync->fluid_chunk->levels;
+  uint8_t expected = fluid_cell_from_block(leaf->block_type);
+
+  if (levels == NULL && expected == 0) {
+    return;
+  }
+
+  for (int z = offset[2]; z < offset[2] + (int)size; z++) {
+    for (int y = offset[1]; y < offset[1] + (int)size; y++) {
+      for (int x = offset[0]; x < offset[0] + (int)size; x++) {
+        uint8_t *cell = levels != NULL ? &levels[fluid_index(x, y, z)] : NULL;
+
+        if (cell != NULL && !fluid_cell_matches(*cell, expected)) {
+          *cell = expected;
+          fluid_queue_around(sync->engine, sync->chunk, x, y, z);
+        } else if (expected != 0) {
+          fluid_queue_faces(sync->engine, sync->chunk, x, y, z);
+        }
+      }
+    }
+  }
+}
+
+void fluid_sync_chunk(FluidEngine *engine, Chunk *chunk) {
+  FluidSync sync = {engine, chunk,
+                    &engine->chunks[fluid_slot(engine, chunk)]};
+  chunk_for_each_leaf(chunk, fluid_sync_leaf, &sync);
+
+  for (unsigned int side = 0; side < 6; side++) {
+    unsigned int axis = side / 2;
+    Vec3i position;
+    vec3i_copy(position, chunk->position);
+    position[axis] += side % 2 ? 1 : -1;
+
+    Chunk *neighbour = world_get_loaded_chunk(engine->world, position);
+
+    if (neighbour == NULL ||
+        engine->chunks[fluid_slot(engine, neighbour)].levels == NULL) {
+      continue;
+    }
+
+    for (int u = 0; u < chunk_size; u++) {
+      for (int v = 0; v < chunk_size; v++) {
+        Vec3i local;
+        local[axis] = side % 2 ? chunk_size - 1 : 0;
+        local[(axis + 1) % 3] = u;
+        local[(axis + 2) % 3] = v;
+        fluid_queue(engine, chunk, local[0], local[1], local[2]);
+      }
+    }
+  }
+}
+
+void fluid_release(FluidEngine *engine, Chunk *chunk) {
+  FluidChunk *fluid_chunk = &engine->chunks[fluid_slot(engine, chunk)];
+
+  free(fluid_chunk->levels);
+  fluid_chunk->levels = NULL;
+
+  if (fluid_chunk->queued != NULL) {
+    memset(fluid_chunk->queued, 0, chunk_volume / 8);
+  }
+
+  vector_clear_FluidCell(&fluid_chunk->active);
+  vector_clear_FluidCell(&fluid_chunk->next);
+  vector_clear_FluidCell(&fluid_chunk->changed);
+
+  for (unsigned int side = 0; side < 6; side++) {
+    vector_clear_FluidCell(&fluid_chunk->inbox[side]);
+  }
+
+  fluid_chunk->outbox = 0;
+}
+
+bool fluid_idle(const FluidEngine *engine) {
+  return engine->listed_count == 0;
+}
+
+static unsigned int fluid_phase(const Chunk *chunk) {
+  return (chunk->position[0] & 1) | (chunk->position[1] & 1) << 1 |
+         (chunk->position[2] & 1) << 2;
+}
+
+static void fluid_prepare(FluidEngine *engine, Chunk *chunk) {
+  FluidChunk *fluid_chunk = &engine->chunks[fluid_slot(engine, chunk)];
+
+  if (fluid_chunk->levels == NULL) {
+    fluid_load_levels(fluid_chunk, chunk);
+  }
+
+  for (int x = -1; x <= 1; x++) {
+    for (int y = -1; y <= 1; y++) {
+      for (int z = -1; z <= 1; z++) {
+        Vec3i position;
+        vec3i_add(position, chunk->position, (Vec3i){x, y, z});
+
+        Chunk *neighbour = world_get_loaded_chunk(engine->world, position);
+
+        if (neighbour != NULL) {
+          chunk_get_solid_rows(neighbour);
+        }
+      }
+    }
+  }
+}
+
+static void fluid_tick_chunk(FluidEngine *engine, unsigned int slot) {
+  FluidChunk *fluid_chunk = &engine->chunks[slot];
+  const Chunk *chunk = &engine->world->chunk_storage[slot];
+
+  for (unsigned int i = 0; i < fluid_chunk->active.size; i++) {
+    FluidCell cell = fluid_chunk->active.data[i];
+    int x = cell % chunk_size;
+    int y = cell / chunk_size % chunk_size;
+    int z = cell / (chunk_size * chunk_size);
+
+    uint8_t flow = fluid_flow(engine, chunk, x, y, z);
+
+    if (flow == fluid_chunk->levels[cell]) {
+      continue;
+    }
+
+    fluid_chunk->levels[cell] = flow;
+    vector_insert_FluidCell(&fluid_chunk->changed, cell);
+    fluid_wake(engine, fluid_chunk, chunk, x, y, z);
+  }
+
+  fluid_chunk->updated = fluid_chunk->active.size;
+  vector_clear_FluidCell(&fluid_chunk->active);
+}
+
+static void fluid_tick_range(void *data, unsigned int begin,
+                             unsigned int end) {
+  FluidEngine *engine = data;
+
+  for (unsigned int i = begin; i < end; i++) {
+    fluid_tick_chunk(engine, engine->order[engine->phase_begin + i]);
+  }
+}
+
+static void fluid_apply(FluidEngine *engine, unsigned int slot) {
+  World *world = engine->world;
+  FluidChunk *fluid_chunk = &engine->chunks[slot];
+  Chunk *chunk = &world->chunk_storage[slot];
+  uint8_t border[6] = {0};
+  uint8_t sections = 0;
+
+  engine->stats.cells_updated += fluid_chunk->updated;
+  engine->stats.cells_changed += fluid_chunk->changed.size;
+  fluid_chunk->updated = 0;
+
+  if (fluid_chunk->changed.size != 0) {
+    vector_clear_FluidCell(&engine->lit);
+
+    mtx_lock(&chunk->mutex);
+    mtx_lock(&world->light_engine.mutex);
+
+    for (unsigned int i = 0; i < fluid_chunk->changed.size; i++) {
+      FluidCell cell = fluid_chunk->changed.data[i];
+      Vec3i local = {cell % chunk_size, cell / chunk_size % chunk_size,
+                     cell / (chunk_size * chunk_size)};
+      BlockType block_type = fluid_block_type(fluid_chunk->levels[cell]);
+      BlockType previous = chunk_get_block_type(chunk, local);
+
+      if (block_type == previous) {
+        continue;
+      }
+
+      chunk_set_block_type(chunk, local, block_type);
+      sections |= chunk_edit_sections(local);
+
+      if (block_type_is_opaque(block_type) != block_type_is_opaque(previous) ||
+          block_type_light_emission(block_type) !=
+              block_type_light_emission(previous)) {
+        vector_insert_FluidCell(&engine->lit, cell);
+      }
+
+      for (unsigned int axis = 0; axis < 3; axis++) {
+        if (local[axis] == 0) {
+          border[axis * 2] |= chunk_neighbour_sections(local, axis);
+        } else if (local[axis] == chunk_size - 1) {
+          border[axis * 2 + 1] |= chunk_neighbour_sections(local, axis);
+        }
+      }
+    }
+
+    mtx_unlock(&world->light_engine.mutex);
+    mtx_unlock(&chunk->mutex);
+
+    chunk->dirty_sections |= sections;
+    vector_clear_FluidCell(&fluid_chunk->changed);
+
+    for (unsigned int i = 0; i < engine->lit.size; i++) {
+      FluidCell cell = engine->lit.data[i];
+      Vec3i block = {cell % chunk_size, cell / chunk_size % chunk_size,
+                     cell / (chunk_size * chunk_size)};
+
+      for (unsigned int axis = 0; axis < 3; axis++) {
+        block[axis] += chunk->position[axis] * chunk_size;
+      }
+
+      light_engine_queue_update(&world->light_engine, block);
+    }
+  }
+
+  for (unsigned int side = 0; side < 6; side++) {
+    bool outbox = fluid_chunk->outbox >> side & 1;
+
+    if (!outbox && border[side] == 0) {
+      continue;
+    }
+
+    Vec3i position;
+    vec3i_copy(position, chunk->position);
+    position[side / 2] += side % 2 ? 1 : -1;
+
+    Chunk *neighbour = world_get_loaded_chunk(world, position);
+
+    if (neighbour == NULL) {
+      continue;
+    }
+
+    neighbour->dirty_sections |= border[side];
+
+    if (outbox) {
+      fluid_list(engine, fluid_slot(engine, neighbour));
+    }
+  }
+
+  fluid_chunk->outbox = 0;
+}
+
+void fluid_tick(FluidEngine *engine) {
+  if (engine->listed_count == 0) {
+    return;
+  }
+
+  TracyCZone(fluid_tick, true);
+
+  uint64_t start = metrics_now();
+  Chunk *chunks = engine->world->chunk_storage;
+  unsigned int phase_begin[fluid_phase_count + 1] = {0};
+  unsigned int listed_count = 0;
+  unsigned int active_cells = 0;
+
+  for (unsigned int i = 0; i < engine->listed_count; i++) {
+    unsigned int slot = engine->listed[i];
+    FluidChunk *fluid_chunk = &engine->chunks[slot];
+
+    for (unsigned int side = 0; side < 6; side++) {
+      Vector_FluidCell *inbox = &fluid_chunk->inbox[side];
+
+      for (unsigned int j = 0; j < inbox->size; j++) {
+        fluid_push(fluid_chunk, inbox->data[j]);
+      }
+
+      vector_clear_FluidCell(inbox);
+    }
+
+    if (fluid_chunk->next.size == 0) {
+      fluid_chunk->listed = false;
+      continue;
+    }
+
+    Vector_FluidCell active = fluid_chunk->active;
+    fluid_chunk->active = fluid_chunk->next;
+    fluid_chunk->next = active;
+
+    for (unsigned int j = 0; j < fluid_chunk->active.size; j++) {
+      FluidCell cell = fluid_chunk->active.data[j];
+      fluid_chunk->queued[cell / 64] &= ~((uint64_t)1 << cell % 64);
+    }
+
+    fluid_prepare(engine, &chunks[slot]);
+
+    active_cells += fluid_chunk->active.size;
+    phase_begin[fluid_phase(&chunks[slot]) + 1]++;
+    engine->listed[listed_count++] = slot;
+  }
+
+  engine->listed_count = listed_count;
+
+  for (unsigned int phase = 0; phase < fluid_phase_count; phase++) {
+    phase_begin[phase + 1] += phase_begin[phase];
+  }
+
+  unsigned int phase_fill[fluid_phase_count];
+  memcpy(phase_fill, phase_begin, sizeof(phase_fill));
+
+  for (unsigned int i = 0; i < listed_count; i++) {
+    unsigned int slot = engine->listed[i];
+    engine->order[phase_fill[fluid_phase(&chunks[slot])]++] = slot;
+  }
+
+  for (unsigned int phase = 0; phase < fluid_phase_count; phase++) {
+    engine->phase_begin = phase_begin[phase];
+    thread_pool_parallel_for(&engine->pool,
+                             phase_begin[phase + 1] - phase_begin[phase], 1,
+                             fluid_tick_range, engine);
+  }
+
+  uint64_t updated = engine->stats.cells_updated;
+
+  for (unsigned int i = 0; i < listed_count; i++) {
+    fluid_apply(engine, engine->order[i]);
+  }
+
+  engine->stats.ticks++;
+  engine->stats.active_chunks = listed_count;
+  engine->stats.active_cells = active_cells;
+
+  metrics_add(METRIC_FLUID_CELLS, engine->stats.cells_updated - updated);
+  metrics_record(METRIC_FLUID_TICK, metrics_now() - start);
+
+  TracyCZoneEnd(fluid_tick);
+}
+
+unsigned int fluid_update(FluidEngine *engine, double delta) {
+  unsigned int ticks = 0;
+  engine->accumulator += delta;
+
+  while (engine->accumulator >= fluid_tick_interval &&
+         ticks < fluid_max_ticks) {
+    fluid_tick(engine);
+    engine->accumulator -= fluid_tick_interval;
+    ticks++;
+  }
+
+  if (engine->accumulator >= fluid_tick_interval) {
+    engine->accumulator = 0;
+  }
+
+  return ticks;
+}
+
+void fluid_engine_free(FluidEngine *engine) {
+  thread_pool_free(&engine->pool);
+
+  for (unsigned int i = 0; i < fluid_window_volume; i++) {
+    FluidChunk *fluid_chunk = &engine->chunks[i];
+
+    free(fluid_chunk->levels);
+    free(fluid_chunk->queued);
+    vector_free_FluidCell(&fluid_chunk->active);
+    vector_free_FluidCell(&fluid_chunk->next);
+    vector_free_FluidCell(&fluid_chunk->changed);
+
+    for (unsigned int side = 0; side < 6; side++) {
+      vector_free_FluidCell(&fluid_chunk->inbox[side]);
+    }
+  }
+
+  free(engine->chunks);
+  free(engine->listed);
+  free(engine->order);
+  vector_free_FluidCell(&engine->lit);
+}
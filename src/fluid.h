@@ -0,0 +1,72 @@
+#pragma once
+
+#include "chunk.h"
+#include "thread_pool.h"
+#include "vec3.h"
+#include "vector.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define fluid_level_max 8
+#define fluid_tick_interval 0.1
+#define fluid_max_ticks 4
+
+typedef struct World World;
+
+typedef ChunkIndex FluidCell;
+
+MakeVectorDeclaration(FluidCell);
+
+typedef struct FluidChunk {
+  uint8_t *levels;
+  uint64_t *queued;
+  Vector_FluidCell active;
+  Vector_FluidCell next;
+  Vector_FluidCell inbox[6];
+  Vector_FluidCell changed;
+  unsigned int updated;
+  uint8_t outbox;
+  bool listed;
+} FluidChunk;
+
+typedef struct FluidStats {
+  unsigned int ticks;
+  uint64_t cells_updated;
+  uint64_t cells_changed;
+  unsigned int active_chunks;
+  unsigned int active_cells;
+} FluidStats;
+
+typedef struct FluidEngine {
+  World *world;
+  FluidChunk *chunks;
+  unsigned int *listed;
+  unsigned int listed_count;
+  unsigned int *order;
+  unsigned int phase_begin;
+  Vector_FluidCell lit;
+  ThreadPool pool;
+  double accumulator;
+  FluidStats stats;
+} FluidEngine;
+
+bool fluid_block_type_is_fluid(BlockType block_type);
+
+uint8_t fluid_get_level(const FluidEngine *engine, const Vec3i block);
+
+void fluid_engine_init(FluidEngine *engine, World *world,
+                       unsigned int thread_count);
+
+void fluid_activate(FluidEngine *engine, const Vec3i block);
+
+void fluid_sync_chunk(FluidEngine *engine, Chunk *chunk);
+
+void fluid_release(FluidEngine *engine, Chunk *chunk);
+
+bool fluid_idle(const FluidEngine *engine);
+
+void fluid_tick(FluidEngine *engine);
+
+unsigned int fluid_update(FluidEngine *engine, double delta);
+
+void fluid_engine_free(FluidEngine *engine);
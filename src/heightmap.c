@@ -0,0 +1,366 @@
+#include "heightmap.h"
+
+#include "math_util.h"
+#include "tracy/TracyC.h"
+#include "world.h"
+#include <stdlib.h>
+
+#define heightmap_window_volume                                                \
+  (render_distance * render_distance * render_distance)
+#define heightmap_column_count (render_distance * render_distance)
+#define heightmap_cell_count (chunk_size * chunk_size)
+
+static inline int heightmap_column_top(ChunkRow column) {
+  return 63 - __builtin_clzll(column);
+}
+
+static inline unsigned int heightmap_column_index(int chunk_x, int chunk_z) {
+  return (chunk_x & (render_distance - 1)) * render_distance +
+         (chunk_z & (render_distance - 1));
+}
+
+void heightmap_init(Heightmap *heightmap, World *world) {
+  heightmap->world = world;
+  heightmap->columns = calloc(heightmap_column_count, sizeof(HeightmapColumn));
+  heightmap->slots = calloc(heightmap_window_volume, sizeof(HeightmapSlot));
+  heightmap->stats = (HeightmapStats){0};
+}
+
+int heightmap_chunk_height(Chunk *chunk, unsigned int x, unsigned int z) {
+  ChunkRow column = chunk_get_solid_columns(chunk)[x + z * chunk_size];
+
+  return column != 0 ? heightmap_column_top(column) : heightmap_none;
+}
+
+static void heightmap_summary_add(HeightmapSummary *summary, int height) {
+  if (height == heightmap_none) {
+    summary->empty++;
+    return;
+  }
+
+  if (summary->highest == heightmap_none) {
+    summary->lowest = height;
+    summary->highest = height;
+    return;
+  }
+
+  summary->lowest = min(summary->lowest, height);
+  summary->highest = max(summary->highest, height);
+}
+
+static void heightmap_summarize(HeightmapColumn *column) {
+  column->summary = (HeightmapSummary){.lowest = heightmap_none,
+                                       .highest = heightmap_none};
+
+  for (unsigned int i = 0; i < heightmap_cell_count; i++) {
+    heightmap_summary_add(&column->summary, column->heights[i]);
+  }
+
+  column->summary_dirty = false;
+}
+
+static void heightmap_column_set(HeightmapColumn *column, unsigned int index,
+                                 int height) {
+  int previous = column->heights[index];
+  HeightmapSummary *summary = &column->summary;
+
+  if (previous == height) {
+    return;
+  }
+
+  column->heights[index] = height;
+
+  if (previous == heightmap_none) {
+    summary->empty--;
+  } else if (previous == summary->lowest || previous == summary->highest) {
+    column->summary_dirty = true;
+  }
+
+  heightmap_summary_add(summary, height);
+}
+
+static unsigned int heightmap_gather(const Heightmap *heightmap,
+                                     unsigned int index_x, unsigned int index_z,
+                                     Vec2i position, Chunk **layers) {
+  World *world = heightmap->world;
+  Chunk *candidates[render_distance];
+  unsigned int candidate_count = 0;
+
+  for (unsigned int y = 0; y < render_distance; y++) {
+    Chunk *chunk = world->chunks[index_x][y][index_z];
+
+    if (chunk != NULL && atomic_load(&chunk->loaded)) {
+      candidates[candidate_count++] = chunk;
+    }
+  }
+
+  unsigned int best = 0;
+  unsigned int best_votes = 0;
+
+  for (unsigned int i = 0; i < candidate_count; i++) {
+    unsigned int votes = 0;
+
+    for (unsigned int j = 0; j < candidate_count; j++) {
+      votes += candidates[i]->position[0] == candidates[j]->position[0] &&
+               candidates[i]->position[2] == candidates[j]->position[2];
+    }
+
+    if (votes > best_votes) {
+      best = i;
+      best_votes = votes;
+    }
+  }
+
+  if (candidate_count == 0) {
+    return 0;
+  }
+
+  position[0] = candidates[best]->position[0];
+  position[1] = candidates[best]->position[2];
+
+  unsigned int count = 0;
+
+  for (unsigned int i = 0; i < candidate_count; i++) {
+    Chunk *chunk = candidates[i];
+
+    if (chunk->position[0] != position[0] ||
+        chunk->position[2] != position[1]) {
+      continue;
+    }
+
+    unsigned int layer = count++;
+
+    while (layer > 0 && layers[layer - 1]->position[1] < chunk->position[1]) {
+      layers[layer] = layers[layer - 1];
+      layer--;
+    }
+
+    layers[layer] = chunk;
+  }
+
+  return count;
+}
+
+static void heightmap_rebuild(Heightmap *heightmap, HeightmapColumn *column,
+                              unsigned int index_x, unsigned int index_z) {
+  Chunk *layers[render_distance];
+  unsigned int count =
+      heightmap_gather(heightmap, index_x, index_z, column->position, layers);
+
+  column->valid = count != 0;
+  column->dirty = false;
+
+  if (!column->valid) {
+    return;
+  }
+
+  const ChunkRow *solid_columns[render_distance];
+  int bases[render_distance];
+
+  for (unsigned int layer = 0; layer < count; layer++) {
+    solid_columns[layer] = chunk_get_solid_columns(layers[layer]);
+    bases[layer] = layers[layer]->position[1] * chunk_size;
+  }
+
+  for (unsigned int i = 0; i < heightmap_cell_count; i++) {
+    int height = heightmap_none;
+
+    for (unsigned int layer = 0; layer < count; layer++) {
+      ChunkRow solid = solid_columns[layer][i];
+
+      if (solid != 0) {
+        height = bases[layer] + heightmap_column_top(solid);
+        break;
+      }
+    }
+
+    column->heights[i] = height;
+  }
+
+  heightmap_summarize(column);
+  heightmap->stats.columns_rebuilt++;
+}
+
+unsigned int heightmap_update(Heightmap *heightmap) {
+  TracyCZone(heightmap_update, true);
+
+  World *world = heightmap->world;
+  double start = world_now();
+  unsigned int count = 0;
+
+  for (unsigned int slot = 0; slot < heightmap_window_volume; slot++) {
+    const Chunk *chunk = &world->chunk_storage[slot];
+    HeightmapSlot *tracked = &heightmap->slots[slot];
+    bool loaded = atomic_load(&chunk->loaded);
+    unsigned int generation = atomic_load(&chunk->generation);
+
+    if (loaded == tracked->loaded &&
+        (!loaded || generation == tracked->generation)) {
+      continue;
+    }
+
+    tracked->loaded = loaded;
+    tracked->generation = generation;
+
+    unsigned int index_x = slot / heightmap_column_count;
+    unsigned int index_z = slot % render_distance;
+    heightmap->columns[index_x * render_distance + index_z].dirty = true;
+  }
+
+  for (unsigned int index_x = 0; index_x < render_distance; index_x++) {
+    for (unsigned int index_z = 0; index_z < render_distance; index_z++) {
+      HeightmapColumn *column =
+          &heightmap->columns[index_x * render_distance + index_z];
+
+      if (column->dirty) {
+        heightmap_rebuild(heightmap, column, index_x, index_z);
+        count++;
+      }
+    }
+  }
+
+  if (count != 0) {
+    heightmap->stats.rebuild_time += world_now() - start;
+  }
+
+  TracyCZoneEnd(heightmap_update);
+
+  return count;
+}
+
+static HeightmapColumn *heightmap_lookup(Heightmap *heightmap, int chunk_x,
+                                         int chunk_z) {
+  unsigned int index = heightmap_column_index(chunk_x, chunk_z);
+  HeightmapColumn *column = &heightmap->columns[index];
+
+  if (column->dirty) {
+    heightmap_rebuild(heightmap, column, index / render_distance,
+                      index % render_distance);
+  }
+
+  if (!column->valid || column->position[0] != chunk_x ||
+      column->position[1] != chunk_z) {
+    return NULL;
+  }
+
+  return column;
+}
+
+static int heightmap_descend(Heightmap *heightmap, Chunk *chunk,
+                             const Vec3i chunk_position, const Vec3i local) {
+  Vec3i position;
+  vec3i_copy(position, chunk_position);
+
+  unsigned int index = local[0] + local[2] * chunk_size;
+  ChunkRow mask = ((ChunkRow)1 << local[1]) - 1;
+
+  heightmap->stats.descents++;
+
+  for (unsigned int i = 0; i < render_distance; i++) {
+    if (chunk != NULL) {
+      ChunkRow solid = chunk_get_solid_columns(chunk)[index] & mask;
+
+      if (solid != 0) {
+        return position[1] * chunk_size + heightmap_column_top(solid);
+      }
+    }
+
+    mask = chunk_row_full;
+    position[1]--;
+    chunk = world_get_loaded_chunk(heightmap->world, position);
+  }
+
+  return heightmap_none;
+}
+
+void heightmap_set_block(Heightmap *heightmap, const Vec3i block,
+                         BlockType block_type) {
+  World *world = heightmap->world;
+  Vec3i chunk_position;
+  Vec3i local;
+  world_block_to_chunk(block, chunk_position, local);
+
+  HeightmapColumn *column = &heightmap->columns[heightmap_column_index(
+      chunk_position[0], chunk_position[2])];
+
+  if (column->dirty || !column->valid ||
+      column->position[0] != chunk_position[0] ||
+      column->position[1] != chunk_position[2]) {
+    return;
+  }
+
+  Chunk *chunk = world_get_loaded_chunk(world, chunk_position);
+
+  if (chunk == NULL) {
+    return;
+  }
+
+  const HeightmapSlot *tracked =
+      &heightmap->slots[chunk - world->chunk_storage];
+
+  if (!tracked->loaded ||
+      tracked->generation != atomic_load(&chunk->generation)) {
+    return;
+  }
+
+  unsigned int index = local[0] + local[2] * chunk_size;
+  int height = column->heights[index];
+
+  heightmap->stats.blocks_updated++;
+
+  if (block_type_is_solid(block_type)) {
+    if (height == heightmap_none || block[1] > height) {
+      heightmap_column_set(column, index, block[1]);
+    }
+
+    return;
+  }
+
+  if (block[1] == height) {
+    heightmap_column_set(
+        column, index,
+        heightmap_descend(heightmap, chunk, chunk_position, local));
+  }
+}
+
+void heightmap_invalidate_chunk(Heightmap *heightmap, const Chunk *chunk) {
+  heightmap
+      ->columns[heightmap_column_index(chunk->position[0], chunk->position[2])]
+      .dirty = true;
+}
+
+int heightmap_get_height(Heightmap *heightmap, int x, int z) {
+  int local_x = x & (chunk_size - 1);
+  int local_z = z & (chunk_size - 1);
+  HeightmapColumn *column = heightmap_lookup(
+      heightmap, (x - local_x) / chunk_size, (z - local_z) / chunk_size);
+
+  if (column == NULL) {
+    return heightmap_none;
+  }
+
+  return column->heights[local_x + local_z * chunk_size];
+}
+
+bool heightmap_get_summary(Heightmap *heightmap, const Vec2i position,
+                           HeightmapSummary *summary) {
+  HeightmapColumn *column =
+      heightmap_lookup(heightmap, position[0], position[1]);
+
+  if (column == NULL) {
+    return false;
+  }
+
+  if (column->summary_dirty) {
+    heightmap_summarize(column);
+  }
+
+  *summary = column->summary;
+
+  return true;
+}
+
+void heightmap_free(Heightmap *heightmap) {
+  free(heightmap->columns);
+  free(heightmap->slots);
+}
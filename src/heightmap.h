@@ -0,0 +1,63 @@
+#pragma once
+
+#include "chunk.h"
+#include "vec2.h"
+#include "vec3.h"
+#include <limits.h>
+#include <stdbool.h>
+
+#define heightmap_none INT_MIN
+
+typedef struct World World;
+
+typedef struct HeightmapSummary {
+  int lowest;
+  int highest;
+  unsigned int empty;
+} HeightmapSummary;
+
+typedef struct HeightmapColumn {
+  Vec2i position;
+  bool valid;
+  bool dirty;
+  bool summary_dirty;
+  HeightmapSummary summary;
+  int heights[chunk_size * chunk_size];
+} HeightmapColumn;
+
+typedef struct HeightmapSlot {
+  unsigned int generation;
+  bool loaded;
+} HeightmapSlot;
+
+typedef struct HeightmapStats {
+  unsigned int columns_rebuilt;
+  unsigned int blocks_updated;
+  unsigned int descents;
+  double rebuild_time;
+} HeightmapStats;
+
+typedef struct Heightmap {
+  World *world;
+  HeightmapColumn *columns;
+  HeightmapSlot *slots;
+  HeightmapStats stats;
+} Heightmap;
+
+void heightmap_init(Heightmap *heightmap, World *world);
+
+unsigned int heightmap_update(Heightmap *heightmap);
+
+void heightmap_set_block(Heightmap *heightmap, const Vec3i block,
+                         BlockType block_type);
+
+void heightmap_invalidate_chunk(Heightmap *heightmap, const Chunk *chunk);
+
+int heightmap_get_height(Heightmap *heightmap, int x, int z);
+
+int heightmap_chunk_height(Chunk *chunk, unsigned int x, unsigned int z);
+
+bool heightmap_get_summary(Heightmap *heightmap, const Vec2i position,
+                           HeightmapSummary *summary);
+
+void heightmap_free(Heightmap *heightmap);
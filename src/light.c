@@ -0,0 +1,742 @@
+#include "light.h"
+
+#include "chunk.h"
+#include "math_util.h"
+#include "metrics.h"
+#include "thread_pool.h"
+#include "tracy/TracyC.h"
+#include "world.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define sky_shift 4
+#define block_shift 0
+#define direction_down 2
+#define direction_up 3
+
+static const int directions[6][3] = {{-1, 0, 0}, {1, 0, 0},  {0, -1, 0},
+                                     {0, 1, 0},  {0, 0, -1}, {0, 0, 1}};
+
+typedef struct LightNode {
+  Chunk *chunk;
+  ChunkIndex index;
+  uint8_t level;
+} LightNode;
+
+typedef struct LightQueue {
+  LightNode *nodes;
+  unsigned int head;
+  unsigned int size;
+  unsigned int allocated_size;
+} LightQueue;
+
+typedef struct LightScratch {
+  uint8_t levels[chunk_volume];
+  ChunkRow opaque[chunk_size * chunk_size];
+  uint8_t heightmap[chunk_size * chunk_size];
+  bool exposed[chunk_size * chunk_size];
+  LightQueue sky_queue;
+  LightQueue block_queue;
+} LightScratch;
+
+typedef struct LightChunkBatch {
+  LightEngine *engine;
+  Chunk *chunks[light_batch_size];
+  unsigned int size;
+} LightChunkBatch;
+
+typedef struct LightUpdateBatch {
+  LightEngine *engine;
+  LightUpdate *updates;
+  unsigned int size;
+} LightUpdateBatch;
+
+MakeVectorDefinition(LightUpdate);
+
+static void light_queue_push(LightQueue *queue, Chunk *chunk,
+                             unsigned int index, uint8_t level) {
+  if (queue->size >= queue->allocated_size) {
+    queue->allocated_size =
+        queue->allocated_size == 0 ? 1024 : queue->allocated_size * 2;
+    queue->nodes =
+        realloc(queue->nodes, queue->allocated_size * sizeof(LightNode));
+  }
+
+  queue->nodes[queue->size++] = (LightNode){chunk, index, level};
+}
+
+static void light_queue_clear(LightQueue *queue) {
+  queue->head = 0;
+  queue->size = 0;
+}
+
+static unsigned int light_index(const Vec3i block) {
+  return block[0] + block[1] * chunk_size + block[2] * chunk_size * chunk_size;
+}
+
+static void light_block_from_index(Vec3i out, unsigned int index) {
+  out[0] = index % chunk_size;
+  out[1] = index / chunk_size % chunk_size;
+  out[2] = index / (chunk_size * chunk_size);
+}
+
+static uint8_t light_level(const ChunkLight *light, unsigned int index) {
+  return light->levels != NULL ? light->levels[index] : light->uniform_level;
+}
+
+static uint8_t light_channel(uint8_t level, unsigned int shift) {
+  return (level >> shift) & light_max;
+}
+
+static uint8_t light_with_channel(uint8_t level, unsigned int shift,
+                                  uint8_t value) {
+  return (level & ~(light_max << shift)) | (value << shift);
+}
+
+static void light_set_channel(ChunkLight *light, unsigned int index,
+                              unsigned int shift, uint8_t value) {
+  uint8_t level = light_level(light, index);
+  uint8_t next_level = light_with_channel(level, shift, value);
+
+  if (next_level == level) {
+    return;
+  }
+
+  if (light->levels == NULL) {
+    light->levels = malloc(chunk_volume);
+    memset(light->levels, light->uniform_level, chunk_volume);
+  }
+
+  light->levels[index] = next_level;
+}
+
+static uint8_t light_propagated(uint8_t level, unsigned int direction,
+                                unsigned int shift) {
+  if (shift == sky_shift && direction == direction_down &&
+      level == light_max) {
+    return light_max;
+  }
+
+  return level - 1;
+}
+
+uint8_t light_get_sky(const Chunk *chunk, const Vec3i block) {
+  return light_channel(light_level(&chunk->light, light_index(block)),
+                       sky_shift);
+}
+
+uint8_t light_get_block(const Chunk *chunk, const Vec3i block) {
+  return light_channel(light_level(&chunk->light, light_index(block)),
+                       block_shift);
+}
+
+static Chunk *light_neighbour(World *world, const Chunk *chunk,
+                              unsigned int direction) {
+  Vec3i position;
+  vec3i_add(position, chunk->position, directions[direction]);
+
+  Chunk *neighbour = world_get_loaded_chunk(world, position);
+
+  if (neighbour == NULL || !neighbour->light.ready) {
+    return NULL;
+  }
+
+  return neighbour;
+}
+
+static bool light_step(World *world, Chunk *chunk, unsigned int index,
+                       unsigned int direction, Chunk **out_chunk,
+                       unsigned int *out_index) {
+  Vec3i block;
+  light_block_from_index(block, index);
+
+  unsigned int axis = direction / 2;
+  block[axis] += directions[direction][axis];
+
+  if (block[axis] < 0 || block[axis] >= chunk_size) {
+    chunk = light_neighbour(world, chunk, direction);
+
+    if (chunk == NULL) {
+      return false;
+    }
+
+    block[axis] = mod(block[axis], chunk_size);
+  }
+
+  *out_chunk = chunk;
+  *out_index = light_index(block);
+
+  return true;
+}
+
+static bool light_is_sky_open(World *world, const Chunk *chunk) {
+  Vec3i above;
+  vec3i_add(above, chunk->position, directions[direction_up]);
+
+  return world_get_loaded_chunk(world, above) == NULL;
+}
+
+static uint8_t light_source_level(World *world, const Chunk *chunk,
+                                  unsigned int index, unsigned int shift) {
+  Vec3i block;
+  light_block_from_index(block, index);
+
+  BlockType block_type = chunk_get_block_type(chunk, block);
+
+  if (shift == block_shift) {
+    return block_type_light_emission(block_type);
+  }
+
+  if (block_type_is_opaque(block_type) || block[1] != chunk_size - 1 ||
+      !light_is_sky_open(world, chunk)) {
+    return 0;
+  }
+
+  return light_max;
+}
+
+static bool light_is_opaque(const Chunk *chunk, unsigned int index) {
+  Vec3i block;
+  light_block_from_index(block, index);
+
+  return block_type_is_opaque(chunk_get_block_type(chunk, block));
+}
+
+static void light_flood(World *world, LightQueue *queue, unsigned int shift) {
+  while (queue->head < queue->size) {
+    LightNode node = queue->nodes[queue->head++];
+    uint8_t level =
+        light_channel(light_level(&node.chunk->light, node.index), shift);
+
+    if (level <= 1) {
+      continue;
+    }
+
+    for (unsigned int direction = 0; direction < 6; direction++) {
+      Chunk *next_chunk;
+      unsigned int next_index;
+
+      if (!light_step(world, node.chunk, node.index, direction, &next_chunk,
+                      &next_index)) {
+        continue;
+      }
+
+      uint8_t next_level = light_propagated(level, direction, shift);
+
+      if (light_channel(light_level(&next_chunk->light, next_index), shift) >=
+              next_level ||
+          light_is_opaque(next_chunk, next_index)) {
+        continue;
+      }
+
+      light_set_channel(&next_chunk->light, next_index, shift, next_level);
+      light_queue_push(queue, next_chunk, next_index, next_level);
+    }
+  }
+
+  light_queue_clear(queue);
+}
+
+static void light_unflood(World *world, LightQueue *removal_queue,
+                          LightQueue *queue, unsigned int shift) {
+  while (removal_queue->head < removal_queue->size) {
+    LightNode node = removal_queue->nodes[removal_queue->head++];
+
+    for (unsigned int direction = 0; direction < 6; direction++) {
+      Chunk *next_chunk;
+      unsigned int next_index;
+
+      if (!light_step(world, node.chunk, node.index, direction, &next_chunk,
+                      &next_index)) {
+        continue;
+      }
+
+      uint8_t next_level =
+          light_channel(light_level(&next_chunk->light, next_index), shift);
+
+      if (next_level == 0) {
+        continue;
+      }
+
+      bool lit_by_node = next_level < node.level ||
+                         (shift == sky_shift && direction == direction_down &&
+                          node.level == light_max);
+
+      if (!lit_by_node) {
+        light_queue_push(queue, next_chunk, next_index, next_level);
+        continue;
+      }
+
+      uint8_t source_level =
+          light_source_level(world, next_chunk, next_index, shift);
+
+      light_set_channel(&next_chunk->light, next_index, shift, source_level);
+      light_queue_push(removal_queue, next_chunk, next_index, next_level);
+
+      if (source_level > 0) {
+        light_queue_push(queue, next_chunk, next_index, source_level);
+      }
+    }
+  }
+
+  light_queue_clear(removal_queue);
+}
+
+static void light_collect_leaf(const VoxelNode *leaf, const Vec3i offset,
+                               unsigned int size, void *data) {
+  LightScratch *scratch = data;
+
+  if (block_type_is_opaque(leaf->block_type)) {
+    ChunkRow row = size == chunk_size
+                       ? chunk_row_full
+                       : (((ChunkRow)1 << size) - 1) << offset[0];
+
+    for (unsigned int z = offset[2]; z < offset[2] + size; z++) {
+      for (unsigned int y = offset[1]; y < offset[1] + size; y++) {
+        scratch->opaque[y + z * chunk_size] |= row;
+      }
+
+      for (unsigned int x = offset[0]; x < offset[0] + size; x++) {
+        uint8_t *height = &scratch->heightmap[x + z * chunk_size];
+        *height = max(*height, offset[1] + size);
+      }
+    }
+  }
+
+  uint8_t emission = block_type_light_emission(leaf->block_type);
+
+  if (emission == 0) {
+    return;
+  }
+
+  for (unsigned int z = offset[2]; z < offset[2] + size; z++) {
+    for (unsigned int y = offset[1]; y < offset[1] + size; y++) {
+      for (unsigned int x = offset[0]; x < offset[0] + size; x++) {
+        unsigned int index = light_index((Vec3i){x, y, z});
+        scratch->levels[index] =
+            light_with_channel(scratch->levels[index], block_shift, emission);
+        light_queue_push(&scratch->block_queue, NULL, index, emission);
+      }
+    }
+  }
+}
+
+static void light_flood_local(LightScratch *scratch, LightQueue *queue,
+                              unsigned int shift) {
+  while (queue->head < queue->size) {
+    unsigned int index = queue->nodes[queue->head++].index;
+    uint8_t level = light_channel(scratch->levels[index], shift);
+
+    if (level <= 1) {
+      continue;
+    }
+
+    Vec3i block;
+    light_block_from_index(block, index);
+
+    for (unsigned int direction = 0; direction < 6; direction++) {
+      Vec3i next_block;
+      vec3i_add(next_block, block, directions[direction]);
+
+      unsigned int axis = direction / 2;
+
+      if (next_block[axis] < 0 || next_block[axis] >= chunk_size) {
+        continue;
+      }
+
+      if (scratch->opaque[next_block[1] + next_block[2] * chunk_size] >>
+              next_block[0] &
+          1) {
+        continue;
+      }
+
+      unsigned int next_index = light_index(next_block);
+      uint8_t next_level = light_propagated(level, direction, shift);
+
+      if (light_channel(scratch->levels[next_index], shift) >= next_level) {
+        continue;
+      }
+
+      scratch->levels[next_index] =
+          light_with_channel(scratch->levels[next_index], shift, next_level);
+      light_queue_push(queue, NULL, next_index, next_level);
+    }
+  }
+
+  light_queue_clear(queue);
+}
+
+static void light_compute_local(LightEngine *engine, Chunk *chunk,
+                                LightScratch *scratch) {
+  TracyCZone(light_compute_local, true);
+  uint64_t start = metrics_now();
+
+  memset(scratch->levels, 0, sizeof(scratch->levels));
+  memset(scratch->opaque, 0, sizeof(scratch->opaque));
+  memset(scratch->heightmap, 0, sizeof(scratch->heightmap));
+
+  mtx_lock(&chunk->mutex);
+  chunk_for_each_leaf(chunk, light_collect_leaf, scratch);
+  mtx_unlock(&chunk->mutex);
+
+  Vec3i above_position;
+  vec3i_add(above_position, chunk->position, directions[direction_up]);
+
+  mtx_lock(&engine->mutex);
+
+  Chunk *above = world_get_loaded_chunk(engine->world, above_position);
+
+  for (unsigned int x = 0; x < chunk_size; x++) {
+    for (unsigned int z = 0; z < chunk_size; z++) {
+      bool exposed = above == NULL;
+
+      if (above != NULL && above->light.ready) {
+        uint8_t above_level =
+            light_level(&above->light, light_index((Vec3i){x, 0, z}));
+        exposed = light_channel(above_level, sky_shift) == light_max;
+      }
+
+      scratch->exposed[x + z * chunk_size] = exposed;
+    }
+  }
+
+  mtx_unlock(&engine->mutex);
+
+  for (unsigned int x = 0; x < chunk_size; x++) {
+    for (unsigned int z = 0; z < chunk_size; z++) {
+      unsigned int column = x + z * chunk_size;
+
+      if (!scratch->exposed[column]) {
+        continue;
+      }
+
+      unsigned int height = scratch->heightmap[column];
+      unsigned int seed_height = height;
+
+      for (unsigned int direction = 0; direction < 6; direction++) {
+        if (direction / 2 == 1) {
+          continue;
+        }
+
+        int next_x = x + directions[direction][0];
+        int next_z = z + directions[direction][2];
+
+        if (next_x < 0 || next_x >= chunk_size || next_z < 0 ||
+            next_z >= chunk_size) {
+          continue;
+        }
+
+        unsigned int next_column = next_x + next_z * chunk_size;
+        unsigned int next_height = scratch->exposed[next_column]
+                                       ? scratch->heightmap[next_column]
+                                       : chunk_size;
+
+        seed_height = max(seed_height, next_height);
+      }
+
+      for (unsigned int y = height; y < chunk_size; y++) {
+        unsigned int index = light_index((Vec3i){x, y, z});
+        scratch->levels[index] =
+            light_with_channel(scratch->levels[index], sky_shift, light_max);
+
+        if (y < seed_height) {
+          light_queue_push(&scratch->sky_queue, NULL, index, light_max);
+        }
+      }
+    }
+  }
+
+  light_flood_local(scratch, &scratch->sky_queue, sky_shift);
+  light_flood_local(scratch, &scratch->block_queue, block_shift);
+
+  metrics_record(METRIC_CHUNK_LIGHT, metrics_now() - start);
+
+  TracyCZoneEnd(light_compute_local);
+}
+
+static void light_seed_border(World *world, Chunk *chunk, LightQueue *queue,
+                              unsigned int shift) {
+  for (unsigned int direction = 0; direction < 6; direction++) {
+    Chunk *neighbour = light_neighbour(world, chunk, direction);
+
+    if (neighbour == NULL) {
+      continue;
+    }
+
+    unsigned int axis = direction / 2;
+    unsigned int axis_a = (axis + 1) % 3;
+    unsigned int axis_b = (axis + 2) % 3;
+
+    for (unsigned int a = 0; a < chunk_size; a++) {
+      for (unsigned int b = 0; b < chunk_size; b++) {
+        Vec3i block;
+        block[axis_a] = a;
+        block[axis_b] = b;
+
+        block[axis] = direction % 2 ? chunk_size - 1 : 0;
+        unsigned int index = light_index(block);
+
+        if (light_channel(light_level(&chunk->light, index), shift) > 1) {
+          light_queue_push(queue, chunk, index, 0);
+        }
+
+        block[axis] = direction % 2 ? 0 : chunk_size - 1;
+        unsigned int neighbour_index = light_index(block);
+
+        if (light_channel(light_level(&neighbour->light, neighbour_index),
+                          shift) > 1) {
+          light_queue_push(queue, neighbour, neighbour_index, 0);
+        }
+      }
+    }
+  }
+}
+
+static void light_commit(LightEngine *engine, Chunk *chunk,
+                         LightScratch *scratch) {
+  TracyCZone(light_commit, true);
+
+  ChunkLight *light = &chunk->light;
+
+  free(light->levels);
+  light->levels = NULL;
+  light->uniform_level = scratch->levels[0];
+
+  if (memcmp(scratch->levels, scratch->levels + 1, chunk_volume - 1) != 0) {
+    light->levels = malloc(chunk_volume);
+    memcpy(light->levels, scratch->levels, chunk_volume);
+  }
+
+  memcpy(light->heightmap, scratch->heightmap, sizeof(light->heightmap));
+  light->ready = true;
+
+  light_seed_border(engine->world, chunk, &scratch->sky_queue, sky_shift);
+  light_flood(engine->world, &scratch->sky_queue, sky_shift);
+
+  light_seed_border(engine->world, chunk, &scratch->block_queue, block_shift);
+  light_flood(engine->world, &scratch->block_queue, block_shift);
+
+  TracyCZoneEnd(light_commit);
+}
+
+static void light_chunk_compute_scratch(LightEngine *engine, Chunk *chunk,
+                                        LightScratch *scratch) {
+  light_compute_local(engine, chunk, scratch);
+
+  mtx_lock(&engine->mutex);
+  light_commit(engine, chunk, scratch);
+  mtx_unlock(&engine->mutex);
+}
+
+static void light_scratch_free(LightScratch *scratch) {
+  free(scratch->sky_queue.nodes);
+  free(scratch->block_queue.nodes);
+  free(scratch);
+}
+
+void light_chunk_compute(LightEngine *engine, Chunk *chunk) {
+  LightScratch *scratch = calloc(1, sizeof(LightScratch));
+  light_chunk_compute_scratch(engine, chunk, scratch);
+  light_scratch_free(scratch);
+}
+
+static void light_chunk_batch_job(void *data) {
+  TracyCZone(light_chunk_batch_job, true);
+
+  LightChunkBatch *batch = data;
+  LightScratch *scratch = calloc(1, sizeof(LightScratch));
+
+  for (unsigned int i = 0; i < batch->size; i++) {
+    light_chunk_compute_scratch(batch->engine, batch->chunks[i], scratch);
+    atomic_fetch_sub(&batch->chunks[i]->light_jobs, 1);
+  }
+
+  light_scratch_free(scratch);
+  free(batch);
+
+  TracyCZoneEnd(light_chunk_batch_job);
+}
+
+static void light_update_heightmap(Chunk *chunk, const Vec3i block,
+                                   BlockType block_type) {
+  uint8_t *height = &chunk->light.heightmap[block[0] + block[2] * chunk_size];
+
+  if (block_type_is_opaque(block_type)) {
+    *height = max(*height, block[1] + 1);
+    return;
+  }
+
+  if (block[1] + 1 != *height) {
+    return;
+  }
+
+  while (*height > 0 &&
+         !block_type_is_opaque(chunk_get_block_type(
+             chunk, (Vec3i){block[0], *height - 1, block[2]}))) {
+    (*height)--;
+  }
+}
+
+static void light_apply_updates(LightEngine *engine, LightUpdate *updates,
+                                unsigned int size, unsigned int shift,
+                                LightQueue *removal_queue, LightQueue *queue) {
+  World *world = engine->world;
+
+  for (unsigned int i = 0; i < size; i++) {
+    Vec3i chunk_position;
+    Vec3i local;
+    world_block_to_chunk(updates[i].block, chunk_position, local);
+
+    Chunk *chunk = world_get_loaded_chunk(world, chunk_position);
+
+    if (chunk == NULL || !chunk->light.ready) {
+      continue;
+    }
+
+    unsigned int index = light_index(local);
+    BlockType block_type = chunk_get_block_type(chunk, local);
+
+    if (shift == sky_shift) {
+      light_update_heightmap(chunk, local, block_type);
+    }
+
+    uint8_t level = light_channel(light_level(&chunk->light, index), shift);
+    uint8_t source_level = light_source_level(world, chunk, index, shift);
+
+    light_set_channel(&chunk->light, index, shift, source_level);
+
+    if (level > 0) {
+      light_queue_push(removal_queue, chunk, index, level);
+    }
+
+    if (source_level > 0) {
+      light_queue_push(queue, chunk, index, source_level);
+    }
+
+    if (block_type_is_opaque(block_type)) {
+      continue;
+    }
+
+    for (unsigned int direction = 0; direction < 6; direction++) {
+      Chunk *next_chunk;
+      unsigned int next_index;
+
+      if (light_step(world, chunk, index, direction, &next_chunk,
+                     &next_index)) {
+        light_queue_push(queue, next_chunk, next_index, 0);
+      }
+    }
+  }
+
+  light_unflood(world, removal_queue, queue, shift);
+  light_flood(world, queue, shift);
+}
+
+static void light_update_batch_job(void *data) {
+  TracyCZone(light_update_batch_job, true);
+
+  LightUpdateBatch *batch = data;
+  LightQueue removal_queue = {0};
+  LightQueue queue = {0};
+
+  mtx_lock(&batch->engine->mutex);
+
+  light_apply_updates(batch->engine, batch->updates, batch->size, sky_shift,
+                      &removal_queue, &queue);
+  light_apply_updates(batch->engine, batch->updates, batch->size, block_shift,
+                      &removal_queue, &queue);
+
+  mtx_unlock(&batch->engine->mutex);
+
+  free(removal_queue.nodes);
+  free(queue.nodes);
+  free(batch->updates);
+  free(batch);
+
+  TracyCZoneEnd(light_update_batch_job);
+}
+
+void light_engine_init(LightEngine *engine, World *world,
+                       unsigned int thread_count) {
+  engine->world = world;
+  vector_init_LightUpdate(&engine->pending, 0);
+
+  mtx_init(&engine->mutex, mtx_plain);
+  mtx_init(&engine->queue_mutex, mtx_plain);
+
+  thread_pool_init(&engine->pool, thread_count);
+}
+
+static int light_compare_height(const void *a, const void *b) {
+  const Chunk *chunk_a = *(Chunk *const *)a;
+  const Chunk *chunk_b = *(Chunk *const *)b;
+
+  return chunk_b->position[1] - chunk_a->position[1];
+}
+
+void light_engine_submit_chunks(LightEngine *engine, Chunk **chunks,
+                                unsigned int count) {
+  Chunk **sorted_chunks = malloc(sizeof(Chunk *) * count);
+  memcpy(sorted_chunks, chunks, sizeof(Chunk *) * count);
+  qsort(sorted_chunks, count, sizeof(Chunk *), light_compare_height);
+
+  for (unsigned int i = 0; i < count; i += light_batch_size) {
+    LightChunkBatch *batch = malloc(sizeof(LightChunkBatch));
+    batch->engine = engine;
+    batch->size = 0;
+
+    for (unsigned int j = i; j < count && batch->size < light_batch_size;
+         j++) {
+      atomic_fetch_add(&sorted_chunks[j]->light_jobs, 1);
+      batch->chunks[batch->size++] = sorted_chunks[j];
+    }
+
+    thread_pool_submit(&engine->pool, light_chunk_batch_job, batch);
+  }
+
+  free(sorted_chunks);
+}
+
+void light_engine_queue_update(LightEngine *engine, const Vec3i block) {
+  mtx_lock(&engine->queue_mutex);
+
+  LightUpdate *update = vector_extend_LightUpdate(&engine->pending, 1);
+  vec3i_copy(update->block, block);
+
+  mtx_unlock(&engine->queue_mutex);
+}
+
+void light_engine_flush(LightEngine *engine) {
+  mtx_lock(&engine->queue_mutex);
+
+  if (engine->pending.size == 0) {
+    mtx_unlock(&engine->queue_mutex);
+    return;
+  }
+
+  LightUpdateBatch *batch = malloc(sizeof(LightUpdateBatch));
+  batch->engine = engine;
+  batch->size = engine->pending.size;
+  batch->updates = vector_release_LightUpdate(&engine->pending);
+
+  mtx_unlock(&engine->queue_mutex);
+
+  thread_pool_submit(&engine->pool, light_update_batch_job, batch);
+}
+
+bool light_engine_busy(LightEngine *engine) {
+  return thread_pool_busy(&engine->pool);
+}
+
+void light_engine_wait(LightEngine *engine) {
+  thread_pool_wait(&engine->pool);
+}
+
+void light_engine_free(LightEngine *engine) {
+  thread_pool_free(&engine->pool);
+
+  vector_free_LightUpdate(&engine->pending);
+
+  mtx_destroy(&engine->mutex);
+  mtx_destroy(&engine->queue_mutex);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "chunk.h"
+#include "thread_pool.h"
+#include "vec3.h"
+#include "vector.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <threads.h>
+
+#define light_max 15
+#define light_batch_size 8
+
+typedef struct World World;
+
+typedef struct LightUpdate {
+  Vec3i block;
+} LightUpdate;
+
+MakeVectorDeclaration(LightUpdate);
+
+typedef struct LightEngine {
+  World *world;
+  ThreadPool pool;
+  mtx_t mutex;
+  mtx_t queue_mutex;
+  Vector_LightUpdate pending;
+} LightEngine;
+
+uint8_t light_get_sky(const Chunk *chunk, const Vec3i block);
+
+uint8_t light_get_block(const Chunk *chunk, const Vec3i block);
+
+void light_chunk_compute(LightEngine *engine, Chunk *chunk);
+
+void light_engine_init(LightEngine *engine, World *world,
+                       unsigned int thread_count);
+
+void light_engine_submit_chunks(LightEngine *engine, Chunk **chunks,
+                                unsigned int count);
+
+void light_engine_queue_update(LightEngine *engine, const Vec3i block);
+
+void light_engine_flush(LightEngine *engine);
+
+bool light_engine_busy(LightEngine *engine);
+
+void light_engine_wait(LightEngine *engine);
+
+void light_engine_free(LightEngine *engine);
@@ -3,12 +3,36 @@
 
 #include "../tracy/public/tracy/TracyC.h"
 #include "camera.h"
+#include "camera_path.h"
 #include "mat4.h"
+#include "metrics.h"
+#include "simulation.h"
 #include "world.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
-int main() {
+int main(int argc, char **argv) {
+  const char *record_filename = NULL;
+  const char *metrics_target = getenv("VOXEL_METRICS");
+  double metrics_interval = 1;
+
+  for (int i = 1; i + 1 < argc; i++) {
+    if (strcmp(argv[i], "--record") == 0) {
+      record_filename = argv[i + 1];
+    } else if (strcmp(argv[i], "--metrics") == 0) {
+      metrics_target = argv[i + 1];
+    } else if (strcmp(argv[i], "--metrics-interval") == 0) {
+      metrics_interval = atof(argv[i + 1]);
+    }
+  }
+
+  if (metrics_target != NULL &&
+      !metrics_open(metrics_target, metrics_interval)) {
+    printf("Could not open metrics output %s\n", metrics_target);
+  }
+
   GLFWwindow *window;
 
   if (!glfwInit()) {
@@ -49,30 +73,51 @@ int main() {
                                 1000);
   mat4_create_identity_matrix(camera.view_matrix);
 
+  CameraPath recorded_path = {.kind = CAMERA_PATH_RECORDED};
+
   World world = {0};
   world_init(&world);
 
+  Simulation simulation;
+  simulation_init(&simulation, &world, simulation_default_timestep);
+  simulation_set_camera(&simulation, &camera.transform);
+  simulation_start(&simulation);
+
   glEnable(GL_DEPTH_TEST);
   glEnable(GL_CULL_FACE);
   glEnable(GL_MULTISAMPLE);
 
   while (!glfwWindowShouldClose(window)) {
     camera_move(&camera, window);
+    simulation_set_camera(&simulation, &camera.transform);
+
+    if (record_filename != NULL) {
+      camera_path_record(&recorded_path, glfwGetTime(), &camera.transform);
+    }
 
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    world_load(&world, &camera);
+    simulation_present(&simulation);
     world_render(&world, &camera);
 
     TracyCFrameMark;
+    metrics_tick();
 
     glfwSwapBuffers(window);
     glfwPollEvents();
   }
 
+  simulation_free(&simulation);
   glfwTerminate();
 
   world_free(&world);
+  metrics_close();
+
+  if (record_filename != NULL) {
+    camera_path_save(&recorded_path, record_filename);
+  }
+
+  camera_path_free(&recorded_path);
 
   return 0;
 }
@@ -5,3 +5,7 @@ double clamp(double value, double min, double max) {
 };
 
 unsigned int mod(int a, unsigned int b) { return (a % b + b) % b; }
+
+int min(int a, int b) { return a < b ? a : b; }
+
+int max(int a, int b) { return a > b ? a : b; }
@@ -7,3 +7,7 @@ static const double DEG_TO_RAD = M_PI / 180;
 double clamp(double value, double min, double max);
 
 unsigned int mod(int a, unsigned int b);
+
+int min(int a, int b);
+
+int max(int a, int b);
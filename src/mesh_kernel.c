@@ -0,0 +1,146 @@
+#include "mesh_kernel.h"
+
+#include "chunk.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+typedef unsigned int (*MeshFaceRowsKernel)(const MaskRow *rows,
+                                           const MaskRow *opaque,
+                                           bool translucent, MaskRow *faces);
+
+static inline __attribute__((always_inline)) unsigned int
+mesh_face_rows(const MaskRow *restrict rows, const MaskRow *restrict opaque,
+               bool translucent, bool negative, MaskRow *restrict faces) {
+  MaskRow inner = (((MaskRow)1 << chunk_size) - 1) << 1;
+  MaskRow translucent_mask = translucent ? ~(MaskRow)0 : 0;
+  unsigned int count = 0;
+
+  for (unsigned int i = 0; i < chunk_size * chunk_size; i++) {
+    MaskRow occluder = opaque[i] | (rows[i] & translucent_mask);
+    MaskRow shifted = negative ? occluder << 1 : occluder >> 1;
+    faces[i] = rows[i] & inner & ~shifted;
+  }
+
+  for (unsigned int i = 0; i < chunk_size * chunk_size; i++) {
+    count += chunk_mask_row_count(faces[i]);
+  }
+
+  return count;
+}
+
+#define MakeMeshFaceRowsKernels(name, attributes)                              \
+  attributes static unsigned int mesh_face_rows_##name##_positive(             \
+      const MaskRow *rows, const MaskRow *opaque, bool translucent,            \
+      MaskRow *faces) {                                                        \
+    return mesh_face_rows(rows, opaque, translucent, false, faces);            \
+  }                                                                            \
+                                                                               \
+  attributes static unsigned int mesh_face_rows_##name##_negative(             \
+      const MaskRow *rows, const MaskRow *opaque, bool translucent,            \
+      MaskRow *faces) {                                                        \
+    return mesh_face_rows(rows, opaque, translucent, true, faces);             \
+  }
+
+MakeMeshFaceRowsKernels(generic, );
+
+#if defined(__x86_64__) || defined(__i386__)
+MakeMeshFaceRowsKernels(sse42, __attribute__((target("sse4.2,popcnt"))));
+MakeMeshFaceRowsKernels(avx2, __attribute__((target("avx2,popcnt"))));
+MakeMeshFaceRowsKernels(
+    avx512,
+    __attribute__((target("avx512f,avx512vl,avx512vpopcntdq,popcnt"))));
+#endif
+
+static const MeshFaceRowsKernel mesh_kernels[MESH_KERNEL_ISA_COUNT][2] = {
+    {mesh_face_rows_generic_positive, mesh_face_rows_generic_negative},
+#if defined(__x86_64__) || defined(__i386__)
+    {mesh_face_rows_sse42_positive, mesh_face_rows_sse42_negative},
+    {mesh_face_rows_avx2_positive, mesh_face_rows_avx2_negative},
+    {mesh_face_rows_avx512_positive, mesh_face_rows_avx512_negative},
+#endif
+};
+
+static const char *const mesh_kernel_names[MESH_KERNEL_ISA_COUNT] = {
+    "generic", "sse4.2", "avx2", "avx512"};
+
+static _Atomic MeshKernelIsa mesh_kernel_isa;
+static once_flag mesh_kernel_once = ONCE_FLAG_INIT;
+
+bool mesh_kernel_supported(MeshKernelIsa isa) {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+
+  switch (isa) {
+  case MESH_KERNEL_GENERIC:
+    return true;
+  case MESH_KERNEL_SSE42:
+    return __builtin_cpu_supports("sse4.2") &&
+           __builtin_cpu_supports("popcnt");
+  case MESH_KERNEL_AVX2:
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+  case MESH_KERNEL_AVX512:
+    return __builtin_cpu_supports("avx512f") &&
+           __builtin_cpu_supports("avx512vl") &&
+           __builtin_cpu_supports("avx512vpopcntdq");
+  default:
+    return false;
+  }
+#else
+  return isa == MESH_KERNEL_GENERIC;
+#endif
+}
+
+static void mesh_kernel_init(void) {
+  MeshKernelIsa isa = MESH_KERNEL_GENERIC;
+
+  for (int i = MESH_KERNEL_ISA_COUNT - 1; i >= 0; i--) {
+    if (mesh_kernel_supported(i)) {
+      isa = i;
+      break;
+    }
+  }
+
+  const char *requested = getenv("VOXEL_ISA");
+
+  if (requested != NULL) {
+    for (unsigned int i = 0; i < MESH_KERNEL_ISA_COUNT; i++) {
+      if (strcmp(requested, mesh_kernel_names[i]) == 0 &&
+          mesh_kernel_supported(i)) {
+        isa = i;
+      }
+    }
+  }
+
+  atomic_store(&mesh_kernel_isa, isa);
+}
+
+bool mesh_kernel_select(MeshKernelIsa isa) {
+  call_once(&mesh_kernel_once, mesh_kernel_init);
+
+  if (isa >= MESH_KERNEL_ISA_COUNT || !mesh_kernel_supported(isa)) {
+    return false;
+  }
+
+  atomic_store(&mesh_kernel_isa, isa);
+
+  return true;
+}
+
+MeshKernelIsa mesh_kernel_active(void) {
+  call_once(&mesh_kernel_once, mesh_kernel_init);
+
+  return atomic_load_explicit(&mesh_kernel_isa, memory_order_relaxed);
+}
+
+const char *mesh_kernel_name(MeshKernelIsa isa) {
+  return isa < MESH_KERNEL_ISA_COUNT ? mesh_kernel_names[isa] : "unknown";
+}
+
+unsigned int mesh_kernel_face_rows(const MaskRow *rows, const MaskRow *opaque,
+                                   bool translucent, bool negative,
+                                   MaskRow *faces) {
+  return mesh_kernels[mesh_kernel_active()][negative](rows, opaque,
+                                                      translucent, faces);
+}
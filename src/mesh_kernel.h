@@ -0,0 +1,25 @@
+#pragma once
+
+#include "chunk.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum MeshKernelIsa {
+  MESH_KERNEL_GENERIC,
+  MESH_KERNEL_SSE42,
+  MESH_KERNEL_AVX2,
+  MESH_KERNEL_AVX512,
+  MESH_KERNEL_ISA_COUNT
+} MeshKernelIsa;
+
+bool mesh_kernel_supported(MeshKernelIsa isa);
+
+bool mesh_kernel_select(MeshKernelIsa isa);
+
+MeshKernelIsa mesh_kernel_active(void);
+
+const char *mesh_kernel_name(MeshKernelIsa isa);
+
+unsigned int mesh_kernel_face_rows(const MaskRow *rows, const MaskRow *opaque,
+                                   bool translucent, bool negative,
+                                   MaskRow *faces);
@@ -0,0 +1,112 @@
+#include "mesh_sections.h"
+
+#include <string.h>
+
+#define mesh_sections_quantum 192
+
+void mesh_sections_init(MeshSections *sections, unsigned int capacity) {
+  *sections = (MeshSections){.capacity = capacity};
+}
+
+unsigned int mesh_sections_headroom(unsigned int size) {
+  return (size + size / 2 + mesh_sections_quantum - 1) /
+         mesh_sections_quantum * mesh_sections_quantum;
+}
+
+void mesh_sections_release(MeshSections *sections, unsigned int section) {
+  sections->used -= sections->ranges[section].size;
+  sections->ranges[section].size = 0;
+  sections->opaque[section] = 0;
+}
+
+static unsigned int mesh_sections_sorted(const MeshSections *sections,
+                                         const MeshRange **sorted) {
+  unsigned int count = 0;
+
+  for (unsigned int section = 0; section < mesh_section_count; section++) {
+    const MeshRange *range = &sections->ranges[section];
+
+    if (range->size == 0) {
+      continue;
+    }
+
+    unsigned int index = count++;
+
+    while (index > 0 && sorted[index - 1]->offset > range->offset) {
+      sorted[index] = sorted[index - 1];
+      index--;
+    }
+
+    sorted[index] = range;
+  }
+
+  return count;
+}
+
+bool mesh_sections_place(MeshSections *sections, unsigned int section,
+                         unsigned int size) {
+  MeshRange *range = &sections->ranges[section];
+
+  if (size <= range->size) {
+    sections->used -= range->size - size;
+    range->size = size;
+    return true;
+  }
+
+  mesh_sections_release(sections, section);
+
+  const MeshRange *sorted[mesh_section_count];
+  unsigned int count = mesh_sections_sorted(sections, sorted);
+  unsigned int cursor = 0;
+
+  for (unsigned int i = 0; i <= count; i++) {
+    unsigned int end = i < count ? sorted[i]->offset : sections->capacity;
+
+    if (end - cursor >= size) {
+      *range = (MeshRange){.offset = cursor, .size = size};
+      sections->used += size;
+      return true;
+    }
+
+    if (i < count) {
+      cursor = sorted[i]->offset + sorted[i]->size;
+    }
+  }
+
+  return false;
+}
+
+void mesh_sections_compact(MeshSections *sections, unsigned int capacity,
+                           MeshRange *previous) {
+  unsigned int cursor = 0;
+
+  memcpy(previous, sections->ranges, sizeof(sections->ranges));
+
+  for (unsigned int section = 0; section < mesh_section_count; section++) {
+    MeshRange *range = &sections->ranges[section];
+
+    range->offset = range->size != 0 ? cursor : 0;
+    cursor += range->size;
+  }
+
+  sections->capacity = capacity;
+}
+
+bool mesh_sections_valid(const MeshSections *sections) {
+  const MeshRange *sorted[mesh_section_count];
+  unsigned int count = mesh_sections_sorted(sections, sorted);
+  unsigned int used = 0;
+
+  for (unsigned int i = 0; i < count; i++) {
+    unsigned int end = sorted[i]->offset + sorted[i]->size;
+
+    if (end > sections->capacity ||
+        (i + 1 < count && end > sorted[i + 1]->offset)) {
+      return false;
+    }
+
+    used += sorted[i]->size;
+  }
+
+  return used == sections->used;
+}
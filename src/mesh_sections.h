@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define mesh_section_count 8
+#define mesh_sections_all ((uint8_t)((1 << mesh_section_count) - 1))
+
+typedef struct MeshRange {
+  unsigned int offset;
+  unsigned int size;
+} MeshRange;
+
+typedef struct MeshSections {
+  unsigned int capacity;
+  unsigned int used;
+  MeshRange ranges[mesh_section_count];
+  unsigned int opaque[mesh_section_count];
+} MeshSections;
+
+void mesh_sections_init(MeshSections *sections, unsigned int capacity);
+
+unsigned int mesh_sections_headroom(unsigned int size);
+
+void mesh_sections_release(MeshSections *sections, unsigned int section);
+
+bool mesh_sections_place(MeshSections *sections, unsigned int section,
+                         unsigned int size);
+
+void mesh_sections_compact(MeshSections *sections, unsigned int capacity,
+                           MeshRange *previous);
+
+bool mesh_sections_valid(const MeshSections *sections);
@@ -0,0 +1,401 @@
+#include "metrics.h"
+
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <threads.h>
+#include <time.h>
+
+#define metrics_thread_capacity 64
+
+typedef struct MetricsThread {
+  alignas(64) atomic_bool claimed;
+  _Atomic uint64_t counters[METRIC_COUNTER_COUNT];
+  _Atomic uint64_t timer_counts[METRIC_TIMER_COUNT];
+  _Atomic uint64_t timer_totals[METRIC_TIMER_COUNT];
+  _Atomic uint64_t timer_maxima[METRIC_TIMER_COUNT];
+  _Atomic uint64_t timer_buckets[METRIC_TIMER_COUNT][metrics_bucket_count];
+} MetricsThread;
+
+typedef struct MetricsOutput {
+  FILE *file;
+  MetricsFormat format;
+  uint64_t interval;
+  uint64_t next_time;
+  bool header;
+} MetricsOutput;
+
+static MetricsThread metrics_threads[metrics_thread_capacity];
+static _Atomic int64_t metrics_gauges[METRIC_GAUGE_COUNT];
+static uint64_t metrics_start;
+static MetricsOutput metrics_output;
+static tss_t metrics_slot_key;
+static once_flag metrics_once = ONCE_FLAG_INIT;
+
+static const char *const metric_counter_names[METRIC_COUNTER_COUNT] = {
+    "chunks_generated", "chunks_meshed",  "faces_emitted",
+    "bytes_uploaded",   "draw_calls",     "empty_views",
+    "meshes_avoided",   "stale_dropped",  "fluid_cells"};
+
+static const char *const metric_timer_names[METRIC_TIMER_COUNT] = {
+    "chunk_generate", "chunk_light",  "chunk_mask",  "chunk_mesh",
+    "chunk_upload",   "world_load",   "world_render", "fluid_tick"};
+
+static const char *const metric_gauge_names[METRIC_GAUGE_COUNT] = {
+    "mesh_queue", "light_queue", "epoch_pending"};
+
+uint64_t metrics_now(void) {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+
+  return (uint64_t)time.tv_sec * 1000000000 + time.tv_nsec;
+}
+
+static void metrics_slot_release(void *data) {
+  MetricsThread *thread = data;
+  atomic_store(&thread->claimed, false);
+}
+
+static void metrics_init(void) {
+  metrics_start = metrics_now();
+  tss_create(&metrics_slot_key, metrics_slot_release);
+}
+
+static MetricsThread *metrics_thread(void) {
+  call_once(&metrics_once, metrics_init);
+
+  MetricsThread *thread = tss_get(metrics_slot_key);
+
+  if (thread != NULL) {
+    return thread;
+  }
+
+  for (unsigned int i = 0; i < metrics_thread_capacity; i++) {
+    bool claimed = false;
+
+    if (atomic_compare_exchange_strong(&metrics_threads[i].claimed, &claimed,
+                                       true)) {
+      tss_set(metrics_slot_key, &metrics_threads[i]);
+      return &metrics_threads[i];
+    }
+  }
+
+  return &metrics_threads[metrics_thread_capacity - 1];
+}
+
+void metrics_add(MetricCounter counter, uint64_t value) {
+  atomic_fetch_add_explicit(&metrics_thread()->counters[counter], value,
+                            memory_order_relaxed);
+}
+
+void metrics_set(MetricGauge gauge, int64_t value) {
+  atomic_store_explicit(&metrics_gauges[gauge], value, memory_order_relaxed);
+}
+
+void metrics_record(MetricTimer timer, uint64_t nanoseconds) {
+  MetricsThread *thread = metrics_thread();
+
+  unsigned int bucket =
+      nanoseconds != 0 ? 64 - __builtin_clzll(nanoseconds) : 0;
+
+  if (bucket >= metrics_bucket_count) {
+    bucket = metrics_bucket_count - 1;
+  }
+
+  atomic_fetch_add_explicit(&thread->timer_counts[timer], 1,
+                            memory_order_relaxed);
+  atomic_fetch_add_explicit(&thread->timer_totals[timer], nanoseconds,
+                            memory_order_relaxed);
+  atomic_fetch_add_explicit(&thread->timer_buckets[timer][bucket], 1,
+                            memory_order_relaxed);
+
+  uint64_t maximum =
+      atomic_load_explicit(&thread->timer_maxima[timer], memory_order_relaxed);
+
+  while (nanoseconds > maximum &&
+         !atomic_compare_exchange_weak_explicit(
+             &thread->timer_maxima[timer], &maximum, nanoseconds,
+             memory_order_relaxed, memory_order_relaxed)) {
+  }
+}
+
+void metrics_snapshot(MetricsSnapshot *snapshot) {
+  call_once(&metrics_once, metrics_init);
+
+  memset(snapshot, 0, sizeof(MetricsSnapshot));
+  snapshot->time = (metrics_now() - metrics_start) / 1e9;
+
+  for (unsigned int i = 0; i < metrics_thread_capacity; i++) {
+    MetricsThread *thread = &metrics_threads[i];
+
+    for (unsigned int j = 0; j < METRIC_COUNTER_COUNT; j++) {
+      snapshot->counters[j] += atomic_load_explicit(&thread->counters[j],
+                                                    memory_order_relaxed);
+    }
+
+    for (unsigned int j = 0; j < METRIC_TIMER_COUNT; j++) {
+      MetricHistogram *histogram = &snapshot->timers[j];
+      uint64_t maximum = atomic_load_explicit(&thread->timer_maxima[j],
+                                              memory_order_relaxed);
+
+      histogram->count += atomic_load_explicit(&thread->timer_counts[j],
+                                               memory_order_relaxed);
+      histogram->total += atomic_load_explicit(&thread->timer_totals[j],
+                                               memory_order_relaxed);
+      histogram->max = maximum > histogram->max ? maximum : histogram->max;
+
+      for (unsigned int k = 0; k < metrics_bucket_count; k++) {
+        histogram->buckets[k] += atomic_load_explicit(
+            &thread->timer_buckets[j][k], memory_order_relaxed);
+      }
+    }
+  }
+
+  for (unsigned int i = 0; i < METRIC_GAUGE_COUNT; i++) {
+    snapshot->gauges[i] =
+        atomic_load_explicit(&metrics_gauges[i], memory_order_relaxed);
+  }
+}
+
+void metrics_reset(void) {
+  for (unsigned int i = 0; i < metrics_thread_capacity; i++) {
+    MetricsThread *thread = &metrics_threads[i];
+
+    for (unsigned int j = 0; j < METRIC_COUNTER_COUNT; j++) {
+      atomic_store_explicit(&thread->counters[j], 0, memory_order_relaxed);
+    }
+
+    for (unsigned int j = 0; j < METRIC_TIMER_COUNT; j++) {
+      atomic_store_explicit(&thread->timer_counts[j], 0, memory_order_relaxed);
+      atomic_store_explicit(&thread->timer_totals[j], 0, memory_order_relaxed);
+      atomic_store_explicit(&thread->timer_maxima[j], 0, memory_order_relaxed);
+
+      for (unsigned int k = 0; k < metrics_bucket_count; k++) {
+        atomic_store_explicit(&thread->timer_buckets[j][k], 0,
+                              memory_order_relaxed);
+      }
+    }
+  }
+}
+
+double metrics_histogram_percentile(const MetricHistogram *histogram,
+                                    double percentile) {
+  if (histogram->count == 0) {
+    return 0;
+  }
+
+  uint64_t target = percentile * histogram->count;
+  uint64_t count = 0;
+
+  for (unsigned int i = 0; i < metrics_bucket_count; i++) {
+    count += histogram->buckets[i];
+
+    if (count > target) {
+      double upper = i != 0 ? (double)(1ull << i) : 1;
+      return upper < histogram->max ? upper : histogram->max;
+    }
+  }
+
+  return histogram->max;
+}
+
+static void metrics_histogram_summary(const MetricHistogram *histogram,
+                                      double summary[5]) {
+  summary[0] =
+      histogram->count != 0 ? histogram->total / 1e6 / histogram->count : 0;
+  summary[1] = metrics_histogram_percentile(histogram, 0.5) / 1e6;
+  summary[2] = metrics_histogram_percentile(histogram, 0.99) / 1e6;
+  summary[3] = histogram->max / 1e6;
+  summary[4] = histogram->total / 1e6;
+}
+
+static void metrics_write_text(FILE *file, const MetricsSnapshot *snapshot) {
+  fprintf(file, "metrics at %.3f s\n", snapshot->time);
+
+  for (unsigned int i = 0; i < METRIC_COUNTER_COUNT; i++) {
+    fprintf(file, "  %-16s %llu\n", metric_counter_names[i],
+            (unsigned long long)snapshot->counters[i]);
+  }
+
+  for (unsigned int i = 0; i < METRIC_GAUGE_COUNT; i++) {
+    fprintf(file, "  %-16s %lld\n", metric_gauge_names[i],
+            (long long)snapshot->gauges[i]);
+  }
+
+  for (unsigned int i = 0; i < METRIC_TIMER_COUNT; i++) {
+    double summary[5];
+    metrics_histogram_summary(&snapshot->timers[i], summary);
+
+    fprintf(file,
+            "  %-16s %8llu calls, mean %.3f ms, p50 %.3f ms, p99 %.3f ms, "
+            "max %.3f ms\n",
+            metric_timer_names[i],
+            (unsigned long long)snapshot->timers[i].count, summary[0],
+            summary[1], summary[2], summary[3]);
+  }
+}
+
+static void metrics_write_json(FILE *file, const MetricsSnapshot *snapshot) {
+  fprintf(file, "{\"time\":%.6f,\"counters\":{", snapshot->time);
+
+  for (unsigned int i = 0; i < METRIC_COUNTER_COUNT; i++) {
+    fprintf(file, "%s\"%s\":%llu", i != 0 ? "," : "", metric_counter_names[i],
+            (unsigned long long)snapshot->counters[i]);
+  }
+
+  fprintf(file, "},\"gauges\":{");
+
+  for (unsigned int i = 0; i < METRIC_GAUGE_COUNT; i++) {
+    fprintf(file, "%s\"%s\":%lld", i != 0 ? "," : "", metric_gauge_names[i],
+            (long long)snapshot->gauges[i]);
+  }
+
+  fprintf(file, "},\"timers\":{");
+
+  for (unsigned int i = 0; i < METRIC_TIMER_COUNT; i++) {
+    double summary[5];
+    metrics_histogram_summary(&snapshot->timers[i], summary);
+
+    fprintf(file,
+            "%s\"%s\":{\"count\":%llu,\"mean_ms\":%.6f,\"p50_ms\":%.6f,"
+            "\"p99_ms\":%.6f,\"max_ms\":%.6f,\"total_ms\":%.6f}",
+            i != 0 ? "," : "", metric_timer_names[i],
+            (unsigned long long)snapshot->timers[i].count, summary[0],
+            summary[1], summary[2], summary[3], summary[4]);
+  }
+
+  fprintf(file, "}}\n");
+}
+
+static void metrics_write_csv(FILE *file, const MetricsSnapshot *snapshot,
+                              bool header) {
+  static const char *const summary_names[5] = {"mean_ms", "p50_ms", "p99_ms",
+                                               "max_ms", "total_ms"};
+
+  if (header) {
+    fprintf(file, "time");
+
+    for (unsigned int i = 0; i < METRIC_COUNTER_COUNT; i++) {
+      fprintf(file, ",%s", metric_counter_names[i]);
+    }
+
+    for (unsigned int i = 0; i < METRIC_GAUGE_COUNT; i++) {
+      fprintf(file, ",%s", metric_gauge_names[i]);
+    }
+
+    for (unsigned int i = 0; i < METRIC_TIMER_COUNT; i++) {
+      fprintf(file, ",%s_count", metric_timer_names[i]);
+
+      for (unsigned int j = 0; j < 5; j++) {
+        fprintf(file, ",%s_%s", metric_timer_names[i], summary_names[j]);
+      }
+    }
+
+    fprintf(file, "\n");
+  }
+
+  fprintf(file, "%.6f", snapshot->time);
+
+  for (unsigned int i = 0; i < METRIC_COUNTER_COUNT; i++) {
+    fprintf(file, ",%llu", (unsigned long long)snapshot->counters[i]);
+  }
+
+  for (unsigned int i = 0; i < METRIC_GAUGE_COUNT; i++) {
+    fprintf(file, ",%lld", (long long)snapshot->gauges[i]);
+  }
+
+  for (unsigned int i = 0; i < METRIC_TIMER_COUNT; i++) {
+    double summary[5];
+    metrics_histogram_summary(&snapshot->timers[i], summary);
+
+    fprintf(file, ",%llu", (unsigned long long)snapshot->timers[i].count);
+
+    for (unsigned int j = 0; j < 5; j++) {
+      fprintf(file, ",%.6f", summary[j]);
+    }
+  }
+
+  fprintf(file, "\n");
+}
+
+void metrics_write(FILE *file, const MetricsSnapshot *snapshot,
+                   MetricsFormat format, bool header) {
+  switch (format) {
+  case METRICS_FORMAT_TEXT:
+    metrics_write_text(file, snapshot);
+    break;
+  case METRICS_FORMAT_JSON:
+    metrics_write_json(file, snapshot);
+    break;
+  case METRICS_FORMAT_CSV:
+    metrics_write_csv(file, snapshot, header);
+    break;
+  }
+
+  fflush(file);
+}
+
+bool metrics_open(const char *target, double interval) {
+  metrics_close();
+
+  MetricsFormat format = METRICS_FORMAT_JSON;
+  const char *extension = strrchr(target, '.');
+
+  if (strcmp(target, "-") == 0) {
+    format = METRICS_FORMAT_TEXT;
+  } else if (extension != NULL && strcmp(extension, ".csv") == 0) {
+    format = METRICS_FORMAT_CSV;
+  }
+
+  FILE *file = format == METRICS_FORMAT_TEXT ? stdout : fopen(target, "wt");
+
+  if (file == NULL) {
+    return false;
+  }
+
+  metrics_output = (MetricsOutput){.file = file,
+                                   .format = format,
+                                   .interval = interval * 1e9,
+                                   .next_time = metrics_now() + interval * 1e9,
+                                   .header = true};
+
+  return true;
+}
+
+static void metrics_output_write(void) {
+  MetricsSnapshot snapshot;
+  metrics_snapshot(&snapshot);
+
+  metrics_write(metrics_output.file, &snapshot, metrics_output.format,
+                metrics_output.header);
+  metrics_output.header = false;
+}
+
+void metrics_tick(void) {
+  if (metrics_output.file == NULL) {
+    return;
+  }
+
+  uint64_t now = metrics_now();
+
+  if (now < metrics_output.next_time) {
+    return;
+  }
+
+  metrics_output.next_time = now + metrics_output.interval;
+  metrics_output_write();
+}
+
+void metrics_close(void) {
+  if (metrics_output.file == NULL) {
+    return;
+  }
+
+  metrics_output_write();
+
+  if (metrics_output.file != stdout) {
+    fclose(metrics_output.file);
+  }
+
+  metrics_output = (MetricsOutput){0};
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define metrics_bucket_count 40
+
+typedef enum MetricCounter {
+  METRIC_CHUNKS_GENERATED,
+  METRIC_CHUNKS_MESHED,
+  METRIC_FACES_EMITTED,
+  METRIC_BYTES_UPLOADED,
+  METRIC_DRAW_CALLS,
+  METRIC_EMPTY_VIEWS,
+  METRIC_MESHES_AVOIDED,
+  METRIC_STALE_DROPPED,
+  METRIC_FLUID_CELLS,
+  METRIC_COUNTER_COUNT
+} MetricCounter;
+
+typedef enum MetricTimer {
+  METRIC_CHUNK_GENERATE,
+  METRIC_CHUNK_LIGHT,
+  METRIC_CHUNK_MASK,
+  METRIC_CHUNK_MESH,
+  METRIC_CHUNK_UPLOAD,
+  METRIC_WORLD_LOAD,
+  METRIC_WORLD_RENDER,
+  METRIC_FLUID_TICK,
+  METRIC_TIMER_COUNT
+} MetricTimer;
+
+typedef enum MetricGauge {
+  METRIC_MESH_QUEUE,
+  METRIC_LIGHT_QUEUE,
+  METRIC_EPOCH_PENDING,
+  METRIC_GAUGE_COUNT
+} MetricGauge;
+
+typedef enum MetricsFormat {
+  METRICS_FORMAT_TEXT,
+  METRICS_FORMAT_JSON,
+  METRICS_FORMAT_CSV
+} MetricsFormat;
+
+typedef struct MetricHistogram {
+  uint64_t count;
+  uint64_t total;
+  uint64_t max;
+  uint64_t buckets[metrics_bucket_count];
+} MetricHistogram;
+
+typedef struct MetricsSnapshot {
+  double time;
+  uint64_t counters[METRIC_COUNTER_COUNT];
+  int64_t gauges[METRIC_GAUGE_COUNT];
+  MetricHistogram timers[METRIC_TIMER_COUNT];
+} MetricsSnapshot;
+
+uint64_t metrics_now(void);
+
+void metrics_add(MetricCounter counter, uint64_t value);
+
+void metrics_set(MetricGauge gauge, int64_t value);
+
+void metrics_record(MetricTimer timer, uint64_t nanoseconds);
+
+void metrics_snapshot(MetricsSnapshot *snapshot);
+
+void metrics_reset(void);
+
+double metrics_histogram_percentile(const MetricHistogram *histogram,
+                                    double percentile);
+
+void metrics_write(FILE *file, const MetricsSnapshot *snapshot,
+                   MetricsFormat format, bool header);
+
+bool metrics_open(const char *target, double interval);
+
+void metrics_tick(void);
+
+void metrics_close(void);
@@ -0,0 +1,1119 @@
+#include "path.h"
+
+#include "math_util.h"
+#include "tracy/TracyC.h"
+#include "world.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define path_window_volume                                                     \
+  (render_distance * render_distance * render_distance)
+#define path_column_count (chunk_size * chunk_size)
+#define path_move_count 12
+#define path_no_cell UINT32_MAX
+#define path_no_key UINT32_MAX
+#define path_goal_key (UINT32_MAX - 1)
+#define path_portal_bits 16
+#define path_portal_capacity (1 << path_portal_bits)
+#define path_node_capacity 1024
+#define path_rebuild_batch_size 4
+
+MakeVectorDefinition(PathStep);
+
+typedef struct PathTransition {
+  uint32_t cell;
+  Vec3i block;
+  Vec3i target;
+  unsigned int offset;
+  unsigned int root;
+} PathTransition;
+
+typedef struct PathBuild {
+  const ChunkRow *rows[27];
+} PathBuild;
+
+typedef struct PathBatch {
+  PathGraph *graph;
+  PathQuery *queries;
+} PathBatch;
+
+static const int path_directions[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+
+static unsigned int path_slot(const Vec3i position) {
+  return (mod(position[0], render_distance) * render_distance +
+          mod(position[1], render_distance)) *
+             render_distance +
+         mod(position[2], render_distance);
+}
+
+static void path_move_offset(unsigned int move, int *offset) {
+  offset[0] = path_directions[move / 3][0];
+  offset[1] = (int)(move % 3) - 1;
+  offset[2] = path_directions[move / 3][1];
+}
+
+static bool path_solid(const PathBuild *build, int x, int y, int z) {
+  int local[3] = {x, y, z};
+  unsigned int index = 0;
+
+  for (unsigned int axis = 0; axis < 3; axis++) {
+    int side = local[axis] < 0 ? 0 : local[axis] >= chunk_size ? 2 : 1;
+
+    index = index * 3 + side;
+    local[axis] -= (side - 1) * chunk_size;
+  }
+
+  const ChunkRow *rows = build->rows[index];
+
+  return rows == NULL || rows[local[1] * chunk_size + local[2]] >> local[0] & 1;
+}
+
+static bool path_walkable(const PathBuild *build, int x, int y, int z) {
+  return path_solid(build, x, y - 1, z) && !path_solid(build, x, y, z) &&
+         !path_solid(build, x, y + 1, z);
+}
+
+static bool path_move_valid(const PathBuild *build, int x, int y, int z,
+                            unsigned int move) {
+  int offset[3];
+  path_move_offset(move, offset);
+
+  int target_x = x + offset[0];
+  int target_y = y + offset[1];
+  int target_z = z + offset[2];
+
+  if (!path_walkable(build, target_x, target_y, target_z)) {
+    return false;
+  }
+
+  if (offset[1] > 0) {
+    return !path_solid(build, x, y + 2, z);
+  }
+
+  if (offset[1] < 0) {
+    return !path_solid(build, target_x, target_y + 2, target_z);
+  }
+
+  return true;
+}
+
+static ChunkRow path_row(const PathBuild *build, int y, int z) {
+  unsigned int side = y < 0 ? 0 : y >= chunk_size ? 2 : 1;
+  const ChunkRow *rows = build->rows[(3 + side) * 3 + 1];
+
+  if (rows == NULL) {
+    return chunk_row_full;
+  }
+
+  return rows[mod(y, chunk_size) * chunk_size + z];
+}
+
+static uint32_t path_chunk_cell(const PathChunk *path_chunk, int x, int y,
+                                int z) {
+  if (path_chunk->columns == NULL || x < 0 || x >= chunk_size || y < 0 ||
+      y >= chunk_size || z < 0 || z >= chunk_size) {
+    return path_no_cell;
+  }
+
+  unsigned int column = x + z * chunk_size;
+
+  for (uint32_t i = path_chunk->columns[column];
+       i < path_chunk->columns[column + 1]; i++) {
+    if (path_chunk->cells[i].y == y) {
+      return i;
+    }
+  }
+
+  return path_no_cell;
+}
+
+static uint32_t path_chunk_neighbour(const PathChunk *path_chunk,
+                                     uint32_t index, unsigned int move) {
+  const PathCell *cell = &path_chunk->cells[index];
+  int offset[3];
+  path_move_offset(move, offset);
+
+  return path_chunk_cell(path_chunk, cell->x + offset[0], cell->y + offset[1],
+                         cell->z + offset[2]);
+}
+
+static void path_cell_block(const PathChunk *path_chunk, uint32_t index,
+                            Vec3i block) {
+  const PathCell *cell = &path_chunk->cells[index];
+
+  block[0] = path_chunk->position[0] * chunk_size + cell->x;
+  block[1] = path_chunk->position[1] * chunk_size + cell->y;
+  block[2] = path_chunk->position[2] * chunk_size + cell->z;
+}
+
+static unsigned int path_estimate(const Vec3i from, const Vec3i to) {
+  unsigned int horizontal = abs(from[0] - to[0]) + abs(from[2] - to[2]);
+  unsigned int vertical = abs(from[1] - to[1]);
+
+  return horizontal > vertical ? horizontal : vertical;
+}
+
+static void path_chunk_clear(PathChunk *path_chunk) {
+  free(path_chunk->columns);
+  free(path_chunk->cells);
+  free(path_chunk->portals);
+  free(path_chunk->distances);
+
+  path_chunk->columns = NULL;
+  path_chunk->cells = NULL;
+  path_chunk->cell_count = 0;
+  path_chunk->region_count = 0;
+  path_chunk->portals = NULL;
+  path_chunk->portal_count = 0;
+  path_chunk->distances = NULL;
+}
+
+static void path_build_rows(const PathGraph *graph, const Vec3i position,
+                            PathBuild *build) {
+  unsigned int index = 0;
+
+  for (int x = -1; x <= 1; x++) {
+    for (int y = -1; y <= 1; y++) {
+      for (int z = -1; z <= 1; z++) {
+        Vec3i neighbour_position;
+        vec3i_add(neighbour_position, position, (Vec3i){x, y, z});
+
+        const Chunk *neighbour =
+            world_get_loaded_chunk(graph->world, neighbour_position);
+
+        build->rows[index++] = neighbour != NULL ? neighbour->solid_rows : NULL;
+      }
+    }
+  }
+}
+
+static void path_chunk_find_cells(PathChunk *path_chunk,
+                                  const PathBuild *build) {
+  ChunkRow walkable[chunk_size * chunk_size];
+  unsigned int count = 0;
+
+  for (int y = 0; y < chunk_size; y++) {
+    for (int z = 0; z < chunk_size; z++) {
+      ChunkRow row = path_row(build, y - 1, z) & ~path_row(build, y, z) &
+                     ~path_row(build, y + 1, z);
+
+      walkable[y * chunk_size + z] = row;
+      count += __builtin_popcountll(row);
+    }
+  }
+
+  if (count == 0) {
+    return;
+  }
+
+  path_chunk->columns = malloc(sizeof(uint32_t) * (path_column_count + 1));
+  path_chunk->cells = malloc(sizeof(PathCell) * count);
+
+  for (int z = 0; z < chunk_size; z++) {
+    for (int x = 0; x < chunk_size; x++) {
+      path_chunk->columns[x + z * chunk_size] = path_chunk->cell_count;
+
+      for (int y = 0; y < chunk_size; y++) {
+        if (walkable[y * chunk_size + z] >> x & 1) {
+          path_chunk->cells[path_chunk->cell_count++] =
+              (PathCell){.x = x, .y = y, .z = z};
+        }
+      }
+    }
+  }
+
+  path_chunk->columns[path_column_count] = path_chunk->cell_count;
+
+  for (unsigned int i = 0; i < path_chunk->cell_count; i++) {
+    PathCell *cell = &path_chunk->cells[i];
+
+    for (unsigned int move = 0; move < path_move_count; move++) {
+      if (path_move_valid(build, cell->x, cell->y, cell->z, move)) {
+        cell->moves |= 1 << move;
+      }
+    }
+  }
+}
+
+static void path_chunk_find_regions(PathChunk *path_chunk, uint32_t *queue) {
+  for (unsigned int i = 0; i < path_chunk->cell_count; i++) {
+    path_chunk->cells[i].region = UINT32_MAX;
+  }
+
+  for (unsigned int seed = 0; seed < path_chunk->cell_count; seed++) {
+    if (path_chunk->cells[seed].region != UINT32_MAX) {
+      continue;
+    }
+
+    uint32_t region = path_chunk->region_count++;
+    unsigned int head = 0;
+    unsigned int tail = 0;
+
+    path_chunk->cells[seed].region = region;
+    queue[tail++] = seed;
+
+    while (head != tail) {
+      uint32_t index = queue[head++];
+      uint16_t moves = path_chunk->cells[index].moves;
+
+      for (unsigned int move = 0; move < path_move_count; move++) {
+        if (!(moves >> move & 1)) {
+          continue;
+        }
+
+        uint32_t neighbour = path_chunk_neighbour(path_chunk, index, move);
+
+        if (neighbour != path_no_cell &&
+            path_chunk->cells[neighbour].region == UINT32_MAX) {
+          path_chunk->cells[neighbour].region = region;
+          queue[tail++] = neighbour;
+        }
+      }
+    }
+  }
+}
+
+static unsigned int path_transition_root(PathTransition *transitions,
+                                         unsigned int index) {
+  while (transitions[index].root != index) {
+    transitions[index].root = transitions[transitions[index].root].root;
+    index = transitions[index].root;
+  }
+
+  return index;
+}
+
+static int path_block_compare(const int *a, const int *b) {
+  for (unsigned int axis = 0; axis < 3; axis++) {
+    if (a[axis] != b[axis]) {
+      return (a[axis] > b[axis]) - (a[axis] < b[axis]);
+    }
+  }
+
+  return 0;
+}
+
+static int path_transition_compare(const void *a, const void *b) {
+  const PathTransition *transition_a = a;
+  const PathTransition *transition_b = b;
+
+  if (transition_a->root != transition_b->root) {
+    return (transition_a->root > transition_b->root) -
+           (transition_a->root < transition_b->root);
+  }
+
+  bool forward_a =
+      path_block_compare(transition_a->block, transition_a->target) < 0;
+  bool forward_b =
+      path_block_compare(transition_b->block, transition_b->target) < 0;
+  const int *low_a = forward_a ? transition_a->block : transition_a->target;
+  const int *low_b = forward_b ? transition_b->block : transition_b->target;
+  const int *high_a = forward_a ? transition_a->target : transition_a->block;
+  const int *high_b = forward_b ? transition_b->target : transition_b->block;
+  int order = path_block_compare(low_a, low_b);
+
+  return order != 0 ? order : path_block_compare(high_a, high_b);
+}
+
+static bool path_targets_linked(const PathChunk *path_chunk,
+                                const PathBuild *build, const int *from,
+                                const int *to) {
+  int local[3];
+
+  for (unsigned int axis = 0; axis < 3; axis++) {
+    local[axis] = from[axis] - path_chunk->position[axis] * chunk_size;
+  }
+
+  for (unsigned int move = 0; move < path_move_count; move++) {
+    int offset[3];
+    path_move_offset(move, offset);
+
+    if (from[0] + offset[0] == to[0] && from[1] + offset[1] == to[1] &&
+        from[2] + offset[2] == to[2]) {
+      return path_move_valid(build, local[0], local[1], local[2], move);
+    }
+  }
+
+  return false;
+}
+
+static void path_chunk_find_portals(PathChunk *path_chunk,
+                                    const PathBuild *build) {
+  unsigned int capacity = 0;
+  unsigned int count = 0;
+  PathTransition *transitions = NULL;
+
+  for (unsigned int i = 0; i < path_chunk->cell_count; i++) {
+    const PathCell *cell = &path_chunk->cells[i];
+
+    for (unsigned int move = 0; move < path_move_count; move++) {
+      int offset[3];
+      path_move_offset(move, offset);
+
+      int target[3] = {cell->x + offset[0], cell->y + offset[1],
+                       cell->z + offset[2]};
+
+      if (!(cell->moves >> move & 1) ||
+          path_chunk_cell(path_chunk, target[0], target[1], target[2]) !=
+              path_no_cell) {
+        continue;
+      }
+
+      if (count == capacity) {
+        capacity = capacity != 0 ? capacity * 2 : 64;
+        transitions = realloc(transitions, sizeof(PathTransition) * capacity);
+      }
+
+      PathTransition *transition = &transitions[count];
+      transition->cell = i;
+      transition->offset = 0;
+      transition->root = count++;
+      path_cell_block(path_chunk, i, transition->block);
+
+      for (unsigned int axis = 0; axis < 3; axis++) {
+        int side = target[axis] < 0 ? 0 : target[axis] >= chunk_size ? 2 : 1;
+
+        transition->offset = transition->offset * 3 + side;
+        transition->target[axis] =
+            path_chunk->position[axis] * chunk_size + target[axis];
+      }
+    }
+  }
+
+  if (count == 0) {
+    return;
+  }
+
+  uint32_t *first = malloc(sizeof(uint32_t) * path_chunk->cell_count);
+  uint32_t *next = malloc(sizeof(uint32_t) * count);
+  memset(first, 0xff, sizeof(uint32_t) * path_chunk->cell_count);
+
+  for (unsigned int i = 0; i < count; i++) {
+    next[i] = first[transitions[i].cell];
+    first[transitions[i].cell] = i;
+  }
+
+  for (unsigned int i = 0; i < count; i++) {
+    const PathTransition *transition = &transitions[i];
+    uint16_t moves = path_chunk->cells[transition->cell].moves;
+
+    for (unsigned int move = 0; move < path_move_count; move++) {
+      uint32_t neighbour =
+          moves >> move & 1
+              ? path_chunk_neighbour(path_chunk, transition->cell, move)
+              : path_no_cell;
+
+      if (neighbour == path_no_cell) {
+        continue;
+      }
+
+      for (uint32_t j = first[neighbour]; j != UINT32_MAX; j = next[j]) {
+        if (transitions[j].offset == transition->offset &&
+            path_targets_linked(path_chunk, build, transition->target,
+                                transitions[j].target)) {
+          transitions[path_transition_root(transitions, j)].root =
+              path_transition_root(transitions, i);
+        }
+      }
+    }
+  }
+
+  free(next);
+  free(first);
+
+  for (unsigned int i = 0; i < count; i++) {
+    transitions[i].root = path_transition_root(transitions, i);
+  }
+
+  qsort(transitions, count, sizeof(PathTransition), path_transition_compare);
+
+  path_chunk->portals = malloc(sizeof(PathPortal) * count);
+
+  for (unsigned int begin = 0; begin < count;) {
+    unsigned int end = begin + 1;
+
+    while (end < count && transitions[end].root == transitions[begin].root) {
+      end++;
+    }
+
+    if (path_chunk->portal_count < path_portal_capacity) {
+      const PathTransition *transition = &transitions[(begin + end - 1) / 2];
+      PathPortal *portal = &path_chunk->portals[path_chunk->portal_count++];
+
+      vec3i_copy(portal->block, transition->block);
+      vec3i_copy(portal->target, transition->target);
+      portal->cell = transition->cell;
+      portal->region = path_chunk->cells[transition->cell].region;
+    }
+
+    begin = end;
+  }
+
+  free(transitions);
+}
+
+static void path_chunk_find_distances(PathChunk *path_chunk, uint32_t *queue,
+                                      uint32_t *costs) {
+  unsigned int portal_count = path_chunk->portal_count;
+
+  if (portal_count == 0) {
+    return;
+  }
+
+  path_chunk->distances =
+      malloc(sizeof(uint32_t) * portal_count * portal_count);
+
+  for (unsigned int from = 0; from < portal_count; from++) {
+    const PathPortal *portal = &path_chunk->portals[from];
+    unsigned int head = 0;
+    unsigned int tail = 0;
+
+    memset(costs, 0xff, sizeof(uint32_t) * path_chunk->cell_count);
+    costs[portal->cell] = 0;
+    queue[tail++] = portal->cell;
+
+    while (head != tail) {
+      uint32_t index = queue[head++];
+      uint16_t moves = path_chunk->cells[index].moves;
+
+      for (unsigned int move = 0; move < path_move_count; move++) {
+        uint32_t neighbour =
+            moves >> move & 1 ? path_chunk_neighbour(path_chunk, index, move)
+                              : path_no_cell;
+
+        if (neighbour != path_no_cell && costs[neighbour] == path_unreachable) {
+          costs[neighbour] = costs[index] + 1;
+          queue[tail++] = neighbour;
+        }
+      }
+    }
+
+    for (unsigned int to = 0; to < portal_count; to++) {
+      path_chunk->distances[from * portal_count + to] =
+          costs[path_chunk->portals[to].cell];
+    }
+  }
+}
+
+static void path_chunk_build(PathGraph *graph, unsigned int slot) {
+  PathChunk *path_chunk = &graph->chunks[slot];
+  PathBuild build;
+
+  path_chunk_clear(path_chunk);
+  path_build_rows(graph, path_chunk->position, &build);
+  path_chunk_find_cells(path_chunk, &build);
+
+  if (path_chunk->cell_count == 0) {
+    return;
+  }
+
+  uint32_t *queue = malloc(sizeof(uint32_t) * path_chunk->cell_count * 2);
+
+  path_chunk_find_regions(path_chunk, queue);
+  path_chunk_find_portals(path_chunk, &build);
+  path_chunk_find_distances(path_chunk, queue,
+                            queue + path_chunk->cell_count);
+
+  free(queue);
+}
+
+static void path_rebuild_range(void *data, unsigned int begin,
+                               unsigned int end) {
+  PathGraph *graph = data;
+
+  for (unsigned int i = begin; i < end; i++) {
+    path_chunk_build(graph, graph->rebuild[i]);
+  }
+}
+
+void path_graph_init(PathGraph *graph, World *world,
+                     unsigned int thread_count) {
+  graph->world = world;
+  graph->chunks = calloc(path_window_volume, sizeof(PathChunk));
+  graph->rebuild = malloc(sizeof(unsigned int) * path_window_volume);
+  graph->search = (PathSearch){0};
+  graph->stats = (PathStats){0};
+
+  thread_pool_init(&graph->pool, thread_count);
+}
+
+static void path_graph_mark(PathGraph *graph, const Vec3i position) {
+  PathChunk *path_chunk = &graph->chunks[path_slot(position)];
+
+  if (path_chunk->loaded && vec3i_compare(path_chunk->position, position)) {
+    path_chunk->dirty = true;
+  }
+}
+
+static void path_graph_mark_around(PathGraph *graph, const Vec3i position) {
+  for (int x = -1; x <= 1; x++) {
+    for (int y = -1; y <= 1; y++) {
+      for (int z = -1; z <= 1; z++) {
+        Vec3i neighbour_position;
+        vec3i_add(neighbour_position, position, (Vec3i){x, y, z});
+        path_graph_mark(graph, neighbour_position);
+      }
+    }
+  }
+}
+
+void path_graph_invalidate(PathGraph *graph, const Vec3i block) {
+  Vec3i low;
+  Vec3i high;
+  Vec3i local;
+
+  world_block_to_chunk((Vec3i){block[0] - 2, block[1] - 3, block[2] - 2}, low,
+                       local);
+  world_block_to_chunk((Vec3i){block[0] + 2, block[1] + 2, block[2] + 2}, high,
+                       local);
+
+  for (int x = low[0]; x <= high[0]; x++) {
+    for (int y = low[1]; y <= high[1]; y++) {
+      for (int z = low[2]; z <= high[2]; z++) {
+        path_graph_mark(graph, (Vec3i){x, y, z});
+      }
+    }
+  }
+}
+
+void path_graph_invalidate_chunk(PathGraph *graph, const Chunk *chunk) {
+  path_graph_mark_around(graph, chunk->position);
+}
+
+unsigned int path_graph_update(PathGraph *graph) {
+  TracyCZone(path_graph_update, true);
+
+  World *world = graph->world;
+  double start = world_now();
+  unsigned int count = 0;
+
+  for (unsigned int slot = 0; slot < path_window_volume; slot++) {
+    const Chunk *chunk = &world->chunk_storage[slot];
+    PathChunk *path_chunk = &graph->chunks[slot];
+    bool loaded = atomic_load(&chunk->loaded);
+    unsigned int generation = atomic_load(&chunk->generation);
+
+    if (loaded == path_chunk->loaded &&
+        (!loaded || generation == path_chunk->generation)) {
+      continue;
+    }
+
+    if (path_chunk->loaded) {
+      path_graph_mark_around(graph, path_chunk->position);
+      graph->stats.cells -= path_chunk->cell_count;
+      graph->stats.portals -= path_chunk->portal_count;
+      path_chunk_clear(path_chunk);
+    }
+
+    path_chunk->loaded = loaded;
+    path_chunk->generation = generation;
+    vec3i_copy(path_chunk->position, chunk->position);
+
+    if (loaded) {
+      path_graph_mark_around(graph, chunk->position);
+    }
+  }
+
+  for (unsigned int slot = 0; slot < path_window_volume; slot++) {
+    PathChunk *path_chunk = &graph->chunks[slot];
+
+    if (!path_chunk->loaded || !path_chunk->dirty) {
+      continue;
+    }
+
+    for (int x = -1; x <= 1; x++) {
+      for (int y = -1; y <= 1; y++) {
+        for (int z = -1; z <= 1; z++) {
+          Vec3i position;
+          vec3i_add(position, path_chunk->position, (Vec3i){x, y, z});
+
+          Chunk *chunk = world_get_loaded_chunk(world, position);
+
+          if (chunk != NULL) {
+            chunk_get_solid_rows(chunk);
+          }
+        }
+      }
+    }
+
+    graph->stats.cells -= path_chunk->cell_count;
+    graph->stats.portals -= path_chunk->portal_count;
+    path_chunk->dirty = false;
+    graph->rebuild[count++] = slot;
+  }
+
+  unsigned int batch_size = count / (graph->pool.thread_count * 4);
+
+  thread_pool_parallel_for(
+      &graph->pool, count,
+      batch_size > path_rebuild_batch_size ? batch_size
+                                           : path_rebuild_batch_size,
+      path_rebuild_range, graph);
+
+  for (unsigned int i = 0; i < count; i++) {
+    const PathChunk *path_chunk = &graph->chunks[graph->rebuild[i]];
+
+    graph->stats.cells += path_chunk->cell_count;
+    graph->stats.portals += path_chunk->portal_count;
+  }
+
+  graph->stats.chunks_rebuilt += count;
+  graph->stats.rebuild_time += world_now() - start;
+
+  TracyCZoneEnd(path_graph_update);
+  return count;
+}
+
+static const PathChunk *path_graph_locate(const PathGraph *graph,
+                                          const Vec3i block, uint32_t *cell) {
+  Vec3i position;
+  Vec3i local;
+  world_block_to_chunk(block, position, local);
+
+  const PathChunk *path_chunk = &graph->chunks[path_slot(position)];
+
+  if (!path_chunk->loaded || path_chunk->dirty ||
+      !vec3i_compare(path_chunk->position, position)) {
+    return NULL;
+  }
+
+  *cell = path_chunk_cell(path_chunk, local[0], local[1], local[2]);
+
+  return *cell != path_no_cell ? path_chunk : NULL;
+}
+
+bool path_is_walkable(const PathGraph *graph, const Vec3i block) {
+  uint32_t cell;
+
+  return path_graph_locate(graph, block, &cell) != NULL;
+}
+
+static void path_search_reserve(PathSearch *search, unsigned int cell_count,
+                                unsigned int portal_count) {
+  if (cell_count > search->cell_capacity) {
+    search->cell_capacity = cell_count;
+    search->cell_stamps =
+        realloc(search->cell_stamps, sizeof(uint32_t) * cell_count);
+    search->cell_costs =
+        realloc(search->cell_costs, sizeof(uint32_t) * cell_count);
+    search->cell_parents =
+        realloc(search->cell_parents, sizeof(uint32_t) * cell_count);
+    search->queue = realloc(search->queue, sizeof(uint32_t) * cell_count);
+    search->stamp = 0;
+    memset(search->cell_stamps, 0, sizeof(uint32_t) * cell_count);
+  }
+
+  if (portal_count > search->portal_capacity) {
+    search->portal_capacity = portal_count;
+    search->goal_costs =
+        realloc(search->goal_costs, sizeof(uint32_t) * portal_count);
+  }
+}
+
+static void path_local_search(PathSearch *search, const PathChunk *path_chunk,
+                              uint32_t from, uint32_t to) {
+  unsigned int head = 0;
+  unsigned int tail = 0;
+
+  if (++search->stamp == 0) {
+    memset(search->cell_stamps, 0, sizeof(uint32_t) * search->cell_capacity);
+    search->stamp = 1;
+  }
+
+  search->cell_stamps[from] = search->stamp;
+  search->cell_costs[from] = 0;
+  search->cell_parents[from] = path_no_cell;
+  search->queue[tail++] = from;
+
+  while (head != tail) {
+    uint32_t index = search->queue[head++];
+    uint16_t moves = path_chunk->cells[index].moves;
+
+    if (index == to) {
+      return;
+    }
+
+    for (unsigned int move = 0; move < path_move_count; move++) {
+      uint32_t neighbour = moves >> move & 1
+                               ? path_chunk_neighbour(path_chunk, index, move)
+                               : path_no_cell;
+
+      if (neighbour == path_no_cell ||
+          search->cell_stamps[neighbour] == search->stamp) {
+        continue;
+      }
+
+      search->cell_stamps[neighbour] = search->stamp;
+      search->cell_costs[neighbour] = search->cell_costs[index] + 1;
+      search->cell_parents[neighbour] = index;
+      search->queue[tail++] = neighbour;
+    }
+  }
+}
+
+static uint32_t path_local_cost(const PathSearch *search, uint32_t cell) {
+  return search->cell_stamps[cell] == search->stamp ? search->cell_costs[cell]
+                                                    : path_unreachable;
+}
+
+static bool path_local_append(PathSearch *search, const PathChunk *path_chunk,
+                              uint32_t from, uint32_t to,
+                              Vector_PathStep *path) {
+  path_search_reserve(search, path_chunk->cell_count, 0);
+  path_local_search(search, path_chunk, from, to);
+
+  uint32_t cost = path_local_cost(search, to);
+
+  if (cost == path_unreachable) {
+    return false;
+  }
+
+  PathStep *steps = vector_extend_PathStep(path, cost);
+
+  for (uint32_t cell = to; cell != from; cell = search->cell_parents[cell]) {
+    path_cell_block(path_chunk, cell, steps[--cost].block);
+  }
+
+  return true;
+}
+
+static PathNode *path_search_node(PathSearch *search, uint32_t key) {
+  if ((search->node_count + 1) * 2 > search->node_capacity) {
+    PathNode *nodes = search->nodes;
+    unsigned int capacity = search->node_capacity;
+
+    search->node_capacity =
+        capacity != 0 ? capacity * 2 : path_node_capacity;
+    search->nodes = calloc(search->node_capacity, sizeof(PathNode));
+    search->node_count = 0;
+
+    for (unsigned int i = 0; i < capacity; i++) {
+      if (nodes[i].stamp == search->query) {
+        *path_search_node(search, nodes[i].key) = nodes[i];
+      }
+    }
+
+    free(nodes);
+  }
+
+  unsigned int mask = search->node_capacity - 1;
+  unsigned int index = (key * 2654435761u) & mask;
+
+  while (search->nodes[index].stamp == search->query &&
+         search->nodes[index].key != key) {
+    index = (index + 1) & mask;
+  }
+
+  PathNode *node = &search->nodes[index];
+
+  if (node->stamp != search->query) {
+    *node = (PathNode){.key = key,
+                       .stamp = search->query,
+                       .cost = path_unreachable,
+                       .parent = path_no_key};
+    search->node_count++;
+  }
+
+  return node;
+}
+
+static void path_open_push(PathSearch *search, uint32_t estimate,
+                           uint32_t key) {
+  if (search->open_size == search->open_capacity) {
+    search->open_capacity =
+        search->open_capacity != 0 ? search->open_capacity * 2 : 256;
+    search->open =
+        realloc(search->open, sizeof(PathOpen) * search->open_capacity);
+  }
+
+  unsigned int index = search->open_size++;
+
+  while (index > 0 && search->open[(index - 1) / 2].estimate > estimate) {
+    search->open[index] = search->open[(index - 1) / 2];
+    index = (index - 1) / 2;
+  }
+
+  search->open[index] = (PathOpen){estimate, key};
+}
+
+static PathOpen path_open_pop(PathSearch *search) {
+  PathOpen top = search->open[0];
+  PathOpen last = search->open[--search->open_size];
+  unsigned int index = 0;
+
+  while (true) {
+    unsigned int child = index * 2 + 1;
+
+    if (child >= search->open_size) {
+      break;
+    }
+
+    if (child + 1 < search->open_size &&
+        search->open[child + 1].estimate < search->open[child].estimate) {
+      child++;
+    }
+
+    if (search->open[child].estimate >= last.estimate) {
+      break;
+    }
+
+    search->open[index] = search->open[child];
+    index = child;
+  }
+
+  if (search->open_size != 0) {
+    search->open[index] = last;
+  }
+
+  return top;
+}
+
+static void path_relax(PathSearch *search, uint32_t key, uint32_t cost,
+                       uint32_t parent, uint32_t estimate) {
+  PathNode *node = path_search_node(search, key);
+
+  if (node->closed || cost >= node->cost) {
+    return;
+  }
+
+  node->cost = cost;
+  node->parent = parent;
+  path_open_push(search, cost + estimate, key);
+}
+
+static bool path_refine(const PathGraph *graph, PathSearch *search,
+                        const PathChunk *start_chunk, uint32_t start_cell,
+                        const PathChunk *goal_chunk, uint32_t goal_cell,
+                        Vector_PathStep *path) {
+  unsigned int length = 0;
+
+  for (uint32_t key = path_search_node(search, path_goal_key)->parent;
+       key != path_no_key; key = path_search_node(search, key)->parent) {
+    length++;
+  }
+
+  uint32_t *keys = malloc(sizeof(uint32_t) * length);
+  unsigned int index = length;
+
+  for (uint32_t key = path_search_node(search, path_goal_key)->parent;
+       key != path_no_key; key = path_search_node(search, key)->parent) {
+    keys[--index] = key;
+  }
+
+  const PathChunk *chunk = start_chunk;
+  uint32_t cell = start_cell;
+  bool found = true;
+
+  for (unsigned int i = 0; i < length && found; i++) {
+    const PathChunk *next_chunk = &graph->chunks[keys[i] >> path_portal_bits];
+    const PathPortal *portal =
+        &next_chunk->portals[keys[i] & (path_portal_capacity - 1)];
+
+    if (next_chunk == chunk) {
+      found = path_local_append(search, chunk, cell, portal->cell, path);
+    } else {
+      vector_insert_PathStep(path, (PathStep){0});
+      vec3i_copy(path->data[path->size - 1].block, portal->block);
+    }
+
+    chunk = next_chunk;
+    cell = portal->cell;
+  }
+
+  free(keys);
+
+  return found && chunk == goal_chunk &&
+         path_local_append(search, goal_chunk, cell, goal_cell, path);
+}
+
+static bool path_search_run(const PathGraph *graph, PathSearch *search,
+                            const Vec3i start, const Vec3i goal,
+                            Vector_PathStep *path) {
+  uint32_t start_cell;
+  uint32_t goal_cell;
+  const PathChunk *start_chunk = path_graph_locate(graph, start, &start_cell);
+  const PathChunk *goal_chunk = path_graph_locate(graph, goal, &goal_cell);
+
+  vector_clear_PathStep(path);
+  search->expanded = 0;
+
+  if (start_chunk == NULL || goal_chunk == NULL) {
+    return false;
+  }
+
+  vector_insert_PathStep(path, (PathStep){0});
+  vec3i_copy(path->data[0].block, start);
+
+  uint32_t start_region = start_chunk->cells[start_cell].region;
+  uint32_t goal_region = goal_chunk->cells[goal_cell].region;
+
+  if (start_chunk == goal_chunk && start_region == goal_region) {
+    return path_local_append(search, start_chunk, start_cell, goal_cell, path);
+  }
+
+  if (++search->query == 0) {
+    memset(search->nodes, 0, sizeof(PathNode) * search->node_capacity);
+    search->query = 1;
+  }
+
+  search->node_count = 0;
+  search->open_size = 0;
+
+  path_search_reserve(search, goal_chunk->cell_count,
+                      goal_chunk->portal_count);
+  path_local_search(search, goal_chunk, goal_cell, path_no_cell);
+
+  for (unsigned int i = 0; i < goal_chunk->portal_count; i++) {
+    const PathPortal *portal = &goal_chunk->portals[i];
+
+    search->goal_costs[i] = portal->region == goal_region
+                                ? path_local_cost(search, portal->cell)
+                                : path_unreachable;
+  }
+
+  path_search_reserve(search, start_chunk->cell_count, 0);
+  path_local_search(search, start_chunk, start_cell, path_no_cell);
+
+  uint32_t start_slot = start_chunk - graph->chunks;
+
+  for (unsigned int i = 0; i < start_chunk->portal_count; i++) {
+    const PathPortal *portal = &start_chunk->portals[i];
+    uint32_t cost = portal->region == start_region
+                        ? path_local_cost(search, portal->cell)
+                        : path_unreachable;
+
+    if (cost != path_unreachable) {
+      path_relax(search, start_slot << path_portal_bits | i, cost,
+                 path_no_key, path_estimate(portal->block, goal));
+    }
+  }
+
+  while (search->open_size != 0) {
+    PathOpen top = path_open_pop(search);
+
+    if (top.key == path_goal_key) {
+      return path_refine(graph, search, start_chunk, start_cell, goal_chunk,
+                         goal_cell, path);
+    }
+
+    PathNode *node = path_search_node(search, top.key);
+
+    if (node->closed) {
+      continue;
+    }
+
+    node->closed = true;
+    search->expanded++;
+
+    uint32_t key = top.key;
+    uint32_t cost = node->cost;
+    uint32_t slot = key >> path_portal_bits;
+    uint32_t index = key & (path_portal_capacity - 1);
+    const PathChunk *path_chunk = &graph->chunks[slot];
+    const PathPortal *portal = &path_chunk->portals[index];
+
+    if (path_chunk == goal_chunk &&
+        search->goal_costs[index] != path_unreachable) {
+      path_relax(search, path_goal_key, cost + search->goal_costs[index], key,
+                 0);
+    }
+
+    Vec3i target_position;
+    Vec3i local;
+    world_block_to_chunk(portal->target, target_position, local);
+
+    uint32_t target_slot = path_slot(target_position);
+    const PathChunk *target_chunk = &graph->chunks[target_slot];
+
+    if (target_chunk->loaded && !target_chunk->dirty &&
+        vec3i_compare(target_chunk->position, target_position)) {
+      for (unsigned int i = 0; i < target_chunk->portal_count; i++) {
+        const PathPortal *link = &target_chunk->portals[i];
+
+        if (vec3i_compare(link->block, portal->target) &&
+            vec3i_compare(link->target, portal->block)) {
+          path_relax(search, target_slot << path_portal_bits | i, cost + 1,
+                     key, path_estimate(link->block, goal));
+          break;
+        }
+      }
+    }
+
+    const uint32_t *distances =
+        &path_chunk->distances[index * path_chunk->portal_count];
+
+    for (unsigned int i = 0; i < path_chunk->portal_count; i++) {
+      if (i != index && distances[i] != path_unreachable) {
+        path_relax(search, slot << path_portal_bits | i, cost + distances[i],
+                   key, path_estimate(path_chunk->portals[i].block, goal));
+      }
+    }
+  }
+
+  return false;
+}
+
+static void path_search_free(PathSearch *search) {
+  free(search->nodes);
+  free(search->open);
+  free(search->cell_stamps);
+  free(search->cell_costs);
+  free(search->cell_parents);
+  free(search->queue);
+  free(search->goal_costs);
+
+  *search = (PathSearch){0};
+}
+
+bool path_find(PathGraph *graph, const Vec3i start, const Vec3i goal,
+               Vector_PathStep *path) {
+  TracyCZone(path_find, true);
+
+  bool found = path_search_run(graph, &graph->search, start, goal, path);
+
+  TracyCZoneEnd(path_find);
+  return found;
+}
+
+static void path_find_range(void *data, unsigned int begin, unsigned int end) {
+  PathBatch *batch = data;
+  PathSearch search = {0};
+
+  for (unsigned int i = begin; i < end; i++) {
+    PathQuery *query = &batch->queries[i];
+
+    query->found = path_search_run(batch->graph, &search, query->start,
+                                   query->goal, &query->path);
+    query->expanded = search.expanded;
+  }
+
+  path_search_free(&search);
+}
+
+void path_find_batch(PathGraph *graph, PathQuery *queries,
+                     unsigned int count) {
+  TracyCZone(path_find_batch, true);
+
+  PathBatch batch = {graph, queries};
+  unsigned int batch_size = count / (graph->pool.thread_count * 4);
+
+  thread_pool_parallel_for(&graph->pool, count,
+                           batch_size > path_query_batch_size
+                               ? batch_size
+                               : path_query_batch_size,
+                           path_find_range, &batch);
+
+  TracyCZoneEnd(path_find_batch);
+}
+
+void path_graph_free(PathGraph *graph) {
+  thread_pool_free(&graph->pool);
+
+  for (unsigned int slot = 0; slot < path_window_volume; slot++) {
+    path_chunk_clear(&graph->chunks[slot]);
+  }
+
+  path_search_free(&graph->search);
+  free(graph->chunks);
+  free(graph->rebuild);
+}
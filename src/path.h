@@ -0,0 +1,123 @@
+#pragma once
+
+#include "chunk.h"
+#include "thread_pool.h"
+#include "vec3.h"
+#include "vector.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define path_unreachable UINT32_MAX
+#define path_query_batch_size 4
+
+typedef struct World World;
+
+typedef struct PathStep {
+  Vec3i block;
+} PathStep;
+
+MakeVectorDeclaration(PathStep);
+
+typedef struct PathCell {
+  uint8_t x;
+  uint8_t y;
+  uint8_t z;
+  uint16_t moves;
+  uint32_t region;
+} PathCell;
+
+typedef struct PathPortal {
+  Vec3i block;
+  Vec3i target;
+  uint32_t cell;
+  uint32_t region;
+} PathPortal;
+
+typedef struct PathChunk {
+  Vec3i position;
+  unsigned int generation;
+  bool loaded;
+  bool dirty;
+  uint32_t *columns;
+  PathCell *cells;
+  unsigned int cell_count;
+  unsigned int region_count;
+  PathPortal *portals;
+  unsigned int portal_count;
+  uint32_t *distances;
+} PathChunk;
+
+typedef struct PathNode {
+  uint32_t key;
+  uint32_t stamp;
+  uint32_t cost;
+  uint32_t parent;
+  bool closed;
+} PathNode;
+
+typedef struct PathOpen {
+  uint32_t estimate;
+  uint32_t key;
+} PathOpen;
+
+typedef struct PathSearch {
+  PathNode *nodes;
+  unsigned int node_capacity;
+  unsigned int node_count;
+  PathOpen *open;
+  unsigned int open_capacity;
+  unsigned int open_size;
+  uint32_t *cell_stamps;
+  uint32_t *cell_costs;
+  uint32_t *cell_parents;
+  uint32_t *queue;
+  unsigned int cell_capacity;
+  uint32_t stamp;
+  uint32_t query;
+  uint32_t *goal_costs;
+  unsigned int portal_capacity;
+  unsigned int expanded;
+} PathSearch;
+
+typedef struct PathQuery {
+  Vec3i start;
+  Vec3i goal;
+  Vector_PathStep path;
+  bool found;
+  unsigned int expanded;
+} PathQuery;
+
+typedef struct PathStats {
+  unsigned int chunks_rebuilt;
+  unsigned int cells;
+  unsigned int portals;
+  double rebuild_time;
+} PathStats;
+
+typedef struct PathGraph {
+  World *world;
+  PathChunk *chunks;
+  unsigned int *rebuild;
+  ThreadPool pool;
+  PathSearch search;
+  PathStats stats;
+} PathGraph;
+
+void path_graph_init(PathGraph *graph, World *world,
+                     unsigned int thread_count);
+
+void path_graph_invalidate(PathGraph *graph, const Vec3i block);
+
+void path_graph_invalidate_chunk(PathGraph *graph, const Chunk *chunk);
+
+unsigned int path_graph_update(PathGraph *graph);
+
+bool path_is_walkable(const PathGraph *graph, const Vec3i block);
+
+bool path_find(PathGraph *graph, const Vec3i start, const Vec3i goal,
+               Vector_PathStep *path);
+
+void path_find_batch(PathGraph *graph, PathQuery *queries,
+                     unsigned int count);
+
+void path_graph_free(PathGraph *graph);
@@ -0,0 +1,238 @@
+#include "prefetch.h"
+
+#include "epoch.h"
+#include "math_util.h"
+#include "tracy/TracyC.h"
+#include "voxel_dag.h"
+#include "world.h"
+#include <math.h>
+#include <stdlib.h>
+
+#define prefetch_velocity_smoothing 0.25
+#define prefetch_default_bytes (64 * 1024)
+#define prefetch_slot_count                                                    \
+  (render_distance * render_distance * render_distance)
+
+static unsigned int prefetch_slot(const Vec3i position) {
+  return (mod(position[0], render_distance) * render_distance +
+          mod(position[1], render_distance)) *
+             render_distance +
+         mod(position[2], render_distance);
+}
+
+static bool prefetch_in_window(const Vec3i center, const Vec3i position) {
+  for (unsigned int i = 0; i < 3; i++) {
+    int offset = position[i] - center[i];
+
+    if (offset < -render_distance / 2 || offset >= render_distance / 2) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static void prefetch_entry_release(PrefetchEntry *entry) {
+  voxel_node_free(&entry->root);
+  vector_free_float(&entry->mesh.vertices);
+  vector_free_float(&entry->mesh.normals);
+  entry->bytes = 0;
+}
+
+static void prefetch_job(void *data) {
+  ChunkPrefetch *prefetch = data;
+
+  for (unsigned int i = 0; i < prefetch->queue_size; i++) {
+    PrefetchEntry *entry = &prefetch->entries[prefetch->queue[i]];
+    int expected = PREFETCH_PENDING;
+
+    if (!atomic_compare_exchange_strong(&entry->state, &expected,
+                                        PREFETCH_RUNNING)) {
+      continue;
+    }
+
+    TracyCZone(prefetch_chunk, true);
+
+    chunk_generate(&entry->root, entry->position);
+
+    ChunkSnapshot snapshot = {.root = entry->root};
+    vec3i_copy(snapshot.position, entry->position);
+
+    epoch_enter();
+
+    uint8_t neighbours =
+        world_present_neighbours(prefetch->world, entry->position);
+    entry->mesh = chunk_snapshot_build_mesh(&snapshot, prefetch->world);
+    entry->neighbours =
+        neighbours & world_present_neighbours(prefetch->world, entry->position);
+
+    epoch_exit();
+    entry->bytes =
+        voxel_node_count(&entry->root) * sizeof(VoxelNode) +
+        (entry->mesh.vertices.size + entry->mesh.normals.size) * sizeof(float);
+
+    atomic_store(&entry->state, PREFETCH_READY);
+
+    TracyCZoneEnd(prefetch_chunk);
+  }
+}
+
+void prefetch_init(ChunkPrefetch *prefetch, World *world) {
+  *prefetch = (ChunkPrefetch){
+      .config = {.enabled = true,
+                 .lookahead = 30,
+                 .shell_depth = 2,
+                 .memory_budget = 64 * 1024 * 1024},
+      .world = world};
+
+  prefetch->entries = calloc(prefetch_slot_count, sizeof(PrefetchEntry));
+  prefetch->queue = malloc(sizeof(unsigned int) * prefetch_slot_count);
+
+  thread_pool_init(&prefetch->pool, 1);
+}
+
+void prefetch_observe(ChunkPrefetch *prefetch, const Vec3 position) {
+  if (prefetch->has_last_position) {
+    for (unsigned int i = 0; i < 3; i++) {
+      double delta = position[i] - prefetch->last_position[i];
+
+      prefetch->velocity[i] +=
+          (delta - prefetch->velocity[i]) * prefetch_velocity_smoothing;
+    }
+  }
+
+  vec3_copy(prefetch->last_position, position);
+  prefetch->has_last_position = true;
+}
+
+void prefetch_update(ChunkPrefetch *prefetch, const Vec3i center) {
+  TracyCZone(prefetch_update, true);
+
+  Vec3i target;
+  int shell_depth = prefetch->config.shell_depth;
+
+  for (unsigned int i = 0; i < 3; i++) {
+    int shift = lround(prefetch->velocity[i] * prefetch->config.lookahead /
+                       chunk_size);
+    target[i] = center[i] + clamp(shift, -shell_depth, shell_depth);
+  }
+
+  bool enabled = prefetch->config.enabled && !vec3i_compare(target, center);
+  size_t resident_bytes = 0;
+  unsigned int ready_count = 0;
+
+  for (unsigned int i = 0; i < prefetch_slot_count; i++) {
+    PrefetchEntry *entry = &prefetch->entries[i];
+    int state = atomic_load(&entry->state);
+
+    if (state == PREFETCH_FREE || state == PREFETCH_RUNNING) {
+      continue;
+    }
+
+    bool wanted = enabled && prefetch_in_window(target, entry->position) &&
+                  !prefetch_in_window(center, entry->position);
+
+    if (state == PREFETCH_PENDING) {
+      if (!wanted && atomic_compare_exchange_strong(&entry->state, &state,
+                                                    PREFETCH_FREE)) {
+        prefetch->stats.cancelled++;
+      }
+
+      continue;
+    }
+
+    if (!wanted) {
+      prefetch_entry_release(entry);
+      atomic_store(&entry->state, PREFETCH_FREE);
+      prefetch->stats.dropped++;
+      continue;
+    }
+
+    resident_bytes += entry->bytes;
+    ready_count++;
+  }
+
+  prefetch->stats.resident_bytes = resident_bytes;
+
+  if (!enabled || thread_pool_busy(&prefetch->pool)) {
+    TracyCZoneEnd(prefetch_update);
+    return;
+  }
+
+  size_t entry_bytes =
+      ready_count != 0 ? resident_bytes / ready_count : prefetch_default_bytes;
+  const Vec3i *offsets = world_window_offsets();
+
+  prefetch->queue_size = 0;
+
+  for (unsigned int i = 0; i < prefetch_slot_count; i++) {
+    if (resident_bytes + entry_bytes > prefetch->config.memory_budget) {
+      break;
+    }
+
+    Vec3i position;
+    vec3i_add(position, target, offsets[i]);
+
+    if (prefetch_in_window(center, position) ||
+        residency_contains(&prefetch->world->residency, position)) {
+      continue;
+    }
+
+    unsigned int slot = prefetch_slot(position);
+    PrefetchEntry *entry = &prefetch->entries[slot];
+
+    if (atomic_load(&entry->state) != PREFETCH_FREE) {
+      continue;
+    }
+
+    vec3i_copy(entry->position, position);
+    atomic_store(&entry->state, PREFETCH_PENDING);
+
+    prefetch->queue[prefetch->queue_size++] = slot;
+    prefetch->stats.scheduled++;
+    resident_bytes += entry_bytes;
+  }
+
+  if (prefetch->queue_size != 0) {
+    thread_pool_submit(&prefetch->pool, prefetch_job, prefetch);
+  }
+
+  TracyCZoneEnd(prefetch_update);
+}
+
+bool prefetch_take(ChunkPrefetch *prefetch, const Vec3i position,
+                   VoxelNode *root, Mesh *mesh, uint8_t *neighbours) {
+  PrefetchEntry *entry = &prefetch->entries[prefetch_slot(position)];
+
+  if (atomic_load(&entry->state) != PREFETCH_READY ||
+      !vec3i_compare(entry->position, position)) {
+    return false;
+  }
+
+  *root = entry->root;
+  *mesh = entry->mesh;
+  *neighbours = entry->neighbours;
+  entry->bytes = 0;
+  atomic_store(&entry->state, PREFETCH_FREE);
+
+  prefetch->stats.hits++;
+
+  return true;
+}
+
+void prefetch_wait(ChunkPrefetch *prefetch) {
+  thread_pool_wait(&prefetch->pool);
+}
+
+void prefetch_free(ChunkPrefetch *prefetch) {
+  thread_pool_free(&prefetch->pool);
+
+  for (unsigned int i = 0; i < prefetch_slot_count; i++) {
+    if (atomic_load(&prefetch->entries[i].state) == PREFETCH_READY) {
+      prefetch_entry_release(&prefetch->entries[i]);
+    }
+  }
+
+  free(prefetch->entries);
+  free(prefetch->queue);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "chunk.h"
+#include "thread_pool.h"
+#include "vec3.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef enum PrefetchState {
+  PREFETCH_FREE,
+  PREFETCH_PENDING,
+  PREFETCH_RUNNING,
+  PREFETCH_READY,
+} PrefetchState;
+
+typedef struct PrefetchEntry {
+  atomic_int state;
+  Vec3i position;
+  VoxelNode root;
+  Mesh mesh;
+  uint8_t neighbours;
+  size_t bytes;
+} PrefetchEntry;
+
+typedef struct PrefetchConfig {
+  bool enabled;
+  double lookahead;
+  unsigned int shell_depth;
+  size_t memory_budget;
+} PrefetchConfig;
+
+typedef struct PrefetchStats {
+  unsigned int scheduled;
+  unsigned int hits;
+  unsigned int cancelled;
+  unsigned int dropped;
+  size_t resident_bytes;
+} PrefetchStats;
+
+typedef struct ChunkPrefetch {
+  PrefetchConfig config;
+  PrefetchStats stats;
+  PrefetchEntry *entries;
+  unsigned int *queue;
+  unsigned int queue_size;
+  Vec3 velocity;
+  Vec3 last_position;
+  bool has_last_position;
+  ThreadPool pool;
+  World *world;
+} ChunkPrefetch;
+
+void prefetch_init(ChunkPrefetch *prefetch, World *world);
+
+void prefetch_observe(ChunkPrefetch *prefetch, const Vec3 position);
+
+void prefetch_update(ChunkPrefetch *prefetch, const Vec3i center);
+
+bool prefetch_take(ChunkPrefetch *prefetch, const Vec3i position,
+                   VoxelNode *root, Mesh *mesh, uint8_t *neighbours);
+
+void prefetch_wait(ChunkPrefetch *prefetch);
+
+void prefetch_free(ChunkPrefetch *prefetch);
@@ -0,0 +1,125 @@
+#include "raycast.h"
+
+#include "chunk.h"
+#include "tracy/TracyC.h"
+#include "world.h"
+#include <math.h>
+
+#define raycast_batch_size 64
+#define raycast_max_distance (render_distance * chunk_size * 2)
+
+typedef struct RaycastBatch {
+  const World *world;
+  const Ray *rays;
+  RaycastHit *hits;
+} RaycastBatch;
+
+bool raycast(const World *world, const Ray *ray, RaycastHit *hit) {
+  *hit = (RaycastHit){.hit = false};
+
+  double length = vec3_length(ray->direction);
+
+  if (length == 0) {
+    return false;
+  }
+
+  Vec3 direction;
+  vec3_multiply_double(direction, ray->direction, 1 / length);
+
+  double max_distance = fmin(ray->max_distance, raycast_max_distance);
+  double distance = 0;
+
+  Vec3i block;
+  Vec3i normal = {0, 0, 0};
+
+  for (unsigned int axis = 0; axis < 3; axis++) {
+    block[axis] = floor(ray->origin[axis]);
+  }
+
+  while (distance <= max_distance) {
+    Vec3i chunk_position;
+    Vec3i local;
+    world_block_to_chunk(block, chunk_position, local);
+
+    Chunk *chunk = world_get_loaded_chunk(world, chunk_position);
+
+    Vec3i offset = {0, 0, 0};
+    unsigned int leaf_size = chunk_size;
+    BlockType block_type = AIR;
+
+    if (chunk != NULL) {
+      block_type =
+          chunk_get_leaf(chunk, local, offset, &leaf_size)->block_type;
+    }
+
+    if (block_type_is_solid(block_type)) {
+      hit->hit = true;
+      hit->block_type = block_type;
+      vec3i_copy(hit->block, block);
+      vec3i_copy(hit->normal, normal);
+      hit->distance = distance;
+
+      return true;
+    }
+
+    int size = leaf_size;
+    Vec3i low;
+    double exit_distance = INFINITY;
+    unsigned int exit_axis = 0;
+
+    for (unsigned int axis = 0; axis < 3; axis++) {
+      low[axis] = chunk_position[axis] * chunk_size + offset[axis];
+
+      if (direction[axis] == 0) {
+        continue;
+      }
+
+      double plane = direction[axis] > 0 ? low[axis] + size : low[axis];
+      double axis_distance = (plane - ray->origin[axis]) / direction[axis];
+
+      if (axis_distance < exit_distance) {
+        exit_distance = axis_distance;
+        exit_axis = axis;
+      }
+    }
+
+    distance = fmax(distance, exit_distance);
+
+    for (unsigned int axis = 0; axis < 3; axis++) {
+      if (axis == exit_axis) {
+        block[axis] = direction[axis] > 0 ? low[axis] + size : low[axis] - 1;
+        normal[axis] = direction[axis] > 0 ? -1 : 1;
+        continue;
+      }
+
+      int position = floor(ray->origin[axis] + direction[axis] * distance);
+      block[axis] = position < low[axis]           ? low[axis]
+                    : position >= low[axis] + size ? low[axis] + size - 1
+                                                   : position;
+      normal[axis] = 0;
+    }
+  }
+
+  return false;
+}
+
+static void raycast_batch_range(void *data, unsigned int begin,
+                                unsigned int end) {
+  TracyCZone(raycast_batch_range, true);
+
+  RaycastBatch *batch = data;
+
+  for (unsigned int i = begin; i < end; i++) {
+    raycast(batch->world, &batch->rays[i], &batch->hits[i]);
+  }
+
+  TracyCZoneEnd(raycast_batch_range);
+}
+
+void raycast_batch(const World *world, ThreadPool *pool, const Ray *rays,
+                   RaycastHit *hits, unsigned int count) {
+  RaycastBatch batch = {world, rays, hits};
+
+  thread_pool_parallel_for(pool, count, raycast_batch_size,
+                           raycast_batch_range, &batch);
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "block_type.h"
+#include "thread_pool.h"
+#include "vec3.h"
+#include <stdbool.h>
+
+typedef struct World World;
+
+typedef struct Ray {
+  Vec3 origin;
+  Vec3 direction;
+  double max_distance;
+} Ray;
+
+typedef struct RaycastHit {
+  bool hit;
+  BlockType block_type;
+  Vec3i block;
+  Vec3i normal;
+  double distance;
+} RaycastHit;
+
+bool raycast(const World *world, const Ray *ray, RaycastHit *hit);
+
+// Rays are traced without chunk locks, the world must not be edited until
+// this returns.
+void raycast_batch(const World *world, ThreadPool *pool, const Ray *rays,
+                   RaycastHit *hits, unsigned int count);
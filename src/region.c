@@ -0,0 +1,593 @@
+#include "region.h"
+
+#include "chunk.h"
+#include "fluid.h"
+#include "light.h"
+#include "math_util.h"
+#include "path.h"
+#include "tracy/TracyC.h"
+#include "world.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define region_paste_mixed UINT16_MAX
+#define region_paste_max_levels 8
+
+MakeVectorDefinition(RegionRun);
+
+typedef struct RegionBox {
+  Vec3i min;
+  Vec3i max;
+} RegionBox;
+
+typedef struct RegionSphere {
+  Vec3 center;
+  double radius;
+} RegionSphere;
+
+typedef struct RegionPaste {
+  RegionBox box;
+  Vec3i origin;
+  BlockType *levels[region_paste_max_levels];
+} RegionPaste;
+
+static VoxelCoverage region_box_test(const Vec3i min, unsigned int size,
+                                     const void *data) {
+  const RegionBox *box = data;
+  bool full = true;
+
+  for (unsigned int axis = 0; axis < 3; axis++) {
+    int high = min[axis] + (int)size;
+
+    if (min[axis] >= box->max[axis] || high <= box->min[axis]) {
+      return VOXEL_COVERAGE_NONE;
+    }
+
+    full &= min[axis] >= box->min[axis] && high <= box->max[axis];
+  }
+
+  return full ? VOXEL_COVERAGE_FULL : VOXEL_COVERAGE_PARTIAL;
+}
+
+static VoxelCoverage region_sphere_test(const Vec3i min, unsigned int size,
+                                        const void *data) {
+  const RegionSphere *sphere = data;
+  double near = 0;
+  double far = 0;
+
+  for (unsigned int axis = 0; axis < 3; axis++) {
+    double low = min[axis] + 0.5 - sphere->center[axis];
+    double high = low + size - 1;
+    double nearest = low > 0 ? low : high < 0 ? high : 0;
+    double farthest = fmax(fabs(low), fabs(high));
+
+    near += nearest * nearest;
+    far += farthest * farthest;
+  }
+
+  double radius = sphere->radius * sphere->radius;
+
+  if (near > radius) {
+    return VOXEL_COVERAGE_NONE;
+  }
+
+  return far <= radius ? VOXEL_COVERAGE_FULL : VOXEL_COVERAGE_PARTIAL;
+}
+
+static void region_invalidate(World *world, Chunk *chunk) {
+  chunk->dirty_sections = mesh_sections_all;
+
+  for (int x = -1; x <= 1; x++) {
+    for (int y = -1; y <= 1; y++) {
+      for (int z = -1; z <= 1; z++) {
+        Vec3i position;
+        vec3i_add(position, chunk->position, (Vec3i){x, y, z});
+
+        Chunk *neighbour = world_get_loaded_chunk(world, position);
+
+        if (neighbour == NULL) {
+          continue;
+        }
+
+        neighbour->light.ready = false;
+
+        if (abs(x) + abs(y) + abs(z) == 1) {
+          neighbour->dirty_sections = mesh_sections_all;
+        }
+      }
+    }
+  }
+}
+
+static void region_sync(World *world, Chunk *chunk) {
+  fluid_sync_chunk(&world->fluid, chunk);
+  path_graph_invalidate_chunk(&world->paths, chunk);
+  heightmap_invalidate_chunk(&world->heightmap, chunk);
+}
+
+static void region_apply(World *world, const Vec3i min, const Vec3i max,
+                         VoxelRegionTest test, const void *data,
+                         BlockType block_type) {
+  TracyCZone(region_apply, true);
+
+  Vec3i last = {max[0] - 1, max[1] - 1, max[2] - 1};
+  Vec3i low_chunk;
+  Vec3i high_chunk;
+  Vec3i local;
+
+  world_block_to_chunk(min, low_chunk, local);
+  world_block_to_chunk(last, high_chunk, local);
+
+  for (int x = low_chunk[0]; x <= high_chunk[0]; x++) {
+    for (int y = low_chunk[1]; y <= high_chunk[1]; y++) {
+      for (int z = low_chunk[2]; z <= high_chunk[2]; z++) {
+        Chunk *chunk = world_get_loaded_chunk(world, (Vec3i){x, y, z});
+
+        if (chunk == NULL) {
+          continue;
+        }
+
+        mtx_lock(&chunk->mutex);
+        mtx_lock(&world->light_engine.mutex);
+
+        bool changed = chunk_fill_region(chunk, test, data, block_type);
+
+        if (changed) {
+          region_invalidate(world, chunk);
+        }
+
+        mtx_unlock(&world->light_engine.mutex);
+        mtx_unlock(&chunk->mutex);
+
+        if (changed) {
+          region_sync(world, chunk);
+        }
+      }
+    }
+  }
+
+  TracyCZoneEnd(region_apply);
+}
+
+void region_fill_box(World *world, const Vec3i from, const Vec3i to,
+                     BlockType block_type) {
+  RegionBox box;
+
+  for (unsigned int axis = 0; axis < 3; axis++) {
+    if (to[axis] <= from[axis]) {
+      return;
+    }
+
+    box.min[axis] = from[axis];
+    box.max[axis] = to[axis];
+  }
+
+  region_apply(world, box.min, box.max, region_box_test, &box, block_type);
+}
+
+void region_fill_sphere(World *world, const Vec3 center, double radius,
+                        BlockType block_type) {
+  if (radius <= 0) {
+    return;
+  }
+
+  RegionSphere sphere = {{center[0], center[1], center[2]}, radius};
+  Vec3i min;
+  Vec3i max;
+
+  for (unsigned int axis = 0; axis < 3; axis++) {
+    min[axis] = floor(center[axis] - radius);
+    max[axis] = ceil(center[axis] + radius) + 1;
+  }
+
+  region_apply(world, min, max, region_sphere_test, &sphere, block_type);
+}
+
+static void region_clip_push(RegionClip *clip, BlockType block_type,
+                             uint32_t count) {
+  RegionRun *last = clip->runs.size != 0
+                        ? &clip->runs.data[clip->runs.size - 1]
+                        : NULL;
+
+  if (last != NULL && last->block_type == block_type &&
+      last->count <= UINT32_MAX - count) {
+    last->count += count;
+    return;
+  }
+
+  vector_insert_RegionRun(&clip->runs, (RegionRun){count, block_type});
+}
+
+void region_copy(World *world, const Vec3i from, const Vec3i to,
+                 RegionClip *clip) {
+  TracyCZone(region_copy, true);
+
+  for (unsigned int axis = 0; axis < 3; axis++) {
+    clip->size[axis] = max(to[axis] - from[axis], 0);
+  }
+
+  vector_init_RegionRun(&clip->runs, 0);
+
+  if (clip->size[0] == 0 || clip->size[1] == 0 || clip->size[2] == 0) {
+    TracyCZoneEnd(region_copy);
+    return;
+  }
+
+  for (int y = from[1]; y < to[1]; y++) {
+    for (int z = from[2]; z < to[2]; z++) {
+      int x = from[0];
+
+      while (x < to[0]) {
+        Vec3i chunk_position;
+        Vec3i local;
+        world_block_to_chunk((Vec3i){x, y, z}, chunk_position, local);
+
+        int chunk_end = min((chunk_position[0] + 1) * chunk_size, to[0]);
+        Chunk *chunk = world_get_loaded_chunk(world, chunk_position);
+
+        if (chunk == NULL) {
+          region_clip_push(clip, AIR, chunk_end - x);
+          x = chunk_end;
+          continue;
+        }
+
+        mtx_lock(&chunk->mutex);
+
+        while (x < chunk_end) {
+          local[0] = x - chunk_position[0] * chunk_size;
+
+          Vec3i offset;
+          unsigned int size;
+          const VoxelNode *leaf = chunk_get_leaf(chunk, local, offset, &size);
+
+          int leaf_end = min(x - local[0] + offset[0] + size, chunk_end);
+          region_clip_push(clip, leaf->block_type, leaf_end - x);
+          x = leaf_end;
+        }
+
+        mtx_unlock(&chunk->mutex);
+      }
+    }
+  }
+
+  TracyCZoneEnd(region_copy);
+}
+
+static VoxelCoverage region_paste_sample(const Vec3i min, unsigned int size,
+                                         const void *data,
+                                         BlockType *block_type) {
+  const RegionPaste *paste = data;
+  VoxelCoverage coverage = region_box_test(min, size, &paste->box);
+
+  if (coverage != VOXEL_COVERAGE_FULL) {
+    return coverage;
+  }
+
+  unsigned int level = __builtin_ctz(size);
+  unsigned int extent = chunk_size >> level;
+  unsigned int x = (min[0] - paste->origin[0]) >> level;
+  unsigned int y = (min[1] - paste->origin[1]) >> level;
+  unsigned int z = (min[2] - paste->origin[2]) >> level;
+
+  *block_type = paste->levels[level][(z * extent + y) * extent + x];
+
+  return *block_type == region_paste_mixed ? VOXEL_COVERAGE_PARTIAL
+                                           : VOXEL_COVERAGE_FULL;
+}
+
+static void region_paste_decode(RegionPaste *paste, const RegionClip *clip,
+                                const size_t *starts, const Vec3i origin) {
+  BlockType *cells = paste->levels[0];
+  int row = clip->size[0];
+  int depth = clip->size[2];
+  unsigned int run = 0;
+
+  for (int y = paste->box.min[1]; y < paste->box.max[1]; y++) {
+    for (int z = paste->box.min[2]; z < paste->box.max[2]; z++) {
+      int x = paste->box.min[0];
+      size_t index = ((size_t)(y - origin[1]) * depth + z - origin[2]) * row +
+                     x - origin[0];
+
+      if (starts[run] > index || starts[run + 1] <= index) {
+        unsigned int low = 0;
+        unsigned int high = clip->runs.size;
+
+        while (high - low > 1) {
+          unsigned int middle = (low + high) / 2;
+
+          if (starts[middle] <= index) {
+            low = middle;
+          } else {
+            high = middle;
+          }
+        }
+
+        run = low;
+      }
+
+      BlockType *cell = &cells[((z - paste->origin[2]) * chunk_size + y -
+                                paste->origin[1]) *
+                                   chunk_size +
+                               x - paste->origin[0]];
+
+      while (x < paste->box.max[0]) {
+        size_t end = min(starts[run + 1] - index, paste->box.max[0] - x);
+        BlockType block_type = clip->runs.data[run].block_type;
+
+        for (size_t i = 0; i < end; i++) {
+          *cell++ = block_type;
+        }
+
+        x += end;
+        index += end;
+
+        if (index == starts[run + 1]) {
+          run++;
+        }
+      }
+    }
+  }
+}
+
+static void region_paste_reduce(RegionPaste *paste) {
+  for (unsigned int level = 1; chunk_size >> level != 0; level++) {
+    unsigned int extent = chunk_size >> level;
+    const BlockType *children = paste->levels[level - 1];
+    BlockType *parents = paste->levels[level];
+    Vec3i low;
+    Vec3i high;
+
+    for (unsigned int axis = 0; axis < 3; axis++) {
+      int size = 1 << level;
+
+      low[axis] = (paste->box.min[axis] - paste->origin[axis] + size - 1) >>
+                  level;
+      high[axis] = (paste->box.max[axis] - paste->origin[axis]) >> level;
+    }
+
+    for (int z = low[2]; z < high[2]; z++) {
+      for (int y = low[1]; y < high[1]; y++) {
+        for (int x = low[0]; x < high[0]; x++) {
+          BlockType block_type = region_paste_mixed;
+
+          for (unsigned int i = 0; i < 8; i++) {
+            unsigned int child_x = x * 2 + (i & 1);
+            unsigned int child_y = y * 2 + (i >> 1 & 1);
+            unsigned int child_z = z * 2 + (i >> 2 & 1);
+            BlockType child =
+                children[(child_z * extent * 2 + child_y) * extent * 2 +
+                         child_x];
+
+            if (i == 0) {
+              block_type = child;
+            } else if (child != block_type) {
+              block_type = region_paste_mixed;
+              break;
+            }
+          }
+
+          parents[(z * extent + y) * extent + x] = block_type;
+        }
+      }
+    }
+  }
+}
+
+void region_paste(World *world, const RegionClip *clip, const Vec3i origin) {
+  TracyCZone(region_paste, true);
+
+  if (clip->runs.size == 0) {
+    TracyCZoneEnd(region_paste);
+    return;
+  }
+
+  size_t *starts = malloc(sizeof(size_t) * (clip->runs.size + 1));
+  starts[0] = 0;
+
+  for (unsigned int i = 0; i < clip->runs.size; i++) {
+    starts[i + 1] = starts[i] + clip->runs.data[i].count;
+  }
+
+  RegionPaste paste;
+  size_t level_volume = chunk_size * chunk_size * chunk_size;
+  BlockType *levels = malloc(sizeof(BlockType) * level_volume * 8 / 7 + 1);
+
+  for (unsigned int level = 0; chunk_size >> level != 0; level++) {
+    paste.levels[level] = levels;
+    levels += level_volume;
+    level_volume /= 8;
+  }
+
+  Vec3i end = {origin[0] + clip->size[0], origin[1] + clip->size[1],
+               origin[2] + clip->size[2]};
+  Vec3i last = {end[0] - 1, end[1] - 1, end[2] - 1};
+  Vec3i low_chunk;
+  Vec3i high_chunk;
+  Vec3i local;
+
+  world_block_to_chunk(origin, low_chunk, local);
+  world_block_to_chunk(last, high_chunk, local);
+
+  for (int x = low_chunk[0]; x <= high_chunk[0]; x++) {
+    for (int y = low_chunk[1]; y <= high_chunk[1]; y++) {
+      for (int z = low_chunk[2]; z <= high_chunk[2]; z++) {
+        Chunk *chunk = world_get_loaded_chunk(world, (Vec3i){x, y, z});
+
+        if (chunk == NULL) {
+          continue;
+        }
+
+        vec3i_copy(paste.origin, (Vec3i){x * chunk_size, y * chunk_size,
+                                         z * chunk_size});
+
+        for (unsigned int axis = 0; axis < 3; axis++) {
+          paste.box.min[axis] = max(origin[axis], paste.origin[axis]);
+          paste.box.max[axis] =
+              min(end[axis], paste.origin[axis] + chunk_size);
+        }
+
+        region_paste_decode(&paste, clip, starts, origin);
+        region_paste_reduce(&paste);
+
+        mtx_lock(&chunk->mutex);
+        mtx_lock(&world->light_engine.mutex);
+
+        bool changed = chunk_paint_region(chunk, region_paste_sample, &paste);
+
+        if (changed) {
+          region_invalidate(world, chunk);
+        }
+
+        mtx_unlock(&world->light_engine.mutex);
+        mtx_unlock(&chunk->mutex);
+
+        if (changed) {
+          region_sync(world, chunk);
+        }
+      }
+    }
+  }
+
+  free(paste.levels[0]);
+  free(starts);
+
+  TracyCZoneEnd(region_paste);
+}
+
+static void region_write(uint8_t **cursor, const void *value, size_t size) {
+  memcpy(*cursor, value, size);
+  *cursor += size;
+}
+
+static bool region_read(const uint8_t **cursor, const uint8_t *end,
+                        void *value, size_t size) {
+  if ((size_t)(end - *cursor) < size) {
+    return false;
+  }
+
+  memcpy(value, *cursor, size);
+  *cursor += size;
+
+  return true;
+}
+
+uint8_t *region_clip_serialize(const RegionClip *clip, size_t *size) {
+  uint16_t palette_index[block_type_capacity];
+  BlockType palette[block_type_capacity];
+  uint16_t palette_size = 0;
+
+  memset(palette_index, 0xff, sizeof(palette_index));
+
+  size_t name_size = 0;
+
+  for (unsigned int i = 0; i < clip->runs.size; i++) {
+    BlockType block_type = clip->runs.data[i].block_type;
+
+    if (palette_index[block_type] == UINT16_MAX) {
+      palette_index[block_type] = palette_size;
+      palette[palette_size++] = block_type;
+      name_size += strlen(block_registry.names[block_type]) + 1;
+    }
+  }
+
+  *size = sizeof(clip->size) + sizeof(palette_size) + name_size +
+          sizeof(uint32_t) +
+          clip->runs.size * (sizeof(uint32_t) + sizeof(uint16_t));
+
+  uint8_t *data = malloc(*size);
+  uint8_t *cursor = data;
+
+  region_write(&cursor, clip->size, sizeof(clip->size));
+  region_write(&cursor, &palette_size, sizeof(palette_size));
+
+  for (unsigned int i = 0; i < palette_size; i++) {
+    const char *name = block_registry.names[palette[i]];
+    region_write(&cursor, name, strlen(name) + 1);
+  }
+
+  uint32_t run_count = clip->runs.size;
+  region_write(&cursor, &run_count, sizeof(run_count));
+
+  for (unsigned int i = 0; i < clip->runs.size; i++) {
+    const RegionRun *run = &clip->runs.data[i];
+    region_write(&cursor, &run->count, sizeof(run->count));
+    region_write(&cursor, &palette_index[run->block_type], sizeof(uint16_t));
+  }
+
+  return data;
+}
+
+bool region_clip_deserialize(RegionClip *clip, const uint8_t *data,
+                             size_t size) {
+  const uint8_t *cursor = data;
+  const uint8_t *end = data + size;
+
+  uint16_t palette_size;
+  BlockType palette[block_type_capacity];
+
+  vector_init_RegionRun(&clip->runs, 0);
+
+  if (!region_read(&cursor, end, clip->size, sizeof(clip->size)) ||
+      !region_read(&cursor, end, &palette_size, sizeof(palette_size)) ||
+      palette_size > block_type_capacity) {
+    return false;
+  }
+
+  for (unsigned int i = 0; i < palette_size; i++) {
+    const uint8_t *name_end = memchr(cursor, 0, end - cursor);
+
+    if (name_end == NULL) {
+      return false;
+    }
+
+    palette[i] = block_registry_find((const char *)cursor);
+    cursor = name_end + 1;
+  }
+
+  uint32_t run_count;
+
+  if (!region_read(&cursor, end, &run_count, sizeof(run_count))) {
+    return false;
+  }
+
+  size_t volume = 1;
+  size_t total = 0;
+
+  for (unsigned int axis = 0; axis < 3; axis++) {
+    if (clip->size[axis] < 0) {
+      return false;
+    }
+
+    volume *= clip->size[axis];
+  }
+
+  vector_reserve_RegionRun(&clip->runs, run_count);
+
+  for (uint32_t i = 0; i < run_count; i++) {
+    RegionRun run;
+    uint16_t index;
+
+    if (!region_read(&cursor, end, &run.count, sizeof(run.count)) ||
+        !region_read(&cursor, end, &index, sizeof(index)) ||
+        index >= palette_size) {
+      region_clip_free(clip);
+      return false;
+    }
+
+    run.block_type = palette[index];
+    total += run.count;
+    vector_insert_RegionRun(&clip->runs, run);
+  }
+
+  if (total != volume) {
+    region_clip_free(clip);
+    return false;
+  }
+
+  return true;
+}
+
+void region_clip_free(RegionClip *clip) {
+  vector_free_RegionRun(&clip->runs);
+}
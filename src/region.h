@@ -0,0 +1,40 @@
+#pragma once
+
+#include "block_type.h"
+#include "vec3.h"
+#include "vector.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct World World;
+
+typedef struct RegionRun {
+  uint32_t count;
+  BlockType block_type;
+} RegionRun;
+
+MakeVectorDeclaration(RegionRun);
+
+typedef struct RegionClip {
+  Vec3i size;
+  Vector_RegionRun runs;
+} RegionClip;
+
+void region_fill_box(World *world, const Vec3i from, const Vec3i to,
+                     BlockType block_type);
+
+void region_fill_sphere(World *world, const Vec3 center, double radius,
+                        BlockType block_type);
+
+void region_copy(World *world, const Vec3i from, const Vec3i to,
+                 RegionClip *clip);
+
+void region_paste(World *world, const RegionClip *clip, const Vec3i origin);
+
+uint8_t *region_clip_serialize(const RegionClip *clip, size_t *size);
+
+bool region_clip_deserialize(RegionClip *clip, const uint8_t *data,
+                             size_t size);
+
+void region_clip_free(RegionClip *clip);
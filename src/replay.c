@@ -0,0 +1,162 @@
+#include "replay.h"
+
+#include "camera.h"
+#include "math_util.h"
+#include "tracy/TracyC.h"
+#include "world.h"
+#include <math.h>
+#include <stdlib.h>
+#include <threads.h>
+
+static void replay_wait(World *world) {
+  light_engine_wait(&world->light_engine);
+  world_wait(world);
+  prefetch_wait(&world->prefetch);
+}
+
+void replay_run(World *world, const CameraPath *path,
+                const ReplayConfig *config, ReplayFrame *frames) {
+  Camera camera = {.transform = {.scale = {1, 1, 1}}};
+
+  if (config->warm_up) {
+    camera_path_sample(path, 0, &camera.transform);
+
+    do {
+      world_load(world, &camera);
+      replay_wait(world);
+    } while (world->stats.unmeshed_chunks != 0 ||
+             world->stats.chunks_meshed != 0);
+  }
+
+  for (unsigned int i = 0; i < config->frame_count; i++) {
+    TracyCZone(replay_frame, true);
+
+    double time = i * config->timestep;
+    camera_path_sample(path, time, &camera.transform);
+
+    world_load(world, &camera);
+
+    if (config->synchronous) {
+      replay_wait(world);
+    }
+
+    const WorldStats *stats = &world->stats;
+    ReplayFrame *frame = &frames[i];
+
+    frame->time = time;
+    frame->load_time = stats->load_time;
+    frame->chunks_generated = stats->chunks_generated;
+    frame->chunks_meshed = stats->chunks_meshed;
+    frame->prefetch_hits = stats->prefetch_hits;
+    frame->residency_hits = stats->residency_hits;
+    frame->unmeshed_chunks = stats->unmeshed_chunks;
+    frame->meshes_avoided = stats->meshes_avoided;
+    frame->stale_dropped = stats->stale_dropped;
+    frame->unloads_deferred = stats->unloads_deferred;
+    frame->mesh_queue = stats->mesh_queue;
+    frame->light_queue = stats->light_queue;
+    frame->mesh_latency_count = stats->mesh_latency_count;
+    frame->mesh_latency_mean =
+        stats->mesh_latency_count != 0
+            ? stats->mesh_latency_total / stats->mesh_latency_count
+            : 0;
+    frame->mesh_latency_max = stats->mesh_latency_max;
+
+    TracyCZoneEnd(replay_frame);
+    TracyCFrameMark;
+  }
+}
+
+double replay_first_frame(World *world, const CameraPath *path,
+                          unsigned int *chunks_meshed) {
+  Camera camera = {.transform = {.scale = {1, 1, 1}}};
+  camera_path_sample(path, 0, &camera.transform);
+
+  double start = world_now();
+
+  for (;;) {
+    world_load(world, &camera);
+
+    if (world->stats.chunks_meshed != 0) {
+      *chunks_meshed = world->stats.chunks_meshed;
+      return world_now() - start;
+    }
+
+    thrd_sleep(&(struct timespec){.tv_nsec = 1000000}, NULL);
+  }
+}
+
+static int replay_compare_double(const void *a, const void *b) {
+  double value_a = *(const double *)a;
+  double value_b = *(const double *)b;
+
+  return (value_a > value_b) - (value_a < value_b);
+}
+
+void replay_summarize(const ReplayFrame *frames, unsigned int frame_count,
+                      ReplaySummary *summary) {
+  *summary = (ReplaySummary){0};
+
+  if (frame_count == 0) {
+    return;
+  }
+
+  double *load_times = malloc(sizeof(double) * frame_count);
+  double latency_total = 0;
+  unsigned int latency_count = 0;
+
+  for (unsigned int i = 0; i < frame_count; i++) {
+    const ReplayFrame *frame = &frames[i];
+
+    load_times[i] = frame->load_time;
+    summary->load_time_mean += frame->load_time / frame_count;
+    summary->chunks_generated += frame->chunks_generated;
+    summary->chunks_meshed += frame->chunks_meshed;
+    summary->prefetch_hits += frame->prefetch_hits;
+    summary->residency_hits += frame->residency_hits;
+    summary->unmeshed_mean += (double)frame->unmeshed_chunks / frame_count;
+    summary->unmeshed_max = max(summary->unmeshed_max, frame->unmeshed_chunks);
+    summary->meshes_avoided += frame->meshes_avoided;
+    summary->stale_dropped += frame->stale_dropped;
+    summary->unloads_deferred += frame->unloads_deferred;
+    summary->mesh_latency_max =
+        fmax(summary->mesh_latency_max, frame->mesh_latency_max);
+
+    latency_total += frame->mesh_latency_mean * frame->mesh_latency_count;
+    latency_count += frame->mesh_latency_count;
+  }
+
+  qsort(load_times, frame_count, sizeof(double), replay_compare_double);
+
+  summary->load_time_p50 = load_times[frame_count / 2];
+  summary->load_time_p99 = load_times[frame_count * 99 / 100];
+  summary->load_time_max = load_times[frame_count - 1];
+  summary->mesh_latency_mean =
+      latency_count != 0 ? latency_total / latency_count : 0;
+  summary->prefetch_hit_rate =
+      summary->chunks_generated != 0
+          ? (double)summary->prefetch_hits / summary->chunks_generated
+          : 0;
+
+  free(load_times);
+}
+
+void replay_write_csv(FILE *file, const ReplayFrame *frames,
+                      unsigned int frame_count) {
+  fprintf(file, "frame,time,load_ms,generated,meshed,prefetch_hits,"
+                "residency_hits,unmeshed,meshes_avoided,stale_dropped,"
+                "unloads_deferred,mesh_queue,light_queue,latency_mean_ms,"
+                "latency_max_ms\n");
+
+  for (unsigned int i = 0; i < frame_count; i++) {
+    const ReplayFrame *frame = &frames[i];
+
+    fprintf(file, "%u,%.4f,%.4f,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%.4f,%.4f\n",
+            i, frame->time, frame->load_time * 1e3, frame->chunks_generated,
+            frame->chunks_meshed, frame->prefetch_hits, frame->residency_hits,
+            frame->unmeshed_chunks, frame->meshes_avoided,
+            frame->stale_dropped, frame->unloads_deferred, frame->mesh_queue,
+            frame->light_queue, frame->mesh_latency_mean * 1e3,
+            frame->mesh_latency_max * 1e3);
+  }
+}
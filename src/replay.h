@@ -0,0 +1,63 @@
+#pragma once
+
+#include "camera_path.h"
+#include <stdbool.h>
+#include <stdio.h>
+
+typedef struct World World;
+
+typedef struct ReplayConfig {
+  double timestep;
+  unsigned int frame_count;
+  bool synchronous;
+  bool warm_up;
+} ReplayConfig;
+
+typedef struct ReplayFrame {
+  double time;
+  double load_time;
+  unsigned int chunks_generated;
+  unsigned int chunks_meshed;
+  unsigned int prefetch_hits;
+  unsigned int residency_hits;
+  unsigned int unmeshed_chunks;
+  unsigned int meshes_avoided;
+  unsigned int stale_dropped;
+  unsigned int unloads_deferred;
+  unsigned int mesh_queue;
+  unsigned int light_queue;
+  unsigned int mesh_latency_count;
+  double mesh_latency_mean;
+  double mesh_latency_max;
+} ReplayFrame;
+
+typedef struct ReplaySummary {
+  double load_time_mean;
+  double load_time_p50;
+  double load_time_p99;
+  double load_time_max;
+  unsigned int chunks_generated;
+  unsigned int chunks_meshed;
+  unsigned int prefetch_hits;
+  double prefetch_hit_rate;
+  unsigned int residency_hits;
+  double unmeshed_mean;
+  unsigned int unmeshed_max;
+  unsigned int meshes_avoided;
+  unsigned int stale_dropped;
+  unsigned int unloads_deferred;
+  double mesh_latency_mean;
+  double mesh_latency_max;
+} ReplaySummary;
+
+void replay_run(World *world, const CameraPath *path,
+                const ReplayConfig *config, ReplayFrame *frames);
+
+double replay_first_frame(World *world, const CameraPath *path,
+                          unsigned int *chunks_meshed);
+
+void replay_summarize(const ReplayFrame *frames, unsigned int frame_count,
+                      ReplaySummary *summary);
+
+void replay_write_csv(FILE *file, const ReplayFrame *frames,
+                      unsigned int frame_count);
@@ -0,0 +1,451 @@
+#include "residency.h"
+
+#include "block_type.h"
+#include "tracy/TracyC.h"
+#include "voxel_dag.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define residency_split_symbol 0
+#define residency_palette_capacity 255
+#define residency_run_capacity 255
+#define residency_default_capacity 1024
+
+MakeVectorDefinition(ResidentOrder);
+
+typedef struct ResidencyEncoder {
+  uint16_t palette_index[block_type_capacity];
+  BlockType palette[residency_palette_capacity];
+  unsigned int palette_size;
+  uint8_t *symbols;
+  unsigned int symbol_count;
+} ResidencyEncoder;
+
+typedef struct ResidencyDecoder {
+  const uint8_t *cursor;
+  const uint8_t *end;
+  const BlockType *palette;
+  unsigned int palette_size;
+  uint8_t symbol;
+  unsigned int remaining;
+} ResidencyDecoder;
+
+static bool residency_encode_node(ResidencyEncoder *encoder,
+                                  const VoxelNode *node) {
+  if (node->has_octants) {
+    encoder->symbols[encoder->symbol_count++] = residency_split_symbol;
+
+    for (unsigned int i = 0; i < 8; i++) {
+      if (!residency_encode_node(encoder, &node->octants[i])) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  uint16_t *index = &encoder->palette_index[node->block_type];
+
+  if (*index == UINT16_MAX) {
+    if (encoder->palette_size == residency_palette_capacity) {
+      return false;
+    }
+
+    *index = encoder->palette_size;
+    encoder->palette[encoder->palette_size++] = node->block_type;
+  }
+
+  encoder->symbols[encoder->symbol_count++] = *index + 1;
+
+  return true;
+}
+
+uint8_t *residency_compress(const VoxelNode *root, size_t *size) {
+  TracyCZone(residency_compress, true);
+
+  ResidencyEncoder encoder;
+  memset(encoder.palette_index, 0xff, sizeof(encoder.palette_index));
+  encoder.palette_size = 0;
+  encoder.symbols = malloc(voxel_node_count(root));
+  encoder.symbol_count = 0;
+
+  if (!residency_encode_node(&encoder, root)) {
+    free(encoder.symbols);
+    TracyCZoneEnd(residency_compress);
+    return NULL;
+  }
+
+  uint8_t *data = malloc(1 + encoder.palette_size * sizeof(BlockType) +
+                         encoder.symbol_count * 2);
+  uint8_t *cursor = data;
+
+  *cursor++ = encoder.palette_size;
+  memcpy(cursor, encoder.palette, encoder.palette_size * sizeof(BlockType));
+  cursor += encoder.palette_size * sizeof(BlockType);
+
+  for (unsigned int i = 0; i < encoder.symbol_count;) {
+    unsigned int run = 1;
+
+    while (i + run < encoder.symbol_count && run < residency_run_capacity &&
+           encoder.symbols[i + run] == encoder.symbols[i]) {
+      run++;
+    }
+
+    *cursor++ = encoder.symbols[i];
+    *cursor++ = run;
+    i += run;
+  }
+
+  free(encoder.symbols);
+
+  *size = cursor - data;
+
+  TracyCZoneEnd(residency_compress);
+  return realloc(data, *size);
+}
+
+static bool residency_next_symbol(ResidencyDecoder *decoder, uint8_t *symbol) {
+  if (decoder->remaining == 0) {
+    if (decoder->end - decoder->cursor < 2 || decoder->cursor[1] == 0) {
+      return false;
+    }
+
+    decoder->symbol = decoder->cursor[0];
+    decoder->remaining = decoder->cursor[1];
+    decoder->cursor += 2;
+  }
+
+  decoder->remaining--;
+  *symbol = decoder->symbol;
+
+  return true;
+}
+
+static bool residency_decode_node(ResidencyDecoder *decoder, VoxelNode *node,
+                                  unsigned int size) {
+  uint8_t symbol;
+
+  if (!residency_next_symbol(decoder, &symbol)) {
+    return false;
+  }
+
+  if (symbol == residency_split_symbol) {
+    if (size == 1) {
+      return false;
+    }
+
+    node->has_octants = true;
+    node->octants = voxel_octants_alloc();
+
+    for (unsigned int i = 0; i < 8; i++) {
+      if (!residency_decode_node(decoder, &node->octants[i], size / 2)) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  if (symbol > decoder->palette_size) {
+    return false;
+  }
+
+  node->has_octants = false;
+  node->block_type = decoder->palette[symbol - 1];
+  node->octants = NULL;
+
+  return true;
+}
+
+bool residency_decompress(const uint8_t *data, size_t size, VoxelNode *root) {
+  TracyCZone(residency_decompress, true);
+
+  BlockType palette[residency_palette_capacity];
+  ResidencyDecoder decoder = {.cursor = data, .end = data + size};
+
+  *root = (VoxelNode){0};
+
+  if (size == 0 || size < 1 + (size_t)data[0] * sizeof(BlockType)) {
+    TracyCZoneEnd(residency_decompress);
+    return false;
+  }
+
+  decoder.palette_size = *decoder.cursor++;
+  memcpy(palette, decoder.cursor, decoder.palette_size * sizeof(BlockType));
+  decoder.cursor += decoder.palette_size * sizeof(BlockType);
+  decoder.palette = palette;
+
+  if (!residency_decode_node(&decoder, root, chunk_size) ||
+      decoder.remaining != 0 || decoder.cursor != decoder.end) {
+    voxel_node_free(root);
+    *root = (VoxelNode){0};
+    TracyCZoneEnd(residency_decompress);
+    return false;
+  }
+
+  voxel_node_share(root);
+
+  TracyCZoneEnd(residency_decompress);
+  return true;
+}
+
+size_t residency_entry_bytes(size_t size) {
+  return size + sizeof(ResidentChunk) + sizeof(ResidentOrder);
+}
+
+static unsigned int residency_hash(const Vec3i position) {
+  uint32_t hash = (uint32_t)position[0] * 73856093u ^
+                  (uint32_t)position[1] * 19349663u ^
+                  (uint32_t)position[2] * 83492791u;
+
+  return hash ^ hash >> 15;
+}
+
+static unsigned int residency_find(const ChunkResidency *residency,
+                                   const Vec3i position) {
+  unsigned int mask = residency->capacity - 1;
+  unsigned int index = residency_hash(position) & mask;
+
+  while (residency->entries[index].used &&
+         !vec3i_compare(residency->entries[index].position, position)) {
+    index = (index + 1) & mask;
+  }
+
+  return index;
+}
+
+static void residency_grow(ChunkResidency *residency) {
+  ResidentChunk *entries = residency->entries;
+  unsigned int capacity = residency->capacity;
+
+  residency->capacity *= 2;
+  residency->entries = calloc(residency->capacity, sizeof(ResidentChunk));
+
+  for (unsigned int i = 0; i < capacity; i++) {
+    if (entries[i].used) {
+      residency->entries[residency_find(residency, entries[i].position)] =
+          entries[i];
+    }
+  }
+
+  free(entries);
+}
+
+static void residency_remove(ChunkResidency *residency, unsigned int index) {
+  ResidentChunk *entry = &residency->entries[index];
+  unsigned int mask = residency->capacity - 1;
+  unsigned int hole = index;
+
+  residency->stats.resident_bytes -=
+      residency_entry_bytes(entry->size + entry->updates_size);
+  residency->stats.resident_chunks--;
+  free(entry->data);
+
+  for (unsigned int next = (hole + 1) & mask; residency->entries[next].used;
+       next = (next + 1) & mask) {
+    unsigned int home =
+        residency_hash(residency->entries[next].position) & mask;
+
+    if (((next - home) & mask) >= ((next - hole) & mask)) {
+      residency->entries[hole] = residency->entries[next];
+      hole = next;
+    }
+  }
+
+  residency->entries[hole].used = false;
+}
+
+static bool residency_in_range(const ChunkResidency *residency,
+                               const Vec3i position) {
+  for (unsigned int axis = 0; axis < 3; axis++) {
+    if (abs(position[axis] - residency->center[axis]) >
+        (int)residency->config.keep_distance) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static bool residency_order_live(const ChunkResidency *residency,
+                                 const ResidentOrder *order,
+                                 unsigned int *index) {
+  *index = residency_find(residency, order->position);
+
+  return residency->entries[*index].used &&
+         residency->entries[*index].stamp == order->stamp;
+}
+
+static void residency_compact(ChunkResidency *residency) {
+  unsigned int size = 0;
+
+  for (unsigned int i = residency->order_head; i < residency->order.size;
+       i++) {
+    unsigned int index;
+
+    if (residency_order_live(residency, &residency->order.data[i], &index)) {
+      residency->order.data[size++] = residency->order.data[i];
+    }
+  }
+
+  residency->order.size = size;
+  residency->order_head = 0;
+}
+
+static void residency_trim(ChunkResidency *residency) {
+  while (residency->stats.resident_bytes > residency->config.memory_budget &&
+         residency->order_head < residency->order.size) {
+    unsigned int index;
+    const ResidentOrder *order =
+        &residency->order.data[residency->order_head++];
+
+    if (residency_order_live(residency, order, &index)) {
+      residency_remove(residency, index);
+      residency->stats.evicted++;
+    }
+  }
+
+  if (residency->order.size - residency->order_head >
+      2 * residency->stats.resident_chunks + residency_default_capacity) {
+    residency_compact(residency);
+  }
+}
+
+void residency_init(ChunkResidency *residency) {
+  residency->config = (ResidencyConfig){
+      .enabled = true,
+      .keep_distance = 16,
+      .memory_budget = 32 * 1024 * 1024,
+  };
+  residency->stats = (ResidencyStats){0};
+  residency->capacity = residency_default_capacity;
+  residency->entries = calloc(residency->capacity, sizeof(ResidentChunk));
+  vector_init_ResidentOrder(&residency->order, residency_default_capacity);
+  residency->order_head = 0;
+  residency->stamp = 0;
+  vec3i_copy(residency->center, (Vec3i){0, 0, 0});
+}
+
+void residency_update(ChunkResidency *residency, const Vec3i center) {
+  if (vec3i_compare(residency->center, center)) {
+    return;
+  }
+
+  vec3i_copy(residency->center, center);
+
+  for (unsigned int i = residency->order_head; i < residency->order.size;
+       i++) {
+    unsigned int index;
+    const ResidentOrder *order = &residency->order.data[i];
+
+    if (!residency_in_range(residency, order->position) &&
+        residency_order_live(residency, order, &index)) {
+      residency_remove(residency, index);
+      residency->stats.evicted++;
+    }
+  }
+
+  residency_compact(residency);
+}
+
+bool residency_contains(const ChunkResidency *residency,
+                        const Vec3i position) {
+  return residency->entries[residency_find(residency, position)].used;
+}
+
+bool residency_store(ChunkResidency *residency, const Vec3i position,
+                     const VoxelNode *root, const uint8_t *updates,
+                     size_t updates_size) {
+  if (!residency->config.enabled || !residency_in_range(residency, position)) {
+    return false;
+  }
+
+  size_t size;
+  uint8_t *data = residency_compress(root, &size);
+
+  if (data == NULL || updates_size > UINT32_MAX ||
+      residency_entry_bytes(size + updates_size) >
+          residency->config.memory_budget) {
+    free(data);
+    residency->stats.rejected++;
+    return false;
+  }
+
+  if (updates_size != 0) {
+    data = realloc(data, size + updates_size);
+    memcpy(data + size, updates, updates_size);
+  }
+
+  unsigned int index = residency_find(residency, position);
+
+  if (residency->entries[index].used) {
+    residency_remove(residency, index);
+  }
+
+  if ((residency->stats.resident_chunks + 1) * 2 > residency->capacity) {
+    residency_grow(residency);
+  }
+
+  index = residency_find(residency, position);
+
+  ResidentChunk *entry = &residency->entries[index];
+  vec3i_copy(entry->position, position);
+  entry->used = true;
+  entry->stamp = ++residency->stamp;
+  entry->size = size;
+  entry->updates_size = updates_size;
+  entry->data = data;
+
+  ResidentOrder order = {.stamp = entry->stamp};
+  vec3i_copy(order.position, position);
+  vector_insert_ResidentOrder(&residency->order, order);
+
+  residency->stats.stored++;
+  residency->stats.resident_chunks++;
+  residency->stats.resident_bytes +=
+      residency_entry_bytes(size + updates_size);
+
+  residency_trim(residency);
+
+  return true;
+}
+
+bool residency_take(ChunkResidency *residency, const Vec3i position,
+                    VoxelNode *root, uint8_t **updates, size_t *updates_size) {
+  unsigned int index = residency_find(residency, position);
+  ResidentChunk *entry = &residency->entries[index];
+
+  *updates = NULL;
+  *updates_size = 0;
+
+  if (!entry->used) {
+    return false;
+  }
+
+  bool decompressed = residency_decompress(entry->data, entry->size, root);
+
+  if (decompressed && entry->updates_size != 0) {
+    *updates_size = entry->updates_size;
+    *updates = malloc(*updates_size);
+    memcpy(*updates, entry->data + entry->size, *updates_size);
+  }
+
+  residency_remove(residency, index);
+
+  if (decompressed) {
+    residency->stats.hits++;
+  }
+
+  return decompressed;
+}
+
+void residency_free(ChunkResidency *residency) {
+  for (unsigned int i = 0; i < residency->capacity; i++) {
+    if (residency->entries[i].used) {
+      free(residency->entries[i].data);
+    }
+  }
+
+  free(residency->entries);
+  vector_free_ResidentOrder(&residency->order);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "chunk.h"
+#include "vec3.h"
+#include "vector.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct ResidentChunk {
+  Vec3i position;
+  bool used;
+  uint32_t stamp;
+  uint32_t size;
+  uint32_t updates_size;
+  uint8_t *data;
+} ResidentChunk;
+
+typedef struct ResidentOrder {
+  Vec3i position;
+  uint32_t stamp;
+} ResidentOrder;
+
+MakeVectorDeclaration(ResidentOrder);
+
+typedef struct ResidencyConfig {
+  bool enabled;
+  unsigned int keep_distance;
+  size_t memory_budget;
+} ResidencyConfig;
+
+typedef struct ResidencyStats {
+  unsigned int stored;
+  unsigned int hits;
+  unsigned int evicted;
+  unsigned int rejected;
+  unsigned int resident_chunks;
+  size_t resident_bytes;
+} ResidencyStats;
+
+typedef struct ChunkResidency {
+  ResidencyConfig config;
+  ResidencyStats stats;
+  ResidentChunk *entries;
+  unsigned int capacity;
+  Vector_ResidentOrder order;
+  unsigned int order_head;
+  uint32_t stamp;
+  Vec3i center;
+} ChunkResidency;
+
+uint8_t *residency_compress(const VoxelNode *root, size_t *size);
+
+bool residency_decompress(const uint8_t *data, size_t size, VoxelNode *root);
+
+size_t residency_entry_bytes(size_t size);
+
+void residency_init(ChunkResidency *residency);
+
+void residency_update(ChunkResidency *residency, const Vec3i center);
+
+bool residency_contains(const ChunkResidency *residency, const Vec3i position);
+
+bool residency_store(ChunkResidency *residency, const Vec3i position,
+                     const VoxelNode *root, const uint8_t *updates,
+                     size_t updates_size);
+
+bool residency_take(ChunkResidency *residency, const Vec3i position,
+                    VoxelNode *root, uint8_t **updates, size_t *updates_size);
+
+void residency_free(ChunkResidency *residency);
@@ -0,0 +1,277 @@
+#include "simulation.h"
+
+#include "block_update.h"
+#include "fluid.h"
+#include "math_util.h"
+#include "tracy/TracyC.h"
+#include <math.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define simulation_fresh (1u << 31)
+#define simulation_max_lag 4
+
+MakeVectorDefinition(SimulationEdit);
+
+static void simulation_frame_init(SimulationFrame *frame) {
+  *frame = (SimulationFrame){0};
+  vector_init_ChunkUpload(&frame->uploads, 0);
+  vector_init_SimulationEdit(&frame->edits, 0);
+}
+
+static void simulation_frame_clear(SimulationFrame *frame) {
+  for (unsigned int i = 0; i < frame->uploads.size; i++) {
+    vector_free_float(&frame->uploads.data[i].mesh.vertices);
+    vector_free_float(&frame->uploads.data[i].mesh.normals);
+  }
+
+  vector_clear_ChunkUpload(&frame->uploads);
+  vector_clear_SimulationEdit(&frame->edits);
+}
+
+static void simulation_move_uploads(Vector_ChunkUpload *uploads,
+                                    Vector_ChunkUpload *source) {
+  if (source->size != 0) {
+    vector_append_ChunkUpload(uploads, source->data, source->size);
+    vector_clear_ChunkUpload(source);
+  }
+}
+
+static void simulation_move_edits(Vector_SimulationEdit *edits,
+                                  Vector_SimulationEdit *source) {
+  if (source->size != 0) {
+    vector_append_SimulationEdit(edits, source->data, source->size);
+    vector_clear_SimulationEdit(source);
+  }
+}
+
+static void simulation_frame_merge(SimulationFrame *frame,
+                                   SimulationFrame *newer) {
+  simulation_move_uploads(&frame->uploads, &newer->uploads);
+  simulation_move_edits(&frame->edits, &newer->edits);
+
+  frame->tick = newer->tick;
+  frame->time = newer->time;
+  frame->camera = newer->camera;
+  frame->stats = newer->stats;
+}
+
+void simulation_init(Simulation *simulation, World *world, double timestep) {
+  simulation->world = world;
+  simulation->timestep = timestep;
+  simulation->camera = (Camera){.transform = {.scale = {1, 1, 1}}};
+
+  for (unsigned int i = 0; i < simulation_frame_count; i++) {
+    simulation_frame_init(&simulation->frames[i]);
+  }
+
+  simulation->back = 0;
+  atomic_init(&simulation->handoff, 1);
+  simulation->front = 2;
+
+  simulation->input_camera = simulation->camera.transform;
+  vector_init_SimulationEdit(&simulation->input_edits, 0);
+  mtx_init(&simulation->input_mutex, mtx_plain);
+
+  simulation->tick_count = 0;
+  simulation->overruns = 0;
+  simulation->ticks_dropped = 0;
+  simulation->frames_merged = 0;
+  simulation->frames_presented = 0;
+  simulation->uploads_applied = 0;
+  simulation->buffers_grown = 0;
+  atomic_init(&simulation->running, false);
+
+  world->defer_uploads = true;
+}
+
+void simulation_set_camera(Simulation *simulation, const Transform *transform) {
+  mtx_lock(&simulation->input_mutex);
+  simulation->input_camera = *transform;
+  mtx_unlock(&simulation->input_mutex);
+}
+
+void simulation_edit(Simulation *simulation, const Vec3i block,
+                     BlockType block_type) {
+  SimulationEdit edit = {.block_type = block_type};
+  vec3i_copy(edit.block, block);
+
+  mtx_lock(&simulation->input_mutex);
+  vector_insert_SimulationEdit(&simulation->input_edits, edit);
+  mtx_unlock(&simulation->input_mutex);
+}
+
+static void simulation_publish(Simulation *simulation) {
+  unsigned int handoff = atomic_load(&simulation->handoff);
+
+  if (handoff & simulation_fresh &&
+      atomic_compare_exchange_strong(&simulation->handoff, &handoff,
+                                     simulation->back)) {
+    unsigned int unread = handoff & ~simulation_fresh;
+
+    simulation_frame_merge(&simulation->frames[unread],
+                           &simulation->frames[simulation->back]);
+    simulation->back = unread;
+    simulation->frames_merged++;
+  }
+
+  simulation->back = atomic_exchange(&simulation->handoff,
+                                     simulation->back | simulation_fresh);
+  simulation_frame_clear(&simulation->frames[simulation->back]);
+}
+
+void simulation_tick(Simulation *simulation) {
+  TracyCZone(simulation_tick, true);
+
+  double start = world_now();
+  World *world = simulation->world;
+  SimulationFrame *frame = &simulation->frames[simulation->back];
+
+  mtx_lock(&simulation->input_mutex);
+  simulation->camera.transform = simulation->input_camera;
+  simulation_move_edits(&frame->edits, &simulation->input_edits);
+  mtx_unlock(&simulation->input_mutex);
+
+  for (unsigned int i = 0; i < frame->edits.size; i++) {
+    const SimulationEdit *edit = &frame->edits.data[i];
+    world_set_block_type(world, edit->block, edit->block_type);
+  }
+
+  block_update_update(&world->updates, simulation->timestep);
+  fluid_update(&world->fluid, simulation->timestep);
+  world_load(world, &simulation->camera);
+
+  frame->tick = simulation->tick_count;
+  frame->time = simulation->tick_count * simulation->timestep;
+  frame->camera = simulation->camera.transform;
+  frame->stats = world->stats;
+  simulation_move_uploads(&frame->uploads, &world->uploads);
+
+  simulation_publish(simulation);
+
+  double elapsed = world_now() - start;
+
+  simulation->tick_times[simulation->tick_count % simulation_tick_samples] =
+      elapsed;
+  simulation->tick_count++;
+  simulation->overruns += elapsed > simulation->timestep;
+
+  TracyCZoneEnd(simulation_tick);
+}
+
+static void simulation_sleep(double seconds) {
+  struct timespec duration = {.tv_sec = seconds,
+                              .tv_nsec = fmod(seconds, 1) * 1e9};
+  thrd_sleep(&duration, NULL);
+}
+
+static int simulation_run(void *data) {
+  Simulation *simulation = data;
+  double deadline = world_now();
+
+  while (atomic_load(&simulation->running)) {
+    simulation_tick(simulation);
+    deadline += simulation->timestep;
+
+    double now = world_now();
+
+    if (now - deadline > simulation_max_lag * simulation->timestep) {
+      simulation->ticks_dropped += (now - deadline) / simulation->timestep;
+      deadline = now;
+    } else if (deadline > now) {
+      simulation_sleep(deadline - now);
+    }
+  }
+
+  return 0;
+}
+
+void simulation_start(Simulation *simulation) {
+  if (atomic_exchange(&simulation->running, true)) {
+    return;
+  }
+
+  thrd_create(&simulation->thread, simulation_run, simulation);
+}
+
+void simulation_stop(Simulation *simulation) {
+  if (!atomic_exchange(&simulation->running, false)) {
+    return;
+  }
+
+  thrd_join(simulation->thread, NULL);
+}
+
+const SimulationFrame *simulation_present(Simulation *simulation) {
+  if (atomic_load(&simulation->handoff) & simulation_fresh) {
+    simulation->front =
+        atomic_exchange(&simulation->handoff, simulation->front) &
+        ~simulation_fresh;
+
+    SimulationFrame *frame = &simulation->frames[simulation->front];
+
+    simulation->uploads_applied += frame->uploads.size;
+    simulation->buffers_grown +=
+        world_apply_uploads(simulation->world, &frame->uploads);
+    simulation->frames_presented++;
+  }
+
+  return &simulation->frames[simulation->front];
+}
+
+static int simulation_compare_double(const void *a, const void *b) {
+  double value_a = *(const double *)a;
+  double value_b = *(const double *)b;
+
+  return (value_a > value_b) - (value_a < value_b);
+}
+
+void simulation_summarize(const Simulation *simulation,
+                          SimulationSummary *summary) {
+  unsigned int count = min(simulation->tick_count, simulation_tick_samples);
+
+  *summary = (SimulationSummary){
+      .ticks = simulation->tick_count,
+      .overruns = simulation->overruns,
+      .ticks_dropped = simulation->ticks_dropped,
+      .frames_merged = simulation->frames_merged,
+      .frames_presented = simulation->frames_presented,
+      .uploads_applied = simulation->uploads_applied,
+      .buffers_grown = simulation->buffers_grown,
+  };
+
+  if (count == 0) {
+    return;
+  }
+
+  double *tick_times = malloc(sizeof(double) * count);
+
+  for (unsigned int i = 0; i < count; i++) {
+    tick_times[i] = simulation->tick_times[i];
+    summary->tick_time_mean += tick_times[i] / count;
+  }
+
+  qsort(tick_times, count, sizeof(double), simulation_compare_double);
+
+  summary->tick_time_p50 = tick_times[count / 2];
+  summary->tick_time_p95 = tick_times[count * 95 / 100];
+  summary->tick_time_p99 = tick_times[count * 99 / 100];
+  summary->tick_time_max = tick_times[count - 1];
+
+  free(tick_times);
+}
+
+void simulation_free(Simulation *simulation) {
+  simulation_stop(simulation);
+
+  for (unsigned int i = 0; i < simulation_frame_count; i++) {
+    simulation_frame_clear(&simulation->frames[i]);
+    vector_free_ChunkUpload(&simulation->frames[i].uploads);
+    vector_free_SimulationEdit(&simulation->frames[i].edits);
+  }
+
+  vector_free_SimulationEdit(&simulation->input_edits);
+  mtx_destroy(&simulation->input_mutex);
+
+  simulation->world->defer_uploads = false;
+}
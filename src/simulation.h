@@ -0,0 +1,89 @@
+#pragma once
+
+#include "block_type.h"
+#include "camera.h"
+#include "transform.h"
+#include "vec3.h"
+#include "vector.h"
+#include "world.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <threads.h>
+
+#define simulation_frame_count 3
+#define simulation_tick_samples 4096
+#define simulation_default_timestep (1.0 / 30)
+
+typedef struct SimulationEdit {
+  Vec3i block;
+  BlockType block_type;
+} SimulationEdit;
+
+MakeVectorDeclaration(SimulationEdit);
+
+typedef struct SimulationFrame {
+  unsigned int tick;
+  double time;
+  Transform camera;
+  Vector_ChunkUpload uploads;
+  Vector_SimulationEdit edits;
+  WorldStats stats;
+} SimulationFrame;
+
+typedef struct SimulationSummary {
+  unsigned int ticks;
+  unsigned int overruns;
+  unsigned int ticks_dropped;
+  unsigned int frames_merged;
+  unsigned int frames_presented;
+  unsigned int uploads_applied;
+  unsigned int buffers_grown;
+  double tick_time_mean;
+  double tick_time_p50;
+  double tick_time_p95;
+  double tick_time_p99;
+  double tick_time_max;
+} SimulationSummary;
+
+typedef struct Simulation {
+  World *world;
+  double timestep;
+  Camera camera;
+  SimulationFrame frames[simulation_frame_count];
+  atomic_uint handoff;
+  unsigned int back;
+  unsigned int front;
+  Transform input_camera;
+  Vector_SimulationEdit input_edits;
+  mtx_t input_mutex;
+  double tick_times[simulation_tick_samples];
+  unsigned int tick_count;
+  unsigned int overruns;
+  unsigned int ticks_dropped;
+  unsigned int frames_merged;
+  unsigned int frames_presented;
+  unsigned int uploads_applied;
+  unsigned int buffers_grown;
+  thrd_t thread;
+  atomic_bool running;
+} Simulation;
+
+void simulation_init(Simulation *simulation, World *world, double timestep);
+
+void simulation_set_camera(Simulation *simulation, const Transform *transform);
+
+void simulation_edit(Simulation *simulation, const Vec3i block,
+                     BlockType block_type);
+
+void simulation_tick(Simulation *simulation);
+
+void simulation_start(Simulation *simulation);
+
+void simulation_stop(Simulation *simulation);
+
+const SimulationFrame *simulation_present(Simulation *simulation);
+
+void simulation_summarize(const Simulation *simulation,
+                          SimulationSummary *summary);
+
+void simulation_free(Simulation *simulation);
@@ -0,0 +1,708 @@
+#include "stream.h"
+
+#include "chunk.h"
+#include "math_util.h"
+#include "residency.h"
+#include "tracy/TracyC.h"
+#include "voxel_dag.h"
+#include "world.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define stream_window_volume                                                   \
+  (render_distance * render_distance * render_distance)
+#define stream_varint_bytes 10
+
+MakeVectorDefinition(StreamEdit);
+
+typedef struct StreamReader {
+  const uint8_t *cursor;
+  const uint8_t *end;
+} StreamReader;
+
+static void stream_write_varint(Vector_uint8_t *bytes, uint64_t value) {
+  while (value >= 0x80) {
+    vector_insert_uint8_t(bytes, value | 0x80);
+    value >>= 7;
+  }
+
+  vector_insert_uint8_t(bytes, value);
+}
+
+static void stream_write_signed(Vector_uint8_t *bytes, int64_t value) {
+  stream_write_varint(bytes, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+static void stream_write_position(Vector_uint8_t *bytes,
+                                  const Vec3i position) {
+  for (unsigned int axis = 0; axis < 3; axis++) {
+    stream_write_signed(bytes, position[axis]);
+  }
+}
+
+static bool stream_read_varint(StreamReader *reader, uint64_t *value) {
+  *value = 0;
+
+  for (unsigned int i = 0; i < stream_varint_bytes; i++) {
+    if (reader->cursor == reader->end) {
+      return false;
+    }
+
+    uint8_t byte = *reader->cursor++;
+    *value |= (uint64_t)(byte & 0x7f) << (7 * i);
+
+    if (!(byte & 0x80)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static bool stream_read_signed(StreamReader *reader, int64_t *value) {
+  uint64_t encoded;
+
+  if (!stream_read_varint(reader, &encoded)) {
+    return false;
+  }
+
+  *value = (int64_t)(encoded >> 1) ^ -(int64_t)(encoded & 1);
+
+  return true;
+}
+
+static bool stream_read_position(StreamReader *reader, Vec3i position) {
+  for (unsigned int axis = 0; axis < 3; axis++) {
+    int64_t value;
+
+    if (!stream_read_signed(reader, &value)) {
+      return false;
+    }
+
+    position[axis] = value;
+  }
+
+  return true;
+}
+
+static void stream_encode_tree(Vector_uint8_t *bytes, const VoxelNode *node) {
+  if (!node->has_octants) {
+    stream_write_varint(bytes, node->block_type + 1);
+    return;
+  }
+
+  stream_write_varint(bytes, 0);
+
+  for (unsigned int i = 0; i < 8; i++) {
+    stream_encode_tree(bytes, &node->octants[i]);
+  }
+}
+
+static bool stream_decode_tree(StreamReader *reader, VoxelNode *node,
+                               unsigned int size) {
+  uint64_t symbol;
+
+  if (!stream_read_varint(reader, &symbol)) {
+    return false;
+  }
+
+  if (symbol == 0) {
+    if (size == 1) {
+      return false;
+    }
+
+    node->has_octants = true;
+    node->octants = voxel_octants_alloc();
+
+    for (unsigned int i = 0; i < 8; i++) {
+      if (!stream_decode_tree(reader, &node->octants[i], size / 2)) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  if (symbol > block_registry.size) {
+    return false;
+  }
+
+  node->has_octants = false;
+  node->block_type = symbol - 1;
+  node->octants = NULL;
+
+  return true;
+}
+
+uint8_t *stream_encode_chunk(const VoxelNode *root, size_t *size) {
+  size_t palette_size;
+  uint8_t *palette = residency_compress(root, &palette_size);
+
+  if (palette != NULL) {
+    uint8_t *data = malloc(palette_size + 1);
+    data[0] = STREAM_CHUNK_PALETTE;
+    memcpy(data + 1, palette, palette_size);
+    free(palette);
+
+    *size = palette_size + 1;
+    return data;
+  }
+
+  Vector_uint8_t bytes;
+  vector_init_uint8_t(&bytes, 256);
+  vector_insert_uint8_t(&bytes, STREAM_CHUNK_TREE);
+  stream_encode_tree(&bytes, root);
+
+  *size = bytes.size;
+  return vector_release_uint8_t(&bytes);
+}
+
+bool stream_decode_chunk(const uint8_t *data, size_t size, VoxelNode *root) {
+  *root = (VoxelNode){0};
+
+  if (size < 2) {
+    return false;
+  }
+
+  if (data[0] == STREAM_CHUNK_PALETTE) {
+    size_t palette_size = data[1];
+
+    if (size < 2 + palette_size * sizeof(BlockType)) {
+      return false;
+    }
+
+    for (size_t i = 0; i < palette_size; i++) {
+      BlockType block_type;
+      memcpy(&block_type, data + 2 + i * sizeof(BlockType), sizeof(BlockType));
+
+      if (block_type >= block_registry.size) {
+        return false;
+      }
+    }
+
+    return residency_decompress(data + 1, size - 1, root);
+  }
+
+  StreamReader reader = {data + 1, data + size};
+
+  if (data[0] != STREAM_CHUNK_TREE ||
+      !stream_decode_tree(&reader, root, chunk_size) ||
+      reader.cursor != reader.end) {
+    voxel_node_free(root);
+    *root = (VoxelNode){0};
+    return false;
+  }
+
+  voxel_node_share(root);
+
+  return true;
+}
+
+static void stream_connection_init(StreamConnection *connection,
+                                   Transport transport) {
+  connection->transport = transport;
+  vector_init_uint8_t(&connection->message, 0);
+  vector_init_uint8_t(&connection->outgoing, 0);
+  vector_init_uint8_t(&connection->incoming, 0);
+  connection->outgoing_head = 0;
+  connection->incoming_head = 0;
+  connection->open = true;
+}
+
+static size_t stream_connection_pending(const StreamConnection *connection) {
+  return connection->outgoing.size - connection->outgoing_head;
+}
+
+static size_t stream_connection_push(StreamConnection *connection,
+                                     StreamMessageKind kind) {
+  size_t start = connection->outgoing.size;
+
+  stream_write_varint(&connection->outgoing, connection->message.size + 1);
+  vector_insert_uint8_t(&connection->outgoing, kind);
+  vector_append_uint8_t(&connection->outgoing, connection->message.data,
+                        connection->message.size);
+  vector_clear_uint8_t(&connection->message);
+
+  return connection->outgoing.size - start;
+}
+
+static void stream_connection_flush(StreamConnection *connection) {
+  size_t pending = stream_connection_pending(connection);
+
+  if (pending == 0 || !connection->open) {
+    return;
+  }
+
+  size_t sent;
+  connection->open = transport_send(
+      &connection->transport,
+      connection->outgoing.data + connection->outgoing_head, pending, &sent);
+  connection->outgoing_head += sent;
+
+  if (connection->outgoing_head == connection->outgoing.size) {
+    vector_clear_uint8_t(&connection->outgoing);
+    connection->outgoing_head = 0;
+  } else if (connection->outgoing_head >= connection->outgoing.size / 2) {
+    memmove(connection->outgoing.data,
+            connection->outgoing.data + connection->outgoing_head,
+            stream_connection_pending(connection));
+    connection->outgoing.size -= connection->outgoing_head;
+    connection->outgoing_head = 0;
+  }
+}
+
+static size_t stream_connection_receive(StreamConnection *connection) {
+  Vector_uint8_t *incoming = &connection->incoming;
+  size_t total = 0;
+
+  if (connection->incoming_head != 0) {
+    memmove(incoming->data, incoming->data + connection->incoming_head,
+            incoming->size - connection->incoming_head);
+    incoming->size -= connection->incoming_head;
+    connection->incoming_head = 0;
+  }
+
+  while (connection->open) {
+    uint8_t *bytes = vector_extend_uint8_t(incoming, stream_receive_bytes);
+    size_t received;
+
+    connection->open = transport_receive(&connection->transport, bytes,
+                                         stream_receive_bytes, &received);
+    incoming->size -= stream_receive_bytes - received;
+    total += received;
+
+    if (received == 0) {
+      break;
+    }
+  }
+
+  return total;
+}
+
+static bool stream_connection_next(StreamConnection *connection,
+                                   StreamMessageKind *kind,
+                                   StreamReader *payload) {
+  const Vector_uint8_t *incoming = &connection->incoming;
+  StreamReader reader = {incoming->data + connection->incoming_head,
+                         incoming->data + incoming->size};
+  uint64_t length;
+
+  if (!stream_read_varint(&reader, &length) || length == 0 ||
+      (uint64_t)(reader.end - reader.cursor) < length) {
+    return false;
+  }
+
+  *kind = reader.cursor[0];
+  payload->cursor = reader.cursor + 1;
+  payload->end = reader.cursor + length;
+  connection->incoming_head = payload->end - incoming->data;
+
+  return true;
+}
+
+static void stream_connection_free(StreamConnection *connection) {
+  transport_close(&connection->transport);
+  vector_free_uint8_t(&connection->message);
+  vector_free_uint8_t(&connection->outgoing);
+  vector_free_uint8_t(&connection->incoming);
+  connection->open = false;
+}
+
+static unsigned int stream_slot(const Vec3i position) {
+  return (mod(position[0], render_distance) * render_distance +
+          mod(position[1], render_distance)) *
+             render_distance +
+         mod(position[2], render_distance);
+}
+
+static bool stream_in_window(const Vec3i view, const Vec3i position) {
+  for (unsigned int axis = 0; axis < 3; axis++) {
+    int offset = position[axis] - view[axis];
+
+    if (offset < -render_distance / 2 || offset >= render_distance / 2) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static int stream_edit_compare(const void *a, const void *b) {
+  const StreamEdit *edit_a = a;
+  const StreamEdit *edit_b = b;
+
+  for (unsigned int axis = 0; axis < 3; axis++) {
+    if (edit_a->chunk[axis] != edit_b->chunk[axis]) {
+      return (edit_a->chunk[axis] > edit_b->chunk[axis]) -
+             (edit_a->chunk[axis] < edit_b->chunk[axis]);
+    }
+  }
+
+  if (edit_a->cell != edit_b->cell) {
+    return (edit_a->cell > edit_b->cell) - (edit_a->cell < edit_b->cell);
+  }
+
+  return (edit_a->sequence > edit_b->sequence) -
+         (edit_a->sequence < edit_b->sequence);
+}
+
+static unsigned int stream_edit_run(const StreamEdit *edits,
+                                    unsigned int begin, unsigned int end) {
+  unsigned int run = 1;
+
+  while (begin + run < end &&
+         edits[begin + run].cell == edits[begin].cell + run &&
+         edits[begin + run].block_type == edits[begin].block_type) {
+    run++;
+  }
+
+  return run;
+}
+
+void stream_server_init(StreamServer *server, World *world,
+                        Transport transport) {
+  server->world = world;
+  stream_connection_init(&server->connection, transport);
+  vec3i_copy(server->view, (Vec3i){0, 0, 0});
+  server->has_view = false;
+  server->sent = malloc(sizeof(Vec3i) * stream_window_volume);
+  server->sent_valid = calloc(stream_window_volume, sizeof(bool));
+  vector_init_StreamEdit(&server->edits, 0);
+  server->sequence = 0;
+  server->batch_bytes = stream_batch_bytes;
+  server->stats = (StreamStats){0};
+}
+
+static bool stream_server_has_chunk(const StreamServer *server,
+                                    const Vec3i position) {
+  unsigned int slot = stream_slot(position);
+
+  return server->sent_valid[slot] &&
+         vec3i_compare(server->sent[slot], position);
+}
+
+void stream_server_edit(StreamServer *server, const Vec3i block,
+                        BlockType block_type) {
+  StreamEdit edit = {.sequence = server->sequence++,
+                     .block_type = block_type};
+  Vec3i local;
+  world_block_to_chunk(block, edit.chunk, local);
+
+  if (!stream_server_has_chunk(server, edit.chunk)) {
+    return;
+  }
+
+  edit.cell = local[0] + chunk_size * (local[1] + chunk_size * local[2]);
+  vector_insert_StreamEdit(&server->edits, edit);
+}
+
+static void stream_server_receive(StreamServer *server) {
+  StreamMessageKind kind;
+  StreamReader payload;
+
+  stream_connection_receive(&server->connection);
+
+  while (stream_connection_next(&server->connection, &kind, &payload)) {
+    Vec3i view;
+
+    if (kind != STREAM_MESSAGE_VIEW || !stream_read_position(&payload, view)) {
+      continue;
+    }
+
+    vec3i_copy(server->view, view);
+    server->has_view = true;
+
+    for (unsigned int slot = 0; slot < stream_window_volume; slot++) {
+      if (server->sent_valid[slot] &&
+          !stream_in_window(view, server->sent[slot])) {
+        server->sent_valid[slot] = false;
+      }
+    }
+  }
+}
+
+static void stream_server_send_edits(StreamServer *server) {
+  Vector_StreamEdit *edits = &server->edits;
+  Vector_uint8_t *message = &server->connection.message;
+
+  if (edits->size == 0) {
+    return;
+  }
+
+  double start = world_now();
+  unsigned int count = 0;
+
+  qsort(edits->data, edits->size, sizeof(StreamEdit), stream_edit_compare);
+
+  for (unsigned int i = 0; i < edits->size; i++) {
+    const StreamEdit *edit = &edits->data[i];
+
+    if (i + 1 < edits->size && edits->data[i + 1].cell == edit->cell &&
+        vec3i_compare(edits->data[i + 1].chunk, edit->chunk)) {
+      continue;
+    }
+
+    if (stream_server_has_chunk(server, edit->chunk)) {
+      edits->data[count++] = *edit;
+    }
+  }
+
+  Vec3i previous = {0, 0, 0};
+
+  for (unsigned int begin = 0; begin < count;) {
+    const StreamEdit *first = &edits->data[begin];
+    unsigned int end = begin + 1;
+
+    while (end < count && vec3i_compare(edits->data[end].chunk, first->chunk)) {
+      end++;
+    }
+
+    if (end - begin > stream_resend_edits) {
+      server->sent_valid[stream_slot(first->chunk)] = false;
+      server->stats.chunks_resent++;
+      begin = end;
+      continue;
+    }
+
+    unsigned int run_count = 0;
+
+    for (unsigned int i = begin; i < end;
+         i += stream_edit_run(edits->data, i, end)) {
+      run_count++;
+    }
+
+    Vec3i delta = {first->chunk[0] - previous[0],
+                   first->chunk[1] - previous[1],
+                   first->chunk[2] - previous[2]};
+    stream_write_position(message, delta);
+    stream_write_varint(message, run_count);
+    vec3i_copy(previous, first->chunk);
+
+    uint32_t cell = 0;
+
+    for (unsigned int i = begin; i < end;) {
+      unsigned int run = stream_edit_run(edits->data, i, end);
+
+      stream_write_varint(message, edits->data[i].cell - cell);
+      stream_write_varint(message, edits->data[i].block_type);
+      stream_write_varint(message, run - 1);
+
+      cell = edits->data[i].cell + run;
+      i += run;
+    }
+
+    server->stats.edits += end - begin;
+    begin = end;
+  }
+
+  if (message->size != 0) {
+    size_t bytes =
+        stream_connection_push(&server->connection, STREAM_MESSAGE_EDITS);
+
+    server->stats.messages++;
+    server->stats.bytes += bytes;
+    server->stats.edit_bytes += bytes;
+  }
+
+  vector_clear_StreamEdit(edits);
+  server->stats.edit_time += world_now() - start;
+}
+
+static void stream_server_send_chunks(StreamServer *server) {
+  StreamConnection *connection = &server->connection;
+  const Vec3i *offsets = world_window_offsets();
+  double start = world_now();
+
+  for (unsigned int i = 0; i < stream_window_volume &&
+                           stream_connection_pending(connection) <
+                               server->batch_bytes;
+       i++) {
+    Vec3i position;
+    vec3i_add(position, server->view, offsets[i]);
+
+    if (stream_server_has_chunk(server, position)) {
+      continue;
+    }
+
+    const Chunk *chunk = world_get_loaded_chunk(server->world, position);
+
+    if (chunk == NULL) {
+      continue;
+    }
+
+    size_t size;
+    uint8_t *data = stream_encode_chunk(&chunk->root, &size);
+
+    stream_write_position(&connection->message, position);
+    vector_append_uint8_t(&connection->message, data, size);
+    free(data);
+
+    size_t bytes = stream_connection_push(connection, STREAM_MESSAGE_CHUNK);
+    unsigned int slot = stream_slot(position);
+
+    vec3i_copy(server->sent[slot], position);
+    server->sent_valid[slot] = true;
+
+    server->stats.messages++;
+    server->stats.chunks++;
+    server->stats.bytes += bytes;
+    server->stats.chunk_bytes += bytes;
+  }
+
+  server->stats.chunk_time += world_now() - start;
+}
+
+bool stream_server_update(StreamServer *server) {
+  TracyCZone(stream_server_update, true);
+
+  stream_server_receive(server);
+
+  if (server->has_view) {
+    stream_server_send_edits(server);
+    stream_server_send_chunks(server);
+  }
+
+  stream_connection_flush(&server->connection);
+
+  TracyCZoneEnd(stream_server_update);
+  return server->connection.open;
+}
+
+void stream_server_free(StreamServer *server) {
+  stream_connection_free(&server->connection);
+  free(server->sent);
+  free(server->sent_valid);
+  vector_free_StreamEdit(&server->edits);
+}
+
+void stream_client_init(StreamClient *client, World *world,
+                        Transport transport) {
+  client->world = world;
+  stream_connection_init(&client->connection, transport);
+  vec3i_copy(client->view, (Vec3i){0, 0, 0});
+  client->has_view = false;
+  client->stats = (StreamStats){0};
+
+  world->remote = true;
+  world->prefetch.config.enabled = false;
+}
+
+static void stream_client_apply_chunk(StreamClient *client,
+                                      StreamReader *payload) {
+  double start = world_now();
+  size_t bytes = payload->end - payload->cursor;
+  Vec3i position;
+  VoxelNode root;
+
+  if (!stream_read_position(payload, position) ||
+      !stream_decode_chunk(payload->cursor, payload->end - payload->cursor,
+                           &root)) {
+    return;
+  }
+
+  if (!stream_in_window(client->view, position)) {
+    voxel_node_free(&root);
+    client->stats.chunks_dropped++;
+    return;
+  }
+
+  world_install_chunk(client->world, position, root);
+
+  client->stats.chunks++;
+  client->stats.chunk_bytes += bytes;
+  client->stats.chunk_time += world_now() - start;
+}
+
+static void stream_client_apply_edits(StreamClient *client,
+                                      StreamReader *payload) {
+  double start = world_now();
+  Vec3i chunk = {0, 0, 0};
+
+  client->stats.edit_bytes += payload->end - payload->cursor;
+
+  while (payload->cursor != payload->end) {
+    Vec3i delta;
+    uint64_t run_count;
+
+    if (!stream_read_position(payload, delta) ||
+        !stream_read_varint(payload, &run_count)) {
+      break;
+    }
+
+    vec3i_add(chunk, chunk, delta);
+
+    uint64_t cell = 0;
+
+    for (uint64_t run = 0; run < run_count; run++) {
+      uint64_t skip;
+      uint64_t block_type;
+      uint64_t extra;
+
+      if (!stream_read_varint(payload, &skip) ||
+          !stream_read_varint(payload, &block_type) ||
+          !stream_read_varint(payload, &extra) ||
+          block_type >= block_registry.size) {
+        client->stats.edit_time += world_now() - start;
+        return;
+      }
+
+      cell += skip;
+
+      for (uint64_t end = cell + extra + 1; cell < end && cell < chunk_volume;
+           cell++) {
+        Vec3i block = {chunk[0] * chunk_size + cell % chunk_size,
+                       chunk[1] * chunk_size + cell / chunk_size % chunk_size,
+                       chunk[2] * chunk_size +
+                           cell / (chunk_size * chunk_size)};
+
+        world_set_block_type(client->world, block, block_type);
+        client->stats.edits++;
+      }
+    }
+  }
+
+  client->stats.edit_time += world_now() - start;
+}
+
+bool stream_client_update(StreamClient *client, const Vec3i view) {
+  TracyCZone(stream_client_update, true);
+
+  StreamConnection *connection = &client->connection;
+
+  if (!client->has_view || !vec3i_compare(client->view, view)) {
+    vec3i_copy(client->view, view);
+    client->has_view = true;
+
+    stream_write_position(&connection->message, view);
+    stream_connection_push(connection, STREAM_MESSAGE_VIEW);
+  }
+
+  stream_connection_flush(connection);
+  client->stats.bytes += stream_connection_receive(connection);
+
+  if (world_busy(client->world)) {
+    TracyCZoneEnd(stream_client_update);
+    return connection->open;
+  }
+
+  StreamMessageKind kind;
+  StreamReader payload;
+
+  while (stream_connection_next(connection, &kind, &payload)) {
+    client->stats.messages++;
+
+    if (kind == STREAM_MESSAGE_CHUNK) {
+      stream_client_apply_chunk(client, &payload);
+    } else if (kind == STREAM_MESSAGE_EDITS) {
+      stream_client_apply_edits(client, &payload);
+    }
+  }
+
+  TracyCZoneEnd(stream_client_update);
+  return connection->open ||
+         connection->incoming_head != connection->incoming.size;
+}
+
+void stream_client_free(StreamClient *client) {
+  stream_connection_free(&client->connection);
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "block_type.h"
+#include "chunk.h"
+#include "transport.h"
+#include "vec3.h"
+#include "vector.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define stream_batch_bytes (256 * 1024)
+#define stream_receive_bytes (64 * 1024)
+#define stream_resend_edits 512
+
+typedef struct World World;
+
+typedef enum StreamMessageKind {
+  STREAM_MESSAGE_VIEW,
+  STREAM_MESSAGE_CHUNK,
+  STREAM_MESSAGE_EDITS,
+} StreamMessageKind;
+
+typedef enum StreamChunkEncoding {
+  STREAM_CHUNK_PALETTE,
+  STREAM_CHUNK_TREE,
+} StreamChunkEncoding;
+
+typedef struct StreamEdit {
+  Vec3i chunk;
+  uint32_t cell;
+  uint32_t sequence;
+  BlockType block_type;
+} StreamEdit;
+
+MakeVectorDeclaration(StreamEdit);
+
+typedef struct StreamConnection {
+  Transport transport;
+  Vector_uint8_t message;
+  Vector_uint8_t outgoing;
+  size_t outgoing_head;
+  Vector_uint8_t incoming;
+  size_t incoming_head;
+  bool open;
+} StreamConnection;
+
+typedef struct StreamStats {
+  unsigned int messages;
+  unsigned int chunks;
+  unsigned int chunks_resent;
+  unsigned int chunks_dropped;
+  unsigned int edits;
+  size_t bytes;
+  size_t chunk_bytes;
+  size_t edit_bytes;
+  double chunk_time;
+  double edit_time;
+} StreamStats;
+
+typedef struct StreamServer {
+  World *world;
+  StreamConnection connection;
+  Vec3i view;
+  bool has_view;
+  Vec3i *sent;
+  bool *sent_valid;
+  Vector_StreamEdit edits;
+  uint32_t sequence;
+  size_t batch_bytes;
+  StreamStats stats;
+} StreamServer;
+
+typedef struct StreamClient {
+  World *world;
+  StreamConnection connection;
+  Vec3i view;
+  bool has_view;
+  StreamStats stats;
+} StreamClient;
+
+uint8_t *stream_encode_chunk(const VoxelNode *root, size_t *size);
+
+bool stream_decode_chunk(const uint8_t *data, size_t size, VoxelNode *root);
+
+void stream_server_init(StreamServer *server, World *world,
+                        Transport transport);
+
+void stream_server_edit(StreamServer *server, const Vec3i block,
+                        BlockType block_type);
+
+bool stream_server_update(StreamServer *server);
+
+void stream_server_free(StreamServer *server);
+
+void stream_client_init(StreamClient *client, World *world,
+                        Transport transport);
+
+bool stream_client_update(StreamClient *client, const Vec3i view);
+
+void stream_client_free(StreamClient *client);
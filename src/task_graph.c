@@ -0,0 +1,160 @@
+#include "task_graph.h"
+
+#include "tracy/TracyC.h"
+#include <stdlib.h>
+
+MakeVectorDefinition(TaskGraphNode);
+MakeVectorDefinition(TaskGraphEdge);
+
+static void task_graph_finish(TaskGraph *graph) {
+  mtx_lock(&graph->mutex);
+
+  if (--graph->remaining == 0) {
+    cnd_broadcast(&graph->done);
+  }
+
+  mtx_unlock(&graph->mutex);
+}
+
+static void task_graph_run_node(void *data) {
+  TracyCZone(task_graph_run_node, true);
+
+  TaskGraphNode *node = data;
+  TaskGraph *graph = node->graph;
+
+  node->job(node->data);
+
+  for (unsigned int i = 0; i < node->dependent_count; i++) {
+    unsigned int dependent = graph->dependents[node->dependent_begin + i];
+
+    if (atomic_fetch_sub(&graph->pending[dependent], 1) == 1) {
+      thread_pool_submit_urgent(graph->pool, task_graph_run_node,
+                                &graph->nodes.data[dependent]);
+    }
+  }
+
+  task_graph_finish(graph);
+
+  TracyCZoneEnd(task_graph_run_node);
+}
+
+void task_graph_init(TaskGraph *graph, ThreadPool *pool) {
+  graph->pool = pool;
+  vector_init_TaskGraphNode(&graph->nodes, 0);
+  vector_init_TaskGraphEdge(&graph->edges, 0);
+  graph->dependents = NULL;
+  graph->pending = NULL;
+  graph->allocated_size = 0;
+  graph->remaining = 0;
+
+  mtx_init(&graph->mutex, mtx_plain);
+  cnd_init(&graph->done);
+}
+
+unsigned int task_graph_add(TaskGraph *graph, ThreadPoolJob job, void *data) {
+  TaskGraphNode node = {.job = job, .data = data, .graph = graph};
+  vector_insert_TaskGraphNode(&graph->nodes, node);
+
+  return graph->nodes.size - 1;
+}
+
+void task_graph_depend(TaskGraph *graph, unsigned int node,
+                       unsigned int dependency) {
+  TaskGraphEdge edge = {node, dependency};
+  vector_insert_TaskGraphEdge(&graph->edges, edge);
+}
+
+void task_graph_run(TaskGraph *graph) {
+  unsigned int node_count = graph->nodes.size;
+  TaskGraphNode *nodes = graph->nodes.data;
+
+  if (node_count == 0) {
+    return;
+  }
+
+  if (node_count > graph->allocated_size) {
+    free(graph->pending);
+    graph->allocated_size = node_count;
+    graph->pending = malloc(sizeof(atomic_uint) * graph->allocated_size);
+  }
+
+  free(graph->dependents);
+  graph->dependents = malloc(sizeof(unsigned int) * (graph->edges.size + 1));
+
+  for (unsigned int i = 0; i < node_count; i++) {
+    nodes[i].dependent_count = 0;
+    atomic_init(&graph->pending[i], 1);
+  }
+
+  for (unsigned int i = 0; i < graph->edges.size; i++) {
+    const TaskGraphEdge *edge = &graph->edges.data[i];
+    nodes[edge->dependency].dependent_count++;
+    atomic_fetch_add(&graph->pending[edge->node], 1);
+  }
+
+  unsigned int begin = 0;
+
+  for (unsigned int i = 0; i < node_count; i++) {
+    nodes[i].dependent_begin = begin;
+    begin += nodes[i].dependent_count;
+    nodes[i].dependent_count = 0;
+  }
+
+  for (unsigned int i = 0; i < graph->edges.size; i++) {
+    const TaskGraphEdge *edge = &graph->edges.data[i];
+    TaskGraphNode *dependency = &nodes[edge->dependency];
+    graph->dependents[dependency->dependent_begin +
+                      dependency->dependent_count++] = edge->node;
+  }
+
+  mtx_lock(&graph->mutex);
+  graph->remaining = node_count;
+  mtx_unlock(&graph->mutex);
+
+  for (unsigned int i = 0; i < node_count; i++) {
+    if (atomic_fetch_sub(&graph->pending[i], 1) == 1) {
+      thread_pool_submit_urgent(graph->pool, task_graph_run_node, &nodes[i]);
+    }
+  }
+}
+
+bool task_graph_busy(TaskGraph *graph) {
+  return task_graph_pending(graph) != 0;
+}
+
+unsigned int task_graph_pending(TaskGraph *graph) {
+  mtx_lock(&graph->mutex);
+  unsigned int remaining = graph->remaining;
+  mtx_unlock(&graph->mutex);
+
+  return remaining;
+}
+
+void task_graph_wait(TaskGraph *graph) {
+  mtx_lock(&graph->mutex);
+
+  while (graph->remaining != 0) {
+    cnd_wait(&graph->done, &graph->mutex);
+  }
+
+  mtx_unlock(&graph->mutex);
+}
+
+void task_graph_clear(TaskGraph *graph) {
+  task_graph_wait(graph);
+
+  vector_clear_TaskGraphNode(&graph->nodes);
+  vector_clear_TaskGraphEdge(&graph->edges);
+}
+
+void task_graph_free(TaskGraph *graph) {
+  task_graph_wait(graph);
+
+  vector_free_TaskGraphNode(&graph->nodes);
+  vector_free_TaskGraphEdge(&graph->edges);
+  free(graph->dependents);
+  free(graph->pending);
+
+  mtx_destroy(&graph->mutex);
+  cnd_destroy(&graph->done);
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "thread_pool.h"
+#include "vector.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <threads.h>
+
+typedef struct TaskGraph TaskGraph;
+
+typedef struct TaskGraphNode {
+  ThreadPoolJob job;
+  void *data;
+  unsigned int dependent_begin;
+  unsigned int dependent_count;
+  TaskGraph *graph;
+} TaskGraphNode;
+
+typedef struct TaskGraphEdge {
+  unsigned int node;
+  unsigned int dependency;
+} TaskGraphEdge;
+
+MakeVectorDeclaration(TaskGraphNode);
+MakeVectorDeclaration(TaskGraphEdge);
+
+struct TaskGraph {
+  ThreadPool *pool;
+  Vector_TaskGraphNode nodes;
+  Vector_TaskGraphEdge edges;
+  unsigned int *dependents;
+  atomic_uint *pending;
+  unsigned int allocated_size;
+  unsigned int remaining;
+  mtx_t mutex;
+  cnd_t done;
+};
+
+void task_graph_init(TaskGraph *graph, ThreadPool *pool);
+
+unsigned int task_graph_add(TaskGraph *graph, ThreadPoolJob job, void *data);
+
+void task_graph_depend(TaskGraph *graph, unsigned int node,
+                       unsigned int dependency);
+
+void task_graph_run(TaskGraph *graph);
+
+bool task_graph_busy(TaskGraph *graph);
+
+unsigned int task_graph_pending(TaskGraph *graph);
+
+void task_graph_wait(TaskGraph *graph);
+
+void task_graph_clear(TaskGraph *graph);
+
+void task_graph_free(TaskGraph *graph);
@@ -0,0 +1,232 @@
+#include "thread_pool.h"
+
+#include "tracy/TracyC.h"
+#include <stdlib.h>
+#include <unistd.h>
+
+typedef struct ThreadPoolGroup {
+  unsigned int remaining;
+  mtx_t mutex;
+  cnd_t done;
+} ThreadPoolGroup;
+
+typedef struct ThreadPoolRange {
+  ThreadPoolRangeJob job;
+  void *data;
+  unsigned int begin;
+  unsigned int end;
+  ThreadPoolGroup *group;
+} ThreadPoolRange;
+
+static int thread_pool_worker(void *data) {
+  TracyCSetThreadName("thread_pool_worker");
+  ThreadPool *pool = data;
+
+  mtx_lock(&pool->mutex);
+
+  while (true) {
+    while (pool->task_count == 0 && !pool->stopping) {
+      cnd_wait(&pool->task_available, &pool->mutex);
+    }
+
+    if (pool->task_count == 0 && pool->stopping) {
+      break;
+    }
+
+    ThreadPoolTask task = pool->tasks[pool->task_head];
+    pool->task_head = (pool->task_head + 1) % pool->allocated_size;
+    pool->task_count--;
+    pool->urgent_count -= pool->urgent_count != 0;
+    pool->active_count++;
+
+    mtx_unlock(&pool->mutex);
+    task.job(task.data);
+    mtx_lock(&pool->mutex);
+
+    pool->active_count--;
+
+    if (pool->task_count == 0 && pool->active_count == 0) {
+      cnd_broadcast(&pool->idle);
+    }
+  }
+
+  mtx_unlock(&pool->mutex);
+
+  return 0;
+}
+
+unsigned int thread_pool_default_thread_count(void) {
+  long processor_count = sysconf(_SC_NPROCESSORS_ONLN);
+
+  if (processor_count <= 1) {
+    return 1;
+  }
+
+  return processor_count - 1;
+}
+
+void thread_pool_init(ThreadPool *pool, unsigned int thread_count) {
+  pool->thread_count = thread_count;
+  pool->allocated_size = 64;
+  pool->tasks = malloc(sizeof(ThreadPoolTask) * pool->allocated_size);
+  pool->task_head = 0;
+  pool->task_count = 0;
+  pool->urgent_count = 0;
+  pool->active_count = 0;
+  pool->stopping = false;
+
+  mtx_init(&pool->mutex, mtx_plain);
+  cnd_init(&pool->task_available);
+  cnd_init(&pool->idle);
+
+  pool->threads = malloc(sizeof(thrd_t) * thread_count);
+
+  for (unsigned int i = 0; i < thread_count; i++) {
+    thrd_create(&pool->threads[i], thread_pool_worker, pool);
+  }
+}
+
+static void thread_pool_reserve(ThreadPool *pool) {
+  if (pool->task_count == pool->allocated_size) {
+    ThreadPoolTask *tasks =
+        malloc(sizeof(ThreadPoolTask) * pool->allocated_size * 2);
+
+    for (unsigned int i = 0; i < pool->task_count; i++) {
+      tasks[i] = pool->tasks[(pool->task_head + i) % pool->allocated_size];
+    }
+
+    free(pool->tasks);
+    pool->tasks = tasks;
+    pool->task_head = 0;
+    pool->allocated_size *= 2;
+  }
+}
+
+void thread_pool_submit(ThreadPool *pool, ThreadPoolJob job, void *data) {
+  mtx_lock(&pool->mutex);
+  thread_pool_reserve(pool);
+
+  unsigned int tail =
+      (pool->task_head + pool->task_count) % pool->allocated_size;
+  pool->tasks[tail] = (ThreadPoolTask){job, data};
+  pool->task_count++;
+
+  cnd_signal(&pool->task_available);
+  mtx_unlock(&pool->mutex);
+}
+
+void thread_pool_submit_urgent(ThreadPool *pool, ThreadPoolJob job,
+                               void *data) {
+  mtx_lock(&pool->mutex);
+  thread_pool_reserve(pool);
+
+  for (unsigned int i = pool->task_count; i > pool->urgent_count; i--) {
+    pool->tasks[(pool->task_head + i) % pool->allocated_size] =
+        pool->tasks[(pool->task_head + i - 1) % pool->allocated_size];
+  }
+
+  unsigned int slot =
+      (pool->task_head + pool->urgent_count) % pool->allocated_size;
+  pool->tasks[slot] = (ThreadPoolTask){job, data};
+  pool->task_count++;
+  pool->urgent_count++;
+
+  cnd_signal(&pool->task_available);
+  mtx_unlock(&pool->mutex);
+}
+
+static void thread_pool_run_range(void *data) {
+  ThreadPoolRange *range = data;
+  range->job(range->data, range->begin, range->end);
+
+  mtx_lock(&range->group->mutex);
+
+  if (--range->group->remaining == 0) {
+    cnd_signal(&range->group->done);
+  }
+
+  mtx_unlock(&range->group->mutex);
+}
+
+void thread_pool_parallel_for(ThreadPool *pool, unsigned int count,
+                              unsigned int batch_size, ThreadPoolRangeJob job,
+                              void *data) {
+  unsigned int range_count = (count + batch_size - 1) / batch_size;
+
+  if (pool == NULL || range_count <= 1) {
+    if (count != 0) {
+      job(data, 0, count);
+    }
+
+    return;
+  }
+
+  ThreadPoolGroup group = {.remaining = range_count};
+  mtx_init(&group.mutex, mtx_plain);
+  cnd_init(&group.done);
+
+  ThreadPoolRange *ranges = malloc(sizeof(ThreadPoolRange) * range_count);
+
+  for (unsigned int i = 0; i < range_count; i++) {
+    unsigned int begin = i * batch_size;
+    unsigned int end = begin + batch_size < count ? begin + batch_size : count;
+    ranges[i] = (ThreadPoolRange){job, data, begin, end, &group};
+    thread_pool_submit(pool, thread_pool_run_range, &ranges[i]);
+  }
+
+  mtx_lock(&group.mutex);
+
+  while (group.remaining != 0) {
+    cnd_wait(&group.done, &group.mutex);
+  }
+
+  mtx_unlock(&group.mutex);
+
+  free(ranges);
+  mtx_destroy(&group.mutex);
+  cnd_destroy(&group.done);
+}
+
+bool thread_pool_busy(ThreadPool *pool) {
+  mtx_lock(&pool->mutex);
+  bool busy = pool->task_count != 0 || pool->active_count != 0;
+  mtx_unlock(&pool->mutex);
+
+  return busy;
+}
+
+unsigned int thread_pool_pending(ThreadPool *pool) {
+  mtx_lock(&pool->mutex);
+  unsigned int pending = pool->task_count + pool->active_count;
+  mtx_unlock(&pool->mutex);
+
+  return pending;
+}
+
+void thread_pool_wait(ThreadPool *pool) {
+  mtx_lock(&pool->mutex);
+
+  while (pool->task_count != 0 || pool->active_count != 0) {
+    cnd_wait(&pool->idle, &pool->mutex);
+  }
+
+  mtx_unlock(&pool->mutex);
+}
+
+void thread_pool_free(ThreadPool *pool) {
+  mtx_lock(&pool->mutex);
+  pool->stopping = true;
+  cnd_broadcast(&pool->task_available);
+  mtx_unlock(&pool->mutex);
+
+  for (unsigned int i = 0; i < pool->thread_count; i++) {
+    thrd_join(pool->threads[i], NULL);
+  }
+
+  free(pool->threads);
+  free(pool->tasks);
+
+  mtx_destroy(&pool->mutex);
+  cnd_destroy(&pool->task_available);
+  cnd_destroy(&pool->idle);
+}
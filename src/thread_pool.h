@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdbool.h>
+#include <threads.h>
+
+typedef void (*ThreadPoolJob)(void *data);
+
+typedef void (*ThreadPoolRangeJob)(void *data, unsigned int begin,
+                                   unsigned int end);
+
+typedef struct ThreadPoolTask {
+  ThreadPoolJob job;
+  void *data;
+} ThreadPoolTask;
+
+typedef struct ThreadPool {
+  thrd_t *threads;
+  unsigned int thread_count;
+  ThreadPoolTask *tasks;
+  unsigned int task_head;
+  unsigned int task_count;
+  unsigned int urgent_count;
+  unsigned int allocated_size;
+  unsigned int active_count;
+  bool stopping;
+  mtx_t mutex;
+  cnd_t task_available;
+  cnd_t idle;
+} ThreadPool;
+
+unsigned int thread_pool_default_thread_count(void);
+
+void thread_pool_init(ThreadPool *pool, unsigned int thread_count);
+
+void thread_pool_submit(ThreadPool *pool, ThreadPoolJob job, void *data);
+
+void thread_pool_submit_urgent(ThreadPool *pool, ThreadPoolJob job,
+                               void *data);
+
+void thread_pool_parallel_for(ThreadPool *pool, unsigned int count,
+                              unsigned int batch_size, ThreadPoolRangeJob job,
+                              void *data);
+
+bool thread_pool_busy(ThreadPool *pool);
+
+unsigned int thread_pool_pending(ThreadPool *pool);
+
+void thread_pool_wait(ThreadPool *pool);
+
+void thread_pool_free(ThreadPool *pool);
@@ -0,0 +1,303 @@
+#include "transport.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <threads.h>
+#include <unistd.h>
+
+#define transport_listen_backlog 16
+
+MakeVectorDefinition(uint8_t);
+
+typedef struct TransportPipe {
+  Vector_uint8_t bytes;
+  size_t head;
+  bool closed;
+} TransportPipe;
+
+typedef struct TransportLoopback {
+  mtx_t mutex;
+  TransportPipe pipes[2];
+  unsigned int references;
+} TransportLoopback;
+
+typedef struct TransportLoopbackEnd {
+  TransportLoopback *loopback;
+  unsigned int side;
+} TransportLoopbackEnd;
+
+bool transport_send(Transport *transport, const uint8_t *bytes, size_t size,
+                    size_t *sent) {
+  return transport->send(transport->data, bytes, size, sent);
+}
+
+bool transport_receive(Transport *transport, uint8_t *bytes, size_t capacity,
+                       size_t *received) {
+  return transport->receive(transport->data, bytes, capacity, received);
+}
+
+void transport_close(Transport *transport) {
+  if (transport->close != NULL) {
+    transport->close(transport->data);
+  }
+
+  *transport = (Transport){0};
+}
+
+static bool transport_loopback_send(void *data, const uint8_t *bytes,
+                                    size_t size, size_t *sent) {
+  TransportLoopbackEnd *end = data;
+  TransportLoopback *loopback = end->loopback;
+  TransportPipe *pipe = &loopback->pipes[end->side];
+
+  *sent = 0;
+
+  mtx_lock(&loopback->mutex);
+
+  if (loopback->pipes[end->side ^ 1].closed) {
+    mtx_unlock(&loopback->mutex);
+    return false;
+  }
+
+  if (pipe->head != 0 && pipe->head >= pipe->bytes.size / 2) {
+    memmove(pipe->bytes.data, pipe->bytes.data + pipe->head,
+            pipe->bytes.size - pipe->head);
+    pipe->bytes.size -= pipe->head;
+    pipe->head = 0;
+  }
+
+  vector_append_uint8_t(&pipe->bytes, bytes, size);
+  *sent = size;
+
+  mtx_unlock(&loopback->mutex);
+
+  return true;
+}
+
+static bool transport_loopback_receive(void *data, uint8_t *bytes,
+                                       size_t capacity, size_t *received) {
+  TransportLoopbackEnd *end = data;
+  TransportLoopback *loopback = end->loopback;
+  TransportPipe *pipe = &loopback->pipes[end->side ^ 1];
+
+  mtx_lock(&loopback->mutex);
+
+  size_t available = pipe->bytes.size - pipe->head;
+  *received = available < capacity ? available : capacity;
+
+  if (*received != 0) {
+    memcpy(bytes, pipe->bytes.data + pipe->head, *received);
+    pipe->head += *received;
+  }
+
+  if (pipe->head == pipe->bytes.size) {
+    vector_clear_uint8_t(&pipe->bytes);
+    pipe->head = 0;
+  }
+
+  bool open = *received != 0 || !pipe->closed;
+
+  mtx_unlock(&loopback->mutex);
+
+  return open;
+}
+
+static void transport_loopback_close(void *data) {
+  TransportLoopbackEnd *end = data;
+  TransportLoopback *loopback = end->loopback;
+
+  mtx_lock(&loopback->mutex);
+  loopback->pipes[end->side].closed = true;
+  unsigned int references = --loopback->references;
+  mtx_unlock(&loopback->mutex);
+
+  free(end);
+
+  if (references != 0) {
+    return;
+  }
+
+  mtx_destroy(&loopback->mutex);
+  vector_free_uint8_t(&loopback->pipes[0].bytes);
+  vector_free_uint8_t(&loopback->pipes[1].bytes);
+  free(loopback);
+}
+
+void transport_loopback_pair(Transport *first, Transport *second) {
+  TransportLoopback *loopback = calloc(1, sizeof(TransportLoopback));
+  mtx_init(&loopback->mutex, mtx_plain);
+  loopback->references = 2;
+
+  Transport *transports[2] = {first, second};
+
+  for (unsigned int side = 0; side < 2; side++) {
+    TransportLoopbackEnd *end = malloc(sizeof(TransportLoopbackEnd));
+    end->loopback = loopback;
+    end->side = side;
+
+    *transports[side] = (Transport){.send = transport_loopback_send,
+                                    .receive = transport_loopback_receive,
+                                    .close = transport_loopback_close,
+                                    .data = end};
+  }
+}
+
+static bool transport_tcp_send(void *data, const uint8_t *bytes, size_t size,
+                               size_t *sent) {
+  int socket = (int)(intptr_t)data;
+
+  *sent = 0;
+
+  while (*sent < size) {
+    ssize_t result = send(socket, bytes + *sent, size - *sent, MSG_NOSIGNAL);
+
+    if (result >= 0) {
+      *sent += result;
+      continue;
+    }
+
+    if (errno == EINTR) {
+      continue;
+    }
+
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+  }
+
+  return true;
+}
+
+static bool transport_tcp_receive(void *data, uint8_t *bytes, size_t capacity,
+                                  size_t *received) {
+  int socket = (int)(intptr_t)data;
+
+  *received = 0;
+
+  for (;;) {
+    ssize_t result = recv(socket, bytes, capacity, 0);
+
+    if (result > 0) {
+      *received = result;
+      return true;
+    }
+
+    if (result == 0) {
+      return false;
+    }
+
+    if (errno != EINTR) {
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+  }
+}
+
+static void transport_tcp_close(void *data) { close((int)(intptr_t)data); }
+
+static bool transport_tcp_open(Transport *transport, int socket) {
+  int flags = fcntl(socket, F_GETFL, 0);
+  int no_delay = 1;
+
+  if (flags < 0 || fcntl(socket, F_SETFL, flags | O_NONBLOCK) < 0 ||
+      setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &no_delay,
+                 sizeof(no_delay)) < 0) {
+    close(socket);
+    return false;
+  }
+
+  *transport = (Transport){.send = transport_tcp_send,
+                           .receive = transport_tcp_receive,
+                           .close = transport_tcp_close,
+                           .data = (void *)(intptr_t)socket};
+
+  return true;
+}
+
+bool transport_tcp_listen(TransportListener *listener, uint16_t port) {
+  struct sockaddr_in address = {.sin_family = AF_INET,
+                                .sin_port = htons(port),
+                                .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+  socklen_t address_size = sizeof(address);
+  int reuse = 1;
+
+  listener->socket = socket(AF_INET, SOCK_STREAM, 0);
+
+  if (listener->socket < 0) {
+    return false;
+  }
+
+  if (setsockopt(listener->socket, SOL_SOCKET, SO_REUSEADDR, &reuse,
+                 sizeof(reuse)) ||
+      bind(listener->socket, (struct sockaddr *)&address, sizeof(address)) ||
+      listen(listener->socket, transport_listen_backlog) ||
+      getsockname(listener->socket, (struct sockaddr *)&address,
+                  &address_size)) {
+    close(listener->socket);
+    listener->socket = -1;
+    return false;
+  }
+
+  listener->port = ntohs(address.sin_port);
+
+  return true;
+}
+
+bool transport_tcp_accept(TransportListener *listener, Transport *transport) {
+  int socket;
+
+  do {
+    socket = accept(listener->socket, NULL, NULL);
+  } while (socket < 0 && errno == EINTR);
+
+  return socket >= 0 && transport_tcp_open(transport, socket);
+}
+
+bool transport_tcp_connect(Transport *transport, const char *host,
+                           uint16_t port) {
+  struct addrinfo hints = {.ai_family = AF_UNSPEC,
+                           .ai_socktype = SOCK_STREAM};
+  struct addrinfo *addresses;
+  char service[8];
+  snprintf(service, sizeof(service), "%u", port);
+
+  if (getaddrinfo(host, service, &hints, &addresses) != 0) {
+    return false;
+  }
+
+  int socket_handle = -1;
+
+  for (struct addrinfo *address = addresses; address != NULL;
+       address = address->ai_next) {
+    socket_handle =
+        socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+
+    if (socket_handle < 0) {
+      continue;
+    }
+
+    if (connect(socket_handle, address->ai_addr, address->ai_addrlen) == 0) {
+      break;
+    }
+
+    close(socket_handle);
+    socket_handle = -1;
+  }
+
+  freeaddrinfo(addresses);
+
+  return socket_handle >= 0 && transport_tcp_open(transport, socket_handle);
+}
+
+void transport_listener_close(TransportListener *listener) {
+  if (listener->socket >= 0) {
+    close(listener->socket);
+  }
+
+  listener->socket = -1;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "vector.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+MakeVectorDeclaration(uint8_t);
+
+typedef bool (*TransportSend)(void *data, const uint8_t *bytes, size_t size,
+                              size_t *sent);
+
+typedef bool (*TransportReceive)(void *data, uint8_t *bytes, size_t capacity,
+                                 size_t *received);
+
+typedef void (*TransportClose)(void *data);
+
+typedef struct Transport {
+  TransportSend send;
+  TransportReceive receive;
+  TransportClose close;
+  void *data;
+} Transport;
+
+typedef struct TransportListener {
+  int socket;
+  uint16_t port;
+} TransportListener;
+
+bool transport_send(Transport *transport, const uint8_t *bytes, size_t size,
+                    size_t *sent);
+
+bool transport_receive(Transport *transport, uint8_t *bytes, size_t capacity,
+                       size_t *received);
+
+void transport_close(Transport *transport);
+
+void transport_loopback_pair(Transport *first, Transport *second);
+
+bool transport_tcp_listen(TransportListener *listener, uint16_t port);
+
+bool transport_tcp_accept(TransportListener *listener, Transport *transport);
+
+bool transport_tcp_connect(Transport *transport, const char *host,
+                           uint16_t port);
+
+void transport_listener_close(TransportListener *listener);
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 
 #define MakeVectorDeclaration(T)                                               \
   typedef struct Vector_##T {                                                  \
@@ -11,10 +13,92 @@
                                                                                \
   void vector_init_##T(Vector_##T *vector, unsigned int size);                 \
                                                                                \
+  void vector_reserve_##T(Vector_##T *vector, unsigned int size);              \
+                                                                               \
   void vector_insert_##T(Vector_##T *vector, T value);                         \
                                                                                \
+  void vector_append_##T(Vector_##T *vector, const T *values,                  \
+                         unsigned int count);                                  \
+                                                                               \
+  T *vector_extend_##T(Vector_##T *vector, unsigned int count);                \
+                                                                               \
   T vector_get_##T(const Vector_##T *vector, unsigned int index);              \
                                                                                \
+  void vector_clear_##T(Vector_##T *vector);                                   \
+                                                                               \
+  T *vector_release_##T(Vector_##T *vector);                                   \
+                                                                               \
   void vector_free_##T(Vector_##T *vector);
 
+#define MakeVectorDefinition(T)                                                \
+  void vector_init_##T(Vector_##T *vector, unsigned int size) {                \
+    vector->allocated_size = size;                                             \
+    vector->size = 0;                                                          \
+    vector->data = size != 0 ? malloc(vector->allocated_size * sizeof(T))      \
+                             : NULL;                                           \
+  }                                                                            \
+                                                                               \
+  void vector_reserve_##T(Vector_##T *vector, unsigned int size) {             \
+    if (size <= vector->allocated_size) {                                      \
+      return;                                                                  \
+    }                                                                          \
+                                                                               \
+    unsigned int allocated_size =                                              \
+        vector->allocated_size != 0 ? vector->allocated_size : 8;              \
+                                                                               \
+    while (allocated_size < size) {                                            \
+      allocated_size *= 2;                                                     \
+    }                                                                          \
+                                                                               \
+    vector->allocated_size = allocated_size;                                   \
+    vector->data = realloc(vector->data, vector->allocated_size * sizeof(T));  \
+  }                                                                            \
+                                                                               \
+  void vector_insert_##T(Vector_##T *vector, T value) {                        \
+    if (vector->size >= vector->allocated_size) {                              \
+      vector_reserve_##T(vector, vector->size + 1);                            \
+    }                                                                          \
+                                                                               \
+    vector->data[vector->size++] = value;                                      \
+  }                                                                            \
+                                                                               \
+  void vector_append_##T(Vector_##T *vector, const T *values,                  \
+                         unsigned int count) {                                 \
+    memcpy(vector_extend_##T(vector, count), values, count * sizeof(T));       \
+  }                                                                            \
+                                                                               \
+  T *vector_extend_##T(Vector_##T *vector, unsigned int count) {               \
+    if (vector->size + count > vector->allocated_size) {                       \
+      vector_reserve_##T(vector, vector->size + count);                        \
+    }                                                                          \
+                                                                               \
+    T *data = vector->data + vector->size;                                     \
+    vector->size += count;                                                     \
+                                                                               \
+    return data;                                                               \
+  }                                                                            \
+                                                                               \
+  T vector_get_##T(const Vector_##T *vector, unsigned int index) {             \
+    return vector->data[index];                                                \
+  }                                                                            \
+                                                                               \
+  void vector_clear_##T(Vector_##T *vector) { vector->size = 0; }              \
+                                                                               \
+  T *vector_release_##T(Vector_##T *vector) {                                  \
+    T *data = vector->data;                                                    \
+                                                                               \
+    vector->data = NULL;                                                       \
+    vector->size = 0;                                                          \
+    vector->allocated_size = 0;                                                \
+                                                                               \
+    return data;                                                               \
+  }                                                                            \
+                                                                               \
+  void vector_free_##T(Vector_##T *vector) {                                   \
+    free(vector->data);                                                        \
+    vector->data = NULL;                                                       \
+    vector->size = 0;                                                          \
+    vector->allocated_size = 0;                                                \
+  }
+
 MakeVectorDeclaration(float);
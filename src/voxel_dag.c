@@ -0,0 +1,271 @@
+#include "voxel_dag.h"
+
+#include "world.h"
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+typedef struct VoxelOctants {
+  atomic_uint reference_count;
+  bool shared;
+  uint64_t hash;
+  VoxelNode nodes[8];
+} VoxelOctants;
+
+typedef struct VoxelDag {
+  mtx_t mutex;
+  VoxelOctants **slots;
+  unsigned int capacity;
+  unsigned int size;
+  atomic_size_t group_count;
+} VoxelDag;
+
+static VoxelDag voxel_dag;
+static once_flag voxel_dag_once = ONCE_FLAG_INIT;
+
+static void voxel_dag_init(void) {
+  mtx_init(&voxel_dag.mutex, mtx_plain);
+  voxel_dag.capacity = 1024;
+  voxel_dag.slots = calloc(voxel_dag.capacity, sizeof(VoxelOctants *));
+}
+
+static VoxelOctants *voxel_octants_get(VoxelNode *octants) {
+  return (VoxelOctants *)((uint8_t *)octants - offsetof(VoxelOctants, nodes));
+}
+
+static uint64_t voxel_octants_hash(const VoxelNode *octants) {
+  uint64_t hash = 0xcbf29ce484222325;
+
+  for (unsigned int i = 0; i < 8; i++) {
+    hash ^= (uint64_t)(uintptr_t)octants[i].octants;
+    hash *= 0x100000001b3;
+    hash ^= octants[i].block_type << 1 | octants[i].has_octants;
+    hash *= 0x100000001b3;
+  }
+
+  return hash ^ hash >> 32;
+}
+
+static bool voxel_octants_equal(const VoxelNode *a, const VoxelNode *b) {
+  for (unsigned int i = 0; i < 8; i++) {
+    if (a[i].has_octants != b[i].has_octants ||
+        a[i].block_type != b[i].block_type ||
+        a[i].octants != b[i].octants) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static void voxel_dag_insert(VoxelOctants *group) {
+  unsigned int mask = voxel_dag.capacity - 1;
+  unsigned int index = group->hash & mask;
+
+  while (voxel_dag.slots[index] != NULL) {
+    index = (index + 1) & mask;
+  }
+
+  voxel_dag.slots[index] = group;
+  voxel_dag.size++;
+}
+
+static void voxel_dag_grow(void) {
+  VoxelOctants **slots = voxel_dag.slots;
+  unsigned int capacity = voxel_dag.capacity;
+
+  voxel_dag.capacity *= 2;
+  voxel_dag.slots = calloc(voxel_dag.capacity, sizeof(VoxelOctants *));
+  voxel_dag.size = 0;
+
+  for (unsigned int i = 0; i < capacity; i++) {
+    if (slots[i] != NULL) {
+      voxel_dag_insert(slots[i]);
+    }
+  }
+
+  free(slots);
+}
+
+static void voxel_dag_remove(VoxelOctants *group) {
+  unsigned int mask = voxel_dag.capacity - 1;
+  unsigned int index = group->hash & mask;
+
+  while (voxel_dag.slots[index] != group) {
+    index = (index + 1) & mask;
+  }
+
+  unsigned int next = index;
+
+  while (true) {
+    next = (next + 1) & mask;
+
+    if (voxel_dag.slots[next] == NULL) {
+      break;
+    }
+
+    unsigned int home = voxel_dag.slots[next]->hash & mask;
+
+    if ((next > index && (home <= index || home > next)) ||
+        (next < index && home <= index && home > next)) {
+      voxel_dag.slots[index] = voxel_dag.slots[next];
+      index = next;
+    }
+  }
+
+  voxel_dag.slots[index] = NULL;
+  voxel_dag.size--;
+}
+
+VoxelNode *voxel_octants_alloc(void) {
+  VoxelOctants *group = calloc(1, sizeof(VoxelOctants));
+  atomic_init(&group->reference_count, 1);
+  atomic_fetch_add(&voxel_dag.group_count, 1);
+
+  return group->nodes;
+}
+
+void voxel_octants_retain(VoxelNode *octants) {
+  atomic_fetch_add(&voxel_octants_get(octants)->reference_count, 1);
+}
+
+void voxel_octants_release(VoxelNode *octants) {
+  VoxelOctants *group = voxel_octants_get(octants);
+
+  if (group->shared) {
+    mtx_lock(&voxel_dag.mutex);
+    bool unused = atomic_fetch_sub(&group->reference_count, 1) == 1;
+
+    if (unused) {
+      voxel_dag_remove(group);
+    }
+
+    mtx_unlock(&voxel_dag.mutex);
+
+    if (!unused) {
+      return;
+    }
+  } else if (atomic_fetch_sub(&group->reference_count, 1) != 1) {
+    return;
+  }
+
+  for (unsigned int i = 0; i < 8; i++) {
+    if (group->nodes[i].has_octants) {
+      voxel_octants_release(group->nodes[i].octants);
+    }
+  }
+
+  free(group);
+  atomic_fetch_sub(&voxel_dag.group_count, 1);
+}
+
+void voxel_node_make_unique(VoxelNode *node) {
+  VoxelOctants *group = voxel_octants_get(node->octants);
+
+  if (!group->shared) {
+    return;
+  }
+
+  VoxelNode *octants = voxel_octants_alloc();
+  memcpy(octants, group->nodes, sizeof(group->nodes));
+
+  for (unsigned int i = 0; i < 8; i++) {
+    if (octants[i].has_octants) {
+      voxel_octants_retain(octants[i].octants);
+    }
+  }
+
+  node->octants = octants;
+  voxel_octants_release(group->nodes);
+}
+
+void voxel_node_share(VoxelNode *node) {
+  if (!node->has_octants) {
+    return;
+  }
+
+  VoxelOctants *group = voxel_octants_get(node->octants);
+
+  if (group->shared) {
+    return;
+  }
+
+  for (unsigned int i = 0; i < 8; i++) {
+    voxel_node_share(&group->nodes[i]);
+  }
+
+  call_once(&voxel_dag_once, voxel_dag_init);
+
+  group->hash = voxel_octants_hash(group->nodes);
+
+  mtx_lock(&voxel_dag.mutex);
+
+  unsigned int mask = voxel_dag.capacity - 1;
+  unsigned int index = group->hash & mask;
+
+  while (voxel_dag.slots[index] != NULL) {
+    VoxelOctants *candidate = voxel_dag.slots[index];
+
+    if (candidate->hash == group->hash &&
+        voxel_octants_equal(candidate->nodes, group->nodes)) {
+      atomic_fetch_add(&candidate->reference_count, 1);
+      mtx_unlock(&voxel_dag.mutex);
+
+      node->octants = candidate->nodes;
+      voxel_octants_release(group->nodes);
+
+      return;
+    }
+
+    index = (index + 1) & mask;
+  }
+
+  if ((voxel_dag.size + 1) * 2 > voxel_dag.capacity) {
+    voxel_dag_grow();
+  }
+
+  group->shared = true;
+  voxel_dag_insert(group);
+
+  mtx_unlock(&voxel_dag.mutex);
+}
+
+size_t voxel_node_count(const VoxelNode *node) {
+  size_t count = 1;
+
+  if (node->has_octants) {
+    for (unsigned int i = 0; i < 8; i++) {
+      count += voxel_node_count(&node->octants[i]);
+    }
+  }
+
+  return count;
+}
+
+void voxel_dag_report(const World *world, VoxelDagReport *report) {
+  size_t chunk_count = render_distance * render_distance * render_distance;
+  size_t group_count = atomic_load(&voxel_dag.group_count);
+
+  report->total_nodes = 0;
+
+  for (unsigned int x = 0; x < render_distance; x++) {
+    for (unsigned int y = 0; y < render_distance; y++) {
+      for (unsigned int z = 0; z < render_distance; z++) {
+        report->total_nodes += voxel_node_count(&world->chunks[x][y][z]->root);
+      }
+    }
+  }
+
+  report->unique_nodes = chunk_count + group_count * 8;
+  report->unique_bytes = group_count * sizeof(VoxelOctants);
+  report->total_bytes =
+      (report->total_nodes - chunk_count) / 8 * sizeof(VoxelOctants);
+
+  call_once(&voxel_dag_once, voxel_dag_init);
+
+  mtx_lock(&voxel_dag.mutex);
+  report->shared_groups = voxel_dag.size;
+  mtx_unlock(&voxel_dag.mutex);
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "chunk.h"
+#include <stddef.h>
+
+typedef struct World World;
+
+typedef struct VoxelDagReport {
+  size_t unique_nodes;
+  size_t total_nodes;
+  size_t unique_bytes;
+  size_t total_bytes;
+  size_t shared_groups;
+} VoxelDagReport;
+
+VoxelNode *voxel_octants_alloc(void);
+
+void voxel_octants_retain(VoxelNode *octants);
+
+void voxel_octants_release(VoxelNode *octants);
+
+void voxel_node_make_unique(VoxelNode *node);
+
+void voxel_node_share(VoxelNode *node);
+
+size_t voxel_node_count(const VoxelNode *node);
+
+void voxel_dag_report(const World *world, VoxelDagReport *report);
@@ -1,43 +1,125 @@
 #include "world.h"
 
+#include "block_update.h"
 #include "camera.h"
 #include "chunk.h"
+#include "epoch.h"
+#include "fluid.h"
+#include "light.h"
 #include "load_shader.h"
 #include "math_util.h"
+#include "metrics.h"
+#include "path.h"
 #include "tracy/TracyC.h"
 #include <GL/glew.h>
+#include <limits.h>
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <threads.h>
+#include <time.h>
 
-int build_chunk_mesh(void *data) {
-  TracyCSetThreadName("build_chunk_mesh");
-  ChunkThreadData *chunk_thread_data = data;
-  chunk_thread_data->world_thread_busy = true;
+#define mesh_batch_size 512
+#define generate_node_none UINT_MAX
+#define window_volume (render_distance * render_distance * render_distance)
 
-  for (int i = 0; i < chunk_thread_data->size; i++) {
-    Chunk *chunk = chunk_thread_data->chunks[i];
-    mtx_lock(&chunk->mutex);
-    Mesh *out = &chunk_thread_data->out[i];
-    *out = chunk_build_mesh(chunk, chunk_thread_data->world);
-    mtx_unlock(&chunk->mutex);
+MakeVectorDefinition(ChunkTask);
+MakeVectorDefinition(ChunkUpload);
+
+static Vec3i window_offsets[window_volume];
+static once_flag window_offsets_once = ONCE_FLAG_INIT;
+
+static int window_offset_distance(const int *offset) {
+  return offset[0] * offset[0] + offset[1] * offset[1] + offset[2] * offset[2];
+}
+
+static int window_offset_compare(const void *a, const void *b) {
+  const int *offset_a = a;
+  const int *offset_b = b;
+  int distance_a = window_offset_distance(offset_a);
+  int distance_b = window_offset_distance(offset_b);
+
+  if (distance_a != distance_b) {
+    return (distance_a > distance_b) - (distance_a < distance_b);
   }
 
-  chunk_thread_data->world_thread_busy = false;
+  for (unsigned int i = 0; i < 3; i++) {
+    if (offset_a[i] != offset_b[i]) {
+      return (offset_a[i] > offset_b[i]) - (offset_a[i] < offset_b[i]);
+    }
+  }
 
   return 0;
 }
 
+static void window_offsets_init(void) {
+  unsigned int index = 0;
+
+  for (int x = 0; x < render_distance; x++) {
+    for (int y = 0; y < render_distance; y++) {
+      for (int z = 0; z < render_distance; z++) {
+        vec3i_copy(window_offsets[index++],
+                   (Vec3i){x - render_distance / 2, y - render_distance / 2,
+                           z - render_distance / 2});
+      }
+    }
+  }
+
+  qsort(window_offsets, window_volume, sizeof(Vec3i), window_offset_compare);
+}
+
+const Vec3i *world_window_offsets(void) {
+  call_once(&window_offsets_once, window_offsets_init);
+
+  return window_offsets;
+}
+
+void world_init_headless(World *world) {
+  block_registry_init();
+
+  vector_init_ChunkPointer(&world->loaded_chunks, window_volume);
+
+  light_engine_init(&world->light_engine, world,
+                    thread_pool_default_thread_count());
+  fluid_engine_init(&world->fluid, world, thread_pool_default_thread_count());
+  block_update_init(&world->updates, world,
+                    thread_pool_default_thread_count());
+  path_graph_init(&world->paths, world, thread_pool_default_thread_count());
+  heightmap_init(&world->heightmap, world);
+
+  task_graph_init(&world->pipeline.graph, &world->light_engine.pool);
+  vector_init_ChunkTask(&world->pipeline.tasks,
+                        window_volume + mesh_batch_size);
+  world->pipeline.generate_nodes =
+      malloc(sizeof(unsigned int) * window_volume);
+  vec3i_copy(world->pipeline.center, (Vec3i){0, 0, 0});
+
+  prefetch_init(&world->prefetch, world);
+  residency_init(&world->residency);
+  world->stats = (WorldStats){0};
+  world->headless = true;
+  world->remote = false;
+  world->defer_uploads = false;
+
+  world->chunk_storage = calloc(window_volume, sizeof(Chunk));
+  world->views = calloc(window_volume, sizeof(ChunkView));
+  vector_init_ChunkUpload(&world->uploads, 0);
+
+  for (int x = 0; x < render_distance; x++) {
+    for (int y = 0; y < render_distance; y++) {
+      for (int z = 0; z < render_distance; z++) {
+        world->chunks[x][y][z] =
+            &world->chunk_storage[(x * render_distance + y) * render_distance +
+                                  z];
+      }
+    }
+  }
+}
+
 void world_init(World *world) {
-  world->chunk_thread_data.chunks =
-      malloc(sizeof(Chunk *) * (int)(pow(render_distance, 3)));
-  world->chunk_thread_data.out =
-      malloc(sizeof(Mesh) * (int)(pow(render_distance, 3)));
-  world->chunk_thread_data.size = 0;
-  world->chunk_thread_data.world_thread_busy = false;
-  world->chunk_thread_data.world = world;
+  world_init_headless(world);
+  world->headless = false;
 
   world->shader.program_id = load_shader("assets/shaders/vertex_shader.glsl",
                                          "assets/shaders/fragment_shader.glsl");
@@ -52,15 +134,10 @@ void world_init(World *world) {
       glGetUniformLocation(world->shader.program_id, "view_matrix");
   world->shader.chunk_position_uniform =
       glGetUniformLocation(world->shader.program_id, "chunk_position");
-
-  for (int x = 0; x < render_distance; x++) {
-    for (int y = 0; y < render_distance; y++) {
-      for (int z = 0; z < render_distance; z++) {
-        world->chunks[x][y][z] = calloc(1, sizeof(Chunk));
-        chunk_init(world->chunks[x][y][z], (Vec3i){x, y, z});
-      }
-    }
-  }
+  world->shader.chunk_size_uniform =
+      glGetUniformLocation(world->shader.program_id, "chunk_size");
+  world->shader.alpha_uniform =
+      glGetUniformLocation(world->shader.program_id, "alpha");
 }
 
 Chunk *world_get_chunk(const World *world, const Vec3i position) {
@@ -71,78 +148,878 @@ Chunk *world_get_chunk(const World *world, const Vec3i position) {
   return world->chunks[index_x][index_y][index_z];
 }
 
-void world_load(World *world, Camera *camera) {
-  if (world->chunk_thread_data.world_thread_busy) {
+Chunk *world_get_loaded_chunk(const World *world, const Vec3i position) {
+  Chunk *chunk = world_get_chunk(world, position);
+
+  if (chunk == NULL || !chunk->loaded ||
+      !vec3i_compare(chunk->position, position)) {
+    return NULL;
+  }
+
+  return chunk;
+}
+
+const ChunkSnapshot *world_get_snapshot(const World *world,
+                                        const Vec3i position) {
+  const ChunkSnapshot *snapshot =
+      chunk_get_snapshot(world_get_chunk(world, position));
+
+  if (snapshot == NULL || !vec3i_compare(snapshot->position, position)) {
+    return NULL;
+  }
+
+  return snapshot;
+}
+
+void world_block_to_chunk(const Vec3i block, Vec3i chunk_position,
+                          Vec3i local) {
+  for (unsigned int axis = 0; axis < 3; axis++) {
+    local[axis] = mod(block[axis], chunk_size);
+    chunk_position[axis] = (block[axis] - local[axis]) / chunk_size;
+  }
+}
+
+BlockType world_get_block_type(const World *world, const Vec3i block) {
+  Vec3i chunk_position;
+  Vec3i local;
+  world_block_to_chunk(block, chunk_position, local);
+
+  Chunk *chunk = world_get_loaded_chunk(world, chunk_position);
+
+  if (chunk == NULL) {
+    return AIR;
+  }
+
+  return chunk_get_block_type(chunk, local);
+}
+
+void world_set_block_type(World *world, const Vec3i block,
+                          BlockType block_type) {
+  Vec3i chunk_position;
+  Vec3i local;
+  world_block_to_chunk(block, chunk_position, local);
+
+  Chunk *chunk = world_get_loaded_chunk(world, chunk_position);
+
+  if (chunk == NULL) {
     return;
   }
 
-  for (int i = 0; i < world->chunk_thread_data.size; i++) {
-    Chunk *chunk = world->chunk_thread_data.chunks[i];
-    Mesh *mesh = &world->chunk_thread_data.out[i];
+  mtx_lock(&chunk->mutex);
+  mtx_lock(&world->light_engine.mutex);
+  chunk_set_block_type(chunk, local, block_type);
+  mtx_unlock(&world->light_engine.mutex);
+  mtx_unlock(&chunk->mutex);
 
-    chunk->mesh_size = mesh->vertices.size;
+  chunk->dirty_sections |= chunk_edit_sections(local);
 
-    if (chunk->mesh_size == 0) {
+  for (unsigned int axis = 0; axis < 3; axis++) {
+    if (local[axis] != 0 && local[axis] != chunk_size - 1) {
       continue;
     }
 
-    glBindBuffer(GL_ARRAY_BUFFER, chunk->vertex_buffer);
-    glBufferData(GL_ARRAY_BUFFER, mesh->vertices.size * sizeof(float),
-                 mesh->vertices.data, GL_STATIC_DRAW);
+    Vec3i neighbour_position;
+    vec3i_copy(neighbour_position, chunk_position);
+    neighbour_position[axis] += local[axis] == 0 ? -1 : 1;
+
+    Chunk *neighbour = world_get_loaded_chunk(world, neighbour_position);
+
+    if (neighbour != NULL) {
+      neighbour->dirty_sections |= chunk_neighbour_sections(local, axis);
+    }
+  }
 
-    glBindBuffer(GL_ARRAY_BUFFER, chunk->normal_buffer);
-    glBufferData(GL_ARRAY_BUFFER, mesh->normals.size * sizeof(float),
-                 mesh->normals.data, GL_STATIC_DRAW);
+  light_engine_queue_update(&world->light_engine, block);
+  fluid_activate(&world->fluid, block);
+  path_graph_invalidate(&world->paths, block);
+  heightmap_set_block(&world->heightmap, block, block_type);
+}
 
-    vector_free_float(&mesh->vertices);
-    vector_free_float(&mesh->normals);
+static void world_grow_buffers(World *world, ChunkView *view,
+                               const MeshRange *previous) {
+  if (world->headless) {
+    return;
   }
 
-  world->chunk_thread_data.size = 0;
+  unsigned int buffers[2] = {view->vertex_buffer, view->normal_buffer};
+  unsigned int grown[2];
+  glGenBuffers(2, grown);
+
+  for (unsigned int i = 0; i < 2; i++) {
+    glBindBuffer(GL_COPY_WRITE_BUFFER, grown[i]);
+    glBufferData(GL_COPY_WRITE_BUFFER,
+                 view->sections.capacity * sizeof(float), NULL,
+                 GL_DYNAMIC_DRAW);
+
+    if (buffers[i] == 0) {
+      continue;
+    }
+
+    glBindBuffer(GL_COPY_READ_BUFFER, buffers[i]);
+
+    for (unsigned int section = 0; section < mesh_section_count; section++) {
+      const MeshRange *range = &view->sections.ranges[section];
+
+      if (range->size != 0) {
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                            previous[section].offset * sizeof(float),
+                            range->offset * sizeof(float),
+                            range->size * sizeof(float));
+      }
+    }
+  }
+
+  if (view->vertex_buffer != 0) {
+    glDeleteBuffers(2, buffers);
+  }
+
+  view->vertex_buffer = grown[0];
+  view->normal_buffer = grown[1];
+}
+
+static bool world_place_sections(World *world, ChunkView *view,
+                                 const Mesh *mesh) {
+  MeshSections *sections = &view->sections;
+  bool placed = true;
+
+  if (mesh->sections == mesh_sections_all) {
+    mesh_sections_init(sections,
+                       mesh_sections_headroom(mesh->vertices.size));
+  }
+
+  for (unsigned int section = 0; section < mesh_section_count; section++) {
+    if (mesh->sections >> section & 1) {
+      mesh_sections_release(sections, section);
+    }
+  }
+
+  for (unsigned int section = 0; section < mesh_section_count && placed;
+       section++) {
+    if (mesh->sections >> section & 1) {
+      placed = mesh_sections_place(sections, section,
+                                   mesh->section_offsets[section + 1] -
+                                       mesh->section_offsets[section]);
+    }
+  }
+
+  if (!placed) {
+    for (unsigned int section = 0; section < mesh_section_count; section++) {
+      if (mesh->sections >> section & 1) {
+        mesh_sections_release(sections, section);
+      }
+    }
+
+    MeshRange previous[mesh_section_count];
+    mesh_sections_compact(
+        sections,
+        mesh_sections_headroom(sections->used + mesh->vertices.size),
+        previous);
+    world_grow_buffers(world, view, previous);
+
+    for (unsigned int section = 0; section < mesh_section_count; section++) {
+      if (mesh->sections >> section & 1) {
+        mesh_sections_place(sections, section,
+                            mesh->section_offsets[section + 1] -
+                                mesh->section_offsets[section]);
+      }
+    }
+  }
+
+  for (unsigned int section = 0; section < mesh_section_count; section++) {
+    if (mesh->sections >> section & 1) {
+      sections->opaque[section] = mesh->section_opaque[section];
+    }
+  }
+
+  return !placed;
+}
+
+static void world_upload_sections(ChunkView *view, const Mesh *mesh) {
+  const Vector_float *data[2] = {&mesh->vertices, &mesh->normals};
+  unsigned int buffers[2] = {view->vertex_buffer, view->normal_buffer};
+  bool full = mesh->sections == mesh_sections_all;
+
+  for (unsigned int i = 0; i < 2; i++) {
+    glBindBuffer(GL_ARRAY_BUFFER, buffers[i]);
+
+    if (full) {
+      glBufferData(GL_ARRAY_BUFFER, view->sections.capacity * sizeof(float),
+                   NULL, GL_DYNAMIC_DRAW);
+      glBufferSubData(GL_ARRAY_BUFFER, 0, data[i]->size * sizeof(float),
+                      data[i]->data);
+      continue;
+    }
+
+    for (unsigned int section = 0; section < mesh_section_count; section++) {
+      const MeshRange *range = &view->sections.ranges[section];
+
+      if ((mesh->sections >> section & 1) && range->size != 0) {
+        glBufferSubData(GL_ARRAY_BUFFER, range->offset * sizeof(float),
+                        range->size * sizeof(float),
+                        data[i]->data + mesh->section_offsets[section]);
+      }
+    }
+  }
+}
+
+static bool world_upload_view(World *world, ChunkView *view,
+                              const Vec3i position, Mesh *mesh) {
+  uint64_t start = metrics_now();
+  size_t bytes = (mesh->vertices.size + mesh->normals.size) * sizeof(float);
+
+  vec3i_copy(view->position, position);
+  view->loaded = true;
+
+  bool grown = world_place_sections(world, view, mesh);
+
+  if (view->sections.capacity != 0 && !world->headless) {
+    if (view->vertex_buffer == 0) {
+      glGenBuffers(1, &view->vertex_buffer);
+      glGenBuffers(1, &view->normal_buffer);
+    }
+
+    world_upload_sections(view, mesh);
+
+    metrics_add(METRIC_BYTES_UPLOADED, bytes);
+    metrics_record(METRIC_CHUNK_UPLOAD, metrics_now() - start);
+  }
+
+  vector_free_float(&mesh->vertices);
+  vector_free_float(&mesh->normals);
+
+  return grown;
+}
+
+static void world_release_view(ChunkView *view) {
+  mesh_sections_init(&view->sections, 0);
+  view->loaded = false;
+}
+
+static void world_upload_mesh(World *world, Chunk *chunk, Mesh *mesh) {
+  unsigned int slot = chunk - world->chunk_storage;
+
+  world->stats.bytes_uploaded +=
+      (mesh->vertices.size + mesh->normals.size) * sizeof(float);
+  world->stats.sections_uploaded += __builtin_popcount(mesh->sections);
+
+  if (world->defer_uploads) {
+    ChunkUpload upload = {.slot = slot, .mesh = *mesh};
+    vec3i_copy(upload.position, chunk->position);
+    vector_insert_ChunkUpload(&world->uploads, upload);
+    return;
+  }
+
+  world->stats.buffers_grown +=
+      world_upload_view(world, &world->views[slot], chunk->position, mesh);
+}
+
+unsigned int world_apply_uploads(World *world, Vector_ChunkUpload *uploads) {
+  unsigned int grown = 0;
+
+  for (unsigned int i = 0; i < uploads->size; i++) {
+    ChunkUpload *upload = &uploads->data[i];
+    ChunkView *view = &world->views[upload->slot];
+
+    if (upload->release) {
+      world_release_view(view);
+      continue;
+    }
+
+    grown += world_upload_view(world, view, upload->position, &upload->mesh);
+  }
+
+  vector_clear_ChunkUpload(uploads);
+
+  return grown;
+}
+
+static bool world_in_window(const Vec3i center, const Vec3i position) {
+  for (unsigned int axis = 0; axis < 3; axis++) {
+    int offset = position[axis] - center[axis];
+
+    if (offset < -render_distance / 2 || offset >= render_distance / 2) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static void world_neighbour_position(const Vec3i position, unsigned int side,
+                                     Vec3i neighbour_position) {
+  vec3i_copy(neighbour_position, position);
+  neighbour_position[side / 2] += side % 2 ? 1 : -1;
+}
+
+uint8_t world_present_neighbours(const World *world, const Vec3i position) {
+  uint8_t present = 0;
+
+  for (unsigned int side = 0; side < 6; side++) {
+    Vec3i neighbour_position;
+    world_neighbour_position(position, side, neighbour_position);
+
+    if (world_get_snapshot(world, neighbour_position) != NULL) {
+      present |= 1 << side;
+    }
+  }
+
+  return present;
+}
+
+static bool chunk_task_stale(const ChunkTask *task) {
+  return atomic_load(&task->chunk->generation) != task->generation;
+}
+
+static void chunk_task_generate(void *data) {
+  ChunkTask *task = data;
+
+  if (chunk_task_stale(task)) {
+    task->stale = true;
+    return;
+  }
+
+  VoxelNode root;
+  chunk_generate(&root, task->position);
+  chunk_init_with_root(task->chunk, task->position, root);
+}
+
+static void chunk_task_mesh(void *data) {
+  ChunkTask *task = data;
+
+  if (chunk_task_stale(task)) {
+    task->stale = true;
+    return;
+  }
+
+  epoch_enter();
+
+  const ChunkSnapshot *snapshot = chunk_get_snapshot(task->chunk);
+  bool occluded = task->kind == CHUNK_TASK_MESH;
+  task->neighbours = world_present_neighbours(task->world, task->position);
+
+  for (unsigned int side = 0; side < 6 && !occluded; side++) {
+    if (!(task->border_sides >> side & 1)) {
+      continue;
+    }
+
+    Vec3i neighbour_position;
+    world_neighbour_position(task->position, side, neighbour_position);
+
+    const ChunkSnapshot *neighbour =
+        world_get_snapshot(task->world, neighbour_position);
+
+    if (snapshot != NULL && neighbour != NULL) {
+      occluded = chunk_snapshot_border_occluded(snapshot, neighbour, side / 2,
+                                                side % 2);
+    }
+  }
+
+  if (occluded) {
+    task->mesh =
+        chunk_snapshot_build_sections(snapshot, task->world, task->sections);
+    task->meshed = true;
+  }
+
+  epoch_exit();
+}
+
+static unsigned int world_generate_node(const World *world,
+                                        const Vec3i position) {
+  const ChunkPipeline *pipeline = &world->pipeline;
+  Chunk *chunk = world_get_chunk(world, position);
+  unsigned int node = pipeline->generate_nodes[chunk - world->chunk_storage];
+
+  if (node == generate_node_none ||
+      !vec3i_compare(pipeline->tasks.data[node].position, position)) {
+    return generate_node_none;
+  }
+
+  return node;
+}
+
+static unsigned int world_add_task(World *world, const ChunkTask *task) {
+  ChunkPipeline *pipeline = &world->pipeline;
+
+  vector_insert_ChunkTask(&pipeline->tasks, *task);
+
+  return task_graph_add(
+      &pipeline->graph,
+      task->kind == CHUNK_TASK_GENERATE ? chunk_task_generate : chunk_task_mesh,
+      &pipeline->tasks.data[pipeline->tasks.size - 1]);
+}
+
+static void world_pipeline_finish(World *world, double now) {
+  ChunkPipeline *pipeline = &world->pipeline;
+  WorldStats *stats = &world->stats;
+
+  task_graph_wait(&pipeline->graph);
+
+  for (unsigned int i = 0; i < pipeline->tasks.size; i++) {
+    ChunkTask *task = &pipeline->tasks.data[i];
+    Chunk *chunk = task->chunk;
+
+    if (task->kind == CHUNK_TASK_GENERATE) {
+      stats->stale_dropped += task->stale;
+      continue;
+    }
+
+    if (task->stale || chunk_task_stale(task)) {
+      if (task->meshed) {
+        vector_free_float(&task->mesh.vertices);
+        vector_free_float(&task->mesh.normals);
+      }
+
+      stats->stale_dropped++;
+      continue;
+    }
+
+    if (!task->meshed) {
+      chunk->mesh_neighbours |= task->border_sides & task->neighbours;
+      stats->meshes_avoided++;
+      continue;
+    }
+
+    chunk->mesh_neighbours = task->neighbours;
+    stats->chunks_meshed++;
+
+    if (chunk->request_time != 0) {
+      double latency = now - chunk->request_time;
+
+      stats->mesh_latency_count++;
+      stats->mesh_latency_total += latency;
+      stats->mesh_latency_max = fmax(stats->mesh_latency_max, latency);
+      chunk->request_time = 0;
+    }
+
+    world_upload_mesh(world, chunk, &task->mesh);
+  }
+
+  metrics_add(METRIC_MESHES_AVOIDED, stats->meshes_avoided);
+  metrics_add(METRIC_STALE_DROPPED, stats->stale_dropped);
+
+  vector_clear_ChunkTask(&pipeline->tasks);
+  task_graph_clear(&pipeline->graph);
+}
+
+static void world_pipeline_cancel(World *world, const Vec3i center) {
+  ChunkPipeline *pipeline = &world->pipeline;
+
+  if (vec3i_compare(pipeline->center, center)) {
+    return;
+  }
+
+  vec3i_copy(pipeline->center, center);
+
+  for (unsigned int i = 0; i < pipeline->tasks.size; i++) {
+    const ChunkTask *task = &pipeline->tasks.data[i];
+
+    if (!world_in_window(center, task->position)) {
+      atomic_fetch_add(&task->chunk->generation, 1);
+    }
+  }
+}
+
+static void world_unload_chunk(World *world, Chunk *chunk) {
+  unsigned int slot = chunk - world->chunk_storage;
+
+  if (world->defer_uploads) {
+    vector_insert_ChunkUpload(&world->uploads,
+                              (ChunkUpload){.slot = slot, .release = true});
+  } else {
+    world_release_view(&world->views[slot]);
+  }
+
+  if (!world->remote) {
+    size_t updates_size;
+    uint8_t *updates = block_update_save(&world->updates, chunk, &updates_size);
+
+    residency_store(&world->residency, chunk->position, &chunk->root, updates,
+                    updates_size);
+    free(updates);
+  }
+
+  block_update_release(&world->updates, chunk);
+  fluid_release(&world->fluid, chunk);
+
+  mtx_lock(&world->light_engine.mutex);
+  atomic_store(&chunk->loaded, false);
+  mtx_unlock(&world->light_engine.mutex);
+
+  chunk_free(chunk);
+}
+
+static unsigned int world_schedule_generate(World *world, const Vec3i center,
+                                            double now) {
+  ChunkPipeline *pipeline = &world->pipeline;
+  const Vec3i *offsets = world_window_offsets();
+  unsigned int generated = 0;
+
+  memset(pipeline->generate_nodes, 0xff, sizeof(unsigned int) * window_volume);
+  residency_update(&world->residency, center);
+
+  for (unsigned int i = 0; i < window_volume; i++) {
+    Vec3i position;
+    vec3i_add(position, center, offsets[i]);
+
+    Chunk *chunk = world_get_chunk(world, position);
+
+    if (chunk->loaded && vec3i_compare(chunk->position, position)) {
+      continue;
+    }
+
+    if (chunk->loaded && atomic_load(&chunk->light_jobs) != 0) {
+      world->stats.unloads_deferred++;
+      continue;
+    }
+
+    if (chunk->loaded) {
+      world_unload_chunk(world, chunk);
+    }
+
+    if (world->remote) {
+      continue;
+    }
+
+    generated++;
+
+    ChunkTask task = {.kind = CHUNK_TASK_GENERATE,
+                      .chunk = chunk,
+                      .generation = atomic_fetch_add(&chunk->generation, 1) + 1,
+                      .world = world};
+    vec3i_copy(task.position, position);
+
+    VoxelNode root;
+    Mesh mesh;
+    uint8_t neighbours;
+
+    uint8_t *updates;
+    size_t updates_size;
+
+    if (residency_take(&world->residency, position, &root, &updates,
+                       &updates_size)) {
+      VoxelNode prefetched_root;
+
+      if (prefetch_take(&world->prefetch, position, &prefetched_root, &mesh,
+                        &neighbours)) {
+        voxel_node_free(&prefetched_root);
+        vector_free_float(&mesh.vertices);
+        vector_free_float(&mesh.normals);
+      }
+
+      chunk_init_with_root(chunk, position, root);
+      chunk->mesh_neighbours = 0;
+      chunk->request_time = now;
+
+      block_update_load(&world->updates, chunk, updates, updates_size);
+      free(updates);
+
+      world->stats.residency_hits++;
+      continue;
+    }
+
+    if (prefetch_take(&world->prefetch, position, &root, &mesh, &neighbours)) {
+      chunk_init_with_root(chunk, position, root);
+      chunk->mesh_neighbours = neighbours;
+      chunk->request_time = 0;
+      world_upload_mesh(world, chunk, &mesh);
+
+      world->stats.prefetch_hits++;
+      world->stats.mesh_latency_count++;
+      continue;
+    }
+
+    chunk->mesh_neighbours = 0;
+    chunk->request_time = now;
+    pipeline->generate_nodes[chunk - world->chunk_storage] =
+        world_add_task(world, &task);
+  }
+
+  return generated;
+}
+
+static void world_schedule_meshes(World *world, const Vec3i center) {
+  ChunkPipeline *pipeline = &world->pipeline;
+  const Vec3i *offsets = world_window_offsets();
+  unsigned int mesh_count = 0;
+
+  for (unsigned int i = 0; i < window_volume && mesh_count < mesh_batch_size;
+       i++) {
+    Vec3i position;
+    vec3i_add(position, center, offsets[i]);
+
+    Chunk *chunk = world_get_chunk(world, position);
+    unsigned int generate_node = world_generate_node(world, position);
+
+    if (generate_node == generate_node_none &&
+        world_get_loaded_chunk(world, position) == NULL) {
+      continue;
+    }
+
+    uint8_t neighbours = 0;
+    unsigned int neighbour_nodes[6];
+
+    for (unsigned int side = 0; side < 6; side++) {
+      Vec3i neighbour_position;
+      world_neighbour_position(position, side, neighbour_position);
+
+      neighbour_nodes[side] = world_generate_node(world, neighbour_position);
+
+      if (neighbour_nodes[side] != generate_node_none ||
+          world_get_loaded_chunk(world, neighbour_position) != NULL) {
+        neighbours |= 1 << side;
+      }
+    }
+
+    ChunkTask task = {.chunk = chunk,
+                      .generation = atomic_load(&chunk->generation),
+                      .sections = mesh_sections_all,
+                      .world = world};
+    vec3i_copy(task.position, position);
+
+    if (generate_node != generate_node_none || chunk->dirty_sections != 0 ||
+        chunk->request_time != 0) {
+      task.kind = CHUNK_TASK_MESH;
+
+      if (generate_node == generate_node_none && chunk->dirty_sections != 0) {
+        mtx_lock(&chunk->mutex);
+        mtx_lock(&world->light_engine.mutex);
+        chunk_publish(chunk);
+        mtx_unlock(&world->light_engine.mutex);
+        mtx_unlock(&chunk->mutex);
+
+        if (chunk->request_time == 0) {
+          task.sections = chunk->dirty_sections;
+        }
+
+        chunk->dirty_sections = 0;
+      }
+    } else {
+      task.kind = CHUNK_TASK_BORDER;
+      task.border_sides = neighbours & ~chunk->mesh_neighbours;
+
+      if (task.border_sides == 0) {
+        continue;
+      }
+    }
+
+    unsigned int node = world_add_task(world, &task);
+    mesh_count++;
+
+    if (generate_node != generate_node_none) {
+      task_graph_depend(&pipeline->graph, node, generate_node);
+    }
+
+    for (unsigned int side = 0; side < 6; side++) {
+      if (neighbour_nodes[side] != generate_node_none) {
+        task_graph_depend(&pipeline->graph, node, neighbour_nodes[side]);
+      }
+    }
+  }
+}
+
+unsigned int world_fill(World *world, const Vec3i center) {
+  world_pipeline_finish(world, world_now());
+
+  unsigned int generated =
+      world_schedule_generate(world, center, world_now());
+
+  task_graph_run(&world->pipeline.graph);
+  task_graph_wait(&world->pipeline.graph);
+
+  return generated;
+}
+
+bool world_busy(World *world) {
+  return task_graph_busy(&world->pipeline.graph);
+}
+
+void world_wait(World *world) { task_graph_wait(&world->pipeline.graph); }
+
+void world_install_chunk(World *world, const Vec3i position, VoxelNode root) {
+  Chunk *chunk = world_get_chunk(world, position);
+  bool replaced = chunk->loaded && vec3i_compare(chunk->position, position);
+
+  while (atomic_load(&chunk->light_jobs) != 0) {
+    thrd_yield();
+  }
+
+  if (chunk->loaded) {
+    world_unload_chunk(world, chunk);
+  }
+
+  atomic_fetch_add(&chunk->generation, 1);
+  chunk_init_with_root(chunk, position, root);
+  chunk->mesh_neighbours = 0;
+  chunk->request_time = world_now();
+
+  for (unsigned int side = 0; side < 6 && replaced; side++) {
+    Vec3i neighbour_position;
+    world_neighbour_position(position, side, neighbour_position);
+
+    Chunk *neighbour = world_get_loaded_chunk(world, neighbour_position);
+
+    if (neighbour != NULL) {
+      neighbour->dirty_sections = mesh_sections_all;
+    }
+  }
+}
+
+double world_now(void) {
+  struct timespec time;
+  timespec_get(&time, TIME_UTC);
+
+  return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+static void world_load_finish(World *world, double start) {
+  WorldStats *stats = &world->stats;
+
+  stats->mesh_queue = task_graph_pending(&world->pipeline.graph);
+  stats->light_queue = thread_pool_pending(&world->light_engine.pool);
+  stats->load_time = world_now() - start;
+
+  metrics_set(METRIC_MESH_QUEUE, stats->mesh_queue);
+  metrics_set(METRIC_LIGHT_QUEUE, stats->light_queue);
+  metrics_set(METRIC_EPOCH_PENDING, epoch_pending());
+  metrics_record(METRIC_WORLD_LOAD, stats->load_time * 1e9);
+}
+
+void world_load(World *world, Camera *camera) {
+  double start = world_now();
+  world->stats = (WorldStats){0};
+
+  epoch_collect();
+  prefetch_observe(&world->prefetch, camera->transform.position);
 
-  TracyCZone(world_load, true);
   Vec3i camera_position = {camera->transform.position[0],
                            camera->transform.position[1],
                            camera->transform.position[2]};
-  camera_position[0] /= 32;
-  camera_position[1] /= 32;
-  camera_position[2] /= 32;
+  camera_position[0] /= chunk_size;
+  camera_position[1] /= chunk_size;
+  camera_position[2] /= chunk_size;
 
-  for (int x = 0; x < render_distance; x++) {
-    for (int y = 0; y < render_distance; y++) {
-      for (int z = 0; z < render_distance; z++) {
-        Vec3i chunk_position;
-        vec3i_add(chunk_position, camera_position,
-                  (Vec3i){x - (float)render_distance / 2,
-                          y - (float)render_distance / 2,
-                          z - (float)render_distance / 2});
+  if (world_busy(world)) {
+    world_pipeline_cancel(world, camera_position);
+    world_load_finish(world, start);
+    return;
+  }
 
-        int index_x = mod(chunk_position[0], render_distance);
-        int index_y = mod(chunk_position[1], render_distance);
-        int index_z = mod(chunk_position[2], render_distance);
+  world_pipeline_finish(world, start);
+  heightmap_update(&world->heightmap);
 
-        Chunk *chunk = world->chunks[index_x][index_y][index_z];
+  TracyCZone(world_load, true);
 
-        if (!vec3i_compare(chunk->position, chunk_position)) {
-          chunk_free(chunk);
-          memset(chunk, 0, sizeof(Chunk));
-          chunk_init(chunk, chunk_position);
-          world->chunk_thread_data.chunks[world->chunk_thread_data.size++] =
-              chunk;
-        }
-      }
+  vec3i_copy(world->pipeline.center, camera_position);
+  world->stats.chunks_generated =
+      world_schedule_generate(world, camera_position, start);
+  world_schedule_meshes(world, camera_position);
+
+  vector_clear_ChunkPointer(&world->loaded_chunks);
+
+  const Vec3i *offsets = world_window_offsets();
+
+  for (unsigned int i = 0; i < window_volume; i++) {
+    Vec3i chunk_position;
+    vec3i_add(chunk_position, camera_position, offsets[i]);
+
+    Chunk *chunk = world_get_chunk(world, chunk_position);
+
+    if (world_generate_node(world, chunk_position) != generate_node_none) {
+      world->stats.unmeshed_chunks++;
+      continue;
+    }
+
+    if (world_get_loaded_chunk(world, chunk_position) == NULL) {
+      continue;
+    }
+
+    if (!chunk->light.ready && atomic_load(&chunk->light_jobs) == 0) {
+      vector_insert_ChunkPointer(&world->loaded_chunks, chunk);
+    }
+
+    if (chunk->request_time != 0) {
+      world->stats.unmeshed_chunks++;
     }
   }
 
-  if (world->chunk_thread_data.size != 0) {
-    thrd_create(&world->world_thread, build_chunk_mesh,
-                &world->chunk_thread_data);
+  task_graph_run(&world->pipeline.graph);
+
+  if (world->loaded_chunks.size != 0) {
+    light_engine_submit_chunks(&world->light_engine, world->loaded_chunks.data,
+                               world->loaded_chunks.size);
   }
 
+  light_engine_flush(&world->light_engine);
+
+  prefetch_update(&world->prefetch, camera_position);
+
+  world_load_finish(world, start);
+
   TracyCZoneEnd(world_load);
 }
 
+static void world_render_layer(World *world, bool translucent) {
+  glUniform1f(world->shader.alpha_uniform, translucent ? 0.6 : 1.0);
+
+  unsigned int draw_count = 0;
+
+  for (unsigned int slot = 0; slot < window_volume; slot++) {
+    const ChunkView *view = &world->views[slot];
+
+    if (!view->loaded) {
+      continue;
+    }
+
+    const MeshSections *sections = &view->sections;
+    int firsts[mesh_section_count];
+    int counts[mesh_section_count];
+    unsigned int range_count = 0;
+
+    for (unsigned int i = 0; i < mesh_section_count; i++) {
+      const MeshRange *range = &sections->ranges[i];
+      unsigned int opaque = sections->opaque[i];
+
+      firsts[range_count] = range->offset + (translucent ? opaque : 0);
+      counts[range_count] = translucent ? range->size - opaque : opaque;
+      range_count += counts[range_count] != 0;
+    }
+
+    if (range_count == 0) {
+      continue;
+    }
+
+    glUniform3f(world->shader.chunk_position_uniform, view->position[0],
+                view->position[1], view->position[2]);
+
+    glBindBuffer(GL_ARRAY_BUFFER, view->vertex_buffer);
+    glVertexAttribPointer(world->shader.vertex_position_attribute, 1, GL_FLOAT,
+                          GL_FALSE, 0, NULL);
+    glBindBuffer(GL_ARRAY_BUFFER, view->normal_buffer);
+    glVertexAttribPointer(world->shader.vertex_normal_attribute, 1, GL_FLOAT,
+                          GL_FALSE, 0, NULL);
+
+    glMultiDrawArrays(GL_TRIANGLES, firsts, counts, range_count);
+    draw_count++;
+  }
+
+  metrics_add(METRIC_DRAW_CALLS, draw_count);
+}
+
+static void world_count_empty_views(const World *world) {
+  unsigned int empty_count = 0;
+
+  for (unsigned int slot = 0; slot < window_volume; slot++) {
+    const ChunkView *view = &world->views[slot];
+
+    empty_count += view->loaded && view->sections.used == 0;
+  }
+
+  metrics_add(METRIC_EMPTY_VIEWS, empty_count);
+}
+
 void world_render(World *world, Camera *camera) {
+  uint64_t start = metrics_now();
+
   glUseProgram(world->shader.program_id);
 
   glUniformMatrix4fv(world->shader.projection_matrix_uniform, 1, GL_FALSE,
@@ -151,58 +1028,74 @@ void world_render(World *world, Camera *camera) {
   glUniformMatrix4fv(world->shader.view_matrix_uniform, 1, GL_FALSE,
                      camera->view_matrix);
 
+  glUniform1f(world->shader.chunk_size_uniform, chunk_size);
+
   glEnableVertexAttribArray(world->shader.vertex_position_attribute);
   glEnableVertexAttribArray(world->shader.vertex_normal_attribute);
 
-  for (unsigned int x = 0; x < render_distance; x++) {
-    for (unsigned int y = 0; y < render_distance; y++) {
-      for (unsigned int z = 0; z < render_distance; z++) {
-        Chunk *chunk = world->chunks[x][y][z];
+  world_render_layer(world, false);
 
-        bool chunk_locked = mtx_trylock(&chunk->mutex);
-        if (chunk_locked) {
-          continue;
-        }
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  glDepthMask(GL_FALSE);
 
-        if (chunk->mesh_size == 0) {
-          mtx_unlock(&chunk->mutex);
-          continue;
-        }
-
-        glUniform3f(world->shader.chunk_position_uniform, chunk->position[0],
-                    chunk->position[1], chunk->position[2]);
+  world_render_layer(world, true);
 
-        glBindBuffer(GL_ARRAY_BUFFER, chunk->vertex_buffer);
-        glVertexAttribPointer(world->shader.vertex_position_attribute, 1,
-                              GL_FLOAT, GL_FALSE, 0, NULL);
-        glBindBuffer(GL_ARRAY_BUFFER, chunk->normal_buffer);
-        glVertexAttribPointer(world->shader.vertex_normal_attribute, 1,
-                              GL_FLOAT, GL_FALSE, 0, NULL);
-
-        glDrawArrays(GL_TRIANGLES, 0, chunk->mesh_size);
-        mtx_unlock(&chunk->mutex);
-      }
-    }
-  }
+  glDepthMask(GL_TRUE);
+  glDisable(GL_BLEND);
 
   glDisableVertexAttribArray(world->shader.vertex_position_attribute);
   glDisableVertexAttribArray(world->shader.vertex_normal_attribute);
+
+  world_count_empty_views(world);
+
+  metrics_record(METRIC_WORLD_RENDER, metrics_now() - start);
 }
 
 void world_free(World *world) {
+  prefetch_free(&world->prefetch);
+  residency_free(&world->residency);
+  fluid_engine_free(&world->fluid);
+  block_update_free(&world->updates);
+  path_graph_free(&world->paths);
+  heightmap_free(&world->heightmap);
+  task_graph_wait(&world->pipeline.graph);
+  light_engine_free(&world->light_engine);
+
+  for (unsigned int i = 0; i < world->pipeline.tasks.size; i++) {
+    ChunkTask *task = &world->pipeline.tasks.data[i];
+
+    if (task->meshed) {
+      vector_free_float(&task->mesh.vertices);
+      vector_free_float(&task->mesh.normals);
+    }
+  }
+
   for (unsigned int x = 0; x < render_distance; x++) {
     for (unsigned int y = 0; y < render_distance; y++) {
       for (unsigned int z = 0; z < render_distance; z++) {
         Chunk *chunk = world->chunks[x][y][z];
-        if (chunk == NULL) {
-          continue;
-        }
 
-        free(chunk);
+        if (chunk->loaded) {
+          chunk_free(chunk);
+        }
       }
     }
   }
 
-  free(world->chunk_thread_data.chunks);
-  free(world->chunk_thread_data.out);
+  for (unsigned int i = 0; i < world->uploads.size; i++) {
+    vector_free_float(&world->uploads.data[i].mesh.vertices);
+    vector_free_float(&world->uploads.data[i].mesh.normals);
+  }
+
+  free(world->chunk_storage);
+  free(world->views);
+  vector_free_ChunkUpload(&world->uploads);
+
+  epoch_flush();
+
+  task_graph_free(&world->pipeline.graph);
+  vector_free_ChunkTask(&world->pipeline.tasks);
+  free(world->pipeline.generate_nodes);
+  vector_free_ChunkPointer(&world->loaded_chunks);
 }
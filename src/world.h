@@ -1,7 +1,17 @@
 #pragma once
 
+#include "block_update.h"
 #include "camera.h"
 #include "chunk.h"
+#include "fluid.h"
+#include "heightmap.h"
+#include "light.h"
+#include "path.h"
+#include "prefetch.h"
+#include "residency.h"
+#include "task_graph.h"
+#include "thread_pool.h"
+#include <stdint.h>
 #include <threads.h>
 
 #define render_distance 16
@@ -13,29 +23,134 @@ typedef struct VoxelShader {
   unsigned int projection_matrix_uniform;
   unsigned int view_matrix_uniform;
   unsigned int chunk_position_uniform;
+  unsigned int chunk_size_uniform;
+  unsigned int alpha_uniform;
 } VoxelShader;
 
-typedef struct ChunkThreadData {
-  Chunk **chunks;
-  Mesh *out;
-  unsigned int size;
-  bool world_thread_busy;
+typedef enum ChunkTaskKind {
+  CHUNK_TASK_GENERATE,
+  CHUNK_TASK_MESH,
+  CHUNK_TASK_BORDER,
+} ChunkTaskKind;
+
+typedef struct ChunkTask {
+  ChunkTaskKind kind;
+  Chunk *chunk;
+  Vec3i position;
+  unsigned int generation;
+  uint8_t border_sides;
+  uint8_t neighbours;
+  uint8_t sections;
+  bool meshed;
+  bool stale;
+  Mesh mesh;
   World *world;
-} ChunkThreadData;
+} ChunkTask;
+
+MakeVectorDeclaration(ChunkTask);
+
+typedef struct ChunkView {
+  Vec3i position;
+  unsigned int vertex_buffer;
+  unsigned int normal_buffer;
+  MeshSections sections;
+  bool loaded;
+} ChunkView;
+
+typedef struct ChunkUpload {
+  unsigned int slot;
+  Vec3i position;
+  bool release;
+  Mesh mesh;
+} ChunkUpload;
+
+MakeVectorDeclaration(ChunkUpload);
+
+typedef struct ChunkPipeline {
+  TaskGraph graph;
+  Vector_ChunkTask tasks;
+  unsigned int *generate_nodes;
+  Vec3i center;
+} ChunkPipeline;
+
+typedef struct WorldStats {
+  unsigned int chunks_generated;
+  unsigned int chunks_meshed;
+  unsigned int prefetch_hits;
+  unsigned int residency_hits;
+  unsigned int unmeshed_chunks;
+  unsigned int meshes_avoided;
+  unsigned int stale_dropped;
+  unsigned int unloads_deferred;
+  unsigned int mesh_queue;
+  unsigned int light_queue;
+  unsigned int sections_uploaded;
+  unsigned int buffers_grown;
+  size_t bytes_uploaded;
+  unsigned int mesh_latency_count;
+  double mesh_latency_total;
+  double mesh_latency_max;
+  double load_time;
+} WorldStats;
 
 typedef struct World {
   Chunk *chunks[render_distance][render_distance][render_distance];
+  Chunk *chunk_storage;
+  ChunkView *views;
+  Vector_ChunkUpload uploads;
+  ChunkPipeline pipeline;
   VoxelShader shader;
-  thrd_t world_thread;
-  ChunkThreadData chunk_thread_data;
+  Vector_ChunkPointer loaded_chunks;
+  LightEngine light_engine;
+  FluidEngine fluid;
+  BlockUpdateScheduler updates;
+  PathGraph paths;
+  Heightmap heightmap;
+  ChunkPrefetch prefetch;
+  ChunkResidency residency;
+  WorldStats stats;
+  bool headless;
+  bool remote;
+  bool defer_uploads;
 } World;
 
+void world_init_headless(World *world);
+
 void world_init(World *world);
 
+const Vec3i *world_window_offsets(void);
+
+unsigned int world_fill(World *world, const Vec3i center);
+
+bool world_busy(World *world);
+
+void world_wait(World *world);
+
+void world_install_chunk(World *world, const Vec3i position, VoxelNode root);
+
 Chunk *world_get_chunk(const World *world, const Vec3i position);
 
+Chunk *world_get_loaded_chunk(const World *world, const Vec3i position);
+
+const ChunkSnapshot *world_get_snapshot(const World *world,
+                                        const Vec3i position);
+
+uint8_t world_present_neighbours(const World *world, const Vec3i position);
+
+void world_block_to_chunk(const Vec3i block, Vec3i chunk_position,
+                          Vec3i local);
+
+BlockType world_get_block_type(const World *world, const Vec3i block);
+
+void world_set_block_type(World *world, const Vec3i block,
+                          BlockType block_type);
+
+double world_now(void);
+
 void world_load(World *world, Camera *camera);
 
+unsigned int world_apply_uploads(World *world, Vector_ChunkUpload *uploads);
+
 void world_render(World *world, Camera *camera);
 
 void world_free(World *world);